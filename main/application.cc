@@ -8,10 +8,16 @@
 #include "assets/lang_config.h"
 #include "mcp_server.h"
 #include "assets.h"
-#include "settings.h"
+#include "settings_schema.h"
+#include "boot_trace.h"
+#include "json_writer.h"
+#include "status_store.h"
 
 #include <cstring>
+#include <algorithm>
+#include <iterator>
 #include <esp_log.h>
+#include <freertos/semphr.h>
 #include <cJSON.h>
 #include <driver/gpio.h>
 #include <arpa/inet.h>
@@ -69,6 +75,33 @@ Application::~Application() {
     vEventGroupDelete(event_group_);
 }
 
+bool Application::HasPendingAssetsDownload() {
+    if (!Assets::GetInstance().partition_valid()) {
+        return false;
+    }
+    return !SettingsSchema::kAssetsDownloadUrl.Get().empty();
+}
+
+void Application::ApplyAssets() {
+    BootTraceScope trace("assets.apply");
+    auto& assets = Assets::GetInstance();
+    if (!assets.partition_valid()) {
+        ESP_LOGW(TAG, "Assets partition is disabled for board %s", BOARD_NAME);
+        return;
+    }
+
+    assets.Apply();
+    // Runs while the network starts, so Wi-Fi config mode may already show its hint. Only the
+    // boot screen is reset, checked under the display lock that the config mode alert also takes
+    auto display = Board::GetInstance().GetDisplay();
+    DisplayLockGuard lock(display);
+    if (device_state_ != kDeviceStateStarting) {
+        return;
+    }
+    display->SetChatMessage("system", "");
+    display->SetEmotion("microchip_ai");
+}
+
 void Application::CheckAssetsVersion() {
     auto& board = Board::GetInstance();
     auto display = board.GetDisplay();
@@ -79,13 +112,10 @@ void Application::CheckAssetsVersion() {
         return;
     }
     
-    Settings settings("assets", true);
     // Check if there is a new assets need to be downloaded
-    std::string download_url = settings.GetString("download_url");
+    std::string download_url = SettingsSchema::kAssetsDownloadUrl.Get();
 
     if (!download_url.empty()) {
-        settings.EraseKey("download_url");
-
         char message[256];
         snprintf(message, sizeof(message), Lang::Strings::FOUND_NEW_ASSETS, download_url.c_str());
         Alert(Lang::Strings::LOADING_ASSETS, message, "cloud_arrow_down", Lang::Sounds::OGG_UPGRADE);
@@ -108,28 +138,31 @@ void Application::CheckAssetsVersion() {
         vTaskDelay(pdMS_TO_TICKS(1000));
 
         if (!success) {
+            // Keep the url, the download resumes from where it stopped on the next boot
             Alert(Lang::Strings::ERROR, Lang::Strings::DOWNLOAD_ASSETS_FAILED, "circle_xmark", Lang::Sounds::OGG_EXCLAMATION);
             vTaskDelay(pdMS_TO_TICKS(2000));
             return;
         }
+        SettingsSchema::kAssetsDownloadUrl.Erase();
     }
 
-    // Apply assets
-    assets.Apply();
-    display->SetChatMessage("system", "");
-    display->SetEmotion("microchip_ai");
+    ApplyAssets();
 }
 
-void Application::CheckNewVersion(Ota& ota) {
+// In background mode the device is already usable with the cached protocol config,
+// so the check stays silent unless an upgrade or activation needs the screen
+void Application::CheckNewVersion(Ota& ota, bool in_background) {
     const int MAX_RETRY = 10;
     int retry_count = 0;
     int retry_delay = 10; // 初始重试延迟为10秒
 
     auto& board = Board::GetInstance();
     while (true) {
-        SetDeviceState(kDeviceStateActivating);
         auto display = board.GetDisplay();
-        display->SetStatus(Lang::Strings::CHECKING_NEW_VERSION);
+        if (!in_background) {
+            SetDeviceState(kDeviceStateActivating);
+            display->SetStatus(Lang::Strings::CHECKING_NEW_VERSION);
+        }
 
         if (!ota.CheckVersion()) {
             retry_count++;
@@ -138,14 +171,16 @@ void Application::CheckNewVersion(Ota& ota) {
                 return;
             }
 
-            char buffer[256];
-            snprintf(buffer, sizeof(buffer), Lang::Strings::CHECK_NEW_VERSION_FAILED, retry_delay, ota.GetCheckVersionUrl().c_str());
-            Alert(Lang::Strings::ERROR, buffer, "cloud_slash", Lang::Sounds::OGG_EXCLAMATION);
+            if (!in_background) {
+                char buffer[256];
+                snprintf(buffer, sizeof(buffer), Lang::Strings::CHECK_NEW_VERSION_FAILED, retry_delay, ota.GetCheckVersionUrl().c_str());
+                Alert(Lang::Strings::ERROR, buffer, "cloud_slash", Lang::Sounds::OGG_EXCLAMATION);
+            }
 
             ESP_LOGW(TAG, "Check new version failed, retry in %d seconds (%d/%d)", retry_delay, retry_count, MAX_RETRY);
             for (int i = 0; i < retry_delay; i++) {
                 vTaskDelay(pdMS_TO_TICKS(1000));
-                if (device_state_ == kDeviceStateIdle) {
+                if (!in_background && device_state_ == kDeviceStateIdle) {
                     break;
                 }
             }
@@ -156,7 +191,10 @@ void Application::CheckNewVersion(Ota& ota) {
         retry_delay = 10; // 重置重试延迟时间
 
         if (ota.HasNewVersion()) {
-            if (UpgradeFirmware(ota)) {
+            if (in_background) {
+                // The device stays usable while the new firmware is downloaded, and boots it when idle
+                StageFirmwareUpgrade(ota);
+            } else if (UpgradeFirmware(ota)) {
                 return; // This line will never be reached after reboot
             }
             // If upgrade failed, continue to normal operation (don't break, just fall through)
@@ -170,10 +208,19 @@ void Application::CheckNewVersion(Ota& ota) {
             break;
         }
 
-        display->SetStatus(Lang::Strings::ACTIVATION);
-        // Activation code is shown to the user and waiting for the user to input
-        if (ota.HasActivationCode()) {
-            ShowActivationCode(ota.GetActivationCode(), ota.GetActivationMessage());
+        auto show_activation = [this, &ota, display]() {
+            SetDeviceState(kDeviceStateActivating);
+            display->SetStatus(Lang::Strings::ACTIVATION);
+            // Activation code is shown to the user and waiting for the user to input
+            if (ota.HasActivationCode()) {
+                ShowActivationCode(ota.GetActivationCode(), ota.GetActivationMessage());
+            }
+        };
+        if (in_background) {
+            // Do not interrupt a conversation, take over the screen once the device is idle
+            RunWhenIdle(show_activation);
+        } else {
+            show_activation();
         }
 
         // This will block the loop until the activation is done or timeout
@@ -195,6 +242,70 @@ void Application::CheckNewVersion(Ota& ota) {
     }
 }
 
+// Called from background tasks, returns once the callback has run on the main task while idle
+void Application::RunWhenIdle(std::function<void()> callback) {
+    auto done = xSemaphoreCreateBinary();
+    bool ran = false;
+    while (!ran) {
+        while (device_state_ != kDeviceStateIdle) {
+            vTaskDelay(pdMS_TO_TICKS(1000));
+        }
+        // The state may change before the main task gets to it, so it is checked again there
+        Schedule([this, &callback, &ran, done]() {
+            if (device_state_ == kDeviceStateIdle) {
+                callback();
+                ran = true;
+            }
+            xSemaphoreGive(done);
+        });
+        xSemaphoreTake(done, portMAX_DELAY);
+    }
+    vSemaphoreDelete(done);
+}
+
+std::string Application::GetCachedProtocolType() {
+    // Written after every successful version check
+    auto type = SettingsSchema::kProtocol.Get();
+    if (!type.empty()) {
+        return type;
+    }
+    // Devices upgraded from older firmware only have the protocol settings
+    if (!SettingsSchema::kMqttEndpoint.Get().empty()) {
+        return "mqtt";
+    }
+    if (!SettingsSchema::kWebsocketUrl.Get().empty()) {
+        return "websocket";
+    }
+    return "";
+}
+
+void Application::OnBackgroundVersionChecked() {
+    Schedule([this]() {
+        if (device_state_ == kDeviceStateActivating) {
+            SetDeviceState(kDeviceStateIdle);
+        }
+    });
+    has_server_time_ = ota_->HasServerTime();
+
+    std::string type = ota_->HasMqttConfig() ? "mqtt" : (ota_->HasWebsocketConfig() ? "websocket" : "");
+    if (type.empty()) {
+        return;
+    }
+    SettingsSchema::kProtocol.Set(type);
+    if (type != protocol_type_) {
+        // Endpoint changes are picked up on the next connection, only a new protocol needs a restart
+        ESP_LOGW(TAG, "Protocol changed from %s to %s", protocol_type_.c_str(), type.c_str());
+        Schedule([this, type]() {
+            if (device_state_ != kDeviceStateIdle) {
+                ESP_LOGW(TAG, "Device is busy, the new protocol is used after reboot");
+                return;
+            }
+            InitializeProtocol(type);
+            protocol_->Start();
+        });
+    }
+}
+
 void Application::ShowActivationCode(const std::string& code, const std::string& message) {
     struct digit_sound {
         char digit;
@@ -346,7 +457,10 @@ void Application::StopListening() {
 }
 
 void Application::Start() {
+    auto& boot_trace = BootTrace::GetInstance();
+    int board_trace = boot_trace.Begin("board");
     auto& board = Board::GetInstance();
+    boot_trace.End(board_trace);
     SetDeviceState(kDeviceStateStarting);
 
     /* Setup the display */
@@ -357,8 +471,11 @@ void Application::Start() {
 
     /* Setup the audio service */
     auto codec = board.GetAudioCodec();
-    audio_service_.Initialize(codec);
-    audio_service_.Start();
+    {
+        BootTraceScope trace("audio.initialize");
+        audio_service_.Initialize(codec);
+        audio_service_.Start();
+    }
 
     AudioServiceCallbacks callbacks;
     callbacks.on_send_queue_available = [this]() {
@@ -381,18 +498,50 @@ void Application::Start() {
     /* Start the clock timer to update the status bar */
     esp_timer_start_periodic(clock_timer_handle_, 1000000);
 
+    /* Apply the local assets (fonts, emoji, models) while the network is connecting */
+    bool assets_download_pending = HasPendingAssetsDownload();
+    if (!assets_download_pending) {
+        xTaskCreate([](void* arg) {
+            Application* app = (Application*)arg;
+            app->ApplyAssets();
+            xEventGroupSetBits(app->event_group_, MAIN_EVENT_ASSETS_APPLIED);
+            vTaskDelete(NULL);
+        }, "apply_assets", 4096 * 3, this, 2, NULL);
+    }
+
     /* Wait for the network to be ready */
-    board.StartNetwork();
+    {
+        BootTraceScope trace("network");
+        board.StartNetwork();
+    }
 
     // Update the status bar immediately to show the network state
     display->UpdateStatusBar(true);
 
-    // Check for new assets version
-    CheckAssetsVersion();
+    if (assets_download_pending) {
+        // New assets replace the partition, so nothing may be applied before the download
+        CheckAssetsVersion();
+    } else {
+        BootTraceScope trace("assets.wait");
+        xEventGroupWaitBits(event_group_, MAIN_EVENT_ASSETS_APPLIED, pdTRUE, pdTRUE, portMAX_DELAY);
+    }
 
-    // Check for new firmware version or get the MQTT broker address
-    Ota ota;
-    CheckNewVersion(ota);
+    // Start with the protocol config of the last boot, and check for new firmware in the background.
+    // Without a cached config the version check must finish first to get the server address
+    ota_ = std::make_unique<Ota>();
+    auto protocol_type = GetCachedProtocolType();
+    bool check_in_background = !protocol_type.empty();
+    if (!check_in_background) {
+        CheckNewVersion(*ota_);
+        protocol_type = ota_->HasWebsocketConfig() && !ota_->HasMqttConfig() ? "websocket" : "mqtt";
+        if (ota_->HasMqttConfig() || ota_->HasWebsocketConfig()) {
+            SettingsSchema::kProtocol.Set(protocol_type);
+        } else {
+            ESP_LOGW(TAG, "No protocol specified in the OTA config, using MQTT");
+        }
+    } else {
+        ESP_LOGI(TAG, "Using cached %s config, checking new version in background", protocol_type.c_str());
+    }
 
     // Initialize the protocol
     display->SetStatus(Lang::Strings::LOADING_PROTOCOL);
@@ -402,12 +551,51 @@ void Application::Start() {
     mcp_server.AddCommonTools();
     mcp_server.AddUserOnlyTools();
 
-    if (ota.HasMqttConfig()) {
-        protocol_ = std::make_unique<MqttProtocol>();
-    } else if (ota.HasWebsocketConfig()) {
+    InitializeProtocol(protocol_type);
+    bool protocol_started = false;
+    {
+        BootTraceScope trace("protocol.start");
+        protocol_started = protocol_->Start();
+    }
+
+    SystemInfo::PrintHeapStats();
+    SetDeviceState(kDeviceStateIdle);
+    boot_trace.Mark("ready");
+    boot_trace.Print();
+#if CONFIG_PRINT_BOOT_TRACE
+    boot_trace.PrintChromeTrace();
+#endif
+
+    if (check_in_background) {
+        xTaskCreate([](void* arg) {
+            Application* app = (Application*)arg;
+            app->CheckNewVersion(*app->ota_, true);
+            app->OnBackgroundVersionChecked();
+            app->check_new_version_task_handle_ = nullptr;
+            vTaskDelete(NULL);
+        }, "check_new_version", 4096 * 3, this, 2, &check_new_version_task_handle_);
+    } else {
+        has_server_time_ = ota_->HasServerTime();
+    }
+
+    if (protocol_started) {
+        std::string message = std::string(Lang::Strings::VERSION) + ota_->GetCurrentVersion();
+        display->ShowNotification(message.c_str());
+        display->SetChatMessage("system", "");
+        // Play the success sound to indicate the device is ready
+        audio_service_.PlaySound(Lang::Sounds::OGG_SUCCESS);
+    }
+}
+
+void Application::InitializeProtocol(const std::string& type) {
+    auto& board = Board::GetInstance();
+    auto display = board.GetDisplay();
+    auto codec = board.GetAudioCodec();
+
+    protocol_type_ = type;
+    if (type == "websocket") {
         protocol_ = std::make_unique<WebsocketProtocol>();
     } else {
-        ESP_LOGW(TAG, "No protocol specified in the OTA config, using MQTT");
         protocol_ = std::make_unique<MqttProtocol>();
     }
 
@@ -439,19 +627,19 @@ void Application::Start() {
             SetDeviceState(kDeviceStateIdle);
         });
     });
-    protocol_->OnIncomingJson([this, display](const cJSON* root) {
-        // Parse JSON data
-        auto type = cJSON_GetObjectItem(root, "type");
-        if (strcmp(type->valuestring, "tts") == 0) {
-            auto state = cJSON_GetObjectItem(root, "state");
-            if (strcmp(state->valuestring, "start") == 0) {
+    protocol_->OnIncomingJson([this, display](const JsonValue& root) {
+        // Dispatch on the message type straight from the receive buffer
+        auto type = root["type"];
+        if (type.Equals("tts")) {
+            auto state = root["state"];
+            if (state.Equals("start")) {
                 Schedule([this]() {
                     aborted_ = false;
                     if (device_state_ == kDeviceStateIdle || device_state_ == kDeviceStateListening) {
                         SetDeviceState(kDeviceStateSpeaking);
                     }
                 });
-            } else if (strcmp(state->valuestring, "stop") == 0) {
+            } else if (state.Equals("stop")) {
                 Schedule([this]() {
                     if (device_state_ == kDeviceStateSpeaking) {
                         if (listening_mode_ == kListeningModeManualStop) {
@@ -461,63 +649,72 @@ void Application::Start() {
                         }
                     }
                 });
-            } else if (strcmp(state->valuestring, "sentence_start") == 0) {
-                auto text = cJSON_GetObjectItem(root, "text");
-                if (cJSON_IsString(text)) {
-                    ESP_LOGI(TAG, "<< %s", text->valuestring);
-                    Schedule([this, display, message = std::string(text->valuestring)]() {
+            } else if (state.Equals("sentence_start")) {
+                auto text = root["text"];
+                if (text.IsString()) {
+                    auto message = text.GetString();
+                    ESP_LOGI(TAG, "<< %s", message.c_str());
+                    Schedule([this, display, message = std::move(message)]() {
                         display->SetChatMessage("assistant", message.c_str());
                     });
                 }
             }
-        } else if (strcmp(type->valuestring, "stt") == 0) {
-            auto text = cJSON_GetObjectItem(root, "text");
-            if (cJSON_IsString(text)) {
-                ESP_LOGI(TAG, ">> %s", text->valuestring);
-                Schedule([this, display, message = std::string(text->valuestring)]() {
+        } else if (type.Equals("stt")) {
+            auto text = root["text"];
+            if (text.IsString()) {
+                auto message = text.GetString();
+                ESP_LOGI(TAG, ">> %s", message.c_str());
+                Schedule([this, display, message = std::move(message)]() {
                     display->SetChatMessage("user", message.c_str());
                 });
             }
-        } else if (strcmp(type->valuestring, "llm") == 0) {
-            auto emotion = cJSON_GetObjectItem(root, "emotion");
-            if (cJSON_IsString(emotion)) {
-                Schedule([this, display, emotion_str = std::string(emotion->valuestring)]() {
+        } else if (type.Equals("llm")) {
+            auto emotion = root["emotion"];
+            if (emotion.IsString()) {
+                Schedule([this, display, emotion_str = emotion.GetString()]() {
                     display->SetEmotion(emotion_str.c_str());
                 });
             }
-        } else if (strcmp(type->valuestring, "mcp") == 0) {
-            auto payload = cJSON_GetObjectItem(root, "payload");
-            if (cJSON_IsObject(payload)) {
-                McpServer::GetInstance().ParseMessage(payload);
+        } else if (type.Equals("mcp")) {
+            auto payload = root["payload"];
+            if (payload.IsObject()) {
+                // The MCP server works on a full tree, build it only for MCP messages
+                cJSON* json = payload.ToCJSON();
+                if (json != nullptr) {
+                    McpServer::GetInstance().ParseMessage(json);
+                    cJSON_Delete(json);
+                }
             }
-        } else if (strcmp(type->valuestring, "system") == 0) {
-            auto command = cJSON_GetObjectItem(root, "command");
-            if (cJSON_IsString(command)) {
-                ESP_LOGI(TAG, "System command: %s", command->valuestring);
-                if (strcmp(command->valuestring, "reboot") == 0) {
+        } else if (type.Equals("system")) {
+            auto command = root["command"];
+            if (command.IsString()) {
+                auto command_str = command.GetString();
+                ESP_LOGI(TAG, "System command: %s", command_str.c_str());
+                if (command_str == "reboot") {
                     // Do a reboot if user requests a OTA update
                     Schedule([this]() {
                         Reboot();
                     });
                 } else {
-                    ESP_LOGW(TAG, "Unknown system command: %s", command->valuestring);
+                    ESP_LOGW(TAG, "Unknown system command: %s", command_str.c_str());
                 }
             }
-        } else if (strcmp(type->valuestring, "alert") == 0) {
-            auto status = cJSON_GetObjectItem(root, "status");
-            auto message = cJSON_GetObjectItem(root, "message");
-            auto emotion = cJSON_GetObjectItem(root, "emotion");
-            if (cJSON_IsString(status) && cJSON_IsString(message) && cJSON_IsString(emotion)) {
-                Alert(status->valuestring, message->valuestring, emotion->valuestring, Lang::Sounds::OGG_VIBRATION);
+        } else if (type.Equals("alert")) {
+            auto status = root["status"];
+            auto message = root["message"];
+            auto emotion = root["emotion"];
+            if (status.IsString() && message.IsString() && emotion.IsString()) {
+                Alert(status.GetString().c_str(), message.GetString().c_str(), emotion.GetString().c_str(), Lang::Sounds::OGG_VIBRATION);
             } else {
                 ESP_LOGW(TAG, "Alert command requires status, message and emotion");
             }
 #if CONFIG_RECEIVE_CUSTOM_MESSAGE
-        } else if (strcmp(type->valuestring, "custom") == 0) {
-            auto payload = cJSON_GetObjectItem(root, "payload");
-            ESP_LOGI(TAG, "Received custom message: %s", cJSON_PrintUnformatted(root));
-            if (cJSON_IsObject(payload)) {
-                Schedule([this, display, payload_str = std::string(cJSON_PrintUnformatted(payload))]() {
+        } else if (type.Equals("custom")) {
+            auto payload = root["payload"];
+            auto message = root.raw();
+            ESP_LOGI(TAG, "Received custom message: %.*s", (int)message.size(), message.data());
+            if (payload.IsObject()) {
+                Schedule([this, display, payload_str = std::string(payload.raw())]() {
                     display->SetChatMessage("system", payload_str.c_str());
                 });
             } else {
@@ -525,22 +722,9 @@ void Application::Start() {
             }
 #endif
         } else {
-            ESP_LOGW(TAG, "Unknown message type: %s", type->valuestring);
+            ESP_LOGW(TAG, "Unknown message type: %s", type.GetString().c_str());
         }
     });
-    bool protocol_started = protocol_->Start();
-
-    SystemInfo::PrintHeapStats();
-    SetDeviceState(kDeviceStateIdle);
-
-    has_server_time_ = ota.HasServerTime();
-    if (protocol_started) {
-        std::string message = std::string(Lang::Strings::VERSION) + ota.GetCurrentVersion();
-        display->ShowNotification(message.c_str());
-        display->SetChatMessage("system", "");
-        // Play the success sound to indicate the device is ready
-        audio_service_.PlaySound(Lang::Sounds::OGG_SUCCESS);
-    }
 }
 
 // Add a async task to MainLoop
@@ -601,7 +785,19 @@ void Application::MainEventLoop() {
             clock_ticks_++;
             auto display = Board::GetInstance().GetDisplay();
             display->UpdateStatusBar();
+
+            // Poll the battery of boards without a battery monitor every 10 seconds, the network
+            // icon is published by the boards when the connection changes
+            if (clock_ticks_ % 10 == 1) {
+                StatusStore::GetInstance().Refresh();
+            }
         
+            // Boot the staged firmware once the device has been left alone for a while
+            if (clock_ticks_ % 5 == 0 && HasStagedFirmware() && IsIdleWindow()) {
+                ESP_LOGI(TAG, "Idle window, rebooting into the staged firmware");
+                Reboot();
+            }
+
             // Print the debug info every 10 seconds
             if (clock_ticks_ % 10 == 0) {
                 // SystemInfo::PrintTaskCpuUsage(pdMS_TO_TICKS(1000));
@@ -671,6 +867,8 @@ void Application::SetDeviceState(DeviceState state) {
     clock_ticks_ = 0;
     auto previous_state = device_state_;
     device_state_ = state;
+    // Every change is activity, idle windows are measured from the last one
+    last_active_time_ = esp_timer_get_time();
     ESP_LOGI(TAG, "STATE: %s", STATE_STRINGS[device_state_]);
 
     // Send the state change event
@@ -729,12 +927,17 @@ void Application::Reboot() {
     }
     protocol_.reset();
     audio_service_.Stop();
+    Settings::Flush();
 
     vTaskDelay(pdMS_TO_TICKS(1000));
     esp_restart();
 }
 
 bool Application::UpgradeFirmware(Ota& ota, const std::string& url) {
+    if (upgrading_.exchange(true)) {
+        ESP_LOGW(TAG, "Firmware upgrade already in progress");
+        return false;
+    }
     auto& board = Board::GetInstance();
     auto display = board.GetDisplay();
     
@@ -776,6 +979,7 @@ bool Application::UpgradeFirmware(Ota& ota, const std::string& url) {
         board.SetPowerSaveMode(true); // Restore power save mode
         Alert(Lang::Strings::ERROR, Lang::Strings::UPGRADE_FAILED, "circle_xmark", Lang::Sounds::OGG_EXCLAMATION);
         vTaskDelay(pdMS_TO_TICKS(3000));
+        upgrading_ = false;
         return false;
     } else {
         // Upgrade success, reboot immediately
@@ -787,6 +991,123 @@ bool Application::UpgradeFirmware(Ota& ota, const std::string& url) {
     }
 }
 
+static DebugStatistics AudioStatisticsSince(const DebugStatistics& now, const DebugStatistics& before) {
+    DebugStatistics statistics;
+    statistics.playback_count = now.playback_count - before.playback_count;
+    statistics.playback_gap_count = now.playback_gap_count - before.playback_gap_count;
+    statistics.encode_count = now.encode_count - before.encode_count;
+    statistics.send_queue_peak = now.send_queue_peak;
+    return statistics;
+}
+
+/*
+ * Download the new firmware into the next OTA partition while the device keeps working.
+ * The download runs below the audio and network tasks and is throttled while the device
+ * is in use. Once written, the main loop boots the firmware in the next idle window, or any
+ * reboot before that does.
+ */
+bool Application::StageFirmwareUpgrade(Ota& ota) {
+    if (upgrading_.exchange(true)) {
+        ESP_LOGW(TAG, "Firmware upgrade already in progress, not staging %s", ota.GetFirmwareVersion().c_str());
+        return false;
+    }
+    // The running firmware got as far as a version check, keep it as the one to roll back to
+    ota.MarkCurrentVersionValid();
+    {
+        std::lock_guard<std::mutex> lock(upgrade_mutex_);
+        upgrade_stage_ = kUpgradeStageDownloading;
+        upgrade_version_ = ota.GetFirmwareVersion();
+        upgrade_progress_ = 0;
+        upgrade_speed_ = 0;
+        upgrade_start_time_ = upgrade_last_poll_time_ = esp_timer_get_time();
+        upgrade_throttled_us_ = 0;
+        audio_service_.ResetSendQueuePeak();
+        upgrade_audio_before_ = audio_service_.GetDebugStatistics();
+    }
+    ESP_LOGI(TAG, "Staging firmware %s in the background", ota.GetFirmwareVersion().c_str());
+
+    bool success;
+    ota.SetRateLimit([this]() { return GetUpgradeRateLimit(); });
+    {
+        TaskPriorityReset priority_reset(1);
+        success = ota.StartUpgrade([this](int progress, size_t speed) {
+            std::lock_guard<std::mutex> lock(upgrade_mutex_);
+            upgrade_progress_ = progress;
+            upgrade_speed_ = speed;
+        });
+    }
+    ota.SetRateLimit(nullptr);
+    upgrading_ = false;
+
+    {
+        std::lock_guard<std::mutex> lock(upgrade_mutex_);
+        upgrade_end_time_ = esp_timer_get_time();
+        upgrade_stage_ = success ? kUpgradeStageStaged : kUpgradeStageFailed;
+        upgrade_audio_during_ = AudioStatisticsSince(audio_service_.GetDebugStatistics(), upgrade_audio_before_);
+        ESP_LOGI(TAG, "Firmware download %s after %lld s, throttled for %lld s. Meanwhile %lu frames played with %lu gaps, "
+            "%lu frames encoded, send queue peak %lu", success ? "finished" : "failed",
+            (upgrade_end_time_ - upgrade_start_time_) / 1000000, upgrade_throttled_us_ / 1000000,
+            upgrade_audio_during_.playback_count, upgrade_audio_during_.playback_gap_count,
+            upgrade_audio_during_.encode_count, upgrade_audio_during_.send_queue_peak);
+    }
+    if (success) {
+        ESP_LOGI(TAG, "Firmware %s is staged, rebooting after %d seconds of idle", ota.GetFirmwareVersion().c_str(), UPGRADE_REBOOT_IDLE_SECONDS);
+    }
+    return success;
+}
+
+bool Application::HasStagedFirmware() {
+    std::lock_guard<std::mutex> lock(upgrade_mutex_);
+    return upgrade_stage_ == kUpgradeStageStaged;
+}
+
+size_t Application::GetUpgradeRateLimit() {
+    bool busy = device_state_ != kDeviceStateIdle || (protocol_ && protocol_->IsAudioChannelOpened()) ||
+        !audio_service_.IsIdle();
+    auto now = esp_timer_get_time();
+    std::lock_guard<std::mutex> lock(upgrade_mutex_);
+    if (busy) {
+        upgrade_throttled_us_ += now - upgrade_last_poll_time_;
+    }
+    upgrade_last_poll_time_ = now;
+    return busy ? UPGRADE_BUSY_BYTES_PER_SECOND : 0;
+}
+
+bool Application::IsIdleWindow() {
+    return CanEnterSleepMode() && esp_timer_get_time() - last_active_time_ >= UPGRADE_REBOOT_IDLE_SECONDS * 1000000LL;
+}
+
+std::string Application::GetUpgradeStatusJson() {
+    static const char* const stage_names[] = { "none", "downloading", "staged", "failed" };
+    auto now = esp_timer_get_time();
+    std::lock_guard<std::mutex> lock(upgrade_mutex_);
+    JsonWriter json;
+    json.BeginObject();
+    json.Member("stage", stage_names[upgrade_stage_]);
+    if (upgrade_stage_ != kUpgradeStageNone) {
+        bool downloading = upgrade_stage_ == kUpgradeStageDownloading;
+        json.Member("version", upgrade_version_);
+        json.Member("progress", upgrade_progress_);
+        json.Member("speed", upgrade_speed_);
+        json.Member("elapsed_seconds", ((downloading ? now : upgrade_end_time_) - upgrade_start_time_) / 1000000);
+        json.Member("throttled_seconds", upgrade_throttled_us_ / 1000000);
+        auto audio = downloading ? AudioStatisticsSince(audio_service_.GetDebugStatistics(), upgrade_audio_before_)
+                                 : upgrade_audio_during_;
+        json.Key("audio").BeginObject();
+        json.Member("playback_frames", audio.playback_count);
+        json.Member("playback_gaps", audio.playback_gap_count);
+        json.Member("encoded_frames", audio.encode_count);
+        json.Member("send_queue_peak", audio.send_queue_peak);
+        json.EndObject();
+    }
+    if (upgrade_stage_ == kUpgradeStageStaged) {
+        json.Member("idle_seconds", (now - last_active_time_.load()) / 1000000);
+        json.Member("reboot_after_idle_seconds", UPGRADE_REBOOT_IDLE_SECONDS);
+    }
+    json.EndObject();
+    return json.Release();
+}
+
 void Application::WakeWordInvoke(const std::string& wake_word) {
     if (device_state_ == kDeviceStateIdle) {
         ToggleChatState();
@@ -8,6 +8,7 @@
 
 #include <string>
 #include <mutex>
+#include <atomic>
 #include <deque>
 #include <memory>
 
@@ -24,7 +25,21 @@
 #define MAIN_EVENT_ERROR (1 << 4)
 #define MAIN_EVENT_CHECK_NEW_VERSION_DONE (1 << 5)
 #define MAIN_EVENT_CLOCK_TICK (1 << 6)
+#define MAIN_EVENT_ASSETS_APPLIED (1 << 7)
 
+// A firmware staged in the background downloads at most this fast while the device is in use,
+// so the conversation keeps its share of the link
+#define UPGRADE_BUSY_BYTES_PER_SECOND (16 * 1024)
+// The staged firmware is booted once the device has been idle this long
+#define UPGRADE_REBOOT_IDLE_SECONDS 120
+
+
+enum UpgradeStage {
+    kUpgradeStageNone,
+    kUpgradeStageDownloading,
+    kUpgradeStageStaged,        // Written and set as the boot partition, waiting for an idle window
+    kUpgradeStageFailed,
+};
 
 enum AecMode {
     kAecOff,
@@ -57,7 +72,10 @@ public:
     void Reboot();
     void WakeWordInvoke(const std::string& wake_word);
     bool UpgradeFirmware(Ota& ota, const std::string& url = "");
+    bool IsUpgrading() const { return upgrading_; }
     bool CanEnterSleepMode();
+    // Progress of the firmware upgrade staged in the background, and how audio fared meanwhile
+    std::string GetUpgradeStatusJson();
     void SendMcpMessage(const std::string& payload);
     void SetAecMode(AecMode mode);
     AecMode GetAecMode() const { return aec_mode_; }
@@ -71,6 +89,8 @@ private:
     std::mutex mutex_;
     std::deque<std::function<void()>> main_tasks_;
     std::unique_ptr<Protocol> protocol_;
+    std::string protocol_type_;
+    std::unique_ptr<Ota> ota_;
     EventGroupHandle_t event_group_ = nullptr;
     esp_timer_handle_t clock_timer_handle_ = nullptr;
     volatile DeviceState device_state_ = kDeviceStateUnknown;
@@ -79,15 +99,41 @@ private:
     std::string last_error_message_;
     AudioService audio_service_;
 
-    bool has_server_time_ = false;
+    std::atomic<bool> has_server_time_{false};
     bool aborted_ = false;
     int clock_ticks_ = 0;
     TaskHandle_t check_new_version_task_handle_ = nullptr;
+    std::atomic<int64_t> last_active_time_{0};
+    // Set while new firmware is being written, by the background stage or a manual upgrade
+    std::atomic<bool> upgrading_{false};
+
+    // Background upgrade, guarded by upgrade_mutex_
+    std::mutex upgrade_mutex_;
+    UpgradeStage upgrade_stage_ = kUpgradeStageNone;
+    std::string upgrade_version_;
+    int upgrade_progress_ = 0;
+    size_t upgrade_speed_ = 0;
+    int64_t upgrade_start_time_ = 0;
+    int64_t upgrade_end_time_ = 0;
+    int64_t upgrade_throttled_us_ = 0;
+    int64_t upgrade_last_poll_time_ = 0;
+    DebugStatistics upgrade_audio_before_;
+    DebugStatistics upgrade_audio_during_;
     TaskHandle_t main_event_loop_task_handle_ = nullptr;
 
     void OnWakeWordDetected();
-    void CheckNewVersion(Ota& ota);
+    void CheckNewVersion(Ota& ota, bool in_background = false);
+    void OnBackgroundVersionChecked();
+    void RunWhenIdle(std::function<void()> callback);
+    bool StageFirmwareUpgrade(Ota& ota);
+    bool HasStagedFirmware();
+    size_t GetUpgradeRateLimit();
+    bool IsIdleWindow();
+    bool HasPendingAssetsDownload();
     void CheckAssetsVersion();
+    void ApplyAssets();
+    std::string GetCachedProtocolType();
+    void InitializeProtocol(const std::string& type);
     void ShowActivationCode(const std::string& code, const std::string& message);
     void SetListeningMode(ListeningMode mode);
 };
@@ -4,11 +4,21 @@
 #include "application.h"
 #include "lvgl_theme.h"
 #include "emote_display.h"
+#include "boot_trace.h"
+#include "settings_schema.h"
+#include "http_downloader.h"
+#include "gif/gif_frame_cache.h"
 
 #include <esp_log.h>
 #include <spi_flash_mmap.h>
 #include <esp_timer.h>
+#include <esp_rom_crc.h>
+#include <esp_heap_caps.h>
 #include <cbin_font.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <cstring>
+#include <algorithm>
 
 
 #define TAG "Assets"
@@ -28,23 +38,44 @@ Assets::Assets() {
 }
 
 Assets::~Assets() {
+    FreeCache();
     if (mmap_handle_ != 0) {
         esp_partition_munmap(mmap_handle_);
     }
 }
 
 uint32_t Assets::CalculateChecksum(const char* data, uint32_t length) {
+    // Sum of all bytes, one word at a time: each 16-bit lane of the accumulator collects
+    // two bytes per word and is flushed before it can overflow
+    auto bytes = reinterpret_cast<const uint8_t*>(data);
     uint32_t checksum = 0;
-    for (uint32_t i = 0; i < length; i++) {
-        checksum += data[i];
+    uint32_t i = 0;
+    while (i < length && (reinterpret_cast<uintptr_t>(bytes + i) & 3) != 0) {
+        checksum += bytes[i++];
+    }
+    while (length - i >= 4) {
+        uint32_t words = std::min<uint32_t>((length - i) / 4, 128);
+        uint32_t lanes = 0;
+        for (uint32_t j = 0; j < words; j++, i += 4) {
+            uint32_t word = *reinterpret_cast<const uint32_t*>(bytes + i);
+            lanes += (word & 0x00FF00FF) + ((word >> 8) & 0x00FF00FF);
+        }
+        checksum += (lanes & 0xFFFF) + (lanes >> 16);
+    }
+    while (i < length) {
+        checksum += bytes[i++];
     }
     return checksum & 0xFFFF;
 }
 
 bool Assets::InitializePartition() {
+    BootTraceScope trace("assets.partition");
     partition_valid_ = false;
     checksum_valid_ = false;
-    assets_.clear();
+    asset_count_ = 0;
+    sorted_index_.clear();
+    // 重新映射后旧地址可能对应另一份GIF数据
+    GifFrameCache::GetInstance().Clear();
 
     partition_ = esp_partition_find_first(ESP_PARTITION_TYPE_ANY, ESP_PARTITION_SUBTYPE_ANY, "assets");
     if (partition_ == nullptr) {
@@ -77,30 +108,192 @@ bool Assets::InitializePartition() {
         ESP_LOGD(TAG, "The stored_len (0x%lx) is greater than the partition size (0x%lx) - 12", stored_len, partition_->size);
         return false;
     }
+    if (stored_files > stored_len / sizeof(mmap_assets_table)) {
+        ESP_LOGE(TAG, "The stored_files (%lu) does not fit in stored_len (0x%lx)", stored_files, stored_len);
+        return false;
+    }
 
-    auto start_time = esp_timer_get_time();
-    uint32_t calculated_checksum = CalculateChecksum(mmap_root_ + 12, stored_len);
-    auto end_time = esp_timer_get_time();
-    ESP_LOGI(TAG, "The checksum calculation time is %d ms", int((end_time - start_time) / 1000));
+    {
+        std::lock_guard<std::mutex> lock(verify_mutex_);
+        verify_generation_++;
+        block_state_.clear();
+        data_length_ = stored_len;
+    }
 
-    if (calculated_checksum != stored_chksum) {
-        ESP_LOGE(TAG, "The calculated checksum (0x%lx) does not match the stored checksum (0x%lx)", calculated_checksum, stored_chksum);
-        return false;
+    // The result of a full verification is cached in NVS, so the data is only read again after it changes
+    uint32_t verified = (uint32_t)SettingsSchema::kAssetsVerified.Get();
+    if (LoadHashTable(stored_len)) {
+        // The table says nothing about the data behind it, the last block is written last by a download
+        if (verified != 0 && verified == fingerprint_ && VerifyRange(12 + stored_len - 1, 1)) {
+            std::lock_guard<std::mutex> lock(verify_mutex_);
+            block_state_.clear();
+        } else if (!VerifyRange(12, stored_files * sizeof(mmap_assets_table))) {
+            // The asset table is needed right now, the data blocks are verified on first access
+            ESP_LOGE(TAG, "The assets table is corrupted");
+            return false;
+        }
+    } else {
+        fingerprint_ = esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(mmap_root_), 12);
+        if (verified == 0 || verified != fingerprint_) {
+            int checksum_trace = BootTrace::GetInstance().Begin("assets.checksum");
+            uint32_t calculated_checksum = CalculateChecksum(mmap_root_ + 12, stored_len);
+            BootTrace::GetInstance().End(checksum_trace);
+
+            if (calculated_checksum != stored_chksum) {
+                ESP_LOGE(TAG, "The calculated checksum (0x%lx) does not match the stored checksum (0x%lx)", calculated_checksum, stored_chksum);
+                return false;
+            }
+            SettingsSchema::kAssetsVerified.Set((int32_t)fingerprint_);
+        }
     }
 
     checksum_valid_ = true;
 
-    for (uint32_t i = 0; i < stored_files; i++) {
-        auto item = (const mmap_assets_table*)(mmap_root_ + 12 + i * sizeof(mmap_assets_table));
-        auto asset = Asset{
-            .size = static_cast<size_t>(item->asset_size),
-            .offset = static_cast<size_t>(12 + sizeof(mmap_assets_table) * stored_files + item->asset_offset)
-        };
-        assets_[item->asset_name] = asset;
+    auto table = reinterpret_cast<const mmap_assets_table*>(mmap_root_ + 12);
+    bool sorted = true;
+    for (uint32_t i = 1; i < stored_files && sorted; i++) {
+        sorted = strncmp(table[i - 1].asset_name, table[i].asset_name, sizeof(table[i].asset_name)) <= 0;
     }
+    if (!sorted) {
+        if (stored_files > UINT16_MAX) {
+            ESP_LOGE(TAG, "Too many assets (%lu) in an unsorted table", stored_files);
+            return false;
+        }
+        // Images from older packers, sort the indexes only
+        sorted_index_.resize(stored_files);
+        for (uint32_t i = 0; i < stored_files; i++) {
+            sorted_index_[i] = i;
+        }
+        std::stable_sort(sorted_index_.begin(), sorted_index_.end(), [table](uint16_t a, uint16_t b) {
+            return strncmp(table[a].asset_name, table[b].asset_name, sizeof(table[a].asset_name)) < 0;
+        });
+        ESP_LOGI(TAG, "The assets table is not sorted, built an index of %lu entries", stored_files);
+    }
+    asset_table_ = mmap_root_ + 12;
+    asset_data_offset_ = 12 + sizeof(mmap_assets_table) * stored_files;
+    asset_count_ = stored_files;
+
+    StartBackgroundVerify();
     return checksum_valid_;
 }
 
+bool Assets::LoadHashTable(uint32_t data_length) {
+    size_t offset = (12 + data_length + 3) & ~3;
+    if (offset + 16 > partition_->size) {
+        return false;
+    }
+    uint32_t header[4];
+    memcpy(header, mmap_root_ + offset, sizeof(header));
+    if (header[0] != ASSETS_HASH_TABLE_MAGIC) {
+        return false;
+    }
+
+    uint32_t block_size = header[1];
+    uint32_t block_count = header[2];
+    if (block_size == 0 || block_count != (data_length + block_size - 1) / block_size ||
+        block_count > (partition_->size - offset - 16) / 4) {
+        ESP_LOGW(TAG, "Invalid hash table (block size %lu, count %lu), fall back to the checksum", block_size, block_count);
+        return false;
+    }
+
+    auto block_crcs = reinterpret_cast<const uint8_t*>(mmap_root_ + offset + 16);
+    uint32_t crc = esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(&header[1]), 8);
+    crc = esp_rom_crc32_le(crc, block_crcs, block_count * 4);
+    if (crc != header[3]) {
+        ESP_LOGW(TAG, "The hash table is corrupted, fall back to the checksum");
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(verify_mutex_);
+    block_crcs_ = block_crcs;
+    block_size_ = block_size;
+    block_state_.assign(block_count, kBlockUnknown);
+    // The image header is not covered by the blocks
+    fingerprint_ = esp_rom_crc32_le(header[3], reinterpret_cast<const uint8_t*>(mmap_root_), 12);
+    ESP_LOGI(TAG, "Assets hash table: %lu blocks of %lu KB", block_count, block_size / 1024);
+    return true;
+}
+
+// Must be called with verify_mutex_ held
+bool Assets::VerifyBlock(size_t index) {
+    if (block_state_[index] == kBlockUnknown) {
+        size_t start = index * block_size_;
+        size_t length = std::min<size_t>(block_size_, data_length_ - start);
+        uint32_t expected;
+        memcpy(&expected, block_crcs_ + index * 4, sizeof(expected));
+        uint32_t crc = esp_rom_crc32_le(0, reinterpret_cast<const uint8_t*>(mmap_root_ + 12 + start), length);
+        if (crc == expected) {
+            block_state_[index] = kBlockValid;
+        } else {
+            ESP_LOGE(TAG, "Assets block %u at 0x%x is corrupted (crc 0x%08lx, expected 0x%08lx)", index, 12 + start, crc, expected);
+            block_state_[index] = kBlockInvalid;
+        }
+    }
+    return block_state_[index] == kBlockValid;
+}
+
+bool Assets::VerifyRange(size_t offset, size_t length) {
+    std::lock_guard<std::mutex> lock(verify_mutex_);
+    if (block_state_.empty() || length == 0) {
+        return true;
+    }
+    if (offset < 12 || offset - 12 + length > data_length_) {
+        return false;
+    }
+    size_t first = (offset - 12) / block_size_;
+    size_t last = (offset - 12 + length - 1) / block_size_;
+    for (size_t i = first; i <= last; i++) {
+        if (!VerifyBlock(i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Assets::StartBackgroundVerify() {
+    int generation;
+    {
+        std::lock_guard<std::mutex> lock(verify_mutex_);
+        if (block_state_.empty()) {
+            return;
+        }
+        generation = verify_generation_;
+    }
+    // Lowest priority above idle, the blocks that are needed during boot get verified on access
+    xTaskCreate([](void* arg) {
+        Assets::GetInstance().BackgroundVerifyTask((int)(intptr_t)arg);
+        vTaskDelete(NULL);
+    }, "assets_verify", 4096, (void*)(intptr_t)generation, 1, nullptr);
+}
+
+void Assets::BackgroundVerifyTask(int generation) {
+    BootTraceScope trace("assets.verify");
+    for (size_t index = 0; ; index++) {
+        {
+            std::lock_guard<std::mutex> lock(verify_mutex_);
+            // A download replaced the image, or every block is known to be valid
+            if (generation != verify_generation_ || block_state_.empty()) {
+                return;
+            }
+            if (index >= block_state_.size()) {
+                break;
+            }
+            if (!VerifyBlock(index)) {
+                return;
+            }
+        }
+        vTaskDelay(1);
+    }
+
+    std::lock_guard<std::mutex> lock(verify_mutex_);
+    if (generation != verify_generation_) {
+        return;
+    }
+    block_state_.clear();
+    SettingsSchema::kAssetsVerified.Set((int32_t)fingerprint_);
+    ESP_LOGI(TAG, "All assets blocks are verified");
+}
+
 bool Assets::Apply() {
     void* ptr = nullptr;
     size_t size = 0;
@@ -150,6 +343,7 @@ bool Assets::Apply() {
 
     cJSON* font = cJSON_GetObjectItem(root, "text_font");
     if (cJSON_IsString(font)) {
+        BootTraceScope trace("assets.font");
         std::string fonts_text_file = font->valuestring;
         if (GetAssetData(fonts_text_file, ptr, size)) {
             auto text_font = std::make_shared<LvglCBinFont>(ptr);
@@ -179,6 +373,14 @@ bool Assets::Apply() {
                 cJSON* file = cJSON_GetObjectItem(emoji, "file");
                 cJSON* eaf = cJSON_GetObjectItem(emoji, "eaf");
                 if (cJSON_IsString(name) && cJSON_IsString(file) && (NULL== eaf)) {
+                    if (IsCompressed(file->valuestring)) {
+                        // Decompress when the emoji is first shown, most of them never are
+                        std::string filename = file->valuestring;
+                        custom_emoji_collection->AddEmoji(name->valuestring, new LvglLazyImage([this, filename](void*& data, size_t& size) {
+                            return GetAssetData(filename, data, size);
+                        }));
+                        continue;
+                    }
                     if (!GetAssetData(file->valuestring, ptr, size)) {
                         ESP_LOGE(TAG, "Emoji %s image file %s is not found", name->valuestring, file->valuestring);
                         continue;
@@ -255,9 +457,11 @@ bool Assets::Apply() {
 
     cJSON* font = cJSON_GetObjectItem(root, "text_font");
     if (cJSON_IsString(font)) {
+        BootTraceScope trace("assets.font");
         std::string fonts_text_file = font->valuestring;
         if (GetAssetData(fonts_text_file, ptr, size)) {
-            auto text_font = std::make_shared<LvglCBinFont>(ptr);
+            // The emote engine draws glyphs with its own renderer, which does not go through LVGL's glyph lookup
+            auto text_font = std::make_shared<LvglCBinFont>(ptr, false);
             if (text_font->font() == nullptr) {
                 ESP_LOGE(TAG, "Failed to load fonts.bin");
                 return false;
@@ -370,148 +574,297 @@ bool Assets::Apply() {
 bool Assets::Download(std::string url, std::function<void(int progress, size_t speed)> progress_callback) {
     ESP_LOGI(TAG, "Downloading new version of assets from %s", url.c_str());
     
+    // Stop the background verification before the mapping goes away
+    {
+        std::lock_guard<std::mutex> lock(verify_mutex_);
+        verify_generation_++;
+        block_state_.clear();
+    }
+
     // 取消当前资源分区的内存映射
     if (mmap_handle_ != 0) {
         esp_partition_munmap(mmap_handle_);
         mmap_handle_ = 0;
         mmap_root_ = nullptr;
     }
+    FreeCache();
     checksum_valid_ = false;
-    assets_.clear();
-
-    // 下载新的资源文件
-    auto network = Board::GetInstance().GetNetwork();
-    auto http = network->CreateHttp(0);
-    
-    if (!http->Open("GET", url)) {
-        ESP_LOGE(TAG, "Failed to open HTTP connection");
+    asset_count_ = 0;
+    sorted_index_.clear();
+    SettingsSchema::kAssetsVerified.Erase();
+    // The old result must not outlive the old image if the download is interrupted by a power loss
+    Settings::Flush();
+
+    // 下载新的资源文件，网络接收和 flash 写入并行，断线后从断点继续
+    HttpDownloader downloader("dl_assets");
+    size_t erased = 0;
+    DownloadCallbacks callbacks;
+    callbacks.on_begin = [this, &erased](size_t offset, size_t total_size) {
+        if (total_size > partition_->size) {
+            ESP_LOGE(TAG, "Assets file size (%u) is larger than partition size (%lu)", total_size, partition_->size);
+            return false;
+        }
+        // Resume offsets are sector aligned, everything after them is erased again
+        erased = offset;
+        return true;
+    };
+    callbacks.on_data = [this, &erased](size_t offset, const char* data, size_t size) {
+        // Erase ahead in 64KB aligned ranges, so the flash driver can use block erase
+        size_t end = offset + size;
+        if (end > erased) {
+            const size_t SECTOR_SIZE = esp_partition_get_main_flash_sector_size();
+            const size_t BLOCK_SIZE = 64 * 1024;
+            size_t erase_end = std::min((end + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE,
+                                        partition_->size / SECTOR_SIZE * SECTOR_SIZE);
+            esp_err_t err = esp_partition_erase_range(partition_, erased, erase_end - erased);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to erase assets partition at 0x%x: %s", erased, esp_err_to_name(err));
+                return false;
+            }
+            erased = erase_end;
+        }
+        esp_err_t err = esp_partition_write(partition_, offset, data, size);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to write to assets partition at offset %u: %s", offset, esp_err_to_name(err));
+            return false;
+        }
+        return true;
+    };
+    callbacks.on_read_back = [this](size_t offset, char* buffer, size_t size) {
+        return esp_partition_read(partition_, offset, buffer, size) == ESP_OK;
+    };
+    callbacks.on_progress = progress_callback;
+
+    if (!downloader.Download(url, callbacks)) {
+        ESP_LOGE(TAG, "Failed to download assets");
         return false;
     }
+    ESP_LOGI(TAG, "Assets download completed, total written: %u bytes", downloader.total_size());
 
-    if (http->GetStatusCode() != 200) {
-        ESP_LOGE(TAG, "Failed to get assets, status code: %d", http->GetStatusCode());
+    // 重新初始化资源分区
+    if (!InitializePartition()) {
+        ESP_LOGE(TAG, "Failed to re-initialize assets partition");
         return false;
     }
 
-    size_t content_length = http->GetBodyLength();
-    if (content_length == 0) {
-        ESP_LOGE(TAG, "Failed to get content length");
+    // Check the whole image now, instead of finding a broken download on first use
+    if (!VerifyRange(12, data_length_)) {
+        ESP_LOGE(TAG, "The downloaded assets are corrupted");
         return false;
     }
 
-    if (content_length > partition_->size) {
-        ESP_LOGE(TAG, "Assets file size (%u) is larger than partition size (%lu)", content_length, partition_->size);
+    return true;
+}
+
+bool Assets::FindAsset(const std::string& name, Asset& asset) const {
+    auto table = reinterpret_cast<const mmap_assets_table*>(asset_table_);
+    const size_t name_size = sizeof(table->asset_name);
+    if (name.size() > name_size) {
         return false;
     }
+    // Names shorter than the field are zero padded, so strncmp gives the same order as the packer
+    size_t low = 0, high = asset_count_;
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        auto& item = table[sorted_index_.empty() ? middle : sorted_index_[middle]];
+        int result = strncmp(item.asset_name, name.c_str(), name_size);
+        if (result == 0) {
+            asset.size = item.asset_size;
+            asset.offset = asset_data_offset_ + item.asset_offset;
+            return true;
+        } else if (result < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return false;
+}
 
-    // 定义扇区大小为4KB（ESP32的标准扇区大小）
-    const size_t SECTOR_SIZE = esp_partition_get_main_flash_sector_size();
-    
-    // 计算需要擦除的扇区数量
-    size_t sectors_to_erase = (content_length + SECTOR_SIZE - 1) / SECTOR_SIZE; // 向上取整
-    size_t total_erase_size = sectors_to_erase * SECTOR_SIZE;
-    
-    ESP_LOGI(TAG, "Sector size: %u, content length: %u, sectors to erase: %u, total erase size: %u", 
-             SECTOR_SIZE, content_length, sectors_to_erase, total_erase_size);
-    
-    // 写入新的资源文件到分区，一边erase一边写入
-    char buffer[512];
-    size_t total_written = 0;
-    size_t recent_written = 0;
-    size_t current_sector = 0;
-    auto last_calc_time = esp_timer_get_time();
-    
-    while (true) {
-        int ret = http->Read(buffer, sizeof(buffer));
-        if (ret < 0) {
-            ESP_LOGE(TAG, "Failed to read HTTP data: %s", esp_err_to_name(ret));
+bool Assets::LocateAsset(const std::string& name, const char*& data, size_t& size, bool& compressed) {
+    Asset asset;
+    if (!FindAsset(name, asset)) {
+        return false;
+    }
+    if (!VerifyRange(asset.offset, asset.size + 2)) {
+        ESP_LOGE(TAG, "The asset %s is corrupted", name.c_str());
+        return false;
+    }
+    auto magic = (const char*)(mmap_root_ + asset.offset);
+    if (magic[0] != 'Z' || (magic[1] != 'Z' && magic[1] != 'L')) {
+        ESP_LOGE(TAG, "The asset %s is not valid with magic %02x%02x", name.c_str(), magic[0], magic[1]);
+        return false;
+    }
+    compressed = magic[1] == 'L';
+    data = magic + 2;
+    size = asset.size;
+    if (compressed) {
+        uint32_t header[3];
+        if (size < sizeof(header)) {
             return false;
         }
-
-        if (ret == 0) {
-            break;
+        memcpy(header, data, sizeof(header));
+        if (header[1] == 0 || header[1] > ASSETS_COMPRESSED_MAX_BLOCK_SIZE ||
+            header[2] != (header[0] + header[1] - 1) / header[1] || header[2] > (size - sizeof(header)) / 4) {
+            ESP_LOGE(TAG, "The compressed asset %s has an invalid header", name.c_str());
+            return false;
         }
+    }
+    return true;
+}
 
-        // 检查是否需要擦除新的扇区
-        size_t write_end_offset = total_written + ret;
-        size_t needed_sectors = (write_end_offset + SECTOR_SIZE - 1) / SECTOR_SIZE;
-        
-        // 擦除需要的新扇区
-        while (current_sector < needed_sectors) {
-            size_t sector_start = current_sector * SECTOR_SIZE;
-            size_t sector_end = (current_sector + 1) * SECTOR_SIZE;
-            
-            // 确保擦除范围不超过分区大小
-            if (sector_end > partition_->size) {
-                ESP_LOGE(TAG, "Sector end (%u) exceeds partition size (%lu)", sector_end, partition_->size);
-                return false;
-            }
-            
-            ESP_LOGD(TAG, "Erasing sector %u (offset: %u, size: %u)", current_sector, sector_start, SECTOR_SIZE);
-            esp_err_t err = esp_partition_erase_range(partition_, sector_start, SECTOR_SIZE);
-            if (err != ESP_OK) {
-                ESP_LOGE(TAG, "Failed to erase sector %u at offset %u: %s", current_sector, sector_start, esp_err_to_name(err));
-                return false;
-            }
-            
-            current_sector++;
-        }
+bool Assets::IsCompressed(const std::string& name) const {
+    Asset asset;
+    if (!FindAsset(name, asset)) {
+        return false;
+    }
+    return mmap_root_[asset.offset] == 'Z' && mmap_root_[asset.offset + 1] == 'L';
+}
 
-        // 写入数据到分区
-        esp_err_t err = esp_partition_write(partition_, total_written, buffer, ret);
-        if (err != ESP_OK) {
-            ESP_LOGE(TAG, "Failed to write to assets partition at offset %u: %s", total_written, esp_err_to_name(err));
+// Decode one LZ4 block (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md), fails unless it fills the output exactly
+static bool Lz4DecodeBlock(const uint8_t* input, size_t input_size, uint8_t* output, size_t output_size) {
+    const uint8_t* ip = input;
+    const uint8_t* input_end = input + input_size;
+    uint8_t* op = output;
+    uint8_t* output_end = output + output_size;
+
+    while (ip < input_end) {
+        uint8_t token = *ip++;
+        size_t length = token >> 4;
+        if (length == 15) {
+            uint8_t byte;
+            do {
+                if (ip >= input_end) {
+                    return false;
+                }
+                byte = *ip++;
+                length += byte;
+            } while (byte == 255);
+        }
+        if (length > (size_t)(input_end - ip) || length > (size_t)(output_end - op)) {
             return false;
         }
+        memcpy(op, ip, length);
+        ip += length;
+        op += length;
+        if (ip == input_end) {
+            break;  // The last sequence has literals only
+        }
 
-        total_written += ret;
-        recent_written += ret;
-
-        // 计算进度和速度
-        if (esp_timer_get_time() - last_calc_time >= 1000000 || total_written == content_length || ret == 0) {
-            size_t progress = total_written * 100 / content_length;
-            size_t speed = recent_written; // 每秒的字节数
-            ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Speed: %u B/s, Sectors erased: %u", 
-                     progress, total_written, content_length, speed, current_sector);
-            if (progress_callback) {
-                progress_callback(progress, speed);
+        if (input_end - ip < 2) {
+            return false;
+        }
+        size_t distance = ip[0] | (ip[1] << 8);
+        ip += 2;
+        if (distance == 0 || distance > (size_t)(op - output)) {
+            return false;
+        }
+        length = token & 0x0F;
+        if (length == 15) {
+            uint8_t byte;
+            do {
+                if (ip >= input_end) {
+                    return false;
+                }
+                byte = *ip++;
+                length += byte;
+            } while (byte == 255);
+        }
+        length += 4;
+        if (length > (size_t)(output_end - op)) {
+            return false;
+        }
+        const uint8_t* match = op - distance;
+        if (distance >= length) {
+            memcpy(op, match, length);
+            op += length;
+        } else {
+            // Overlapping match repeats the last bytes
+            while (length-- > 0) {
+                *op++ = *match++;
             }
-            last_calc_time = esp_timer_get_time();
-            recent_written = 0; // 重置最近写入的字节数
         }
     }
-    
-    http->Close();
+    return op == output_end;
+}
 
-    if (total_written != content_length) {
-        ESP_LOGE(TAG, "Downloaded size (%u) does not match expected size (%u)", total_written, content_length);
+bool Assets::DecompressBlock(const char* data, size_t size, uint32_t index, char* output, size_t& output_size) {
+    uint32_t header[3];
+    memcpy(header, data, sizeof(header));
+    uint32_t raw_size = header[0], block_size = header[1], block_count = header[2];
+    size_t table_end = ASSETS_COMPRESSED_HEADER_SIZE + block_count * 4;
+    uint32_t start = 0, end = 0;
+    if (index > 0) {
+        memcpy(&start, data + ASSETS_COMPRESSED_HEADER_SIZE + (index - 1) * 4, 4);
+    }
+    memcpy(&end, data + ASSETS_COMPRESSED_HEADER_SIZE + index * 4, 4);
+    if (start > end || table_end + end > size) {
         return false;
     }
 
-    ESP_LOGI(TAG, "Assets download completed, total written: %u bytes, total sectors erased: %u", 
-             total_written, current_sector);
-
-    // 重新初始化资源分区
-    if (!InitializePartition()) {
-        ESP_LOGE(TAG, "Failed to re-initialize assets partition");
-        return false;
+    output_size = std::min<size_t>(block_size, raw_size - index * block_size);
+    auto input = reinterpret_cast<const uint8_t*>(data + table_end + start);
+    if (end - start == output_size) {
+        memcpy(output, input, output_size);
+        return true;
     }
+    return Lz4DecodeBlock(input, end - start, reinterpret_cast<uint8_t*>(output), output_size);
+}
 
-    return true;
+void Assets::FreeCache() {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    for (auto& item : cache_) {
+        heap_caps_free(item.data);
+    }
+    cache_.clear();
+    // 解压缓冲区释放后地址可能被另一个GIF复用
+    GifFrameCache::GetInstance().Clear();
 }
 
 bool Assets::GetAssetData(const std::string& name, void*& ptr, size_t& size) {
-    auto asset = assets_.find(name);
-    if (asset == assets_.end()) {
+    const char* data;
+    size_t stored_size;
+    bool compressed;
+    if (!LocateAsset(name, data, stored_size, compressed)) {
         return false;
     }
-    auto data = (const char*)(mmap_root_ + asset->second.offset);
-    if (data[0] != 'Z' || data[1] != 'Z') {
-        ESP_LOGE(TAG, "The asset %s is not valid with magic %02x%02x", name.c_str(), data[0], data[1]);
+    if (!compressed) {
+        ptr = static_cast<void*>(const_cast<char*>(data));
+        size = stored_size;
+        return true;
+    }
+
+    size_t offset = data - mmap_root_;
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    for (auto& item : cache_) {
+        if (item.offset == offset) {
+            ptr = item.data;
+            size = item.size;
+            return true;
+        }
+    }
+
+    auto start_time = esp_timer_get_time();
+    uint32_t header[3];
+    memcpy(header, data, sizeof(header));
+    auto output = (char*)heap_caps_malloc_prefer(header[0], 2, MALLOC_CAP_SPIRAM, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (output == nullptr) {
+        ESP_LOGE(TAG, "Failed to allocate %lu bytes for the asset %s", header[0], name.c_str());
         return false;
     }
+    for (uint32_t i = 0; i < header[2]; i++) {
+        size_t block_size;
+        if (!DecompressBlock(data, stored_size, i, output + i * header[1], block_size)) {
+            ESP_LOGE(TAG, "Failed to decompress block %lu of the asset %s", i, name.c_str());
+            heap_caps_free(output);
+            return false;
+        }
+    }
+    cache_.push_back({ offset, output, header[0] });
+    ESP_LOGI(TAG, "Decompressed %s: %u -> %lu bytes in %lld us", name.c_str(), stored_size, header[0],
+        esp_timer_get_time() - start_time);
 
-    ptr = static_cast<void*>(const_cast<char*>(data + 2));
-    size = asset->second.size;
+    ptr = output;
+    size = header[0];
     return true;
 }
@@ -1,8 +1,9 @@
 #ifndef ASSETS_H
 #define ASSETS_H
 
-#include <map>
 #include <string>
+#include <vector>
+#include <mutex>
 #include <functional>
 
 #include <cJSON.h>
@@ -15,6 +16,23 @@ struct Asset {
     size_t offset;
 };
 
+/*
+ * Optional block hash table appended after the assets data (4 bytes aligned):
+ * |magic "AHT1" 4|block_size 4|block_count 4|table_crc 4|crc32 of each block 4 * block_count|
+ * Blocks cover the asset table and data, table_crc covers block_size, block_count and the block crcs.
+ * Images without it are verified with the 16-bit checksum in the header.
+ */
+#define ASSETS_HASH_TABLE_MAGIC 0x31544841  // "AHT1"
+
+/*
+ * Asset data starts with "ZZ" when stored as is, or "ZL" when compressed:
+ * |"ZL" 2|raw_size 4|block_size 4|block_count 4|end offset of each block 4 * block_count|blocks|
+ * Blocks are independent LZ4 blocks of block_size raw bytes (the last one may be shorter),
+ * a block that does not shrink is stored as is. The size in the asset table is the size after "ZL".
+ */
+#define ASSETS_COMPRESSED_HEADER_SIZE 12
+#define ASSETS_COMPRESSED_MAX_BLOCK_SIZE (64 * 1024)
+
 class Assets {
 public:
     static Assets& GetInstance() {
@@ -25,7 +43,9 @@ public:
 
     bool Download(std::string url, std::function<void(int progress, size_t speed)> progress_callback);
     bool Apply();
+    // Compressed assets are decompressed into PSRAM on first use and stay cached
     bool GetAssetData(const std::string& name, void*& ptr, size_t& size);
+    bool IsCompressed(const std::string& name) const;
 
     inline bool partition_valid() const { return partition_valid_; }
     inline bool checksum_valid() const { return checksum_valid_; }
@@ -38,6 +58,17 @@ private:
 
     bool InitializePartition();
     uint32_t CalculateChecksum(const char* data, uint32_t length);
+    bool LoadHashTable(uint32_t data_length);
+    bool FindAsset(const std::string& name, Asset& asset) const;
+    // Verify the blocks overlapping [offset, offset + length) of the partition, blocks are checked only once
+    bool VerifyRange(size_t offset, size_t length);
+    bool VerifyBlock(size_t index);
+    void StartBackgroundVerify();
+    void BackgroundVerifyTask(int generation);
+    // Check an asset and return its stored data after the magic
+    bool LocateAsset(const std::string& name, const char*& data, size_t& size, bool& compressed);
+    bool DecompressBlock(const char* data, size_t size, uint32_t index, char* output, size_t& output_size);
+    void FreeCache();
 
     const esp_partition_t* partition_ = nullptr;
     esp_partition_mmap_handle_t mmap_handle_ = 0;
@@ -46,7 +77,31 @@ private:
     bool checksum_valid_ = false;
     std::string default_assets_url_;
     srmodel_list_t* models_list_ = nullptr;
-    std::map<std::string, Asset> assets_;
+    // The asset table is used in place in the mapped partition. Packers sort it by name,
+    // older images get a sorted index instead so that lookups are always a binary search
+    const char* asset_table_ = nullptr;
+    uint32_t asset_count_ = 0;
+    size_t asset_data_offset_ = 0;
+    std::vector<uint16_t> sorted_index_;
+
+    // Lazy verification state, block_state_ is empty when every block is known to be valid
+    enum BlockState : uint8_t { kBlockUnknown, kBlockValid, kBlockInvalid };
+    std::mutex verify_mutex_;
+    std::vector<BlockState> block_state_;
+    const uint8_t* block_crcs_ = nullptr;
+    uint32_t block_size_ = 0;
+    uint32_t data_length_ = 0;
+    uint32_t fingerprint_ = 0;      // Identifies the image whose verification is cached in NVS
+    int verify_generation_ = 0;
+
+    // Decompressed assets, the pointers are handed out so they live until the image is replaced
+    struct CachedAsset {
+        size_t offset;
+        char* data;
+        size_t size;
+    };
+    std::mutex cache_mutex_;
+    std::vector<CachedAsset> cache_;
 };
 
 #endif
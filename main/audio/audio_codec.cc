@@ -1,6 +1,7 @@
 #include "audio_codec.h"
 #include "board.h"
-#include "settings.h"
+#include "settings_schema.h"
+#include "status_store.h"
 
 #include <esp_log.h>
 #include <cstring>
@@ -27,12 +28,12 @@ bool AudioCodec::InputData(std::vector<int16_t>& data) {
 }
 
 void AudioCodec::Start() {
-    Settings settings("audio", false);
-    output_volume_ = settings.GetInt("output_volume", output_volume_);
+    output_volume_ = SettingsSchema::kOutputVolume.Get(output_volume_);
     if (output_volume_ <= 0) {
         ESP_LOGW(TAG, "Output volume value (%d) is too small, setting to default (10)", output_volume_);
         output_volume_ = 10;
     }
+    StatusStore::GetInstance().SetOutputVolume(output_volume_);
 
     if (tx_handle_ != nullptr) {
         ESP_ERROR_CHECK(i2s_channel_enable(tx_handle_));
@@ -51,8 +52,8 @@ void AudioCodec::SetOutputVolume(int volume) {
     output_volume_ = volume;
     ESP_LOGI(TAG, "Set output volume to %d", output_volume_);
     
-    Settings settings("audio", true);
-    settings.SetInt("output_volume", output_volume_);
+    SettingsSchema::kOutputVolume.Set(output_volume_);
+    StatusStore::GetInstance().SetOutputVolume(output_volume_);
 }
 
 void AudioCodec::SetInputGain(float gain) {
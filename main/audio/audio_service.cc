@@ -1,6 +1,8 @@
 #include "audio_service.h"
+#include "boot_trace.h"
 #include <esp_log.h>
 #include <cstring>
+#include <algorithm>
 
 #if CONFIG_USE_AUDIO_PROCESSOR
 #include "processors/afe_audio_processor.h"
@@ -31,7 +33,10 @@ AudioService::~AudioService() {
 
 void AudioService::Initialize(AudioCodec* codec) {
     codec_ = codec;
-    codec_->Start();
+    {
+        BootTraceScope trace("codec.start");
+        codec_->Start();
+    }
 
     /* Setup the audio codec */
     opus_decoder_ = std::make_unique<OpusDecoderWrapper>(codec->output_sample_rate(), 1, OPUS_FRAME_DURATION_MS);
@@ -269,6 +274,12 @@ void AudioService::AudioOutputTask() {
         audio_queue_cv_.notify_all();
         lock.unlock();
 
+        // Frames are written back to back while the decoder keeps up, a short pause means it did not
+        auto gap = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - last_output_time_).count();
+        if (gap > OPUS_FRAME_DURATION_MS && gap < AUDIO_PLAYBACK_GAP_MAX_MS) {
+            debug_statistics_.playback_gap_count++;
+        }
+
         if (!codec_->output_enabled()) {
             esp_timer_stop(audio_power_timer_);
             esp_timer_start_periodic(audio_power_timer_, AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
@@ -355,6 +366,7 @@ void AudioService::OpusCodecTask() {
                 {
                     std::lock_guard<std::mutex> lock(audio_queue_mutex_);
                     audio_send_queue_.push_back(std::move(packet));
+                    debug_statistics_.send_queue_peak = std::max<uint32_t>(debug_statistics_.send_queue_peak, audio_send_queue_.size());
                 }
                 if (callbacks_.on_send_queue_available) {
                     callbacks_.on_send_queue_available();
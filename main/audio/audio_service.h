@@ -45,6 +45,8 @@
 
 #define AUDIO_POWER_TIMEOUT_MS 15000
 #define AUDIO_POWER_CHECK_INTERVAL_MS 1000
+// A pause in playback longer than this is the end of a sentence, not an underrun
+#define AUDIO_PLAYBACK_GAP_MAX_MS 1000
 
 
 #define AS_EVENT_AUDIO_TESTING_RUNNING      (1 << 0)
@@ -77,6 +79,8 @@ struct DebugStatistics {
     uint32_t decode_count = 0;
     uint32_t encode_count = 0;
     uint32_t playback_count = 0;
+    uint32_t playback_gap_count = 0;    // The playback queue ran dry in the middle of a sentence
+    uint32_t send_queue_peak = 0;       // Most packets waiting for the network at once
 };
 
 class AudioService {
@@ -109,6 +113,8 @@ public:
     bool ReadAudioData(std::vector<int16_t>& data, int sample_rate, int samples);
     void ResetDecoder();
     void SetModelsList(srmodel_list_t* models_list);
+    const DebugStatistics& GetDebugStatistics() const { return debug_statistics_; }
+    void ResetSendQueuePeak() { debug_statistics_.send_queue_peak = 0; }
 
 private:
     AudioCodec* codec_ = nullptr;
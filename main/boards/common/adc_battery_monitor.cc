@@ -1,4 +1,5 @@
 #include "adc_battery_monitor.h"
+#include "status_store.h"
 
 AdcBatteryMonitor::AdcBatteryMonitor(adc_unit_t adc_unit, adc_channel_t adc_channel, float upper_resistor, float lower_resistor, gpio_num_t charging_pin)
     : charging_pin_(charging_pin) {
@@ -112,6 +113,7 @@ void AdcBatteryMonitor::CheckBatteryStatus() {
     bool new_charging_status = IsCharging();
     if (new_charging_status != is_charging_) {
         is_charging_ = new_charging_status;
+        StatusStore::GetInstance().SetBattery(GetBatteryLevel(), is_charging_, !is_charging_);
         if (on_charging_status_changed_) {
             on_charging_status_changed_(is_charging_);
         }
@@ -1,6 +1,7 @@
 #include "axp2101.h"
 #include "board.h"
 #include "display.h"
+#include "settings.h"
 
 #include <esp_log.h>
 
@@ -35,6 +36,8 @@ float Axp2101::GetTemperature() {
 }
 
 void Axp2101::PowerOff() {
+    // Settings written in the last moments are still waiting for the settings task
+    Settings::Flush();
     uint8_t value = ReadReg(0x10);
     value = value | 0x01;
     WriteReg(0x10, value);
@@ -1,5 +1,5 @@
 #include "backlight.h"
-#include "settings.h"
+#include "settings_schema.h"
 
 #include <esp_log.h>
 #include <driver/ledc.h>
@@ -31,8 +31,7 @@ Backlight::~Backlight() {
 
 void Backlight::RestoreBrightness() {
     // Load brightness from settings
-    Settings settings("display");  
-    int saved_brightness = settings.GetInt("brightness", 75);
+    int saved_brightness = SettingsSchema::kBrightness.Get();
     
     // 检查亮度值是否为0或过小，设置默认值
     if (saved_brightness <= 0) {
@@ -53,8 +52,7 @@ void Backlight::SetBrightness(uint8_t brightness, bool permanent) {
     }
 
     if (permanent) {
-        Settings settings("display", true);
-        settings.SetInt("brightness", brightness);
+        SettingsSchema::kBrightness.Set(brightness);
     }
 
     target_brightness_ = brightness;
@@ -1,6 +1,6 @@
 #include "board.h"
 #include "system_info.h"
-#include "settings.h"
+#include "settings_schema.h"
 #include "display/display.h"
 #include "display/oled_display.h"
 #include "assets/lang_config.h"
@@ -13,11 +13,10 @@
 #define TAG "Board"
 
 Board::Board() {
-    Settings settings("board", true);
-    uuid_ = settings.GetString("uuid");
+    uuid_ = SettingsSchema::kBoardUuid.Get();
     if (uuid_.empty()) {
         uuid_ = GenerateUuid();
-        settings.SetString("uuid", uuid_);
+        SettingsSchema::kBoardUuid.Set(uuid_);
     }
     ESP_LOGI(TAG, "UUID=%s SKU=%s", uuid_.c_str(), BOARD_NAME);
 }
@@ -170,6 +169,7 @@ std::string Board::GetSystemInfoJson() {
     }
     json += R"(},)";
 
+    json += R"("settings":)" + SettingsSchema::ToJson() + R"(,)";
     json += R"("board":)" + GetBoardJson();
 
     // Close the JSON object
@@ -9,6 +9,7 @@
 #include "esp_video_device.h"
 #include "esp_video_init.h"
 #include "jpg/image_to_jpeg.h"
+#include "jpg/pixel_convert.h"
 #include "linux/videodev2.h"
 #include "lvgl_display.h"
 #include "mcp_server.h"
@@ -302,6 +303,10 @@ Esp32Camera::~Esp32Camera() {
     }
     sensor_format_ = 0;
     esp_video_deinit();
+    if (frame_.data) {
+        heap_caps_free(frame_.data);
+        frame_.data = nullptr;
+    }
 }
 
 void Esp32Camera::SetExplainUrl(const std::string& url, const std::string& token) {
@@ -327,70 +332,48 @@ bool Esp32Camera::Capture() {
             return false;
         }
         if (i == 2) {
-            // 保存帧副本到PSRAM
-            if (frame_.data) {
-                heap_caps_free(frame_.data);
-                frame_.data = nullptr;
-                frame_.format = 0;
-            }
+            // 保存帧副本到PSRAM，尺寸不变时复用上次的缓冲区
+            frame_.format = 0;
             frame_.len = buf.bytesused;
-            frame_.data = (uint8_t*)heap_caps_malloc(frame_.len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-            if (!frame_.data) {
-                ESP_LOGE(TAG, "alloc frame copy failed");
-                return false;
+            if (frame_.len > frame_.capacity) {
+                if (frame_.data) {
+                    heap_caps_free(frame_.data);
+                }
+                frame_.data = (uint8_t*)heap_caps_malloc(frame_.len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+                frame_.capacity = frame_.data ? frame_.len : 0;
+                if (!frame_.data) {
+                    ESP_LOGE(TAG, "alloc frame copy failed");
+                    return false;
+                }
             }
+            auto src = (const uint8_t*)mmap_buffers_[buf.index].start;
 
             ESP_LOGD(TAG, "frame.len = %d, frame.width = %d, frame.height = %d", frame_.len, frame_.width,
                      frame_.height);
-            ESP_LOG_BUFFER_HEXDUMP(TAG, frame_.data, MIN(frame_.len, 256), ESP_LOG_DEBUG);
+            ESP_LOG_BUFFER_HEXDUMP(TAG, src, MIN(frame_.len, 256), ESP_LOG_DEBUG);
 
             switch (sensor_format_) {
                 case V4L2_PIX_FMT_RGB565:
                 case V4L2_PIX_FMT_RGB24:
                 case V4L2_PIX_FMT_YUYV:
+                case V4L2_PIX_FMT_YUV422P:
 #ifdef CONFIG_XIAOZHI_ENABLE_CAMERA_ENDIANNESS_SWAP
                     {
-                        auto src16 = (uint16_t*)mmap_buffers_[buf.index].start;
-                        auto dst16 = (uint16_t*)frame_.data;
-                        size_t count = (size_t)mmap_buffers_[buf.index].length / 2;
-                        for (size_t i = 0; i < count; i++) {
-                            dst16[i] = __builtin_bswap16(src16[i]);
-                        }
+                        size_t row_bytes = frame_.len / frame_.height;
+                        pixel_swap16(src, row_bytes, frame_.data, row_bytes, row_bytes / 2, frame_.height);
                     }
 #else
-                    memcpy(frame_.data, mmap_buffers_[buf.index].start, frame_.len);
+                    memcpy(frame_.data, src, frame_.len);
 #endif  // CONFIG_XIAOZHI_ENABLE_CAMERA_ENDIANNESS_SWAP
-                    frame_.format = sensor_format_;
+                    // YUV422P 这个格式是 422 YUYV，不是 planer
+                    frame_.format = sensor_format_ == V4L2_PIX_FMT_YUV422P ? V4L2_PIX_FMT_YUYV : sensor_format_;
                     break;
-                case V4L2_PIX_FMT_YUV422P: {
-                    // 这个格式是 422 YUYV，不是 planer
-                    frame_.format = V4L2_PIX_FMT_YUYV;
-#ifdef CONFIG_XIAOZHI_ENABLE_CAMERA_ENDIANNESS_SWAP
-                    {
-                        auto src16 = (uint16_t*)mmap_buffers_[buf.index].start;
-                        auto dst16 = (uint16_t*)frame_.data;
-                        size_t count = (size_t)mmap_buffers_[buf.index].length / 2;
-                        for (size_t i = 0; i < count; i++) {
-                            dst16[i] = __builtin_bswap16(src16[i]);
-                        }
-                    }
-#else
-                    memcpy(frame_.data, mmap_buffers_[buf.index].start, frame_.len);
-#endif  // CONFIG_XIAOZHI_ENABLE_CAMERA_ENDIANNESS_SWAP
-                    break;
-                }
-                case V4L2_PIX_FMT_RGB565X: {
+                case V4L2_PIX_FMT_RGB565X:
                     // 大端序的 RGB565 需要转换为小端序
                     // 目前 esp_video 的大小端都会返回格式为 RGB565，不会返回格式为 RGB565X，此 case 用于未来版本兼容
-                    auto src16 = (uint16_t*)mmap_buffers_[buf.index].start;
-                    auto dst16 = (uint16_t*)frame_.data;
-                    size_t pixel_count = (size_t)frame_.width * (size_t)frame_.height;
-                    for (size_t i = 0; i < pixel_count; i++) {
-                        dst16[i] = __builtin_bswap16(src16[i]);
-                    }
+                    pixel_swap16(src, frame_.width * 2, frame_.data, frame_.width * 2, frame_.width, frame_.height);
                     frame_.format = V4L2_PIX_FMT_RGB565;
                     break;
-                }
                 default:
                     ESP_LOGE(TAG, "unsupported sensor format: 0x%08x", sensor_format_);
                     return false;
@@ -409,109 +392,34 @@ bool Esp32Camera::Capture() {
         }
         uint16_t w = frame_.width;
         uint16_t h = frame_.height;
-        size_t lvgl_image_size = frame_.len;
         size_t stride = ((w * 2) + 3) & ~3;  // 4字节对齐
+        size_t lvgl_image_size = stride * h;
         lv_color_format_t color_format = LV_COLOR_FORMAT_RGB565;
-        uint8_t* data = nullptr;
+        // 预览图片由显示端接管并在替换时释放，因此每次都是新的缓冲区
+        uint8_t* data = (uint8_t*)heap_caps_malloc(lvgl_image_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        if (data == nullptr) {
+            ESP_LOGE(TAG, "Failed to allocate memory for preview image");
+            return false;
+        }
 
         switch (frame_.format) {
             case V4L2_PIX_FMT_YUYV:
-                // color_format = LV_COLOR_FORMAT_YUY2;
-                // [[fallthrough]];
                 // LV_COLOR_FORMAT_YUY2 的显示似乎有问题，暂时转换为 RGB565 显示
-                {
-                    color_format = LV_COLOR_FORMAT_RGB565;
-                    data = (uint8_t*)heap_caps_malloc(w * h * 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-                    lvgl_image_size = w * h * 2;
-                    if (data == nullptr) {
-                        ESP_LOGE(TAG, "Failed to allocate memory for preview image");
-                        return false;
-                    }
-                    const uint8_t* src = (const uint8_t*)frame_.data;
-                    size_t src_len = frame_.len;
-                    size_t dst_off = 0;
-
-                    auto clamp = [](int v) -> uint8_t {
-                        if (v < 0) return 0;
-                        if (v > 255) return 255;
-                        return (uint8_t)v;
-                    };
-
-                    // 每 4 字节处理两个像素： Y0 U Y1 V
-                    for (size_t i = 0; i + 3 < src_len; i += 4) {
-                        int y0 = (int)src[i + 0];
-                        int u  = (int)src[i + 1];
-                        int y1 = (int)src[i + 2];
-                        int v  = (int)src[i + 3];
-
-                        int c0 = y0 - 16;
-                        int c1 = y1 - 16;
-                        int d  = u  - 128;
-                        int e  = v  - 128;
-
-                        // 常用整数近似转换
-                        int r0 = (298 * c0 + 409 * e + 128) >> 8;
-                        int g0 = (298 * c0 - 100 * d - 208 * e + 128) >> 8;
-                        int b0 = (298 * c0 + 516 * d + 128) >> 8;
-
-                        int r1 = (298 * c1 + 409 * e + 128) >> 8;
-                        int g1 = (298 * c1 - 100 * d - 208 * e + 128) >> 8;
-                        int b1 = (298 * c1 + 516 * d + 128) >> 8;
-
-                        uint8_t cr0 = clamp(r0);
-                        uint8_t cg0 = clamp(g0);
-                        uint8_t cb0 = clamp(b0);
-
-                        uint8_t cr1 = clamp(r1);
-                        uint8_t cg1 = clamp(g1);
-                        uint8_t cb1 = clamp(b1);
-
-                        // RGB565 打包
-                        uint16_t pix0 = (uint16_t)(((cr0 >> 3) << 11) | ((cg0 >> 2) << 5) | (cb0 >> 3));
-                        uint16_t pix1 = (uint16_t)(((cr1 >> 3) << 11) | ((cg1 >> 2) << 5) | (cb1 >> 3));
-
-                        // 小端序：低字节先写入
-                        data[dst_off++] = (uint8_t)(pix0 & 0xFF);
-                        data[dst_off++] = (uint8_t)((pix0 >> 8) & 0xFF);
-
-                        data[dst_off++] = (uint8_t)(pix1 & 0xFF);
-                        data[dst_off++] = (uint8_t)((pix1 >> 8) & 0xFF);
-                    }
-                    break;
-                }
+                pixel_yuyv_to_rgb565(frame_.data, w * 2, data, stride, w, h);
+                break;
             case V4L2_PIX_FMT_RGB565:
                 // 默认的 color_format 就是 LV_COLOR_FORMAT_RGB565
-                data = (uint8_t*)heap_caps_malloc(w * h * 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-                if (data == nullptr) {
-                    ESP_LOGE(TAG, "Failed to allocate memory for preview image");
-                    return false;
+                for (uint16_t y = 0; y < h; y++) {
+                    memcpy(data + y * stride, frame_.data + y * w * 2, w * 2);
                 }
-                memcpy(data, frame_.data, frame_.len);
-                lvgl_image_size = frame_.len;  // fallthrough 时兼顾 YUYV 与 RGB565
                 break;
-
-            case V4L2_PIX_FMT_RGB24: {
+            case V4L2_PIX_FMT_RGB24:
                 // RGB888 需要转换为 RGB565
-                color_format = LV_COLOR_FORMAT_RGB565;
-                data = (uint8_t*)heap_caps_malloc(w * h * 2, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-                uint16_t* dst16 = (uint16_t*)data;
-                if (data == nullptr) {
-                    ESP_LOGE(TAG, "Failed to allocate memory for preview image");
-                    return false;
-                }
-                const uint8_t* src = frame_.data;
-                size_t pixel_count = (size_t)w * (size_t)h;
-                for (size_t i = 0; i < pixel_count; i++) {
-                    uint8_t r = src[i * 3 + 0];
-                    uint8_t g = src[i * 3 + 1];
-                    uint8_t b = src[i * 3 + 2];
-                    dst16[i] = (uint16_t)(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
-                }
-                lvgl_image_size = w * h * 2;
+                pixel_rgb24_to_rgb565(frame_.data, w * 3, data, stride, w, h);
                 break;
-            }
             default:
                 ESP_LOGE(TAG, "unsupported frame format: 0x%08x", frame_.format);
+                heap_caps_free(data);
                 return false;
         }
 
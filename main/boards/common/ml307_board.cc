@@ -2,12 +2,15 @@
 
 #include "application.h"
 #include "display.h"
+#include "json_writer.h"
+#include "status_store.h"
 #include "assets/lang_config.h"
 
 #include <esp_log.h>
 #include <esp_timer.h>
 #include <font_awesome.h>
 #include <opus_encoder.h>
+#include <thread>
 
 static const char *TAG = "Ml307Board";
 
@@ -34,8 +37,13 @@ void Ml307Board::StartNetwork() {
     modem_->OnNetworkStateChanged([this, &application](bool network_ready) {
         if (network_ready) {
             ESP_LOGI(TAG, "Network is ready");
+            // Reading the signal strength is an AT command, which cannot wait on the modem's callback
+            std::thread([this]() {
+                StatusStore::GetInstance().SetNetworkIcon(GetNetworkStateIcon());
+            }).detach();
         } else {
             ESP_LOGE(TAG, "Network is down");
+            StatusStore::GetInstance().SetNetworkIcon(FONT_AWESOME_SIGNAL_OFF);
             auto device_state = application.GetDeviceState();
             if (device_state == kDeviceStateListening || device_state == kDeviceStateSpeaking) {
                 application.Schedule([this, &application]() {
@@ -59,6 +67,8 @@ void Ml307Board::StartNetwork() {
         vTaskDelay(pdMS_TO_TICKS(10000));
     }
 
+    StatusStore::GetInstance().SetNetworkIcon(GetNetworkStateIcon());
+
     // Print the ML307 modem information
     std::string module_revision = modem_->GetModuleRevision();
     std::string imei = modem_->GetImei();
@@ -135,63 +145,61 @@ std::string Ml307Board::GetDeviceStatusJson() {
      * }
      */
     auto& board = Board::GetInstance();
-    auto root = cJSON_CreateObject();
+    JsonWriter json;
+    json.BeginObject();
 
     // Audio speaker
-    auto audio_speaker = cJSON_CreateObject();
+    json.Key("audio_speaker").BeginObject();
     auto audio_codec = board.GetAudioCodec();
     if (audio_codec) {
-        cJSON_AddNumberToObject(audio_speaker, "volume", audio_codec->output_volume());
+        json.Member("volume", audio_codec->output_volume());
     }
-    cJSON_AddItemToObject(root, "audio_speaker", audio_speaker);
+    json.EndObject();
 
     // Screen brightness
     auto backlight = board.GetBacklight();
-    auto screen = cJSON_CreateObject();
+    json.Key("screen").BeginObject();
     if (backlight) {
-        cJSON_AddNumberToObject(screen, "brightness", backlight->brightness());
+        json.Member("brightness", backlight->brightness());
     }
     auto display = board.GetDisplay();
     if (display && display->height() > 64) { // For LCD display only
         auto theme = display->GetTheme();
         if (theme != nullptr) {
-            cJSON_AddStringToObject(screen, "theme", theme->name().c_str());
+            json.Member("theme", theme->name());
         }
     }
-    cJSON_AddItemToObject(root, "screen", screen);
+    json.EndObject();
 
     // Battery
     int battery_level = 0;
     bool charging = false;
     bool discharging = false;
     if (board.GetBatteryLevel(battery_level, charging, discharging)) {
-        cJSON* battery = cJSON_CreateObject();
-        cJSON_AddNumberToObject(battery, "level", battery_level);
-        cJSON_AddBoolToObject(battery, "charging", charging);
-        cJSON_AddItemToObject(root, "battery", battery);
+        json.Key("battery").BeginObject();
+        json.Member("level", battery_level);
+        json.Member("charging", charging);
+        json.EndObject();
     }
 
     // Network
-    auto network = cJSON_CreateObject();
-    cJSON_AddStringToObject(network, "type", "cellular");
-    cJSON_AddStringToObject(network, "carrier", modem_->GetCarrierName().c_str());
+    json.Key("network").BeginObject();
+    json.Member("type", "cellular");
+    json.Member("carrier", modem_->GetCarrierName());
     int csq = modem_->GetCsq();
     if (csq == -1) {
-        cJSON_AddStringToObject(network, "signal", "unknown");
+        json.Member("signal", "unknown");
     } else if (csq >= 0 && csq <= 14) {
-        cJSON_AddStringToObject(network, "signal", "very weak");
+        json.Member("signal", "very weak");
     } else if (csq >= 15 && csq <= 19) {
-        cJSON_AddStringToObject(network, "signal", "weak");
+        json.Member("signal", "weak");
     } else if (csq >= 20 && csq <= 24) {
-        cJSON_AddStringToObject(network, "signal", "medium");
+        json.Member("signal", "medium");
     } else if (csq >= 25 && csq <= 31) {
-        cJSON_AddStringToObject(network, "signal", "strong");
+        json.Member("signal", "strong");
     }
-    cJSON_AddItemToObject(root, "network", network);
+    json.EndObject();
 
-    auto json_str = cJSON_PrintUnformatted(root);
-    std::string json(json_str);
-    cJSON_free(json_str);
-    cJSON_Delete(root);
-    return json;
+    json.EndObject();
+    return json.Release();
 }
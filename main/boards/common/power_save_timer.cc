@@ -1,6 +1,6 @@
 #include "power_save_timer.h"
 #include "application.h"
-#include "settings.h"
+#include "settings_schema.h"
 
 #include <esp_log.h>
 
@@ -29,8 +29,7 @@ PowerSaveTimer::~PowerSaveTimer() {
 
 void PowerSaveTimer::SetEnabled(bool enabled) {
     if (enabled && !enabled_) {
-        Settings settings("wifi", false);
-        if (!settings.GetBool("sleep_mode", true)) {
+        if (!SettingsSchema::kSleepMode.Get()) {
             ESP_LOGI(TAG, "Power save timer is disabled by settings");
             return;
         }
@@ -9,8 +9,7 @@ PressToTalkMcpTool::PressToTalkMcpTool()
 
 void PressToTalkMcpTool::Initialize() {
     // 从设置中读取当前状态
-    Settings settings("vendor");
-    press_to_talk_enabled_ = settings.GetInt("press_to_talk", 0) != 0;
+    press_to_talk_enabled_ = SettingsSchema::kPressToTalk.Get() != 0;
 
     // 注册MCP工具
     auto& mcp_server = McpServer::GetInstance();
@@ -51,7 +50,6 @@ ReturnValue PressToTalkMcpTool::HandleSetPressToTalk(const PropertyList& propert
 void PressToTalkMcpTool::SetPressToTalkEnabled(bool enabled) {
     press_to_talk_enabled_ = enabled;
     
-    Settings settings("vendor", true);
-    settings.SetInt("press_to_talk", enabled ? 1 : 0);
+    SettingsSchema::kPressToTalk.Set(enabled ? 1 : 0);
     ESP_LOGI(TAG, "Press to talk enabled: %d", enabled);
 } 
\ No newline at end of file
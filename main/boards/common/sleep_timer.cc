@@ -2,6 +2,7 @@
 #include "application.h"
 #include "board.h"
 #include "display.h"
+#include "settings_schema.h"
 #include "settings.h"
 
 #include <esp_log.h>
@@ -33,8 +34,7 @@ SleepTimer::~SleepTimer() {
 
 void SleepTimer::SetEnabled(bool enabled) {
     if (enabled && !enabled_) {
-        Settings settings("wifi", false);
-        if (!settings.GetBool("sleep_mode", true)) {
+        if (!SettingsSchema::kSleepMode.Get()) {
             ESP_LOGI(TAG, "Power save timer is disabled by settings");
             return;
         }
@@ -118,6 +118,7 @@ void SleepTimer::CheckTimer() {
             on_enter_deep_sleep_mode_();
         }
 
+        Settings::Flush();
         esp_deep_sleep_start();
     }
 }
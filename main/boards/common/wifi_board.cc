@@ -3,13 +3,16 @@
 #include "display.h"
 #include "application.h"
 #include "system_info.h"
-#include "settings.h"
+#include "settings_schema.h"
+#include "json_writer.h"
+#include "status_store.h"
 #include "assets/lang_config.h"
 
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <esp_network.h>
 #include <esp_log.h>
+#include <esp_wifi.h>
 
 #include <font_awesome.h>
 #include <wifi_station.h>
@@ -20,11 +23,10 @@
 static const char *TAG = "WifiBoard";
 
 WifiBoard::WifiBoard() {
-    Settings settings("wifi", true);
-    wifi_config_mode_ = settings.GetInt("force_ap") == 1;
+    wifi_config_mode_ = SettingsSchema::kForceAp.Get() == 1;
     if (wifi_config_mode_) {
         ESP_LOGI(TAG, "force_ap is set to 1, reset to 0");
-        settings.SetInt("force_ap", 0);
+        SettingsSchema::kForceAp.Set(0);
     }
 }
 
@@ -40,6 +42,7 @@ void WifiBoard::EnterWifiConfigMode() {
     wifi_ap.SetLanguage(Lang::CODE);
     wifi_ap.SetSsidPrefix("Xiaozhi");
     wifi_ap.Start();
+    StatusStore::GetInstance().SetNetworkIcon(FONT_AWESOME_WIFI);
 
     // 等待 1.5 秒显示开发板信息
     vTaskDelay(pdMS_TO_TICKS(1500));
@@ -104,7 +107,13 @@ void WifiBoard::StartNetwork() {
         std::string notification = Lang::Strings::CONNECTED_TO;
         notification += ssid;
         display->ShowNotification(notification.c_str(), 30000);
+        StatusStore::GetInstance().SetNetworkIcon(GetNetworkStateIcon());
     });
+    // The icon is published on connection changes, the status bar does not poll it
+    esp_event_handler_register(WIFI_EVENT, WIFI_EVENT_STA_DISCONNECTED,
+        [](void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data) {
+            StatusStore::GetInstance().SetNetworkIcon(FONT_AWESOME_WIFI_SLASH);
+        }, nullptr);
     wifi_station.Start();
 
     // Try to connect to WiFi, if failed, launch the WiFi configuration AP
@@ -164,8 +173,7 @@ void WifiBoard::SetPowerSaveMode(bool enabled) {
 void WifiBoard::ResetWifiConfiguration() {
     // Set a flag and reboot the device to enter the network configuration mode
     {
-        Settings settings("wifi", true);
-        settings.SetInt("force_ap", 1);
+        SettingsSchema::kForceAp.Set(1);
     }
     GetDisplay()->ShowNotification(Lang::Strings::ENTERING_WIFI_CONFIG_MODE);
     vTaskDelay(pdMS_TO_TICKS(1000));
@@ -201,68 +209,66 @@ std::string WifiBoard::GetDeviceStatusJson() {
      * }
      */
     auto& board = Board::GetInstance();
-    auto root = cJSON_CreateObject();
+    JsonWriter json;
+    json.BeginObject();
 
     // Audio speaker
-    auto audio_speaker = cJSON_CreateObject();
+    json.Key("audio_speaker").BeginObject();
     auto audio_codec = board.GetAudioCodec();
     if (audio_codec) {
-        cJSON_AddNumberToObject(audio_speaker, "volume", audio_codec->output_volume());
+        json.Member("volume", audio_codec->output_volume());
     }
-    cJSON_AddItemToObject(root, "audio_speaker", audio_speaker);
+    json.EndObject();
 
     // Screen brightness
     auto backlight = board.GetBacklight();
-    auto screen = cJSON_CreateObject();
+    json.Key("screen").BeginObject();
     if (backlight) {
-        cJSON_AddNumberToObject(screen, "brightness", backlight->brightness());
+        json.Member("brightness", backlight->brightness());
     }
     auto display = board.GetDisplay();
     if (display && display->height() > 64) { // For LCD display only
         auto theme = display->GetTheme();
         if (theme != nullptr) {
-            cJSON_AddStringToObject(screen, "theme", theme->name().c_str());
+            json.Member("theme", theme->name());
         }
     }
-    cJSON_AddItemToObject(root, "screen", screen);
+    json.EndObject();
 
     // Battery
     int battery_level = 0;
     bool charging = false;
     bool discharging = false;
     if (board.GetBatteryLevel(battery_level, charging, discharging)) {
-        cJSON* battery = cJSON_CreateObject();
-        cJSON_AddNumberToObject(battery, "level", battery_level);
-        cJSON_AddBoolToObject(battery, "charging", charging);
-        cJSON_AddItemToObject(root, "battery", battery);
+        json.Key("battery").BeginObject();
+        json.Member("level", battery_level);
+        json.Member("charging", charging);
+        json.EndObject();
     }
 
     // Network
-    auto network = cJSON_CreateObject();
+    json.Key("network").BeginObject();
     auto& wifi_station = WifiStation::GetInstance();
-    cJSON_AddStringToObject(network, "type", "wifi");
-    cJSON_AddStringToObject(network, "ssid", wifi_station.GetSsid().c_str());
+    json.Member("type", "wifi");
+    json.Member("ssid", wifi_station.GetSsid());
     int rssi = wifi_station.GetRssi();
     if (rssi >= -60) {
-        cJSON_AddStringToObject(network, "signal", "strong");
+        json.Member("signal", "strong");
     } else if (rssi >= -70) {
-        cJSON_AddStringToObject(network, "signal", "medium");
+        json.Member("signal", "medium");
     } else {
-        cJSON_AddStringToObject(network, "signal", "weak");
+        json.Member("signal", "weak");
     }
-    cJSON_AddItemToObject(root, "network", network);
+    json.EndObject();
 
     // Chip
     float esp32temp = 0.0f;
     if (board.GetTemperature(esp32temp)) {
-        auto chip = cJSON_CreateObject();
-        cJSON_AddNumberToObject(chip, "temperature", esp32temp);
-        cJSON_AddItemToObject(root, "chip", chip);
+        json.Key("chip").BeginObject();
+        json.Member("temperature", esp32temp);
+        json.EndObject();
     }
 
-    auto json_str = cJSON_PrintUnformatted(root);
-    std::string json(json_str);
-    cJSON_free(json_str);
-    cJSON_Delete(root);
-    return json;
+    json.EndObject();
+    return json.Release();
 }
@@ -0,0 +1,133 @@
+#include "boot_trace.h"
+#include "json_writer.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_system.h>
+#include <esp_heap_caps.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+
+#define TAG "BootTrace"
+
+int BootTrace::Begin(const char* name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (count_ >= BOOT_TRACE_MAX_EVENTS) {
+        return -1;
+    }
+    auto& event = events_[count_];
+    event.name = name;
+    strncpy(event.task, pcTaskGetName(NULL), sizeof(event.task) - 1);
+    event.task[sizeof(event.task) - 1] = '\0';
+    event.free_heap_before = esp_get_free_heap_size();
+    event.end_us = -1;
+    event.start_us = esp_timer_get_time();
+    return count_++;
+}
+
+void BootTrace::End(int index) {
+    int64_t now = esp_timer_get_time();
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (index < 0 || index >= count_) {
+        return;
+    }
+    auto& event = events_[index];
+    event.end_us = now;
+    event.free_heap_after = esp_get_free_heap_size();
+    event.free_internal_after = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    event.min_free_heap = esp_get_minimum_free_heap_size();
+}
+
+void BootTrace::Mark(const char* name) {
+    End(Begin(name));
+}
+
+void BootTrace::Print() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ESP_LOGI(TAG, "%-24s %-16s %9s %9s %9s %9s", "phase", "task", "start_ms", "dur_ms", "used_kb", "sram_kb");
+    for (int i = 0; i < count_; i++) {
+        auto& event = events_[i];
+        if (event.end_us < 0) {
+            ESP_LOGI(TAG, "%-24s %-16s %9.1f %9s", event.name, event.task, event.start_us / 1000.0, "running");
+            continue;
+        }
+        int heap_delta = (int)event.free_heap_before - (int)event.free_heap_after;
+        ESP_LOGI(TAG, "%-24s %-16s %9.1f %9.1f %+9d %9lu", event.name, event.task, event.start_us / 1000.0,
+            (event.end_us - event.start_us) / 1000.0, heap_delta / 1024, (unsigned long)(event.free_internal_after / 1024));
+    }
+}
+
+std::string BootTrace::GetChromeTrace() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    JsonWriter writer(count_ * 192 + 64);
+    writer.BeginObject();
+    writer.Member("displayTimeUnit", "ms");
+    writer.Key("traceEvents").BeginArray();
+
+    // Every task gets its own track, named by a metadata event
+    const char* tasks[BOOT_TRACE_MAX_EVENTS];
+    int task_count = 0;
+    auto task_id = [&](const char* task) {
+        for (int i = 0; i < task_count; i++) {
+            if (strcmp(tasks[i], task) == 0) {
+                return i + 1;
+            }
+        }
+        tasks[task_count++] = task;
+        writer.BeginObject();
+        writer.Member("name", "thread_name").Member("ph", "M").Member("pid", 1).Member("tid", task_count);
+        writer.Key("args").BeginObject().Member("name", task).EndObject();
+        writer.EndObject();
+        return task_count;
+    };
+
+    for (int i = 0; i < count_; i++) {
+        auto& event = events_[i];
+        int tid = task_id(event.task);
+        if (event.end_us < 0) {
+            continue;
+        }
+        writer.BeginObject();
+        writer.Member("name", event.name).Member("cat", "boot");
+        writer.Member("ph", event.end_us == event.start_us ? "i" : "X");
+        writer.Member("ts", event.start_us);
+        if (event.end_us != event.start_us) {
+            writer.Member("dur", event.end_us - event.start_us);
+        }
+        writer.Member("pid", 1).Member("tid", tid);
+        writer.Key("args").BeginObject();
+        writer.Member("free_heap_before", event.free_heap_before);
+        writer.Member("free_heap_after", event.free_heap_after);
+        writer.Member("free_internal", event.free_internal_after);
+        writer.Member("min_free_heap", event.min_free_heap);
+        writer.EndObject();
+        writer.EndObject();
+
+        // Heap counter track
+        writer.BeginObject();
+        writer.Member("name", "heap").Member("ph", "C").Member("ts", event.end_us).Member("pid", 1);
+        writer.Key("args").BeginObject();
+        writer.Member("free", event.free_heap_after);
+        writer.Member("internal", event.free_internal_after);
+        writer.EndObject();
+        writer.EndObject();
+    }
+
+    writer.EndArray();
+    writer.EndObject();
+    return writer.Release();
+}
+
+void BootTrace::PrintChromeTrace() {
+    auto trace = GetChromeTrace();
+    // Printed in short lines, so the log output of other tasks does not get interleaved within a line
+    printf("BOOT_TRACE_BEGIN\n");
+    const size_t line_size = 96;
+    for (size_t offset = 0; offset < trace.size(); offset += line_size) {
+        printf("BOOT_TRACE %.*s\n", (int)std::min(line_size, trace.size() - offset), trace.c_str() + offset);
+    }
+    printf("BOOT_TRACE_END\n");
+}
@@ -0,0 +1,75 @@
+#ifndef BOOT_TRACE_H
+#define BOOT_TRACE_H
+
+#include <string>
+#include <mutex>
+#include <cstdint>
+
+#define BOOT_TRACE_MAX_EVENTS 48
+
+/*
+ * Records the duration and heap usage of every startup phase.
+ *
+ * Phases may nest and may run on different tasks. The trace can be printed as a table,
+ * or exported in the Chrome trace event format, which opens directly in Perfetto
+ * (ui.perfetto.dev) or chrome://tracing. Recording stops once the buffer is full,
+ * so the tracer costs nothing after boot.
+ *
+ *   {
+ *       BootTraceScope trace("assets.apply");
+ *       assets.Apply();
+ *   }
+ */
+class BootTrace {
+public:
+    static BootTrace& GetInstance() {
+        static BootTrace instance;
+        return instance;
+    }
+    // Delete copy constructor and assignment operator
+    BootTrace(const BootTrace&) = delete;
+    BootTrace& operator=(const BootTrace&) = delete;
+
+    // name must be a string literal, returns the event index or -1 if the buffer is full
+    int Begin(const char* name);
+    void End(int index);
+    // A zero length marker, e.g. "ready"
+    void Mark(const char* name);
+
+    // Print a summary table to the log
+    void Print();
+    // Print the Chrome trace JSON between BOOT_TRACE_BEGIN / BOOT_TRACE_END lines, see scripts/boot_trace.py
+    void PrintChromeTrace();
+    std::string GetChromeTrace();
+
+private:
+    BootTrace() = default;
+
+    struct Event {
+        const char* name;
+        char task[16];
+        int64_t start_us;
+        int64_t end_us;             // -1 while the phase is running
+        uint32_t free_heap_before;
+        uint32_t free_heap_after;
+        uint32_t free_internal_after;
+        uint32_t min_free_heap;     // Minimum free heap since boot when the phase ended
+    };
+
+    std::mutex mutex_;
+    Event events_[BOOT_TRACE_MAX_EVENTS];
+    int count_ = 0;
+};
+
+class BootTraceScope {
+public:
+    explicit BootTraceScope(const char* name) : index_(BootTrace::GetInstance().Begin(name)) {}
+    ~BootTraceScope() { BootTrace::GetInstance().End(index_); }
+    BootTraceScope(const BootTraceScope&) = delete;
+    BootTraceScope& operator=(const BootTraceScope&) = delete;
+
+private:
+    int index_;
+};
+
+#endif // BOOT_TRACE_H
@@ -0,0 +1,269 @@
+#include "delta_patcher.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <algorithm>
+#include <cstring>
+
+#define TAG "DeltaPatcher"
+#define DELTA_SCRATCH_SIZE 1024
+
+static bool ReadVarint(const uint8_t* data, size_t size, size_t& position, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (position >= size) {
+            return false;
+        }
+        uint8_t byte = data[position++];
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint32_t ReadUint32(const uint8_t* data) {
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+DeltaPatcher::DeltaPatcher(std::function<bool(size_t offset, uint8_t* buffer, size_t size)> read_source,
+                           std::function<bool(const uint8_t* data, size_t size)> write_target)
+    : read_source_(read_source), write_target_(write_target) {
+    mbedtls_sha256_init(&sha256_);
+}
+
+DeltaPatcher::~DeltaPatcher() {
+    mbedtls_sha256_free(&sha256_);
+    if (window_ != nullptr) {
+        heap_caps_free(window_);
+    }
+    if (output_ != nullptr) {
+        heap_caps_free(output_);
+    }
+}
+
+void DeltaPatcher::SetSourceElfSha256(const uint8_t* sha256) {
+    memcpy(expected_source_, sha256, sizeof(expected_source_));
+    check_source_ = true;
+}
+
+bool DeltaPatcher::Fail(const char* message) {
+    ESP_LOGE(TAG, "%s (output %u/%u)", message, written_, target_size_);
+    failed_ = true;
+    return false;
+}
+
+bool DeltaPatcher::ParseHeader() {
+    if (ReadUint32(pending_) != DELTA_PATCH_MAGIC) {
+        return Fail("Invalid patch magic");
+    }
+    window_size_ = ReadUint32(pending_ + 4);
+    source_size_ = ReadUint32(pending_ + 8);
+    target_size_ = ReadUint32(pending_ + 12);
+    memcpy(target_sha256_, pending_ + 48, sizeof(target_sha256_));
+    if (check_source_ && memcmp(pending_ + 16, expected_source_, sizeof(expected_source_)) != 0) {
+        return Fail("The patch is made for another firmware");
+    }
+    if (window_size_ == 0 || window_size_ > DELTA_PATCH_MAX_WINDOW) {
+        return Fail("Invalid window size");
+    }
+
+    // The window and the scratch space for copies share one allocation
+    window_ = (uint8_t*)heap_caps_malloc_prefer(window_size_ + DELTA_SCRATCH_SIZE, 2,
+        MALLOC_CAP_SPIRAM, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    output_ = (uint8_t*)heap_caps_malloc(DELTA_OUTPUT_BUFFER_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (window_ == nullptr || output_ == nullptr) {
+        return Fail("Failed to allocate patch buffers");
+    }
+    mbedtls_sha256_starts(&sha256_, 0);
+    ESP_LOGI(TAG, "Patching %u bytes into %u bytes, window %lu", source_size_, target_size_, window_size_);
+    return true;
+}
+
+bool DeltaPatcher::Feed(const uint8_t* data, size_t size) {
+    while (size > 0 && !failed_) {
+        if (ended_) {
+            return Fail("Data after the end of the patch");
+        }
+        if (!header_done_) {
+            size_t length = std::min(size, DELTA_PATCH_HEADER_SIZE - pending_size_);
+            memcpy(pending_ + pending_size_, data, length);
+            pending_size_ += length;
+            data += length;
+            size -= length;
+            if (pending_size_ == DELTA_PATCH_HEADER_SIZE) {
+                if (!ParseHeader()) {
+                    return false;
+                }
+                header_done_ = true;
+                pending_size_ = 0;
+            }
+            continue;
+        }
+        if (literal_left_ > 0) {
+            size_t length = std::min(size, literal_left_);
+            if (!Emit(data, length)) {
+                return false;
+            }
+            literal_left_ -= length;
+            data += length;
+            size -= length;
+            continue;
+        }
+
+        // Operation headers are at most 21 bytes, collect them one byte at a time
+        pending_[pending_size_++] = *data++;
+        size--;
+        if (ParseOperation() > 0) {
+            pending_size_ = 0;
+        } else if (pending_size_ >= 21) {
+            return Fail("Invalid operation");
+        }
+    }
+    return !failed_;
+}
+
+size_t DeltaPatcher::ParseOperation() {
+    size_t position = 1;
+    uint64_t length = 0, argument = 0;
+    switch (pending_[0]) {
+    case kOpEnd:
+        ended_ = true;
+        return position;
+    case kOpLiteral:
+        if (!ReadVarint(pending_, pending_size_, position, length)) {
+            return 0;
+        }
+        // written_ never exceeds target_size_, so the subtraction cannot wrap
+        if (length > target_size_ - written_) {
+            Fail("Literal exceeds the target size");
+            return position;
+        }
+        literal_left_ = length;
+        return position;
+    case kOpCopySource: {
+        if (!ReadVarint(pending_, pending_size_, position, length) ||
+            !ReadVarint(pending_, pending_size_, position, argument)) {
+            return 0;
+        }
+        int64_t delta = (int64_t)(argument >> 1) ^ -(int64_t)(argument & 1);
+        // source_position_ stays within [0, source_size_], so neither side can overflow
+        if (delta < -source_position_ || delta > (int64_t)source_size_ - source_position_) {
+            Fail("Source copy out of range");
+            return position;
+        }
+        int64_t offset = source_position_ + delta;
+        if (CopySource(offset, length)) {
+            source_position_ = offset + length;
+        }
+        return position;
+    }
+    case kOpCopyTarget:
+        if (!ReadVarint(pending_, pending_size_, position, length) ||
+            !ReadVarint(pending_, pending_size_, position, argument)) {
+            return 0;
+        }
+        CopyTarget(argument, length);
+        return position;
+    default:
+        Fail("Unknown operation");
+        return position;
+    }
+}
+
+bool DeltaPatcher::CopySource(size_t offset, uint64_t length) {
+    if (offset > source_size_ || length > source_size_ - offset || length > target_size_ - written_) {
+        return Fail("Source copy out of range");
+    }
+    uint8_t* scratch = window_ + window_size_;
+    size_t left = (size_t)length;
+    while (left > 0) {
+        size_t size = std::min(left, (size_t)DELTA_SCRATCH_SIZE);
+        if (!read_source_(offset, scratch, size)) {
+            return Fail("Failed to read the source image");
+        }
+        if (!Emit(scratch, size)) {
+            return false;
+        }
+        offset += size;
+        left -= size;
+    }
+    return true;
+}
+
+bool DeltaPatcher::CopyTarget(uint64_t distance, uint64_t length) {
+    if (distance == 0 || distance > window_size_ || distance > written_ || length > target_size_ - written_) {
+        return Fail("Target copy out of range");
+    }
+    uint8_t* scratch = window_ + window_size_;
+    size_t left = (size_t)length;
+    size_t back = (size_t)distance;
+    while (left > 0) {
+        // An overlapping copy repeats the last `back` bytes, so copy at most that much at a time
+        size_t size = std::min({ left, back, (size_t)DELTA_SCRATCH_SIZE });
+        size_t start = (written_ - back) % window_size_;
+        size_t first = std::min(size, window_size_ - start);
+        memcpy(scratch, window_ + start, first);
+        memcpy(scratch + first, window_, size - first);
+        if (!Emit(scratch, size)) {
+            return false;
+        }
+        left -= size;
+    }
+    return true;
+}
+
+bool DeltaPatcher::Emit(const uint8_t* data, size_t size) {
+    if (written_ + size > target_size_) {
+        return Fail("Output exceeds the target size");
+    }
+    while (size > 0) {
+        size_t position = written_ % window_size_;
+        size_t length = std::min({ size, window_size_ - position, DELTA_OUTPUT_BUFFER_SIZE - output_size_ });
+        memcpy(window_ + position, data, length);
+        memcpy(output_ + output_size_, data, length);
+        output_size_ += length;
+        written_ += length;
+        data += length;
+        size -= length;
+        if (output_size_ == DELTA_OUTPUT_BUFFER_SIZE && !FlushOutput()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool DeltaPatcher::FlushOutput() {
+    if (output_size_ == 0) {
+        return true;
+    }
+    mbedtls_sha256_update(&sha256_, output_, output_size_);
+    if (!write_target_(output_, output_size_)) {
+        return Fail("Failed to write the target image");
+    }
+    output_size_ = 0;
+    return true;
+}
+
+bool DeltaPatcher::Finish() {
+    if (failed_) {
+        return false;
+    }
+    if (!ended_ || literal_left_ > 0) {
+        return Fail("The patch is incomplete");
+    }
+    if (!FlushOutput()) {
+        return false;
+    }
+    if (written_ != target_size_) {
+        return Fail("Output size mismatch");
+    }
+    uint8_t sha256[32];
+    mbedtls_sha256_finish(&sha256_, sha256);
+    if (memcmp(sha256, target_sha256_, sizeof(sha256)) != 0) {
+        return Fail("SHA-256 of the patched image does not match");
+    }
+    ESP_LOGI(TAG, "Patched image verified, %u bytes", written_);
+    return true;
+}
@@ -0,0 +1,91 @@
+#ifndef DELTA_PATCHER_H
+#define DELTA_PATCHER_H
+
+#include <string>
+#include <functional>
+#include <cstdint>
+#include <mbedtls/sha256.h>
+
+/*
+ * Delta patch format, generated by scripts/delta_ota.py (all integers little endian):
+ *
+ * Header: |magic "DLT1" 4|window_size 4|source_size 4|target_size 4|source_elf_sha256 32|target_sha256 32|
+ * Then a stream of operations, lengths and distances are LEB128 varints:
+ *   0x00                           end of patch
+ *   0x01 |length|bytes...          literal bytes
+ *   0x02 |length|zigzag delta      copy from the source image, offset relative to the end of the last source copy
+ *   0x03 |length|distance          copy from the target output, at most window_size bytes back
+ *
+ * source_elf_sha256 identifies the running firmware (esp_app_desc_t::app_elf_sha256),
+ * target_sha256 is the SHA-256 of the whole reconstructed image.
+ */
+#define DELTA_PATCH_MAGIC 0x31544C44    // "DLT1"
+#define DELTA_PATCH_HEADER_SIZE 80
+#define DELTA_PATCH_MAX_WINDOW (64 * 1024)
+#define DELTA_OUTPUT_BUFFER_SIZE 4096
+
+/*
+ * Rebuilds a new image from the source image and a delta patch received in pieces of any size.
+ * The output is produced in order, so it can be written straight into an OTA partition.
+ */
+class DeltaPatcher {
+public:
+    DeltaPatcher(std::function<bool(size_t offset, uint8_t* buffer, size_t size)> read_source,
+                 std::function<bool(const uint8_t* data, size_t size)> write_target);
+    ~DeltaPatcher();
+
+    // Checks the header once it is complete, so a patch for another source fails early
+    void SetSourceElfSha256(const uint8_t* sha256);
+
+    bool Feed(const uint8_t* data, size_t size);
+    // Flush the output and check that the patch is complete and the image hash matches
+    bool Finish();
+
+    inline size_t target_size() const { return target_size_; }
+    inline size_t written() const { return written_; }
+
+private:
+    enum Opcode : uint8_t {
+        kOpEnd = 0x00,
+        kOpLiteral = 0x01,
+        kOpCopySource = 0x02,
+        kOpCopyTarget = 0x03,
+    };
+
+    std::function<bool(size_t offset, uint8_t* buffer, size_t size)> read_source_;
+    std::function<bool(const uint8_t* data, size_t size)> write_target_;
+    uint8_t expected_source_[32] = {};
+    bool check_source_ = false;
+
+    // Header and operation headers are collected here until complete
+    uint8_t pending_[DELTA_PATCH_HEADER_SIZE];
+    size_t pending_size_ = 0;
+    bool header_done_ = false;
+    bool ended_ = false;
+    bool failed_ = false;
+    size_t literal_left_ = 0;
+
+    uint32_t window_size_ = 0;
+    size_t source_size_ = 0;
+    size_t target_size_ = 0;
+    uint8_t target_sha256_[32];
+    int64_t source_position_ = 0;
+
+    uint8_t* window_ = nullptr;     // Ring buffer of the latest output
+    uint8_t* output_ = nullptr;
+    size_t output_size_ = 0;
+    size_t written_ = 0;            // Total output bytes
+    mbedtls_sha256_context sha256_;
+
+    bool ParseHeader();
+    // Returns the number of bytes of pending_ used by a complete operation header, 0 if incomplete
+    size_t ParseOperation();
+    bool Emit(const uint8_t* data, size_t size);
+    bool FlushOutput();
+    // Lengths come straight from the patch, so they are checked before being narrowed to size_t
+    bool CopySource(size_t offset, uint64_t length);
+    bool CopyTarget(uint64_t distance, uint64_t length);
+    bool Fail(const char* message);
+};
+
+#endif // DELTA_PATCHER_H
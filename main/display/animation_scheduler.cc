@@ -0,0 +1,124 @@
+#include "animation_scheduler.h"
+#include "device_state_event.h"
+#include "json_writer.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#define TAG "AnimationScheduler"
+
+AnimationScheduler& AnimationScheduler::GetInstance() {
+    static AnimationScheduler instance;
+    return instance;
+}
+
+AnimationScheduler::AnimationScheduler() {
+    window_start_time_ = esp_timer_get_time();
+
+    // Capturing and playing audio need the CPU more than the animations do
+    DeviceStateEventManager::GetInstance().RegisterStateChangeCallback([this](DeviceState previous_state, DeviceState current_state) {
+        SetAudioBusy(current_state == kDeviceStateListening || current_state == kDeviceStateSpeaking);
+    });
+}
+
+bool AnimationScheduler::CanPresent() {
+    auto now = esp_timer_get_time();
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto since_present = now - present_time_;
+    if (frame_pending_ && since_present < ANIMATION_FLUSH_TIMEOUT_MS * 1000LL) {
+        if (!frame_held_) {
+            frame_held_ = true;
+            metrics_.held_frames++;
+        }
+        return false;
+    }
+    return since_present >= 1000000LL / FpsLimit();
+}
+
+void AnimationScheduler::FramePresented(uint32_t dropped) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    present_time_ = esp_timer_get_time();
+    frame_pending_ = true;
+    frame_held_ = false;
+    metrics_.presented_frames++;
+    metrics_.dropped_frames += dropped;
+}
+
+void AnimationScheduler::BeginFlush(int64_t time_us) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Only refreshes that carry an animation frame are measured
+    if (frame_pending_ && !flushing_) {
+        flushing_ = true;
+        flush_start_time_ = time_us;
+    }
+}
+
+void AnimationScheduler::EndFlush(int64_t time_us) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!flushing_) {
+        return;
+    }
+    flushing_ = false;
+    frame_pending_ = false;
+
+    RollWindow(time_us);
+    uint32_t duration = time_us > flush_start_time_ ? time_us - flush_start_time_ : 0;
+    window_frames_++;
+    window_flush_time_us_ += duration;
+    if (duration > window_max_flush_time_us_) {
+        window_max_flush_time_us_ = duration;
+    }
+}
+
+void AnimationScheduler::RollWindow(int64_t now) {
+    auto elapsed = now - window_start_time_;
+    if (elapsed < ANIMATION_METRICS_WINDOW_MS * 1000LL) {
+        return;
+    }
+    metrics_.fps = window_frames_ * 1000000.0f / elapsed;
+    metrics_.flush_time_us = window_frames_ > 0 ? window_flush_time_us_ / window_frames_ : 0;
+    metrics_.max_flush_time_us = window_max_flush_time_us_;
+    window_start_time_ = now;
+    window_frames_ = 0;
+    window_flush_time_us_ = 0;
+    window_max_flush_time_us_ = 0;
+}
+
+int AnimationScheduler::GetFpsLimit() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return FpsLimit();
+}
+
+void AnimationScheduler::SetAudioBusy(bool busy) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (audio_busy_ != busy) {
+        audio_busy_ = busy;
+        ESP_LOGD(TAG, "Animation frame rate limited to %d fps", FpsLimit());
+    }
+}
+
+AnimationMetrics AnimationScheduler::GetMetrics() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // An animation that stopped leaves its last window behind
+    RollWindow(esp_timer_get_time());
+    metrics_.fps_limit = FpsLimit();
+    metrics_.audio_busy = audio_busy_;
+    return metrics_;
+}
+
+std::string AnimationScheduler::GetMetricsJson() {
+    auto metrics = GetMetrics();
+    JsonWriter json;
+    json.BeginObject();
+    json.Member("fps", metrics.fps);
+    json.Member("fps_limit", metrics.fps_limit);
+    json.Member("audio_busy", metrics.audio_busy);
+    json.Member("flush_time_us", metrics.flush_time_us);
+    json.Member("max_flush_time_us", metrics.max_flush_time_us);
+    json.Member("presented_frames", metrics.presented_frames);
+    json.Member("dropped_frames", metrics.dropped_frames);
+    json.Member("held_frames", metrics.held_frames);
+    json.Member("window_ms", ANIMATION_METRICS_WINDOW_MS);
+    json.EndObject();
+    return json.Release();
+}
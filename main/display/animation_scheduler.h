@@ -0,0 +1,81 @@
+#ifndef ANIMATION_SCHEDULER_H
+#define ANIMATION_SCHEDULER_H
+
+#include <mutex>
+#include <string>
+#include <cstdint>
+
+// Most animation frames presented per second
+#define ANIMATION_MAX_FPS 30
+// Most frames per second while the device is listening or speaking, so the audio tasks keep the CPU
+#define ANIMATION_AUDIO_BUSY_MAX_FPS 12
+// A frame that has not reached the panel after this long no longer holds back the next one
+#define ANIMATION_FLUSH_TIMEOUT_MS 200
+// Length of the window the FPS and flush times are measured over
+#define ANIMATION_METRICS_WINDOW_MS 2000
+
+struct AnimationMetrics {
+    float fps = 0;                      // Frames that reached the panel per second, last window
+    uint32_t flush_time_us = 0;         // Average time from the start of a refresh to the frame being on the panel, last window
+    uint32_t max_flush_time_us = 0;     // Slowest of those, last window
+    uint32_t presented_frames = 0;      // Totals since boot
+    uint32_t dropped_frames = 0;        // Frames skipped to stay on time
+    uint32_t held_frames = 0;           // Frames postponed because the previous one was still being flushed
+    int fps_limit = ANIMATION_MAX_FPS;
+    bool audio_busy = false;
+};
+
+/*
+ * Paces the emotion animations to the panel.
+ *
+ * An animation asks CanPresent() before it shows a new frame. The answer is no while its previous
+ * frame is still being rendered and flushed, or when the frame would come sooner than the frame
+ * rate limit allows. The animation keeps its own timeline meanwhile and skips the frames it missed
+ * once it may present again (reported through FramePresented), so it stays on time instead of
+ * slowing down, and it never makes the panel flush faster than the panel can. The limit drops while
+ * the device is listening or speaking.
+ *
+ * The displays report every refresh that carries an animation frame with BeginFlush() / EndFlush().
+ */
+class AnimationScheduler {
+public:
+    static AnimationScheduler& GetInstance();
+    AnimationScheduler(const AnimationScheduler&) = delete;
+    AnimationScheduler& operator=(const AnimationScheduler&) = delete;
+
+    bool CanPresent();
+    // A new frame was handed to the display, after skipping `dropped` frames
+    void FramePresented(uint32_t dropped = 0);
+    // The display started / finished putting the presented frame on the panel, times from esp_timer_get_time()
+    void BeginFlush(int64_t time_us);
+    void EndFlush(int64_t time_us);
+
+    int GetFpsLimit();
+    void SetAudioBusy(bool busy);
+
+    AnimationMetrics GetMetrics();
+    std::string GetMetricsJson();
+
+private:
+    AnimationScheduler();
+    ~AnimationScheduler() = default;
+
+    void RollWindow(int64_t now);
+    int FpsLimit() const { return audio_busy_ ? ANIMATION_AUDIO_BUSY_MAX_FPS : ANIMATION_MAX_FPS; }
+
+    std::mutex mutex_;
+    bool audio_busy_ = false;
+    bool frame_pending_ = false;    // Presented but not on the panel yet
+    bool frame_held_ = false;       // The next frame was already counted as held
+    bool flushing_ = false;
+    int64_t present_time_ = 0;
+    int64_t flush_start_time_ = 0;
+
+    int64_t window_start_time_ = 0;
+    uint32_t window_frames_ = 0;
+    uint64_t window_flush_time_us_ = 0;
+    uint32_t window_max_flush_time_us_ = 0;
+    AnimationMetrics metrics_;
+};
+
+#endif // ANIMATION_SCHEDULER_H
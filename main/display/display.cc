@@ -9,7 +9,7 @@
 #include "board.h"
 #include "application.h"
 #include "audio_codec.h"
-#include "settings.h"
+#include "settings_schema.h"
 #include "assets/lang_config.h"
 
 #define TAG "Display"
@@ -47,8 +47,7 @@ void Display::SetChatMessage(const char* role, const char* content) {
 
 void Display::SetTheme(Theme* theme) {
     current_theme_ = theme;
-    Settings settings("display", true);
-    settings.SetString("theme", theme->name());
+    SettingsSchema::kTheme.Set(theme->name());
 }
 
 void Display::SetPowerSaveMode(bool on) {
@@ -1,6 +1,9 @@
 #include "emote_display.h"
 
 // Standard C++ headers
+#include <algorithm>
+#include <atomic>
+#include <climits>
 #include <cstring>
 #include <memory>
 #include <unordered_map>
@@ -23,6 +26,7 @@
 #include "assets.h"
 #include "assets/lang_config.h"
 #include "board.h"
+#include "animation_scheduler.h"
 #include "gfx.h"
 
 LV_FONT_DECLARE(BUILTIN_TEXT_FONT);
@@ -68,6 +72,14 @@ static gfx_obj_t* g_obj_img_status = nullptr;
 static std::string g_current_icon_type = ICON_WIFI_FAILED;
 static gfx_image_dsc_t g_icon_img_dsc;
 
+// The engine whose band is being sent to the panel, and when the panel finished a band
+// (low 32 bits of esp_timer_get_time()), both used by the panel IO interrupt
+static std::atomic<gfx_handle_t> g_flushing_engine = nullptr;
+static std::atomic<uint32_t> g_flush_done_time = 0;
+static bool g_flush_io_ready_registered = false;
+// First row of the last band sent
+static int g_last_flush_y = INT_MAX;
+
 
 // ============================================================================
 // Forward Declarations
@@ -171,7 +183,7 @@ static void SetUIDisplayMode(const UIDisplayMode mode, EmoteDisplay* const displ
         const AssetData emoji_data = display->GetIconData(ICON_LISTEN);
         if (emoji_data.data) {
             gfx_anim_set_src(g_obj_anim_listen, emoji_data.data, emoji_data.size);
-            gfx_anim_set_segment(g_obj_anim_listen, 0, 0xFFFF, 20, true);
+            gfx_anim_set_segment(g_obj_anim_listen, 0, 0xFFFF, std::min(20, AnimationScheduler::GetInstance().GetFpsLimit()), true);
             gfx_anim_start(g_obj_anim_listen);
         }
         break;
@@ -218,7 +230,8 @@ static void InitializeGraphics(const esp_lcd_panel_handle_t panel, gfx_handle_t*
 
     gfx_cfg.task.task_stack_caps = MALLOC_CAP_DEFAULT;
     gfx_cfg.task.task_affinity = 0;
-    gfx_cfg.task.task_priority = 5;
+    // Below opus_codec, the engine renders with what the audio tasks leave
+    gfx_cfg.task.task_priority = 1;
     gfx_cfg.task.task_stack = 8 * 1024;
 
     *engine_handle = gfx_emote_init(&gfx_cfg);
@@ -268,7 +281,7 @@ static void SetupUI(const gfx_handle_t engine_handle, EmoteDisplay* const displa
     SetUIDisplayMode(UIDisplayMode::SHOW_TIPS, display);
 }
 
-static void RegisterCallbacks(const esp_lcd_panel_io_handle_t panel_io, const gfx_handle_t engine_handle)
+static void RegisterCallbacks(const esp_lcd_panel_io_handle_t panel_io)
 {
     if (!panel_io) {
         ESP_LOGE(TAG, "RegisterCallbacks: panel_io is nullptr");
@@ -278,7 +291,7 @@ static void RegisterCallbacks(const esp_lcd_panel_io_handle_t panel_io, const gf
     const esp_lcd_panel_io_callbacks_t cbs = {
         .on_color_trans_done = EmoteEngine::OnFlushIoReady,
     };
-    esp_lcd_panel_io_register_event_callbacks(panel_io, &cbs, engine_handle);
+    g_flush_io_ready_registered = esp_lcd_panel_io_register_event_callbacks(panel_io, &cbs, nullptr) == ESP_OK;
 }
 
 // ============================================================================
@@ -288,6 +301,8 @@ static void RegisterCallbacks(const esp_lcd_panel_io_handle_t panel_io, const gf
 EmoteEngine::EmoteEngine(const esp_lcd_panel_handle_t panel, const esp_lcd_panel_io_handle_t panel_io,
                          const int width, const int height, EmoteDisplay* const display)
 {
+    // Registered before the engine starts flushing, it waits for these callbacks
+    RegisterCallbacks(panel_io);
     InitializeGraphics(panel, &engine_handle_, width, height);
 
     if (display) {
@@ -295,8 +310,6 @@ EmoteEngine::EmoteEngine(const esp_lcd_panel_handle_t panel, const esp_lcd_panel
         SetupUI(engine_handle_, display);
         gfx_emote_unlock(engine_handle_);
     }
-
-    RegisterCallbacks(panel_io, engine_handle_);
 }
 
 EmoteEngine::~EmoteEngine()
@@ -323,7 +336,7 @@ void EmoteEngine::SetEyes(const std::string &emoji_name, const bool repeat, cons
     if (emoji_data.data) {
         DisplayLockGuard lock(display);
         gfx_anim_set_src(g_obj_anim_eye, emoji_data.data, emoji_data.size);
-        gfx_anim_set_segment(g_obj_anim_eye, 0, 0xFFFF, fps, repeat);
+        gfx_anim_set_segment(g_obj_anim_eye, 0, 0xFFFF, std::min(fps, AnimationScheduler::GetInstance().GetFpsLimit()), repeat);
         gfx_obj_set_visible(g_obj_anim_eye, true);
         gfx_anim_start(g_obj_anim_eye);
     } else {
@@ -362,17 +375,45 @@ bool EmoteEngine::OnFlushIoReady(const esp_lcd_panel_io_handle_t panel_io,
                                  esp_lcd_panel_io_event_data_t* const edata,
                                  void* const user_ctx)
 {
+    // The buffer is handed back to the engine only once the panel has it, which paces the frames to the panel
+    g_flush_done_time.store(static_cast<uint32_t>(esp_timer_get_time()));
+    const gfx_handle_t handle = g_flushing_engine.exchange(nullptr);
+    if (handle) {
+        gfx_emote_flush_ready(handle, true);
+    }
     return true;
 }
 
 void EmoteEngine::OnFlush(const gfx_handle_t handle, const int x_start, const int y_start,
                           const int x_end, const int y_end, const void* const color_data)
 {
+    // The bands of a frame go top down, so a band that does not start below the last one begins a new frame
+    if (y_start <= g_last_flush_y) {
+        auto& scheduler = AnimationScheduler::GetInstance();
+        const int64_t now = esp_timer_get_time();
+        const uint32_t since_done = static_cast<uint32_t>(now) - g_flush_done_time.load();
+        scheduler.EndFlush(now - since_done);
+        scheduler.FramePresented();
+        scheduler.BeginFlush(now);
+    }
+    g_last_flush_y = y_start;
+
     auto* const panel = static_cast<esp_lcd_panel_handle_t>(gfx_emote_get_user_data(handle));
-    if (panel) {
-        esp_lcd_panel_draw_bitmap(panel, x_start, y_start, x_end, y_end, color_data);
+    if (!panel || !g_flush_io_ready_registered) {
+        if (panel) {
+            esp_lcd_panel_draw_bitmap(panel, x_start, y_start, x_end, y_end, color_data);
+        }
+        gfx_emote_flush_ready(handle, true);
+        return;
+    }
+
+    g_flushing_engine.store(handle);
+    if (esp_lcd_panel_draw_bitmap(panel, x_start, y_start, x_end, y_end, color_data) != ESP_OK) {
+        // Nothing was queued, so no interrupt will hand the buffer back
+        if (g_flushing_engine.exchange(nullptr)) {
+            gfx_emote_flush_ready(handle, true);
+        }
     }
-    gfx_emote_flush_ready(handle, true);
 }
 
 // ============================================================================
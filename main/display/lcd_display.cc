@@ -1,8 +1,10 @@
 #include "lcd_display.h"
 #include "gif/lvgl_gif.h"
-#include "settings.h"
+#include "settings_schema.h"
 #include "lvgl_theme.h"
 #include "assets/lang_config.h"
+#include "boot_trace.h"
+#include "animation_scheduler.h"
 
 #include <vector>
 #include <algorithm>
@@ -21,7 +23,18 @@ LV_FONT_DECLARE(BUILTIN_TEXT_FONT);
 LV_FONT_DECLARE(BUILTIN_ICON_FONT);
 LV_FONT_DECLARE(font_awesome_30_4);
 
+// Refreshes carrying an animation frame are timed, and the next frame waits for them to finish
+static void OnRefreshEvent(lv_event_t* e) {
+    auto& scheduler = AnimationScheduler::GetInstance();
+    if (lv_event_get_code(e) == LV_EVENT_REFR_START) {
+        scheduler.BeginFlush(esp_timer_get_time());
+    } else {
+        scheduler.EndFlush(esp_timer_get_time());
+    }
+}
+
 void LcdDisplay::InitializeLcdThemes() {
+    BootTraceScope trace("display.themes");
     auto text_font = std::make_shared<LvglBuiltInFont>(&BUILTIN_TEXT_FONT);
     auto icon_font = std::make_shared<LvglBuiltInFont>(&BUILTIN_ICON_FONT);
     auto large_icon_font = std::make_shared<LvglBuiltInFont>(&font_awesome_30_4);
@@ -70,8 +83,7 @@ LcdDisplay::LcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_
     InitializeLcdThemes();
 
     // Load theme from settings
-    Settings settings("display", false);
-    std::string theme_name = settings.GetString("theme", "light");
+    std::string theme_name = SettingsSchema::kTheme.Get();
     current_theme_ = LvglThemeManager::GetInstance().GetTheme(theme_name);
 
     // Create a timer to hide the preview image
@@ -89,7 +101,8 @@ LcdDisplay::LcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_
 }
 
 SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
-                           int width, int height, int offset_x, int offset_y, bool mirror_x, bool mirror_y, bool swap_xy)
+                           int width, int height, int offset_x, int offset_y, bool mirror_x, bool mirror_y, bool swap_xy,
+                           const LcdFlushConfig& flush_config)
     : LcdDisplay(panel_io, panel, width, height) {
 
     // draw white
@@ -130,9 +143,9 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
         .io_handle = panel_io_,
         .panel_handle = panel_,
         .control_handle = nullptr,
-        .buffer_size = static_cast<uint32_t>(width_ * 20),
-        .double_buffer = false,
-        .trans_size = 0,
+        .buffer_size = static_cast<uint32_t>(width_ * flush_config.buffer_lines),
+        .double_buffer = flush_config.double_buffer,
+        .trans_size = static_cast<uint32_t>(width_ * flush_config.trans_lines),
         .hres = static_cast<uint32_t>(width_),
         .vres = static_cast<uint32_t>(height_),
         .monochrome = false,
@@ -143,10 +156,10 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
         },
         .color_format = LV_COLOR_FORMAT_RGB565,
         .flags = {
-            .buff_dma = 1,
-            .buff_spiram = 0,
+            .buff_dma = !flush_config.buffer_in_psram,
+            .buff_spiram = flush_config.buffer_in_psram,
             .sw_rotate = 0,
-            .swap_bytes = 1,
+            .swap_bytes = flush_config.swap_bytes,
             .full_refresh = 0,
             .direct_mode = 0,
         },
@@ -157,6 +170,7 @@ SpiLcdDisplay::SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_h
         ESP_LOGE(TAG, "Failed to add display");
         return;
     }
+    flush_pipeline_ = std::make_unique<LcdFlushPipeline>(display_, panel_io_, flush_config);
 
     if (offset_x != 0 || offset_y != 0) {
         lv_display_set_offset(display_, offset_x, offset_y);
@@ -321,6 +335,7 @@ LcdDisplay::~LcdDisplay() {
     if (container_ != nullptr) {
         lv_obj_del(container_);
     }
+    flush_pipeline_.reset();
     if (display_ != nullptr) {
         lv_display_delete(display_);
     }
@@ -333,6 +348,13 @@ LcdDisplay::~LcdDisplay() {
     }
 }
 
+std::string LcdDisplay::GetFlushStatsJson() {
+    if (flush_pipeline_ == nullptr) {
+        return "";
+    }
+    return flush_pipeline_->GetStatsJson();
+}
+
 bool LcdDisplay::Lock(int timeout_ms) {
     return lvgl_port_lock(timeout_ms);
 }
@@ -344,11 +366,12 @@ void LcdDisplay::Unlock() {
 #if CONFIG_USE_WECHAT_MESSAGE_STYLE
 void LcdDisplay::SetupUI() {
     DisplayLockGuard lock(this);
+    lv_display_add_event_cb(display_, OnRefreshEvent, LV_EVENT_REFR_START, nullptr);
+    lv_display_add_event_cb(display_, OnRefreshEvent, LV_EVENT_REFR_READY, nullptr);
 
     auto lvgl_theme = static_cast<LvglTheme*>(current_theme_);
     auto text_font = lvgl_theme->text_font()->font();
-    auto icon_font = lvgl_theme->icon_font()->font();
-    auto large_icon_font = lvgl_theme->large_icon_font()->font();
+    styles_.Apply(lvgl_theme);
 
     auto screen = lv_screen_active();
     lv_obj_set_style_text_font(screen, text_font, 0);
@@ -358,29 +381,21 @@ void LcdDisplay::SetupUI() {
     /* Container */
     container_ = lv_obj_create(screen);
     lv_obj_set_size(container_, LV_HOR_RES, LV_VER_RES);
-    lv_obj_set_style_radius(container_, 0, 0);
     lv_obj_set_flex_flow(container_, LV_FLEX_FLOW_COLUMN);
-    lv_obj_set_style_pad_all(container_, 0, 0);
-    lv_obj_set_style_border_width(container_, 0, 0);
+    styles_.Attach(container_, {kLvglStylePlain, kLvglStyleBackground});
     lv_obj_set_style_pad_row(container_, 0, 0);
-    lv_obj_set_style_bg_color(container_, lvgl_theme->background_color(), 0);
-    lv_obj_set_style_border_color(container_, lvgl_theme->border_color(), 0);
 
     /* Status bar */
     status_bar_ = lv_obj_create(container_);
     lv_obj_set_size(status_bar_, LV_HOR_RES, LV_SIZE_CONTENT);
-    lv_obj_set_style_radius(status_bar_, 0, 0);
-    lv_obj_set_style_bg_color(status_bar_, lvgl_theme->background_color(), 0);
-    lv_obj_set_style_text_color(status_bar_, lvgl_theme->text_color(), 0);
-    
+    styles_.Attach(status_bar_, {kLvglStyleStatusBar});
+
     /* Content - Chat area */
     content_ = lv_obj_create(container_);
-    lv_obj_set_style_radius(content_, 0, 0);
     lv_obj_set_width(content_, LV_HOR_RES);
     lv_obj_set_flex_grow(content_, 1);
+    styles_.Attach(content_, {kLvglStylePlain, kLvglStyleChatBackground}); // Background for chat area
     lv_obj_set_style_pad_all(content_, lvgl_theme->spacing(4), 0);
-    lv_obj_set_style_border_width(content_, 0, 0);
-    lv_obj_set_style_bg_color(content_, lvgl_theme->chat_background_color(), 0); // Background for chat area
 
     // Enable scrolling for chat content
     lv_obj_set_scrollbar_mode(content_, LV_SCROLLBAR_MODE_OFF);
@@ -391,31 +406,22 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_flex_align(content_, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_START);
     lv_obj_set_style_pad_row(content_, lvgl_theme->spacing(4), 0); // Space between messages
 
-    // We'll create chat messages dynamically in SetChatMessage
+    // Chat messages are rows recycled by SetChatMessage, styled by the shared chat styles
     chat_message_label_ = nullptr;
 
     /* Status bar */
     lv_obj_set_flex_flow(status_bar_, LV_FLEX_FLOW_ROW);
-    lv_obj_set_style_pad_all(status_bar_, 0, 0);
-    lv_obj_set_style_border_width(status_bar_, 0, 0);
-    lv_obj_set_style_pad_column(status_bar_, 0, 0);
-    lv_obj_set_style_pad_top(status_bar_, lvgl_theme->spacing(2), 0);
-    lv_obj_set_style_pad_bottom(status_bar_, lvgl_theme->spacing(2), 0);
-    lv_obj_set_style_pad_left(status_bar_, lvgl_theme->spacing(4), 0);
-    lv_obj_set_style_pad_right(status_bar_, lvgl_theme->spacing(4), 0);
     lv_obj_set_scrollbar_mode(status_bar_, LV_SCROLLBAR_MODE_OFF);
     // 设置状态栏的内容垂直居中
     lv_obj_set_flex_align(status_bar_, LV_FLEX_ALIGN_SPACE_BETWEEN, LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_CENTER);
 
     network_label_ = lv_label_create(status_bar_);
     lv_label_set_text(network_label_, "");
-    lv_obj_set_style_text_font(network_label_, icon_font, 0);
-    lv_obj_set_style_text_color(network_label_, lvgl_theme->text_color(), 0);
+    styles_.Attach(network_label_, {kLvglStyleIcon});
 
     notification_label_ = lv_label_create(status_bar_);
     lv_obj_set_flex_grow(notification_label_, 1);
     lv_obj_set_style_text_align(notification_label_, LV_TEXT_ALIGN_CENTER, 0);
-    lv_obj_set_style_text_color(notification_label_, lvgl_theme->text_color(), 0);
     lv_label_set_text(notification_label_, "");
     lv_obj_add_flag(notification_label_, LV_OBJ_FLAG_HIDDEN);
 
@@ -423,29 +429,25 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_flex_grow(status_label_, 1);
     lv_label_set_long_mode(status_label_, LV_LABEL_LONG_SCROLL_CIRCULAR);
     lv_obj_set_style_text_align(status_label_, LV_TEXT_ALIGN_CENTER, 0);
-    lv_obj_set_style_text_color(status_label_, lvgl_theme->text_color(), 0);
     lv_label_set_text(status_label_, Lang::Strings::INITIALIZING);
     
     mute_label_ = lv_label_create(status_bar_);
     lv_label_set_text(mute_label_, "");
-    lv_obj_set_style_text_font(mute_label_, icon_font, 0);
-    lv_obj_set_style_text_color(mute_label_, lvgl_theme->text_color(), 0);
+    styles_.Attach(mute_label_, {kLvglStyleIcon});
 
     battery_label_ = lv_label_create(status_bar_);
     lv_label_set_text(battery_label_, "");
-    lv_obj_set_style_text_font(battery_label_, icon_font, 0);
-    lv_obj_set_style_text_color(battery_label_, lvgl_theme->text_color(), 0);
+    styles_.Attach(battery_label_, {kLvglStyleIcon});
     lv_obj_set_style_margin_left(battery_label_, lvgl_theme->spacing(2), 0); // 添加左边距，与前面的元素分隔
 
     low_battery_popup_ = lv_obj_create(screen);
     lv_obj_set_scrollbar_mode(low_battery_popup_, LV_SCROLLBAR_MODE_OFF);
     lv_obj_set_size(low_battery_popup_, LV_HOR_RES * 0.9, text_font->line_height * 2);
     lv_obj_align(low_battery_popup_, LV_ALIGN_BOTTOM_MID, 0, -lvgl_theme->spacing(4));
-    lv_obj_set_style_bg_color(low_battery_popup_, lvgl_theme->low_battery_color(), 0);
-    lv_obj_set_style_radius(low_battery_popup_, lvgl_theme->spacing(4), 0);
+    styles_.Attach(low_battery_popup_, {kLvglStylePopup});
     low_battery_label_ = lv_label_create(low_battery_popup_);
     lv_label_set_text(low_battery_label_, Lang::Strings::BATTERY_NEED_CHARGE);
-    lv_obj_set_style_text_color(low_battery_label_, lv_color_white(), 0);
+    styles_.Attach(low_battery_label_, {kLvglStylePopupText});
     lv_obj_center(low_battery_label_);
     lv_obj_add_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
 
@@ -455,207 +457,136 @@ void LcdDisplay::SetupUI() {
     // Display AI logo while booting
     emoji_label_ = lv_label_create(screen);
     lv_obj_center(emoji_label_);
-    lv_obj_set_style_text_font(emoji_label_, large_icon_font, 0);
-    lv_obj_set_style_text_color(emoji_label_, lvgl_theme->text_color(), 0);
+    styles_.Attach(emoji_label_, {kLvglStyleLargeIcon});
     lv_label_set_text(emoji_label_, FONT_AWESOME_MICROCHIP_AI);
 }
 #if CONFIG_IDF_TARGET_ESP32P4
-#define  MAX_MESSAGES 40
+#define  MAX_CHAT_MESSAGES 40
 #else
-#define  MAX_MESSAGES 20
+#define  MAX_CHAT_MESSAGES 20
 #endif
+// Chat rows are marked with this flag, other children of content_ are image bubbles
+#define CHAT_ROW_FLAG LV_OBJ_FLAG_USER_1
+
+static const char* const kChatRoles[] = { "user", "assistant", "system" };
+
+static int GetChatRole(const char* role) {
+    for (int i = 0; i < kChatRoleCount; i++) {
+        if (strcmp(role, kChatRoles[i]) == 0) {
+            return i;
+        }
+    }
+    return kChatRoleAssistant;
+}
+
+lv_obj_t* LcdDisplay::CreateChatRow() {
+    lv_obj_t* row = lv_obj_create(content_);
+    lv_obj_remove_style_all(row);
+    lv_obj_add_style(row, styles_.get(kLvglStyleChatRow), 0);
+    lv_obj_remove_flag(row, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_add_flag(row, CHAT_ROW_FLAG);
+
+    lv_obj_t* bubble = lv_obj_create(row);
+    lv_obj_remove_style_all(bubble);
+    lv_obj_add_style(bubble, styles_.get(kLvglStyleChatBubble), 0);
+    lv_obj_remove_flag(bubble, LV_OBJ_FLAG_SCROLLABLE);
+
+    lv_obj_t* label = lv_label_create(bubble);
+    lv_label_set_long_mode(label, LV_LABEL_LONG_WRAP);
+
+    lv_obj_set_user_data(row, (void*)(intptr_t)-1);
+    return row;
+}
+
+// The oldest row is moved to the end and refilled, instead of deleting it and creating a new one
+lv_obj_t* LcdDisplay::AcquireChatRow() {
+    uint32_t child_count = lv_obj_get_child_cnt(content_);
+    lv_obj_t* first = child_count > 0 ? lv_obj_get_child(content_, 0) : nullptr;
+    if (first != nullptr && (child_count >= MAX_CHAT_MESSAGES || lv_obj_has_flag(first, LV_OBJ_FLAG_HIDDEN))) {
+        if (lv_obj_has_flag(first, CHAT_ROW_FLAG)) {
+            lv_obj_move_to_index(first, -1);
+            lv_obj_remove_flag(first, LV_OBJ_FLAG_HIDDEN);
+            return first;
+        }
+        // An image bubble, they are not recycled
+        lv_obj_delete(first);
+    }
+    return CreateChatRow();
+}
+
+// A released row is hidden and waits at the front, where it is the first to be reused
+void LcdDisplay::ReleaseChatRow(lv_obj_t* row) {
+    lv_obj_add_flag(row, LV_OBJ_FLAG_HIDDEN);
+    lv_obj_move_to_index(row, 0);
+    lv_label_set_text_static(lv_obj_get_child(lv_obj_get_child(row, 0), 0), "");
+}
+
+void LcdDisplay::SetChatRowRole(lv_obj_t* row, int role) {
+    int old_role = (int)(intptr_t)lv_obj_get_user_data(row);
+    if (old_role == role) {
+        return;
+    }
+    lv_obj_t* bubble = lv_obj_get_child(row, 0);
+    lv_obj_t* label = lv_obj_get_child(bubble, 0);
+    if (old_role >= 0) {
+        lv_obj_remove_style(row, styles_.get(LvglStyleRole(kLvglStyleUserRow + old_role)), 0);
+        lv_obj_remove_style(bubble, styles_.get(LvglStyleRole(kLvglStyleUserBubble + old_role)), 0);
+        lv_obj_remove_style(label, styles_.get(LvglStyleRole(kLvglStyleUserText + old_role)), 0);
+    }
+    lv_obj_add_style(row, styles_.get(LvglStyleRole(kLvglStyleUserRow + role)), 0);
+    lv_obj_add_style(bubble, styles_.get(LvglStyleRole(kLvglStyleUserBubble + role)), 0);
+    lv_obj_add_style(label, styles_.get(LvglStyleRole(kLvglStyleUserText + role)), 0);
+    lv_obj_set_user_data(row, (void*)(intptr_t)role);
+}
+
 void LcdDisplay::SetChatMessage(const char* role, const char* content) {
     DisplayLockGuard lock(this);
     if (content_ == nullptr) {
         return;
     }
-    
-    // 检查消息数量是否超过限制
-    uint32_t child_count = lv_obj_get_child_cnt(content_);
-    if (child_count >= MAX_MESSAGES) {
-        // 删除最早的消息（第一个子对象）
-        lv_obj_t* first_child = lv_obj_get_child(content_, 0);
-        lv_obj_t* last_child = lv_obj_get_child(content_, child_count - 1);
-        if (first_child != nullptr) {
-            lv_obj_del(first_child);
-        }
-        // Scroll to the last message immediately
-        if (last_child != nullptr) {
-            lv_obj_scroll_to_view_recursive(last_child, LV_ANIM_OFF);
-        }
-    }
-    
-    // 折叠系统消息（如果是系统消息，检查最后一个消息是否也是系统消息）
-    if (strcmp(role, "system") == 0) {
-        if (child_count > 0) {
-            // 获取最后一个消息容器
-            lv_obj_t* last_container = lv_obj_get_child(content_, child_count - 1);
-            if (last_container != nullptr && lv_obj_get_child_cnt(last_container) > 0) {
-                // 获取容器内的气泡
-                lv_obj_t* last_bubble = lv_obj_get_child(last_container, 0);
-                if (last_bubble != nullptr) {
-                    // 检查气泡类型是否为系统消息
-                    void* bubble_type_ptr = lv_obj_get_user_data(last_bubble);
-                    if (bubble_type_ptr != nullptr && strcmp((const char*)bubble_type_ptr, "system") == 0) {
-                        // 如果最后一个消息也是系统消息，则删除它
-                        lv_obj_del(last_container);
-                    }
-                }
-            }
-        }
-    } else {
+
+    int chat_role = GetChatRole(role);
+    if (chat_role != kChatRoleSystem) {
         // 隐藏居中显示的 AI logo
         lv_obj_add_flag(emoji_label_, LV_OBJ_FLAG_HIDDEN);
     }
 
+    // 折叠系统消息：如果最后一个消息也是系统消息，则替换它
+    lv_obj_t* row = nullptr;
+    uint32_t child_count = lv_obj_get_child_cnt(content_);
+    lv_obj_t* last = child_count > 0 ? lv_obj_get_child(content_, child_count - 1) : nullptr;
+    if (chat_role == kChatRoleSystem && last != nullptr && lv_obj_has_flag(last, CHAT_ROW_FLAG) &&
+        !lv_obj_has_flag(last, LV_OBJ_FLAG_HIDDEN) && (int)(intptr_t)lv_obj_get_user_data(last) == kChatRoleSystem) {
+        row = last;
+        if (content[0] == '\0') {
+            ReleaseChatRow(row);
+            return;
+        }
+    }
+
     //避免出现空的消息框
-    if(strlen(content) == 0) {
+    if (content[0] == '\0') {
         return;
     }
+    if (row == nullptr) {
+        row = AcquireChatRow();
+    }
+    SetChatRowRole(row, chat_role);
 
+    // 计算文本实际宽度，气泡宽度不超过屏幕宽度的85%
     auto lvgl_theme = static_cast<LvglTheme*>(current_theme_);
-    auto text_font = lvgl_theme->text_font()->font();
-
-    // Create a message bubble
-    lv_obj_t* msg_bubble = lv_obj_create(content_);
-    lv_obj_set_style_radius(msg_bubble, 8, 0);
-    lv_obj_set_scrollbar_mode(msg_bubble, LV_SCROLLBAR_MODE_OFF);
-    lv_obj_set_style_border_width(msg_bubble, 0, 0);
-    lv_obj_set_style_pad_all(msg_bubble, lvgl_theme->spacing(4), 0);
+    lv_coord_t text_width = lvgl_theme->text_font()->GetTextWidth(content);
+    lv_coord_t max_width = LV_HOR_RES * 85 / 100 - 16;
+    text_width = std::clamp<lv_coord_t>(text_width, 20, max_width);
 
-    // Create the message text
-    lv_obj_t* msg_text = lv_label_create(msg_bubble);
-    lv_label_set_text(msg_text, content);
-    
-    // 计算文本实际宽度
-    lv_coord_t text_width = lv_txt_get_width(content, strlen(content), text_font, 0);
-
-    // 计算气泡宽度
-    lv_coord_t max_width = LV_HOR_RES * 85 / 100 - 16;  // 屏幕宽度的85%
-    lv_coord_t min_width = 20;  
-    lv_coord_t bubble_width;
-    
-    // 确保文本宽度不小于最小宽度
-    if (text_width < min_width) {
-        text_width = min_width;
-    }
+    lv_obj_t* label = lv_obj_get_child(lv_obj_get_child(row, 0), 0);
+    lv_label_set_text(label, content);
+    lv_obj_set_width(label, text_width);
 
-    // 如果文本宽度小于最大宽度，使用文本宽度
-    if (text_width < max_width) {
-        bubble_width = text_width; 
-    } else {
-        bubble_width = max_width;
-    }
-    
-    // 设置消息文本的宽度
-    lv_obj_set_width(msg_text, bubble_width);  // 减去padding
-    lv_label_set_long_mode(msg_text, LV_LABEL_LONG_WRAP);
-
-    // 设置气泡宽度
-    lv_obj_set_width(msg_bubble, bubble_width);
-    lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-
-    // Set alignment and style based on message role
-    if (strcmp(role, "user") == 0) {
-        // User messages are right-aligned with green background
-        lv_obj_set_style_bg_color(msg_bubble, lvgl_theme->user_bubble_color(), 0);
-        lv_obj_set_style_bg_opa(msg_bubble, LV_OPA_70, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, lvgl_theme->text_color(), 0);
-        
-        // 设置自定义属性标记气泡类型
-        lv_obj_set_user_data(msg_bubble, (void*)"user");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    } else if (strcmp(role, "assistant") == 0) {
-        // Assistant messages are left-aligned with white background
-        lv_obj_set_style_bg_color(msg_bubble, lvgl_theme->assistant_bubble_color(), 0);
-        lv_obj_set_style_bg_opa(msg_bubble, LV_OPA_70, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, lvgl_theme->text_color(), 0);
-        
-        // 设置自定义属性标记气泡类型
-        lv_obj_set_user_data(msg_bubble, (void*)"assistant");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    } else if (strcmp(role, "system") == 0) {
-        // System messages are center-aligned with light gray background
-        lv_obj_set_style_bg_color(msg_bubble, lvgl_theme->system_bubble_color(), 0);
-        lv_obj_set_style_bg_opa(msg_bubble, LV_OPA_70, 0);
-        // Set text color for contrast
-        lv_obj_set_style_text_color(msg_text, lvgl_theme->system_text_color(), 0);
-        
-        // 设置自定义属性标记气泡类型
-        lv_obj_set_user_data(msg_bubble, (void*)"system");
-        
-        // Set appropriate width for content
-        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
-        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
-        
-        // Don't grow
-        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
-    }
-    
-    // Create a full-width container for user messages to ensure right alignment
-    if (strcmp(role, "user") == 0) {
-        // Create a full-width container
-        lv_obj_t* container = lv_obj_create(content_);
-        lv_obj_set_width(container, LV_HOR_RES);
-        lv_obj_set_height(container, LV_SIZE_CONTENT);
-        
-        // Make container transparent and borderless
-        lv_obj_set_style_bg_opa(container, LV_OPA_TRANSP, 0);
-        lv_obj_set_style_border_width(container, 0, 0);
-        lv_obj_set_style_pad_all(container, 0, 0);
-        
-        // Move the message bubble into this container
-        lv_obj_set_parent(msg_bubble, container);
-        
-        // Right align the bubble in the container
-        lv_obj_align(msg_bubble, LV_ALIGN_RIGHT_MID, -25, 0);
-        
-        // Auto-scroll to this container
-        lv_obj_scroll_to_view_recursive(container, LV_ANIM_ON);
-    } else if (strcmp(role, "system") == 0) {
-        // 为系统消息创建全宽容器以确保居中对齐
-        lv_obj_t* container = lv_obj_create(content_);
-        lv_obj_set_width(container, LV_HOR_RES);
-        lv_obj_set_height(container, LV_SIZE_CONTENT);
-        
-        // 使容器透明且无边框
-        lv_obj_set_style_bg_opa(container, LV_OPA_TRANSP, 0);
-        lv_obj_set_style_border_width(container, 0, 0);
-        lv_obj_set_style_pad_all(container, 0, 0);
-        
-        // 将消息气泡移入此容器
-        lv_obj_set_parent(msg_bubble, container);
-        
-        // 将气泡居中对齐在容器中
-        lv_obj_align(msg_bubble, LV_ALIGN_CENTER, 0, 0);
-        
-        // 自动滚动底部
-        lv_obj_scroll_to_view_recursive(container, LV_ANIM_ON);
-    } else {
-        // For assistant messages
-        // Left align assistant messages
-        lv_obj_align(msg_bubble, LV_ALIGN_LEFT_MID, 0, 0);
+    lv_obj_scroll_to_view_recursive(row, LV_ANIM_ON);
 
-        // Auto-scroll to the message bubble
-        lv_obj_scroll_to_view_recursive(msg_bubble, LV_ANIM_ON);
-    }
-    
     // Store reference to the latest message label
-    chat_message_label_ = msg_text;
+    chat_message_label_ = label;
 }
 
 void LcdDisplay::SetPreviewImage(std::unique_ptr<LvglImage> image) {
@@ -668,20 +599,21 @@ void LcdDisplay::SetPreviewImage(std::unique_ptr<LvglImage> image) {
         return;
     }
     
-    auto lvgl_theme = static_cast<LvglTheme*>(current_theme_);
-    // Create a message bubble for image preview
+    // Keep the number of children bounded, the same as for text messages
+    if (lv_obj_get_child_cnt(content_) >= MAX_CHAT_MESSAGES) {
+        lv_obj_t* first = lv_obj_get_child(content_, 0);
+        if (chat_message_label_ != nullptr && lv_obj_get_parent(lv_obj_get_parent(chat_message_label_)) == first) {
+            chat_message_label_ = nullptr;
+        }
+        lv_obj_delete(first);
+    }
+
+    // Create a message bubble for image preview, styled like an assistant message
     lv_obj_t* img_bubble = lv_obj_create(content_);
-    lv_obj_set_style_radius(img_bubble, 8, 0);
-    lv_obj_set_scrollbar_mode(img_bubble, LV_SCROLLBAR_MODE_OFF);
-    lv_obj_set_style_border_width(img_bubble, 0, 0);
-    lv_obj_set_style_pad_all(img_bubble, lvgl_theme->spacing(4), 0);
-    
-    // Set image bubble background color (similar to system message)
-    lv_obj_set_style_bg_color(img_bubble, lvgl_theme->assistant_bubble_color(), 0);
-    lv_obj_set_style_bg_opa(img_bubble, LV_OPA_70, 0);
-    
-    // 设置自定义属性标记气泡类型
-    lv_obj_set_user_data(img_bubble, (void*)"image");
+    lv_obj_remove_style_all(img_bubble);
+    lv_obj_add_style(img_bubble, styles_.get(kLvglStyleChatBubble), 0);
+    lv_obj_add_style(img_bubble, styles_.get(kLvglStyleAssistantBubble), 0);
+    lv_obj_remove_flag(img_bubble, LV_OBJ_FLAG_SCROLLABLE);
 
     // Create the image object inside the bubble
     lv_obj_t* preview_image = lv_image_create(img_bubble);
@@ -744,10 +676,12 @@ void LcdDisplay::SetPreviewImage(std::unique_ptr<LvglImage> image) {
 #else
 void LcdDisplay::SetupUI() {
     DisplayLockGuard lock(this);
+    lv_display_add_event_cb(display_, OnRefreshEvent, LV_EVENT_REFR_START, nullptr);
+    lv_display_add_event_cb(display_, OnRefreshEvent, LV_EVENT_REFR_READY, nullptr);
+
     LvglTheme* lvgl_theme = static_cast<LvglTheme*>(current_theme_);
     auto text_font = lvgl_theme->text_font()->font();
-    auto icon_font = lvgl_theme->icon_font()->font();
-    auto large_icon_font = lvgl_theme->large_icon_font()->font();
+    styles_.Apply(lvgl_theme);
 
     auto screen = lv_screen_active();
     lv_obj_set_style_text_font(screen, text_font, 0);
@@ -757,50 +691,33 @@ void LcdDisplay::SetupUI() {
     /* Container */
     container_ = lv_obj_create(screen);
     lv_obj_set_size(container_, LV_HOR_RES, LV_VER_RES);
-    lv_obj_set_style_radius(container_, 0, 0);
     lv_obj_set_flex_flow(container_, LV_FLEX_FLOW_COLUMN);
-    lv_obj_set_style_pad_all(container_, 0, 0);
-    lv_obj_set_style_border_width(container_, 0, 0);
+    styles_.Attach(container_, {kLvglStylePlain, kLvglStyleBackground});
     lv_obj_set_style_pad_row(container_, 0, 0);
-    lv_obj_set_style_bg_color(container_, lvgl_theme->background_color(), 0);
-    lv_obj_set_style_border_color(container_, lvgl_theme->border_color(), 0);
 
     /* Status bar */
     status_bar_ = lv_obj_create(container_);
     lv_obj_set_size(status_bar_, LV_HOR_RES, LV_SIZE_CONTENT);
-    lv_obj_set_style_radius(status_bar_, 0, 0);
-    lv_obj_set_style_bg_color(status_bar_, lvgl_theme->background_color(), 0);
-    lv_obj_set_style_text_color(status_bar_, lvgl_theme->text_color(), 0);
     lv_obj_set_flex_flow(status_bar_, LV_FLEX_FLOW_ROW);
-    lv_obj_set_style_pad_top(status_bar_, lvgl_theme->spacing(2), 0);
-    lv_obj_set_style_pad_bottom(status_bar_, lvgl_theme->spacing(2), 0);
-    lv_obj_set_style_pad_left(status_bar_, lvgl_theme->spacing(4), 0);
-    lv_obj_set_style_pad_right(status_bar_, lvgl_theme->spacing(4), 0);
-    lv_obj_set_style_border_width(status_bar_, 0, 0);
-    lv_obj_set_style_pad_column(status_bar_, 0, 0);
+    styles_.Attach(status_bar_, {kLvglStyleStatusBar});
     
     /* Content */
     content_ = lv_obj_create(container_);
     lv_obj_set_scrollbar_mode(content_, LV_SCROLLBAR_MODE_OFF);
-    lv_obj_set_style_radius(content_, 0, 0);
     lv_obj_set_width(content_, LV_HOR_RES);
     lv_obj_set_flex_grow(content_, 1);
-    lv_obj_set_style_pad_all(content_, 0, 0);
-    lv_obj_set_style_border_width(content_, 0, 0);
-    lv_obj_set_style_bg_color(content_, lvgl_theme->chat_background_color(), 0);
+    styles_.Attach(content_, {kLvglStylePlain, kLvglStyleChatBackground});
 
     lv_obj_set_flex_flow(content_, LV_FLEX_FLOW_COLUMN); // 垂直布局（从上到下）
     lv_obj_set_flex_align(content_, LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_SPACE_EVENLY); // 子对象居中对齐，等距分布
 
     emoji_box_ = lv_obj_create(content_);
     lv_obj_set_size(emoji_box_, LV_SIZE_CONTENT, LV_SIZE_CONTENT);
+    styles_.Attach(emoji_box_, {kLvglStylePlain});
     lv_obj_set_style_bg_opa(emoji_box_, LV_OPA_TRANSP, 0);
-    lv_obj_set_style_pad_all(emoji_box_, 0, 0);
-    lv_obj_set_style_border_width(emoji_box_, 0, 0);
 
     emoji_label_ = lv_label_create(emoji_box_);
-    lv_obj_set_style_text_font(emoji_label_, large_icon_font, 0);
-    lv_obj_set_style_text_color(emoji_label_, lvgl_theme->text_color(), 0);
+    styles_.Attach(emoji_label_, {kLvglStyleLargeIcon});
     lv_label_set_text(emoji_label_, FONT_AWESOME_MICROCHIP_AI);
 
     emoji_image_ = lv_img_create(emoji_box_);
@@ -817,18 +734,16 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_width(chat_message_label_, width_ * 0.9); // 限制宽度为屏幕宽度的 90%
     lv_label_set_long_mode(chat_message_label_, LV_LABEL_LONG_WRAP); // 设置为自动换行模式
     lv_obj_set_style_text_align(chat_message_label_, LV_TEXT_ALIGN_CENTER, 0); // 设置文本居中对齐
-    lv_obj_set_style_text_color(chat_message_label_, lvgl_theme->text_color(), 0);
+    styles_.Attach(chat_message_label_, {kLvglStyleText});
 
     /* Status bar */
     network_label_ = lv_label_create(status_bar_);
     lv_label_set_text(network_label_, "");
-    lv_obj_set_style_text_font(network_label_, icon_font, 0);
-    lv_obj_set_style_text_color(network_label_, lvgl_theme->text_color(), 0);
+    styles_.Attach(network_label_, {kLvglStyleIcon});
 
     notification_label_ = lv_label_create(status_bar_);
     lv_obj_set_flex_grow(notification_label_, 1);
     lv_obj_set_style_text_align(notification_label_, LV_TEXT_ALIGN_CENTER, 0);
-    lv_obj_set_style_text_color(notification_label_, lvgl_theme->text_color(), 0);
     lv_label_set_text(notification_label_, "");
     lv_obj_add_flag(notification_label_, LV_OBJ_FLAG_HIDDEN);
 
@@ -836,29 +751,25 @@ void LcdDisplay::SetupUI() {
     lv_obj_set_flex_grow(status_label_, 1);
     lv_label_set_long_mode(status_label_, LV_LABEL_LONG_SCROLL_CIRCULAR);
     lv_obj_set_style_text_align(status_label_, LV_TEXT_ALIGN_CENTER, 0);
-    lv_obj_set_style_text_color(status_label_, lvgl_theme->text_color(), 0);
     lv_label_set_text(status_label_, Lang::Strings::INITIALIZING);
 
     mute_label_ = lv_label_create(status_bar_);
     lv_label_set_text(mute_label_, "");
-    lv_obj_set_style_text_font(mute_label_, icon_font, 0);
-    lv_obj_set_style_text_color(mute_label_, lvgl_theme->text_color(), 0);
+    styles_.Attach(mute_label_, {kLvglStyleIcon});
 
     battery_label_ = lv_label_create(status_bar_);
     lv_label_set_text(battery_label_, "");
-    lv_obj_set_style_text_font(battery_label_, icon_font, 0);
-    lv_obj_set_style_text_color(battery_label_, lvgl_theme->text_color(), 0);
+    styles_.Attach(battery_label_, {kLvglStyleIcon});
 
     low_battery_popup_ = lv_obj_create(screen);
     lv_obj_set_scrollbar_mode(low_battery_popup_, LV_SCROLLBAR_MODE_OFF);
     lv_obj_set_size(low_battery_popup_, LV_HOR_RES * 0.9, text_font->line_height * 2);
     lv_obj_align(low_battery_popup_, LV_ALIGN_BOTTOM_MID, 0, -lvgl_theme->spacing(4));
-    lv_obj_set_style_bg_color(low_battery_popup_, lvgl_theme->low_battery_color(), 0);
-    lv_obj_set_style_radius(low_battery_popup_, lvgl_theme->spacing(4), 0);
+    styles_.Attach(low_battery_popup_, {kLvglStylePopup});
     
     low_battery_label_ = lv_label_create(low_battery_popup_);
     lv_label_set_text(low_battery_label_, Lang::Strings::BATTERY_NEED_CHARGE);
-    lv_obj_set_style_text_color(low_battery_label_, lv_color_white(), 0);
+    styles_.Attach(low_battery_label_, {kLvglStylePopupText});
     lv_obj_center(low_battery_label_);
     lv_obj_add_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
 }
@@ -941,8 +852,17 @@ void LcdDisplay::SetEmotion(const char* emotion) {
         
         if (gif_controller_->IsLoaded()) {
             // Set up frame update callback
+            // The canvas is updated in place, so only the area the frame changed is redrawn and flushed
             gif_controller_->SetFrameCallback([this]() {
-                lv_image_set_src(emoji_image_, gif_controller_->image_dsc());
+                lv_area_t area;
+                if (!gif_controller_->GetDirtyArea(area) || lv_image_get_scale(emoji_image_) != LV_SCALE_NONE) {
+                    lv_obj_invalidate(emoji_image_);
+                    return;
+                }
+                lv_area_t coords;
+                lv_obj_get_content_coords(emoji_image_, &coords);
+                lv_area_move(&area, coords.x1, coords.y1);
+                lv_obj_invalidate_area(emoji_image_, &area);
             });
             
             // Set initial frame and start animation
@@ -983,130 +903,17 @@ void LcdDisplay::SetTheme(Theme* theme) {
     
     auto lvgl_theme = static_cast<LvglTheme*>(theme);
     
-    // Get the active screen
-    lv_obj_t* screen = lv_screen_active();
-
-    // Set font
-    auto text_font = lvgl_theme->text_font()->font();
-    auto icon_font = lvgl_theme->icon_font()->font();
-    auto large_icon_font = lvgl_theme->large_icon_font()->font();
-
-    if (text_font->line_height >= 40) {
-        lv_obj_set_style_text_font(mute_label_, large_icon_font, 0);
-        lv_obj_set_style_text_font(battery_label_, large_icon_font, 0);
-        lv_obj_set_style_text_font(network_label_, large_icon_font, 0);
-    } else {
-        lv_obj_set_style_text_font(mute_label_, icon_font, 0);
-        lv_obj_set_style_text_font(battery_label_, icon_font, 0);
-        lv_obj_set_style_text_font(network_label_, icon_font, 0);
-    }
-
     // Set parent text color
-    lv_obj_set_style_text_font(screen, text_font, 0);
+    lv_obj_t* screen = lv_screen_active();
+    lv_obj_set_style_text_font(screen, lvgl_theme->text_font()->font(), 0);
     lv_obj_set_style_text_color(screen, lvgl_theme->text_color(), 0);
 
-    // Set background image
-    if (lvgl_theme->background_image() != nullptr) {
-        lv_obj_set_style_bg_image_src(container_, lvgl_theme->background_image()->image_dsc(), 0);
-    } else {
-        lv_obj_set_style_bg_image_src(container_, nullptr, 0);
-        lv_obj_set_style_bg_color(container_, lvgl_theme->background_color(), 0);
-    }
-    
-    // Update status bar background color with 50% opacity
+    // Status bar at 50% opacity over the background, content transparent
     lv_obj_set_style_bg_opa(status_bar_, LV_OPA_50, 0);
-    lv_obj_set_style_bg_color(status_bar_, lvgl_theme->background_color(), 0);
-    
-    // Update status bar elements
-    lv_obj_set_style_text_color(network_label_, lvgl_theme->text_color(), 0);
-    lv_obj_set_style_text_color(status_label_, lvgl_theme->text_color(), 0);
-    lv_obj_set_style_text_color(notification_label_, lvgl_theme->text_color(), 0);
-    lv_obj_set_style_text_color(mute_label_, lvgl_theme->text_color(), 0);
-    lv_obj_set_style_text_color(battery_label_, lvgl_theme->text_color(), 0);
-    lv_obj_set_style_text_color(emoji_label_, lvgl_theme->text_color(), 0);
-
-    // Set content background opacity
     lv_obj_set_style_bg_opa(content_, LV_OPA_TRANSP, 0);
 
-    // If we have the chat message style, update all message bubbles
-#if CONFIG_USE_WECHAT_MESSAGE_STYLE
-    // Iterate through all children of content (message containers or bubbles)
-    uint32_t child_count = lv_obj_get_child_cnt(content_);
-    for (uint32_t i = 0; i < child_count; i++) {
-        lv_obj_t* obj = lv_obj_get_child(content_, i);
-        if (obj == nullptr) continue;
-        
-        lv_obj_t* bubble = nullptr;
-        
-        // 检查这个对象是容器还是气泡
-        // 如果是容器（用户或系统消息），则获取其子对象作为气泡
-        // 如果是气泡（助手消息），则直接使用
-        if (lv_obj_get_child_cnt(obj) > 0) {
-            // 可能是容器，检查它是否为用户或系统消息容器
-            // 用户和系统消息容器是透明的
-            lv_opa_t bg_opa = lv_obj_get_style_bg_opa(obj, 0);
-            if (bg_opa == LV_OPA_TRANSP) {
-                // 这是用户或系统消息的容器
-                bubble = lv_obj_get_child(obj, 0);
-            } else {
-                // 这可能是助手消息的气泡自身
-                bubble = obj;
-            }
-        } else {
-            // 没有子元素，可能是其他UI元素，跳过
-            continue;
-        }
-        
-        if (bubble == nullptr) continue;
-        
-        // 使用保存的用户数据来识别气泡类型
-        void* bubble_type_ptr = lv_obj_get_user_data(bubble);
-        if (bubble_type_ptr != nullptr) {
-            const char* bubble_type = static_cast<const char*>(bubble_type_ptr);
-            
-            // 根据气泡类型应用正确的颜色
-            if (strcmp(bubble_type, "user") == 0) {
-                lv_obj_set_style_bg_color(bubble, lvgl_theme->user_bubble_color(), 0);
-            } else if (strcmp(bubble_type, "assistant") == 0) {
-                lv_obj_set_style_bg_color(bubble, lvgl_theme->assistant_bubble_color(), 0); 
-            } else if (strcmp(bubble_type, "system") == 0) {
-                lv_obj_set_style_bg_color(bubble, lvgl_theme->system_bubble_color(), 0);
-            } else if (strcmp(bubble_type, "image") == 0) {
-                lv_obj_set_style_bg_color(bubble, lvgl_theme->system_bubble_color(), 0);
-            }
-            
-            // Update border color
-            lv_obj_set_style_border_color(bubble, lvgl_theme->border_color(), 0);
-            
-            // Update text color for the message
-            if (lv_obj_get_child_cnt(bubble) > 0) {
-                lv_obj_t* text = lv_obj_get_child(bubble, 0);
-                if (text != nullptr) {
-                    // 根据气泡类型设置文本颜色
-                    if (strcmp(bubble_type, "system") == 0) {
-                        lv_obj_set_style_text_color(text, lvgl_theme->system_text_color(), 0);
-                    } else {
-                        lv_obj_set_style_text_color(text, lvgl_theme->text_color(), 0);
-                    }
-                }
-            }
-        } else {
-            ESP_LOGW(TAG, "child[%lu] Bubble type is not found", i);
-        }
-    }
-#else
-    // Simple UI mode - just update the main chat message
-    if (chat_message_label_ != nullptr) {
-        lv_obj_set_style_text_color(chat_message_label_, lvgl_theme->text_color(), 0);
-    }
-    
-    if (emoji_label_ != nullptr) {
-        lv_obj_set_style_text_color(emoji_label_, lvgl_theme->text_color(), 0);
-    }
-#endif
-    
-    // Update low battery popup
-    lv_obj_set_style_bg_color(low_battery_popup_, lvgl_theme->low_battery_color(), 0);
+    // Every object, including the message bubbles, refers to the shared styles
+    styles_.Apply(lvgl_theme);
 
     // No errors occurred. Save theme to settings
     Display::SetTheme(lvgl_theme);
@@ -3,6 +3,7 @@
 
 #include "lvgl_display.h"
 #include "gif/lvgl_gif.h"
+#include "lcd_flush_pipeline.h"
 
 #include <esp_lcd_panel_io.h>
 #include <esp_lcd_panel_ops.h>
@@ -13,6 +14,13 @@
 
 #define PREVIEW_IMAGE_DURATION_MS 5000
 
+enum ChatRole {
+    kChatRoleUser,
+    kChatRoleAssistant,
+    kChatRoleSystem,
+    kChatRoleCount,
+};
+
 
 class LcdDisplay : public LvglDisplay {
 protected:
@@ -32,9 +40,14 @@ protected:
     lv_obj_t* chat_message_label_ = nullptr;
     esp_timer_handle_t preview_timer_ = nullptr;
     std::unique_ptr<LvglImage> preview_image_cached_ = nullptr;
+    std::unique_ptr<LcdFlushPipeline> flush_pipeline_ = nullptr;
 
     void InitializeLcdThemes();
     void SetupUI();
+    lv_obj_t* CreateChatRow();
+    lv_obj_t* AcquireChatRow();
+    void ReleaseChatRow(lv_obj_t* row);
+    void SetChatRowRole(lv_obj_t* row, int role);
     virtual bool Lock(int timeout_ms = 0) override;
     virtual void Unlock() override;
 
@@ -50,6 +63,9 @@ public:
 
     // Add theme switching function
     virtual void SetTheme(Theme* theme) override;
+
+    // Flush throughput and render/flush overlap, empty when the panel is not followed
+    std::string GetFlushStatsJson();
 };
 
 // SPI LCD显示器
@@ -57,7 +73,8 @@ class SpiLcdDisplay : public LcdDisplay {
 public:
     SpiLcdDisplay(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_handle_t panel,
                   int width, int height, int offset_x, int offset_y,
-                  bool mirror_x, bool mirror_y, bool swap_xy);
+                  bool mirror_x, bool mirror_y, bool swap_xy,
+                  const LcdFlushConfig& flush_config = LcdFlushConfig());
 };
 
 // RGB LCD显示器
@@ -0,0 +1,168 @@
+#include "lcd_flush_pipeline.h"
+#include "json_writer.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <algorithm>
+
+#define TAG "LcdFlushPipeline"
+
+LcdFlushConfig LcdFlushConfig::DoubleBuffered(int width, int height) {
+    LcdFlushConfig config;
+    config.double_buffer = true;
+    config.buffer_lines = std::max(height / 10, 10);
+
+    auto tile_size = [width](uint32_t lines) { return width * lines * sizeof(uint16_t); };
+    auto fits_internal = [&tile_size](uint32_t lines) {
+        return heap_caps_get_largest_free_block(MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL) >= tile_size(lines) &&
+            heap_caps_get_free_size(MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL) >= 2 * tile_size(lines) + LCD_FLUSH_INTERNAL_RESERVE;
+    };
+    if (fits_internal(config.buffer_lines)) {
+        return config;
+    }
+
+#if CONFIG_SPIRAM
+    // PSRAM can afford bigger tiles, fewer flushes make up for copying them through the transfer buffers
+    config.buffer_in_psram = true;
+    config.buffer_lines = std::max(height / 4, 10);
+    config.trans_lines = std::max<uint32_t>(config.buffer_lines / 8, 2);
+#else
+    while (config.buffer_lines > 10 && !fits_internal(config.buffer_lines)) {
+        config.buffer_lines -= 2;
+    }
+    if (!fits_internal(config.buffer_lines)) {
+        ESP_LOGW(TAG, "Not enough DMA capable RAM for double buffering, keep a single buffer");
+        return LcdFlushConfig();
+    }
+#endif
+    return config;
+}
+
+LcdFlushPipeline::LcdFlushPipeline(lv_display_t* display, esp_lcd_panel_io_handle_t panel_io, const LcdFlushConfig& config)
+    : display_(display), config_(config) {
+    window_start_time_ = esp_timer_get_time();
+
+    lv_display_add_event_cb(display_, OnEvent, LV_EVENT_RENDER_START, this);
+    lv_display_add_event_cb(display_, OnEvent, LV_EVENT_RENDER_READY, this);
+    lv_display_add_event_cb(display_, OnEvent, LV_EVENT_FLUSH_START, this);
+    lv_display_add_event_cb(display_, OnEvent, LV_EVENT_FLUSH_WAIT_START, this);
+    lv_display_add_event_cb(display_, OnEvent, LV_EVENT_FLUSH_WAIT_FINISH, this);
+
+    // Through transfer buffers esp_lvgl_port waits on its own interrupt between the chunks of a tile
+    if (config_.double_buffer && !config_.buffer_in_psram && config_.trans_lines == 0) {
+        const esp_lcd_panel_io_callbacks_t cbs = {
+            .on_color_trans_done = OnColorTransDone,
+        };
+        time_transfers_ = esp_lcd_panel_io_register_event_callbacks(panel_io, &cbs, this) == ESP_OK;
+    }
+
+    ESP_LOGI(TAG, "%lu line tiles, %s buffered in %s, transfers %s", config_.buffer_lines,
+        config_.double_buffer ? "double" : "single", config_.buffer_in_psram ? "PSRAM" : "DMA RAM",
+        time_transfers_ ? "timed" : "not timed");
+}
+
+LcdFlushPipeline::~LcdFlushPipeline() {
+    lv_display_remove_event_cb_with_user_data(display_, OnEvent, this);
+}
+
+bool LcdFlushPipeline::OnColorTransDone(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_io_event_data_t* edata, void* user_ctx) {
+    auto self = static_cast<LcdFlushPipeline*>(user_ctx);
+    uint32_t now = static_cast<uint32_t>(esp_timer_get_time());
+    self->window_transfer_time_us_ += now - self->transfer_start_time_.load();
+    self->window_transfers_++;
+    lv_display_flush_ready(self->display_);
+    return false;
+}
+
+void LcdFlushPipeline::OnEvent(lv_event_t* e) {
+    auto self = static_cast<LcdFlushPipeline*>(lv_event_get_user_data(e));
+    auto now = esp_timer_get_time();
+    std::lock_guard<std::mutex> lock(self->mutex_);
+
+    switch (lv_event_get_code(e)) {
+    case LV_EVENT_RENDER_START:
+        self->render_start_time_ = now;
+        break;
+    case LV_EVENT_RENDER_READY:
+        self->window_refreshes_++;
+        self->window_render_time_us_ += now - self->render_start_time_;
+        self->RollWindow(now);
+        break;
+    case LV_EVENT_FLUSH_START: {
+        // The transfer starts right after this event, in the flush callback
+        self->transfer_start_time_ = static_cast<uint32_t>(now);
+        auto area = static_cast<const lv_area_t*>(lv_event_get_param(e));
+        self->window_flushes_++;
+        self->window_bytes_ += lv_area_get_size(area) * lv_color_format_get_size(lv_display_get_color_format(self->display_));
+        break;
+    }
+    case LV_EVENT_FLUSH_WAIT_START:
+        self->wait_start_time_ = now;
+        break;
+    case LV_EVENT_FLUSH_WAIT_FINISH:
+        self->window_wait_time_us_ += now - self->wait_start_time_;
+        break;
+    default:
+        break;
+    }
+}
+
+void LcdFlushPipeline::RollWindow(int64_t now) {
+    auto elapsed = now - window_start_time_;
+    if (elapsed < LCD_FLUSH_STATS_WINDOW_MS * 1000LL) {
+        return;
+    }
+    uint32_t transfer_time_us = window_transfer_time_us_.exchange(0);
+    uint32_t transfers = window_transfers_.exchange(0);
+
+    stats_.flushes_per_second = window_flushes_ * 1000000.0f / elapsed;
+    stats_.bytes_per_second = window_bytes_ * 1000000 / elapsed;
+    stats_.render_time_us = window_refreshes_ > 0 ? window_render_time_us_ / window_refreshes_ : 0;
+    stats_.wait_time_us = window_flushes_ > 0 ? window_wait_time_us_ / window_flushes_ : 0;
+    if (time_transfers_ && transfers > 0 && transfer_time_us > 0) {
+        // Bytes per microsecond are MB/s
+        stats_.throughput_mbps = static_cast<float>(window_bytes_) / transfer_time_us;
+        stats_.transfer_time_us = transfer_time_us / transfers;
+        stats_.overlap = std::clamp(1.0f - static_cast<float>(window_wait_time_us_) / transfer_time_us, 0.0f, 1.0f);
+    } else {
+        stats_.throughput_mbps = 0;
+        stats_.transfer_time_us = 0;
+        stats_.overlap = 0;
+    }
+
+    window_start_time_ = now;
+    window_flushes_ = 0;
+    window_refreshes_ = 0;
+    window_bytes_ = 0;
+    window_render_time_us_ = 0;
+    window_wait_time_us_ = 0;
+}
+
+LcdFlushStats LcdFlushPipeline::GetStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    RollWindow(esp_timer_get_time());
+    return stats_;
+}
+
+std::string LcdFlushPipeline::GetStatsJson() {
+    auto stats = GetStats();
+    JsonWriter json;
+    json.BeginObject();
+    json.Member("buffer_lines", config_.buffer_lines);
+    json.Member("double_buffer", config_.double_buffer);
+    json.Member("buffer_in_psram", config_.buffer_in_psram);
+    json.Member("swap_bytes", config_.swap_bytes);
+    json.Member("flushes_per_second", stats.flushes_per_second);
+    json.Member("bytes_per_second", stats.bytes_per_second);
+    json.Member("render_time_us", stats.render_time_us);
+    json.Member("wait_time_us", stats.wait_time_us);
+    if (time_transfers_) {
+        json.Member("throughput_mbps", stats.throughput_mbps);
+        json.Member("transfer_time_us", stats.transfer_time_us);
+        json.Member("overlap", stats.overlap);
+    }
+    json.Member("window_ms", LCD_FLUSH_STATS_WINDOW_MS);
+    json.EndObject();
+    return json.Release();
+}
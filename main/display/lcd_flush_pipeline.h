@@ -0,0 +1,81 @@
+#ifndef LCD_FLUSH_PIPELINE_H
+#define LCD_FLUSH_PIPELINE_H
+
+#include <esp_lcd_panel_io.h>
+#include <lvgl.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <cstdint>
+
+// Length of the window the flush statistics are measured over
+#define LCD_FLUSH_STATS_WINDOW_MS 2000
+// Internal RAM left for Wi-Fi and audio when deciding where double buffered tiles go
+#define LCD_FLUSH_INTERNAL_RESERVE (64 * 1024)
+
+// Draw buffer settings of an SPI LCD. The defaults are the single 20 line buffer every SPI panel used so far.
+struct LcdFlushConfig {
+    uint32_t buffer_lines = 20;     // Height of the tile LVGL renders before it is flushed
+    bool double_buffer = false;     // Render the next tile while the previous one is being sent
+    bool buffer_in_psram = false;   // Tiles live in PSRAM and are copied through DMA capable transfer buffers
+    uint32_t trans_lines = 0;       // Height of those transfer buffers
+    bool swap_bytes = true;         // The panel expects big endian RGB565
+
+    // Double buffered tiles of about a tenth of the screen, kept in DMA capable internal RAM when it can spare them
+    static LcdFlushConfig DoubleBuffered(int width, int height);
+};
+
+struct LcdFlushStats {
+    float throughput_mbps = 0;      // Bytes sent per second of transfer, 0 when transfers are not timed
+    float overlap = 0;              // Share of the transfer time LVGL spent rendering rather than waiting
+    float flushes_per_second = 0;
+    uint32_t bytes_per_second = 0;
+    uint32_t render_time_us = 0;    // Average time of a refresh, rendering, flushing and waiting included
+    uint32_t transfer_time_us = 0;  // Average time a tile takes to reach the panel
+    uint32_t wait_time_us = 0;      // Average time LVGL waited for a transfer per flush
+};
+
+/*
+ * Follows the flushes of an LVGL display to the panel.
+ *
+ * Rendering, flushing and waiting for the previous transfer are measured from the LVGL display
+ * events. With double buffered tiles sent straight from DMA capable RAM the pipeline also takes
+ * over the transfer done interrupt from esp_lvgl_port, which only marks the flush ready in that
+ * case, so the transfers themselves can be timed.
+ */
+class LcdFlushPipeline {
+public:
+    LcdFlushPipeline(lv_display_t* display, esp_lcd_panel_io_handle_t panel_io, const LcdFlushConfig& config);
+    ~LcdFlushPipeline();
+
+    LcdFlushStats GetStats();
+    std::string GetStatsJson();
+
+private:
+    static void OnEvent(lv_event_t* e);
+    static bool OnColorTransDone(esp_lcd_panel_io_handle_t panel_io, esp_lcd_panel_io_event_data_t* edata, void* user_ctx);
+    void RollWindow(int64_t now);
+
+    lv_display_t* display_;
+    LcdFlushConfig config_;
+    bool time_transfers_ = false;
+
+    // Set by the LVGL task and the transfer done interrupt
+    std::atomic<uint32_t> transfer_start_time_{0};
+    std::atomic<uint32_t> window_transfer_time_us_{0};
+    std::atomic<uint32_t> window_transfers_{0};
+
+    std::mutex mutex_;
+    int64_t render_start_time_ = 0;
+    int64_t wait_start_time_ = 0;
+    uint32_t window_flushes_ = 0;
+    uint32_t window_refreshes_ = 0;
+    uint64_t window_bytes_ = 0;
+    uint64_t window_render_time_us_ = 0;
+    uint64_t window_wait_time_us_ = 0;
+    int64_t window_start_time_ = 0;
+    LcdFlushStats stats_;
+};
+
+#endif // LCD_FLUSH_PIPELINE_H
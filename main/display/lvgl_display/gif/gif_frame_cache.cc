@@ -0,0 +1,95 @@
+#include "gif_frame_cache.h"
+
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+
+#define TAG "GifFrameCache"
+
+GifCachedFrame::GifCachedFrame(GifCachedFrame&& other) : pixels(other.pixels), delay(other.delay), area(other.area) {
+    other.pixels = nullptr;
+}
+
+GifCachedFrame::~GifCachedFrame() {
+    if (pixels != nullptr) {
+        heap_caps_free(pixels);
+    }
+}
+
+GifFrameCache& GifFrameCache::GetInstance() {
+    static GifFrameCache instance;
+    return instance;
+}
+
+std::shared_ptr<GifFrames> GifFrameCache::Find(const void* source, size_t size) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+        if ((*it)->source == source && (*it)->source_size == size) {
+            entries_.splice(entries_.begin(), entries_, it);
+            return entries_.front();
+        }
+    }
+    return nullptr;
+}
+
+bool GifFrameCache::AllocateFrame(GifFrames& frames, GifCachedFrame& frame) {
+    size_t size = frames.width * frames.height * 4;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (frames.bytes + size > budget_) {
+        return false;
+    }
+    EvictLocked(size);
+    if (used_ + recording_ + size > budget_) {
+        return false;
+    }
+    frame.pixels = (uint8_t*)heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+    if (frame.pixels == nullptr) {
+        return false;
+    }
+    frames.bytes += size;
+    recording_ += size;
+    return true;
+}
+
+void GifFrameCache::Commit(std::shared_ptr<GifFrames> frames) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    recording_ -= frames->bytes;
+    if (frames->generation != generation_) {
+        // The data it was recorded from may be gone already
+        ESP_LOGD(TAG, "Drop %ux%u recorded before the cache was cleared", frames->width, frames->height);
+        return;
+    }
+    used_ += frames->bytes;
+    entries_.push_front(frames);
+    ESP_LOGI(TAG, "Cached %u frames of %ux%u, %u bytes, %u of %u bytes used", frames->frames.size(),
+        frames->width, frames->height, frames->bytes, used_, budget_);
+}
+
+void GifFrameCache::Discard(GifFrames& frames) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    recording_ -= frames.bytes;
+    frames.bytes = 0;
+    frames.frames.clear();
+}
+
+void GifFrameCache::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    generation_++;
+    entries_.clear();
+    used_ = 0;
+}
+
+void GifFrameCache::SetBudget(size_t budget) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    budget_ = budget;
+    EvictLocked(0);
+}
+
+// A GIF still playing keeps its frames until it is destroyed, only the cache forgets it
+void GifFrameCache::EvictLocked(size_t needed) {
+    while (!entries_.empty() && used_ + recording_ + needed > budget_) {
+        auto& oldest = entries_.back();
+        used_ -= oldest->bytes;
+        ESP_LOGD(TAG, "Evict %ux%u, %u bytes", oldest->width, oldest->height, oldest->bytes);
+        entries_.pop_back();
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <lvgl.h>
+#include <cstdint>
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#if CONFIG_SPIRAM
+#define GIF_FRAME_CACHE_BUDGET (2 * 1024 * 1024)
+#else
+#define GIF_FRAME_CACHE_BUDGET 0
+#endif
+
+/**
+ * The composed canvas of one GIF frame, with the area that changed from the previous frame
+ */
+struct GifCachedFrame {
+    uint8_t* pixels = nullptr;
+    uint16_t delay = 0;
+    lv_area_t area = {};
+
+    GifCachedFrame() = default;
+    GifCachedFrame(const GifCachedFrame&) = delete;
+    GifCachedFrame& operator=(const GifCachedFrame&) = delete;
+    GifCachedFrame(GifCachedFrame&& other);
+    ~GifCachedFrame();
+};
+
+/**
+ * All frames of one loop of a GIF, keyed by the address and size of the GIF data
+ */
+struct GifFrames {
+    const void* source;
+    size_t source_size;
+    uint32_t generation;        // Cache generation the recording started in
+    uint16_t width;
+    uint16_t height;
+    int32_t loop_count;
+    size_t bytes = 0;
+    std::vector<GifCachedFrame> frames;
+};
+
+/**
+ * Decoded GIF frames in PSRAM, shared by every LvglGif playing the same data. Looping emotions
+ * are decoded once and then copied from the cache. The least recently used GIFs are dropped
+ * to stay within the byte budget. The assets call Clear() before their data moves, since new
+ * data may show up at an address that was cached before.
+ */
+class GifFrameCache {
+public:
+    static GifFrameCache& GetInstance();
+
+    std::shared_ptr<GifFrames> Find(const void* source, size_t size);
+    // Allocate the pixels of a frame being recorded, evicting other GIFs when over budget
+    bool AllocateFrame(GifFrames& frames, GifCachedFrame& frame);
+    // Make a completely recorded GIF available to Find()
+    void Commit(std::shared_ptr<GifFrames> frames);
+    // Give back the budget of a recording that was abandoned
+    void Discard(GifFrames& frames);
+    // Forget every GIF, recordings already running are not committed
+    void Clear();
+    uint32_t generation() const { return generation_; }
+
+    size_t budget() const { return budget_; }
+    void SetBudget(size_t budget);
+
+private:
+    GifFrameCache() = default;
+    void EvictLocked(size_t needed);
+
+    std::mutex mutex_;
+    std::list<std::shared_ptr<GifFrames>> entries_;   // Most recently used first
+    size_t budget_ = GIF_FRAME_CACHE_BUDGET;
+    size_t used_ = 0;
+    size_t recording_ = 0;
+    std::atomic<uint32_t> generation_{0};
+};
@@ -1,5 +1,6 @@
 #include "gifdec.h"
 
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
@@ -10,24 +11,33 @@
 #define MIN(A, B) ((A) < (B) ? (A) : (B))
 #define MAX(A, B) ((A) > (B) ? (A) : (B))
 
-typedef struct Entry {
-    uint16_t length;
-    uint16_t prefix;
-    uint8_t  suffix;
-} Entry;
-
-typedef struct Table {
-    int bulk;
-    int nentries;
-    Entry * entries;
-} Table;
-
-#if LV_GIF_CACHE_DECODE_DATA
 #define LZW_MAXBITS                 12
 #define LZW_TABLE_SIZE              (1 << LZW_MAXBITS)
+#if LV_GIF_CACHE_DECODE_DATA
 #define LZW_CACHE_SIZE              (LZW_TABLE_SIZE * 4)
+#else
+/* prefix and length (16 bit), suffix and first byte (8 bit) per code, plus an output stack */
+#define LZW_TABLE_BYTES             (LZW_TABLE_SIZE * 7)
+#define LZW_CACHE_SIZE              0
+
+/* Frames are only decoded on the LVGL task, so the open GIFs share one code table.
+ * It is allocated by the first decode and freed with the last GIF. */
+static uint8_t * lzw_table;
+static int lzw_table_users;
 #endif
 
+/* Bit reader over the image data sub-blocks.
+ * Keys are cut from a 32-bit accumulator that is refilled from a whole sub-block,
+ * instead of reading the source one byte at a time for every key. */
+typedef struct BitReader {
+    uint32_t bits;
+    int nbits;
+    int avail;
+    bool done;
+    const uint8_t * p;
+    uint8_t block[0xFF];
+} BitReader;
+
 static gd_GIF  * gif_open(gd_GIF * gif);
 static bool f_gif_open(gd_GIF * gif, const void * path, bool is_file);
 static void f_gif_read(gd_GIF * gif, void * buf, size_t len);
@@ -38,6 +48,24 @@ static void f_gif_close(gd_GIF * gif);
     #include "gifdec_mve.h"
 #endif
 
+/* A palette color as one canvas pixel, i.e. B, G, R, A in memory (little endian) */
+static inline uint32_t
+canvas_pixel(const uint8_t * color, uint8_t opa)
+{
+    return ((uint32_t) opa << 24) | ((uint32_t) color[0] << 16) | ((uint32_t) color[1] << 8) | color[2];
+}
+
+#ifndef GIFDEC_FILL_BG
+static void
+fill_rect(uint32_t * dst, int w, int h, int stride, uint32_t pixel)
+{
+    for(int j = 0; j < h; j++) {
+        for(int k = 0; k < w; k++) dst[k] = pixel;
+        dst += stride;
+    }
+}
+#endif
+
 static uint16_t
 read_num(gd_GIF * gif)
 {
@@ -116,19 +144,11 @@ static gd_GIF * gif_open(gd_GIF * gif_base)
         ESP_LOGW(TAG, "Zero size image");
         goto fail;
     }
-#if LV_GIF_CACHE_DECODE_DATA
     if(0 == (INT_MAX - sizeof(gd_GIF) - LZW_CACHE_SIZE) / width / height / 5){
         ESP_LOGW(TAG, "Image dimensions are too large");
         goto fail;
     } 
-    gif = lv_malloc(sizeof(gd_GIF) + 5 * width * height + LZW_CACHE_SIZE);
-#else
-    if(0 == (INT_MAX - sizeof(gd_GIF)) / width / height / 5){
-        ESP_LOGW(TAG, "Image dimensions are too large");
-        goto fail;
-    } 
-    gif = lv_malloc(sizeof(gd_GIF) + 5 * width * height);
-#endif
+    gif = lv_malloc(sizeof(gd_GIF) + LZW_CACHE_SIZE + 5 * width * height);
     if(!gif) goto fail;
     memcpy(gif, gif_base, sizeof(gd_GIF));
     gif->width  = width;
@@ -139,25 +159,25 @@ static gd_GIF * gif_open(gd_GIF * gif_base)
     f_gif_read(gif, gif->gct.colors, 3 * gif->gct.size);
     gif->palette = &gif->gct;
     gif->bgindex = bgidx;
-    gif->canvas = (uint8_t *) &gif[1];
+#if LV_GIF_CACHE_DECODE_DATA
+    /* The code table goes first so that it and the canvas stay word aligned */
+    gif->lzw_cache = (uint8_t *) &gif[1];
+#else
+    gif->lzw_cache = NULL;
+    lzw_table_users++;
+#endif
+    gif->canvas = (uint8_t *) &gif[1] + LZW_CACHE_SIZE;
     gif->frame = &gif->canvas[4 * width * height];
     if(gif->bgindex) {
         memset(gif->frame, gif->bgindex, gif->width * gif->height);
     }
     bgcolor = &gif->palette->colors[gif->bgindex * 3];
-    #if LV_GIF_CACHE_DECODE_DATA
-    gif->lzw_cache = gif->frame + width * height;
-    #endif
 
 #ifdef GIFDEC_FILL_BG
     GIFDEC_FILL_BG(gif->canvas, gif->width * gif->height, 1, gif->width * gif->height, bgcolor, 0x00);
 #else
-    for(int i = 0; i < gif->width * gif->height; i++) {
-        gif->canvas[i * 4 + 0] = *(bgcolor + 2);
-        gif->canvas[i * 4 + 1] = *(bgcolor + 1);
-        gif->canvas[i * 4 + 2] = *(bgcolor + 0);
-        gif->canvas[i * 4 + 3] = 0x00;  // 初始化为透明，让第一帧根据自己的透明度设置来渲染
-    }
+    // 初始化为透明，让第一帧根据自己的透明度设置来渲染
+    fill_rect((uint32_t *) gif->canvas, gif->width, gif->height, gif->width, canvas_pixel(bgcolor, 0x00));
 #endif
     gif->anim_start = f_gif_seek(gif, 0, LV_FS_SEEK_CUR);
     gif->loop_count = -1;
@@ -299,6 +319,7 @@ read_ext(gd_GIF * gif)
     }
 }
 
+#if LV_GIF_CACHE_DECODE_DATA
 static uint16_t
 get_key(gd_GIF *gif, int key_size, uint8_t *sub_len, uint8_t *shift, uint8_t *byte)
 {
@@ -328,7 +349,6 @@ get_key(gd_GIF *gif, int key_size, uint8_t *sub_len, uint8_t *shift, uint8_t *by
     return key;
 }
 
-#if LV_GIF_CACHE_DECODE_DATA
 /* Decompress image pixels.
  * Return 0 on success or -1 on out-of-memory (w.r.t. LZW code table) or parse error. */
 static int
@@ -478,146 +498,185 @@ read_image_data(gd_GIF *gif, int interlace)
     return ret;
 }
 #else
-static Table *
-new_table(int key_size)
+static bool
+bits_next_block(gd_GIF * gif, BitReader * br)
 {
-    int key;
-    int init_bulk = MAX(1 << (key_size + 1), 0x100);
-    Table * table = lv_malloc(sizeof(*table) + sizeof(Entry) * init_bulk);
-    if(table) {
-        table->bulk = init_bulk;
-        table->nentries = (1 << key_size) + 2;
-        table->entries = (Entry *) &table[1];
-        for(key = 0; key < (1 << key_size); key++)
-            table->entries[key] = (Entry) {
-            1, 0xFFF, key
-        };
-    }
-    return table;
+    uint8_t size;
+
+    f_gif_read(gif, &size, 1);
+    if(size == 0) {
+        br->done = true;
+        return false;
+    }
+    if(gif->is_file) {
+        f_gif_read(gif, br->block, size);
+        br->p = br->block;
+    }
+    else {
+        /* Decode straight from the GIF data in memory */
+        br->p = (const uint8_t *) &gif->data[gif->f_rw_p];
+        gif->f_rw_p += size;
+    }
+    br->avail = size;
+    return true;
 }
 
-/* Add table entry. Return value:
- *  0 on success
- *  +1 if key size must be incremented after this addition
- *  -1 if could not realloc table */
-static int
-add_entry(Table ** tablep, uint16_t length, uint16_t prefix, uint8_t suffix)
+/* Return the next key, or 0x1000 at the end of the image data. */
+static inline int
+bits_get_key(gd_GIF * gif, BitReader * br, int key_size)
 {
-    Table * table = *tablep;
-    if(table->nentries == table->bulk) {
-        table->bulk *= 2;
-        table = lv_realloc(table, sizeof(*table) + sizeof(Entry) * table->bulk);
-        if(!table) return -1;
-        table->entries = (Entry *) &table[1];
-        *tablep = table;
-    }
-    table->entries[table->nentries] = (Entry) {
-        length, prefix, suffix
-    };
-    table->nentries++;
-    if((table->nentries & (table->nentries - 1)) == 0)
-        return 1;
-    return 0;
+    int key;
+
+    if(br->nbits < key_size) {
+        while(br->nbits <= 24) {
+            if(br->avail == 0 && (br->done || !bits_next_block(gif, br))) break;
+            br->bits |= (uint32_t) *br->p++ << br->nbits;
+            br->nbits += 8;
+            br->avail--;
+        }
+        if(br->nbits < key_size) return 0x1000;
+    }
+    key = br->bits & ((1 << key_size) - 1);
+    br->bits >>= key_size;
+    br->nbits -= key_size;
+    return key;
 }
 
-/* Compute output index of y-th input line, in frame of height h. */
-static int
-interlaced_line_index(int h, int y)
+/* Start of the next row of the frame, following the interlace passes if needed. */
+static inline uint8_t *
+next_row(gd_GIF * gif, int interlace, int * y, int * pass)
 {
-    int p; /* number of lines in current pass */
-
-    p = (h - 1) / 8 + 1;
-    if(y < p)  /* pass 1 */
-        return y * 8;
-    y -= p;
-    p = (h - 5) / 8 + 1;
-    if(y < p)  /* pass 2 */
-        return y * 8 + 4;
-    y -= p;
-    p = (h - 3) / 4 + 1;
-    if(y < p)  /* pass 3 */
-        return y * 4 + 2;
-    y -= p;
-    /* pass 4 */
-    return y * 2 + 1;
+    static const uint8_t pass_step[] = {8, 8, 4, 2};
+    static const uint8_t pass_start[] = {0, 4, 2, 1};
+
+    if(interlace) {
+        *y += pass_step[*pass];
+        while(*y >= gif->fh && *pass < 3) {
+            *y = pass_start[++(*pass)];
+        }
+    }
+    else {
+        (*y)++;
+    }
+    return &gif->frame[(gif->fy + *y) * gif->width + gif->fx];
 }
 
 /* Decompress image pixels.
- * Return 0 on success or -1 on out-of-memory (w.r.t. LZW code table) or parse error. */
+ * Return 0 on success or -1 on parse error.
+ * The code table is shared by all GIFs, and every string is written straight to its place
+ * in the frame: backwards from its last byte when it fits in the current row, through the stack
+ * when it wraps to the next one. */
 static int
 read_image_data(gd_GIF * gif, int interlace)
 {
-    uint8_t sub_len, shift, byte;
-    int init_key_size, key_size, table_is_full = 0;
-    int frm_off, frm_size, str_len = 0, i, p, x, y;
-    uint16_t key, clear, stop;
-    int ret;
-    Table * table;
-    Entry entry = {0};
+    uint16_t * prefix, * length;
+    uint8_t * suffix, * first, * stack;
+    BitReader br;
+    uint8_t byte;
+    int init_key_size, key_size, clear, stop, next, prev, key, code, len, n;
+    int frm_off, frm_size, x, y, pass;
+    uint8_t * row, * dst;
     size_t start, end;
 
+    if(lzw_table == NULL) {
+        lzw_table = lv_malloc(LZW_TABLE_BYTES);
+        if(lzw_table == NULL) {
+            ESP_LOGW(TAG, "Failed to allocate the LZW code table");
+            return -1;
+        }
+    }
+    prefix = (uint16_t *) lzw_table;
+    length = prefix + LZW_TABLE_SIZE;
+    suffix = (uint8_t *) (length + LZW_TABLE_SIZE);
+    first = suffix + LZW_TABLE_SIZE;
+    stack = first + LZW_TABLE_SIZE;
+
     f_gif_read(gif, &byte, 1);
-    key_size = (int) byte;
+    if(byte >= LZW_MAXBITS) {
+        ESP_LOGW(TAG, "invalid LZW code size: %d", byte);
+        return -1;
+    }
     start = f_gif_seek(gif, 0, LV_FS_SEEK_CUR);
     discard_sub_blocks(gif);
     end = f_gif_seek(gif, 0, LV_FS_SEEK_CUR);
     f_gif_seek(gif, start, LV_FS_SEEK_SET);
-    clear = 1 << key_size;
+
+    clear = 1 << byte;
     stop = clear + 1;
-    table = new_table(key_size);
-    key_size++;
-    init_key_size = key_size;
-    sub_len = shift = 0;
-    key = get_key(gif, key_size, &sub_len, &shift, &byte); /* clear code */
+    init_key_size = byte + 1;
+    for(key = 0; key < clear; key++) {
+        length[key] = 1;
+        first[key] = key;
+    }
+    memset(&br, 0, offsetof(BitReader, block));
+
+    key_size = init_key_size;
+    next = clear + 2;
+    prev = -1;
     frm_off = 0;
-    ret = 0;
     frm_size = gif->fw * gif->fh;
+    x = y = pass = 0;
+    row = &gif->frame[gif->fy * gif->width + gif->fx];
     while(frm_off < frm_size) {
+        key = bits_get_key(gif, &br, key_size);
         if(key == clear) {
             key_size = init_key_size;
-            table->nentries = (1 << (key_size - 1)) + 2;
-            table_is_full = 0;
+            next = clear + 2;
+            prev = -1;
+            continue;
         }
-        else if(!table_is_full) {
-            ret = add_entry(&table, str_len + 1, key, entry.suffix);
-            if(ret == -1) {
-                lv_free(table);
-                return -1;
-            }
-            if(table->nentries == 0x1000) {
-                ret = 0;
-                table_is_full = 1;
+        if(key == stop || key == 0x1000) break;
+        if(prev < 0) {
+            /* The first key after a clear code must be a literal */
+            if(key >= clear) break;
+        }
+        else if(key > next) {
+            break;
+        }
+        else if(next < LZW_TABLE_SIZE) {
+            /* key == next is the KwKwK case: the previous string plus its own first byte */
+            prefix[next] = prev;
+            suffix[next] = first[key < next ? key : prev];
+            first[next] = first[prev];
+            length[next] = length[prev] + 1;
+            next++;
+            if(next == (1 << key_size) && key_size < LZW_MAXBITS) key_size++;
+        }
+        prev = key;
+
+        len = length[key];
+        if(frm_off + len > frm_size) {
+            ESP_LOGW(TAG, "LZW table token overflows the frame buffer");
+            return -1;
+        }
+        frm_off += len;
+        if(x + len <= gif->fw) {
+            dst = row + x + len - 1;
+            for(code = key; code >= clear; code = prefix[code]) *dst-- = suffix[code];
+            *dst = code;
+            x += len;
+            if(x == gif->fw) {
+                row = next_row(gif, interlace, &y, &pass);
+                x = 0;
             }
         }
-        key = get_key(gif, key_size, &sub_len, &shift, &byte);
-        if(key == clear) continue;
-        if(key == stop || key == 0x1000) break;
-        if(ret == 1) key_size++;
-        entry = table->entries[key];
-        str_len = entry.length;
-	if(frm_off + str_len > frm_size){
-		ESP_LOGW(TAG, "LZW table token overflows the frame buffer");
-		lv_free(table);
-		return -1;
-	}
-        for(i = 0; i < str_len; i++) {
-            p = frm_off + entry.length - 1;
-            x = p % gif->fw;
-            y = p / gif->fw;
-            if(interlace)
-                y = interlaced_line_index((int) gif->fh, y);
-            gif->frame[(gif->fy + y) * gif->width + gif->fx + x] = entry.suffix;
-            if(entry.prefix == 0xFFF)
-                break;
-            else
-                entry = table->entries[entry.prefix];
+        else {
+            dst = stack + len;
+            for(code = key; code >= clear; code = prefix[code]) *--dst = suffix[code];
+            *--dst = code;
+            while(len > 0) {
+                n = MIN(len, gif->fw - x);
+                memcpy(row + x, dst, n);
+                dst += n;
+                len -= n;
+                x += n;
+                if(x == gif->fw) {
+                    row = next_row(gif, interlace, &y, &pass);
+                    x = 0;
+                }
+            }
         }
-        frm_off += str_len;
-        if(key < table->nentries - 1 && !table_is_full)
-            table->entries[table->nentries - 1].suffix = entry.suffix;
     }
-    lv_free(table);
-    if(key == stop) f_gif_read(gif, &sub_len, 1);  /* Must be zero! */
     f_gif_seek(gif, end, LV_FS_SEEK_SET);
     return 0;
 }
@@ -657,6 +716,41 @@ read_image(gd_GIF * gif)
     return read_image_data(gif, interlace);
 }
 
+#ifndef GIFDEC_RENDER_FRAME
+/* Expand a row of palette indexes into canvas pixels through a lookup table of ready made pixels,
+ * leaving the pixels under the transparent index untouched. */
+static void
+expand_row(uint32_t * dst, const uint8_t * src, int n, const uint32_t * lut, int tindex)
+{
+    int k = 0;
+
+    if(tindex > 0xFF) {
+        for(; k + 4 <= n; k += 4) {
+            dst[k + 0] = lut[src[k + 0]];
+            dst[k + 1] = lut[src[k + 1]];
+            dst[k + 2] = lut[src[k + 2]];
+            dst[k + 3] = lut[src[k + 3]];
+        }
+    }
+    else {
+        /* Skip fully transparent runs of four pixels with a single compare */
+        uint32_t transparent = 0x01010101u * (uint32_t) tindex;
+        uint32_t quad;
+        for(; k + 4 <= n; k += 4) {
+            memcpy(&quad, &src[k], 4);
+            if(quad == transparent) continue;
+            if(src[k + 0] != tindex) dst[k + 0] = lut[src[k + 0]];
+            if(src[k + 1] != tindex) dst[k + 1] = lut[src[k + 1]];
+            if(src[k + 2] != tindex) dst[k + 2] = lut[src[k + 2]];
+            if(src[k + 3] != tindex) dst[k + 3] = lut[src[k + 3]];
+        }
+    }
+    for(; k < n; k++) {
+        if(src[k] != tindex) dst[k] = lut[src[k]];
+    }
+}
+#endif
+
 static void
 render_frame_rect(gd_GIF * gif, uint8_t * buffer)
 {
@@ -666,20 +760,13 @@ render_frame_rect(gd_GIF * gif, uint8_t * buffer)
                         &gif->frame[i], gif->palette->colors,
                         gif->gce.transparency ? gif->gce.tindex : 0x100);
 #else
-    int j, k;
-    uint8_t index, * color;
-
-    for(j = 0; j < gif->fh; j++) {
-        for(k = 0; k < gif->fw; k++) {
-            index = gif->frame[(gif->fy + j) * gif->width + gif->fx + k];
-            color = &gif->palette->colors[index * 3];
-            if(!gif->gce.transparency || index != gif->gce.tindex) {
-                buffer[(i + k) * 4 + 0] = *(color + 2);
-                buffer[(i + k) * 4 + 1] = *(color + 1);
-                buffer[(i + k) * 4 + 2] = *(color + 0);
-                buffer[(i + k) * 4 + 3] = 0xFF;
-            }
-        }
+    uint32_t lut[0x100];
+    int tindex = gif->gce.transparency ? gif->gce.tindex : 0x100;
+    const uint8_t * color = gif->palette->colors;
+
+    for(int k = 0; k < 0x100; k++, color += 3) lut[k] = canvas_pixel(color, 0xFF);
+    for(int j = 0; j < gif->fh; j++) {
+        expand_row((uint32_t *) &buffer[i * 4], &gif->frame[i], gif->fw, lut, tindex);
         i += gif->width;
     }
 #endif
@@ -701,16 +788,7 @@ dispose(gd_GIF * gif)
 #ifdef GIFDEC_FILL_BG
             GIFDEC_FILL_BG(&(gif->canvas[i * 4]), gif->fw, gif->fh, gif->width, bgcolor, opa);
 #else
-            int j, k;
-            for(j = 0; j < gif->fh; j++) {
-                for(k = 0; k < gif->fw; k++) {
-                    gif->canvas[(i + k) * 4 + 0] = *(bgcolor + 2);
-                    gif->canvas[(i + k) * 4 + 1] = *(bgcolor + 1);
-                    gif->canvas[(i + k) * 4 + 2] = *(bgcolor + 0);
-                    gif->canvas[(i + k) * 4 + 3] = opa;
-                }
-                i += gif->width;
-            }
+            fill_rect((uint32_t *) &gif->canvas[i * 4], gif->fw, gif->fh, gif->width, canvas_pixel(bgcolor, opa));
 #endif
             break;
         case 3: /* Restore to previous, i.e., don't update canvas.*/
@@ -738,6 +816,7 @@ gd_get_frame(gd_GIF * gif)
             else if(gif->loop_count > 1) {
                 gif->loop_count--;
             }
+            gif->loops++;
         }
         else if(sep == '!')
             read_ext(gif);
@@ -759,6 +838,7 @@ void
 gd_rewind(gd_GIF * gif)
 {
     gif->loop_count = -1;
+    gif->loops = 0;
     f_gif_seek(gif, gif->anim_start, LV_FS_SEEK_SET);
 }
 
@@ -766,6 +846,12 @@ void
 gd_close_gif(gd_GIF * gif)
 {
     f_gif_close(gif);
+#if !LV_GIF_CACHE_DECODE_DATA
+    if(--lzw_table_users == 0) {
+        lv_free(lzw_table);
+        lzw_table = NULL;
+    }
+#endif
     lv_free(gif);
 }
 
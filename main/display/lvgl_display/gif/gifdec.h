@@ -33,6 +33,7 @@ typedef struct _gd_GIF {
     uint16_t width, height;
     uint16_t depth;
     int32_t loop_count;
+    uint32_t loops;     /* Times the data wrapped around to the first frame */
     gd_GCE gce;
     gd_Palette * palette;
     gd_Palette lct, gct;
@@ -46,9 +47,7 @@ typedef struct _gd_GIF {
     uint16_t fx, fy, fw, fh;
     uint8_t bgindex;
     uint8_t * canvas, * frame;
-#if LV_GIF_CACHE_DECODE_DATA
-    uint8_t *lzw_cache;
-#endif
+    uint8_t * lzw_cache;    /* LZW code table before the canvas, shared by all GIFs without LV_GIF_CACHE_DECODE_DATA */
 } gd_GIF;
 
 gd_GIF * gd_open_gif_file(const char * fname);
@@ -1,11 +1,13 @@
 #include "lvgl_gif.h"
+#include "animation_scheduler.h"
 #include <esp_log.h>
 #include <cstring>
 
 #define TAG "LvglGif"
 
 LvglGif::LvglGif(const lv_img_dsc_t* img_dsc)
-    : gif_(nullptr), timer_(nullptr), last_call_(0), playing_(false), loaded_(false) {
+    : gif_(nullptr), timer_(nullptr), last_call_(0), playing_(false), loaded_(false),
+      dirty_area_{}, dirty_(false), frame_index_(-1), loop_count_(-1) {
     if (!img_dsc || !img_dsc->data) {
         ESP_LOGE(TAG, "Invalid image descriptor");
         return;
@@ -33,6 +35,21 @@ LvglGif::LvglGif(const lv_img_dsc_t* img_dsc)
         gd_render_frame(gif_, gif_->canvas);
     }
 
+    // A GIF played before is copied from the cache, otherwise its first loop is recorded
+    auto& frame_cache = GifFrameCache::GetInstance();
+    cache_ = frame_cache.Find(img_dsc->data, img_dsc->data_size);
+    if (cache_) {
+        loop_count_ = cache_->loop_count;
+    } else if (frame_cache.budget() > 0) {
+        recording_ = std::make_shared<GifFrames>();
+        recording_->source = img_dsc->data;
+        recording_->source_size = img_dsc->data_size;
+        recording_->generation = frame_cache.generation();
+        recording_->width = gif_->width;
+        recording_->height = gif_->height;
+        recording_->loop_count = -1;
+    }
+
     loaded_ = true;
     ESP_LOGD(TAG, "GIF loaded from image descriptor: %dx%d", gif_->width, gif_->height);
 }
@@ -93,6 +110,8 @@ void LvglGif::Resume() {
 
     if (timer_) {
         playing_ = true;
+        // The frames missed while paused are not caught up with
+        last_call_ = lv_tick_get();
         lv_timer_resume(timer_);
         ESP_LOGD(TAG, "GIF animation resumed");
     }
@@ -106,6 +125,12 @@ void LvglGif::Stop() {
 
     if (gif_) {
         gd_rewind(gif_);
+        // The rewound decoder does not continue the recorded loop
+        DiscardRecording();
+        if (cache_) {
+            frame_index_ = -1;
+            loop_count_ = cache_->loop_count;
+        }
         NextFrame();
         ESP_LOGD(TAG, "GIF animation stopped and rewound");
     }
@@ -123,6 +148,9 @@ int32_t LvglGif::GetLoopCount() const {
     if (!loaded_ || !gif_) {
         return -1;
     }
+    if (cache_) {
+        return loop_count_;
+    }
     return gif_->loop_count;
 }
 
@@ -132,6 +160,7 @@ void LvglGif::SetLoopCount(int32_t count) {
         return;
     }
     gif_->loop_count = count;
+    loop_count_ = count;
 }
 
 uint16_t LvglGif::width() const {
@@ -152,18 +181,96 @@ void LvglGif::SetFrameCallback(std::function<void()> callback) {
     frame_callback_ = callback;
 }
 
+bool LvglGif::GetDirtyArea(lv_area_t& area) const {
+    if (!dirty_) {
+        return false;
+    }
+    area = dirty_area_;
+    return true;
+}
+
+uint32_t LvglGif::FrameDelay() const {
+    uint32_t delay = gif_->gce.delay;
+    if (cache_) {
+        delay = frame_index_ >= 0 ? cache_->frames[frame_index_].delay : 0;
+    }
+    return delay * 10;
+}
+
 void LvglGif::NextFrame() {
     if (!loaded_ || !gif_ || !playing_) {
         return;
     }
 
     // Check if enough time has passed for the next frame
-    uint32_t elapsed = lv_tick_elaps(last_call_);
-    if (elapsed < gif_->gce.delay * 10) {
+    uint32_t delay = FrameDelay();
+    if (lv_tick_elaps(last_call_) < delay) {
         return;
     }
 
-    last_call_ = lv_tick_get();
+    // The previous frame may still be on its way to the panel
+    auto& scheduler = AnimationScheduler::GetInstance();
+    if (!scheduler.CanPresent()) {
+        return;
+    }
+
+    // Frames are timed from when they were due rather than from when they were shown, and the
+    // ones that are over by now are composed into the canvas without being shown
+    lv_area_t area = {};
+    bool has_area = false;
+    uint32_t dropped = 0;
+    while (true) {
+        last_call_ += delay;
+
+        if (cache_) {
+            NextCachedFrame();
+        } else {
+            DecodeNextFrame();
+        }
+        if (dirty_) {
+            if (has_area) {
+                area.x1 = LV_MIN(area.x1, dirty_area_.x1);
+                area.y1 = LV_MIN(area.y1, dirty_area_.y1);
+                area.x2 = LV_MAX(area.x2, dirty_area_.x2);
+                area.y2 = LV_MAX(area.y2, dirty_area_.y2);
+            } else {
+                area = dirty_area_;
+                has_area = true;
+            }
+        }
+
+        delay = FrameDelay();
+        if (!playing_ || delay == 0 || lv_tick_elaps(last_call_) < delay) {
+            break;
+        }
+        if (dropped + 1 >= GIF_MAX_CATCH_UP_FRAMES) {
+            // Too far behind, e.g. after a stall: start the timeline over
+            last_call_ = lv_tick_get();
+            break;
+        }
+        dropped++;
+    }
+    dirty_area_ = area;
+    dirty_ = has_area;
+
+    // Call frame callback if set
+    if (dirty_) {
+        scheduler.FramePresented(dropped);
+        if (frame_callback_) {
+            frame_callback_();
+        }
+    }
+}
+
+void LvglGif::DecodeNextFrame() {
+    // Restoring the previous frame to the background changes its rectangle too
+    lv_area_t area = {};
+    bool has_area = false;
+    if (gif_->gce.disposal == 2 && gif_->fw > 0 && gif_->fh > 0) {
+        lv_area_set(&area, gif_->fx, gif_->fy, gif_->fx + gif_->fw - 1, gif_->fy + gif_->fh - 1);
+        has_area = true;
+    }
+    uint32_t loops = gif_->loops;
 
     // Get next frame
     int has_next = gd_get_frame(gif_);
@@ -177,17 +284,121 @@ void LvglGif::NextFrame() {
     }
 
     // Render current frame
+    dirty_ = false;
     if (gif_->canvas) {
         gd_render_frame(gif_, gif_->canvas);
-        
-        // Call frame callback if set
-        if (frame_callback_) {
-            frame_callback_();
+
+        if (gif_->fw > 0 && gif_->fh > 0) {
+            lv_area_t frame_area;
+            lv_area_set(&frame_area, gif_->fx, gif_->fy, gif_->fx + gif_->fw - 1, gif_->fy + gif_->fh - 1);
+            if (has_area) {
+                area.x1 = LV_MIN(area.x1, frame_area.x1);
+                area.y1 = LV_MIN(area.y1, frame_area.y1);
+                area.x2 = LV_MAX(area.x2, frame_area.x2);
+                area.y2 = LV_MAX(area.y2, frame_area.y2);
+            } else {
+                area = frame_area;
+                has_area = true;
+            }
         }
+        dirty_area_ = area;
+        dirty_ = has_area;
+    }
+
+    if (has_next == 1) {
+        RecordFrame(gif_->loops != loops);
+    } else {
+        DiscardRecording();
+    }
+}
+
+void LvglGif::NextCachedFrame() {
+    int next = frame_index_ + 1;
+    if (next >= (int)cache_->frames.size()) {
+        // The same loop count handling as gifdec at the end of the data
+        if (loop_count_ == 1 || loop_count_ < 0) {
+            playing_ = false;
+            dirty_ = false;
+            if (timer_) {
+                lv_timer_pause(timer_);
+            }
+            ESP_LOGD(TAG, "GIF animation completed");
+            return;
+        } else if (loop_count_ > 1) {
+            loop_count_--;
+        }
+        next = 0;
+    }
+
+    // The canvas holds the previous frame, so only the changed area is copied
+    auto& frame = cache_->frames[next];
+    lv_area_t area = frame.area;
+    if (frame_index_ < 0) {
+        lv_area_set(&area, 0, 0, gif_->width - 1, gif_->height - 1);
+    }
+    size_t stride = gif_->width * 4;
+    size_t offset = area.y1 * stride + area.x1 * 4;
+    size_t length = lv_area_get_width(&area) * 4;
+    for (int32_t y = area.y1; y <= area.y2; y++) {
+        memcpy(gif_->canvas + offset, frame.pixels + offset, length);
+        offset += stride;
+    }
+
+    frame_index_ = next;
+    dirty_area_ = area;
+    dirty_ = true;
+}
+
+void LvglGif::RecordFrame(bool wrapped) {
+    if (!recording_) {
+        return;
+    }
+
+    size_t size = gif_->width * gif_->height * 4;
+    auto& frame_cache = GifFrameCache::GetInstance();
+    if (!wrapped) {
+        GifCachedFrame frame;
+        if (!frame_cache.AllocateFrame(*recording_, frame)) {
+            ESP_LOGD(TAG, "GIF is over the frame cache budget");
+            DiscardRecording();
+            return;
+        }
+        if (recording_->frames.empty()) {
+            recording_->loop_count = gif_->loop_count;
+        }
+        memcpy(frame.pixels, gif_->canvas, size);
+        frame.delay = gif_->gce.delay;
+        frame.area = dirty_area_;
+        recording_->frames.push_back(std::move(frame));
+        return;
+    }
+
+    // The loop repeats from here only if the first frame of the second loop equals the recorded one
+    auto& first = recording_->frames.front();
+    if (memcmp(first.pixels, gif_->canvas, size) != 0) {
+        ESP_LOGD(TAG, "GIF frames differ between loops, not cached");
+        DiscardRecording();
+        return;
+    }
+    first.area = dirty_area_;
+    cache_ = recording_;
+    recording_.reset();
+    frame_cache.Commit(cache_);
+    frame_index_ = 0;
+    loop_count_ = gif_->loop_count;
+}
+
+void LvglGif::DiscardRecording() {
+    if (recording_) {
+        GifFrameCache::GetInstance().Discard(*recording_);
+        recording_.reset();
     }
 }
 
 void LvglGif::Cleanup() {
+    DiscardRecording();
+    cache_.reset();
+
     // Stop and delete timer
     if (timer_) {
         lv_timer_delete(timer_);
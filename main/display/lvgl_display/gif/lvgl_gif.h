@@ -2,10 +2,14 @@
 
 #include "../lvgl_image.h"
 #include "gifdec.h"
+#include "gif_frame_cache.h"
 #include <lvgl.h>
 #include <memory>
 #include <functional>
 
+// Most frames composed in one timer tick to catch up with the GIF timeline, the last one is shown
+#define GIF_MAX_CATCH_UP_FRAMES 4
+
 /**
  * C++ implementation of LVGL GIF widget
  * Provides GIF animation functionality using gifdec library
@@ -69,6 +73,11 @@ public:
      */
     void SetFrameCallback(std::function<void()> callback);
 
+    /**
+     * Get the canvas area changed by the last frame, false if nothing changed
+     */
+    bool GetDirtyArea(lv_area_t& area) const;
+
 private:
     // GIF decoder instance
     gd_GIF* gif_;
@@ -88,11 +97,43 @@ private:
     
     // Frame update callback
     std::function<void()> frame_callback_;
+
+    // Canvas area changed by the last frame
+    lv_area_t dirty_area_;
+    bool dirty_;
+
+    // Frames of a looping GIF, copied into the canvas instead of decoding
+    std::shared_ptr<GifFrames> cache_;
+    int frame_index_;
+    int32_t loop_count_;
+    // Frames of the first loop, committed to the cache when the second loop repeats them
+    std::shared_ptr<GifFrames> recording_;
     
     /**
-     * Update to next frame
+     * Update to the frame that is due, skipping the ones that are already over
      */
     void NextFrame();
+
+    /**
+     * Display time of the current frame in milliseconds
+     */
+    uint32_t FrameDelay() const;
+
+    /**
+     * Decode the next frame into the canvas
+     */
+    void DecodeNextFrame();
+
+    /**
+     * Copy the next cached frame into the canvas
+     */
+    void NextCachedFrame();
+
+    /**
+     * Add the decoded frame to the recording
+     */
+    void RecordFrame(bool wrapped);
+    void DiscardRecording();
     
     /**
      * Cleanup resources
@@ -10,6 +10,7 @@
 #include "driver/jpeg_encode.h"
 #endif
 #include "image_to_jpeg.h"
+#include "pixel_convert.h"
 
 #define TAG "image_to_jpeg"
 
@@ -24,14 +25,6 @@ static void* malloc_psram(size_t size) {
 #endif
 }
 
-static __always_inline uint8_t expand_5_to_8(uint8_t v) {
-    return (uint8_t)((v << 3) | (v >> 2));
-}
-
-static __always_inline uint8_t expand_6_to_8(uint8_t v) {
-    return (uint8_t)((v << 2) | (v >> 4));
-}
-
 static uint8_t* convert_input_to_encoder_buf(const uint8_t* src, uint16_t width, uint16_t height, v4l2_pix_fmt_t format,
                                              jpeg_pixel_format_t* out_fmt, int* out_size) {
     // 直接支持的格式：GRAY、RGB888、YCbYCr(YUYV)
@@ -65,20 +58,11 @@ static uint8_t* convert_input_to_encoder_buf(const uint8_t* src, uint16_t width,
     // V4L2 UYVY (Cb Y Cr Y) -> 重排为 YUYV 再作为 YCbYCr 输入
     if (format == V4L2_PIX_FMT_UYVY) {
         int sz = (int)width * (int)height * 2;
-        const uint8_t* s = src;
         uint8_t* buf = (uint8_t*)jpeg_calloc_align(sz, 16);
         if (!buf)
             return NULL;
-        uint8_t* d = buf;
-        for (int i = 0; i < sz; i += 4) {
-            // src: Cb, Y0, Cr, Y1 -> dst: Y0, Cb, Y1, Cr
-            d[0] = s[1];
-            d[1] = s[0];
-            d[2] = s[3];
-            d[3] = s[2];
-            s += 4;
-            d += 4;
-        }
+        // src: Cb, Y0, Cr, Y1 -> dst: Y0, Cb, Y1, Cr，即交换每个16位的字节
+        pixel_swap16(src, (size_t)width * 2, buf, (size_t)width * 2, width, height);
         if (out_fmt)
             *out_fmt = JPEG_PIXEL_FORMAT_YCbYCr;
         if (out_size)
@@ -89,29 +73,10 @@ static uint8_t* convert_input_to_encoder_buf(const uint8_t* src, uint16_t width,
     // V4L2 YUV422P (YUV422 Planar) -> 重排为 YUYV (YCbYCr)
     if (format == V4L2_PIX_FMT_YUV422P) {
         int sz = (int)width * (int)height * 2;
-        const uint8_t* y_plane = src;
-        const uint8_t* u_plane = y_plane + (int)width * (int)height;
-        const uint8_t* v_plane = u_plane + ((int)width / 2) * (int)height;
         uint8_t* buf = (uint8_t*)jpeg_calloc_align(sz, 16);
         if (!buf)
             return NULL;
-        uint8_t* dst = buf;
-        for (int y = 0; y < height; y++) {
-            const uint8_t* y_row = y_plane + y * (int)width;
-            const uint8_t* u_row = u_plane + y * ((int)width / 2);
-            const uint8_t* v_row = v_plane + y * ((int)width / 2);
-            for (int x = 0; x < width; x += 2) {
-                uint8_t y0 = y_row[x + 0];
-                uint8_t y1 = y_row[x + 1];
-                uint8_t cb = u_row[x / 2];
-                uint8_t cr = v_row[x / 2];
-                dst[0] = y0;
-                dst[1] = cb;
-                dst[2] = y1;
-                dst[3] = cr;
-                dst += 4;
-            }
-        }
+        pixel_yuv422p_to_yuyv(src, buf, (size_t)width * 2, width, height);
         if (out_fmt)
             *out_fmt = JPEG_PIXEL_FORMAT_YCbYCr;
         if (out_size)
@@ -130,23 +95,7 @@ static uint8_t* convert_input_to_encoder_buf(const uint8_t* src, uint16_t width,
         memcpy(rgb, src, rgb_size);
     } else if (format == V4L2_PIX_FMT_RGB565) {
         // RGB565 小端，需要转换为 RGB888
-        const uint8_t* p = src;
-        uint8_t* d = rgb;
-        int pixels = (int)width * (int)height;
-        for (int i = 0; i < pixels; i++) {
-            uint8_t lo = p[0];  // 低字节（LSB）
-            uint8_t hi = p[1];  // 高字节（MSB）
-            p += 2;
-
-            uint8_t r5 = (hi >> 3) & 0x1F;
-            uint8_t g6 = ((hi & 0x07) << 3) | ((lo & 0xE0) >> 5);
-            uint8_t b5 = lo & 0x1F;
-
-            d[0] = expand_5_to_8(r5);
-            d[1] = expand_6_to_8(g6);
-            d[2] = expand_5_to_8(b5);
-            d += 3;
-        }
+        pixel_rgb565_to_rgb24(src, (size_t)width * 2, rgb, (size_t)width * 3, width, height);
     } else {
         // 其他未覆盖格式，清零
         memset(rgb, 0, rgb_size);
@@ -225,18 +174,15 @@ static uint8_t* convert_input_to_hw_encoder_buf(const uint8_t* src, uint16_t wid
     if (format == V4L2_PIX_FMT_YUYV) {
         // 硬件需要 | Y1 V Y0 U | 的“大端”格式，因此需要 bswap16
         int sz = (int)width * (int)height * 2;
-        uint16_t* buf = (uint16_t*)malloc_psram(sz);
+        uint8_t* buf = (uint8_t*)malloc_psram(sz);
         if (!buf)
             return NULL;
-        const uint16_t* bsrc = (const uint16_t*)src;
-        for (int i = 0; i < sz / 2; i++) {
-            buf[i] = __builtin_bswap16(bsrc[i]);
-        }
+        pixel_swap16(src, (size_t)width * 2, buf, (size_t)width * 2, width, height);
         if (out_fmt)
             *out_fmt = JPEG_ENCODE_IN_FORMAT_YUV422;
         if (out_size)
             *out_size = sz;
-        return (uint8_t*)buf;
+        return buf;
     }
 
     return NULL;
@@ -412,3 +358,92 @@ bool image_to_jpeg_cb(uint8_t* src, size_t src_len, uint16_t width, uint16_t hei
 #endif
     return encode_with_esp_new_jpeg(src, src_len, width, height, format, quality, NULL, NULL, cb, arg);
 }
+
+bool rgb565_rows_to_jpeg_cb(uint16_t width, uint16_t height, uint8_t quality, jpg_rgb565_rows_cb rows, void* rows_arg,
+                            jpg_out_cb cb, void* arg, size_t* work_size) {
+    if (quality < 1)
+        quality = 1;
+    if (quality > 100)
+        quality = 100;
+
+    jpeg_enc_config_t cfg = DEFAULT_JPEG_ENC_CONFIG();
+    cfg.width = width;
+    cfg.height = height;
+    cfg.src_type = JPEG_PIXEL_FORMAT_RGB888;
+    cfg.subsampling = JPEG_SUBSAMPLE_420;
+    cfg.quality = quality;
+    cfg.rotate = JPEG_ROTATE_0D;
+    cfg.task_enable = false;
+
+    jpeg_enc_handle_t h = NULL;
+    jpeg_error_t ret = jpeg_enc_open(&cfg, &h);
+    if (ret != JPEG_ERR_OK) {
+        ESP_LOGE(TAG, "jpeg_enc_open failed: %d", (int)ret);
+        return false;
+    }
+
+    // 分块编码每次输入一个MCU行块（4:2:0为16行）
+    int row_bytes = (int)width * 3;
+    int block_size = jpeg_enc_get_block_size(h);
+    if (block_size <= 0 || block_size % row_bytes != 0) {
+        jpeg_enc_close(h);
+        ESP_LOGE(TAG, "unexpected block size %d for width %u", block_size, width);
+        return false;
+    }
+    int block_lines = block_size / row_bytes;
+
+    // 一个块的输出不会超过它的RGB888输入，另留出文件头的空间
+    int out_cap = block_size + 2048;
+    uint8_t* block = (uint8_t*)jpeg_calloc_align(block_size, 16);
+    uint8_t* outbuf = (uint8_t*)malloc_psram(out_cap);
+    if (!block || !outbuf) {
+        if (block)
+            jpeg_free_align(block);
+        free(outbuf);
+        jpeg_enc_close(h);
+        ESP_LOGE(TAG, "alloc block buffers failed");
+        return false;
+    }
+    if (work_size)
+        *work_size = (size_t)block_size + (size_t)out_cap;
+
+    bool ok = true;
+    size_t index = 0;
+    for (int y = 0; y < height; y += block_lines) {
+        uint16_t lines = (uint16_t)(height - y < block_lines ? height - y : block_lines);
+        size_t stride = 0;
+        const uint8_t* src = rows(rows_arg, (uint16_t)y, lines, &stride);
+        if (!src) {
+            ok = false;
+            break;
+        }
+        // 最后一块不足时重复最后一行
+        for (int line = 0; line < block_lines; line++) {
+            int src_line = line < lines ? line : lines - 1;
+            pixel_rgb565_to_rgb24(src + src_line * stride, stride, block + line * row_bytes, row_bytes, width, 1);
+        }
+
+        int out_len = 0;
+        ret = jpeg_enc_process_with_block(h, block, block_size, outbuf, out_cap, &out_len);
+        if (ret < JPEG_ERR_OK) {
+            ESP_LOGE(TAG, "jpeg_enc_process_with_block failed: %d", (int)ret);
+            ok = false;
+            break;
+        }
+        if (out_len > 0) {
+            if (cb(arg, index, outbuf, (size_t)out_len) != (size_t)out_len) {
+                ok = false;
+                break;
+            }
+            index += out_len;
+        }
+    }
+    if (ok) {
+        cb(arg, index, NULL, 0);  // 结束信号
+    }
+
+    jpeg_enc_close(h);
+    jpeg_free_align(block);
+    free(outbuf);
+    return ok;
+}
@@ -63,6 +63,33 @@ bool image_to_jpeg(uint8_t *src, size_t src_len, uint16_t width, uint16_t height
 bool image_to_jpeg_cb(uint8_t *src, size_t src_len, uint16_t width, uint16_t height, 
                       v4l2_pix_fmt_t format, uint8_t quality, jpg_out_cb cb, void *arg);
 
+// RGB565行数据回调函数类型（本机字节序）
+// arg: 用户自定义参数, y: 起始行, lines: 行数, stride: 输出每行字节数
+// 返回: 第y行的像素指针，之后lines行都需有效；失败返回NULL
+typedef const uint8_t *(*jpg_rgb565_rows_cb)(void *arg, uint16_t y, uint16_t lines, size_t *stride);
+
+/**
+ * @brief 按行块把RGB565图像流式编码为JPEG（回调版本）
+ *
+ * 使用esp_new_jpeg的分块编码，一次只转换一个MCU行块：
+ * - 不需要整幅图像的输入缓冲区，像素按需通过rows回调获取
+ * - 字节序处理合并在RGB565到RGB888的转换中，无需单独的交换过程
+ * - 每个块的JPEG数据立即交给cb，cb返回值小于len时中止编码
+ *
+ * @param width     图像宽度
+ * @param height    图像高度
+ * @param quality   JPEG质量 (1-100)
+ * @param rows      像素行回调函数
+ * @param rows_arg  传递给rows的用户参数
+ * @param cb        输出回调函数，index为已输出的字节数，最后以data为NULL调用一次
+ * @param arg       传递给cb的用户参数
+ * @param work_size 可选，返回编码使用的缓冲区字节数
+ *
+ * @return true 成功, false 失败
+ */
+bool rgb565_rows_to_jpeg_cb(uint16_t width, uint16_t height, uint8_t quality, jpg_rgb565_rows_cb rows, void *rows_arg,
+                            jpg_out_cb cb, void *arg, size_t *work_size);
+
 #ifdef __cplusplus
 }
 #endif
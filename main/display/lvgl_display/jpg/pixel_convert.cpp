@@ -0,0 +1,188 @@
+#include "pixel_convert.h"
+
+#include <stdint.h>
+
+/*
+ * 摄像头帧多在PSRAM中，逐字节读写会让每个像素都走一次cache访问。对齐的行按32位字读写，
+ * 一次处理两个16位像素（RGB24为四个像素对应三个字），计算与逐像素版本完全一致。
+ */
+
+static inline bool is_aligned4(const void *a, const void *b) {
+    return (((uintptr_t)a | (uintptr_t)b) & 3) == 0;
+}
+
+static inline int clamp_u8(int v) {
+    return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+static inline uint32_t pack_rgb565(uint32_t r, uint32_t g, uint32_t b) {
+    return ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3);
+}
+
+static inline uint32_t expand_5_to_8(uint32_t v) {
+    return (v << 3) | (v >> 2);
+}
+
+static inline uint32_t expand_6_to_8(uint32_t v) {
+    return (v << 2) | (v >> 4);
+}
+
+// 两个像素共用一组色度，返回 pix0 | pix1 << 16
+static inline uint32_t yuyv_pair_to_rgb565(int y0, int u, int y1, int v) {
+    int d = u - 128;
+    int e = v - 128;
+    // 常用整数近似转换，+128 用于四舍五入
+    int rv = 409 * e + 128;
+    int guv = -100 * d - 208 * e + 128;
+    int bu = 516 * d + 128;
+    int l0 = 298 * (y0 - 16);
+    int l1 = 298 * (y1 - 16);
+
+    uint32_t pix0 = pack_rgb565(clamp_u8((l0 + rv) >> 8), clamp_u8((l0 + guv) >> 8), clamp_u8((l0 + bu) >> 8));
+    uint32_t pix1 = pack_rgb565(clamp_u8((l1 + rv) >> 8), clamp_u8((l1 + guv) >> 8), clamp_u8((l1 + bu) >> 8));
+    return pix0 | (pix1 << 16);
+}
+
+static inline void rgb565_to_rgb24_pixel(uint32_t c, uint8_t *d) {
+    d[0] = (uint8_t)expand_5_to_8((c >> 11) & 0x1F);
+    d[1] = (uint8_t)expand_6_to_8((c >> 5) & 0x3F);
+    d[2] = (uint8_t)expand_5_to_8(c & 0x1F);
+}
+
+void pixel_swap16(const uint8_t *src, size_t src_stride, uint8_t *dst, size_t dst_stride,
+                  uint16_t width, uint16_t height) {
+    for (int y = 0; y < height; y++) {
+        const uint8_t *s = src + (size_t)y * src_stride;
+        uint8_t *d = dst + (size_t)y * dst_stride;
+        int x = 0;
+        if (is_aligned4(s, d)) {
+            const uint32_t *s32 = (const uint32_t *)s;
+            uint32_t *d32 = (uint32_t *)d;
+            for (; x + 1 < width; x += 2) {
+                uint32_t v = *s32++;
+                *d32++ = ((v & 0x00FF00FFu) << 8) | ((v >> 8) & 0x00FF00FFu);
+            }
+        }
+        for (; x < width; x++) {
+            uint8_t lo = s[x * 2];
+            d[x * 2] = s[x * 2 + 1];
+            d[x * 2 + 1] = lo;
+        }
+    }
+}
+
+void pixel_yuyv_to_rgb565(const uint8_t *src, size_t src_stride, uint8_t *dst, size_t dst_stride,
+                          uint16_t width, uint16_t height) {
+    for (int y = 0; y < height; y++) {
+        const uint8_t *s = src + (size_t)y * src_stride;
+        uint8_t *d = dst + (size_t)y * dst_stride;
+        if (is_aligned4(s, d)) {
+            // 小端下一个字为 Y0 | U << 8 | Y1 << 16 | V << 24
+            const uint32_t *s32 = (const uint32_t *)s;
+            uint32_t *d32 = (uint32_t *)d;
+            for (int x = 0; x + 1 < width; x += 2) {
+                uint32_t v = *s32++;
+                *d32++ = yuyv_pair_to_rgb565(v & 0xFF, (v >> 8) & 0xFF, (v >> 16) & 0xFF, v >> 24);
+            }
+        } else {
+            for (int x = 0; x + 1 < width; x += 2) {
+                uint32_t pix = yuyv_pair_to_rgb565(s[0], s[1], s[2], s[3]);
+                d[0] = (uint8_t)pix;
+                d[1] = (uint8_t)(pix >> 8);
+                d[2] = (uint8_t)(pix >> 16);
+                d[3] = (uint8_t)(pix >> 24);
+                s += 4;
+                d += 4;
+            }
+        }
+    }
+}
+
+void pixel_rgb24_to_rgb565(const uint8_t *src, size_t src_stride, uint8_t *dst, size_t dst_stride,
+                           uint16_t width, uint16_t height) {
+    for (int y = 0; y < height; y++) {
+        const uint8_t *s = src + (size_t)y * src_stride;
+        uint8_t *d = dst + (size_t)y * dst_stride;
+        int x = 0;
+        if (is_aligned4(s, d)) {
+            // 四个像素 R0 G0 B0 R1 | G1 B1 R2 G2 | B2 R3 G3 B3 对应三个字
+            const uint32_t *s32 = (const uint32_t *)s;
+            uint32_t *d32 = (uint32_t *)d;
+            for (; x + 3 < width; x += 4) {
+                uint32_t w0 = s32[0];
+                uint32_t w1 = s32[1];
+                uint32_t w2 = s32[2];
+                s32 += 3;
+                uint32_t p0 = pack_rgb565(w0 & 0xFF, (w0 >> 8) & 0xFF, (w0 >> 16) & 0xFF);
+                uint32_t p1 = pack_rgb565(w0 >> 24, w1 & 0xFF, (w1 >> 8) & 0xFF);
+                uint32_t p2 = pack_rgb565((w1 >> 16) & 0xFF, w1 >> 24, w2 & 0xFF);
+                uint32_t p3 = pack_rgb565((w2 >> 8) & 0xFF, (w2 >> 16) & 0xFF, w2 >> 24);
+                d32[0] = p0 | (p1 << 16);
+                d32[1] = p2 | (p3 << 16);
+                d32 += 2;
+            }
+        }
+        for (; x < width; x++) {
+            uint32_t pix = pack_rgb565(s[x * 3], s[x * 3 + 1], s[x * 3 + 2]);
+            d[x * 2] = (uint8_t)pix;
+            d[x * 2 + 1] = (uint8_t)(pix >> 8);
+        }
+    }
+}
+
+void pixel_rgb565_to_rgb24(const uint8_t *src, size_t src_stride, uint8_t *dst, size_t dst_stride,
+                           uint16_t width, uint16_t height) {
+    for (int y = 0; y < height; y++) {
+        const uint8_t *s = src + (size_t)y * src_stride;
+        uint8_t *d = dst + (size_t)y * dst_stride;
+        int x = 0;
+        if (is_aligned4(s, d)) {
+            const uint32_t *s32 = (const uint32_t *)s;
+            uint32_t *d32 = (uint32_t *)d;
+            for (; x + 3 < width; x += 4) {
+                uint8_t px[12];
+                uint32_t a = s32[0];
+                uint32_t b = s32[1];
+                s32 += 2;
+                rgb565_to_rgb24_pixel(a & 0xFFFF, px);
+                rgb565_to_rgb24_pixel(a >> 16, px + 3);
+                rgb565_to_rgb24_pixel(b & 0xFFFF, px + 6);
+                rgb565_to_rgb24_pixel(b >> 16, px + 9);
+                // 在寄存器中拼成三个字写出
+                d32[0] = px[0] | (px[1] << 8) | (px[2] << 16) | ((uint32_t)px[3] << 24);
+                d32[1] = px[4] | (px[5] << 8) | (px[6] << 16) | ((uint32_t)px[7] << 24);
+                d32[2] = px[8] | (px[9] << 8) | (px[10] << 16) | ((uint32_t)px[11] << 24);
+                d32 += 3;
+            }
+        }
+        for (; x < width; x++) {
+            rgb565_to_rgb24_pixel(s[x * 2] | (s[x * 2 + 1] << 8), d + x * 3);
+        }
+    }
+}
+
+void pixel_yuv422p_to_yuyv(const uint8_t *src, uint8_t *dst, size_t dst_stride, uint16_t width, uint16_t height) {
+    const uint8_t *y_plane = src;
+    const uint8_t *u_plane = y_plane + (size_t)width * height;
+    const uint8_t *v_plane = u_plane + (size_t)(width / 2) * height;
+    for (int y = 0; y < height; y++) {
+        const uint8_t *y_row = y_plane + (size_t)y * width;
+        const uint8_t *u_row = u_plane + (size_t)y * (width / 2);
+        const uint8_t *v_row = v_plane + (size_t)y * (width / 2);
+        uint8_t *d = dst + (size_t)y * dst_stride;
+        if (is_aligned4(d, d)) {
+            uint32_t *d32 = (uint32_t *)d;
+            for (int x = 0; x + 1 < width; x += 2) {
+                *d32++ = y_row[x] | (u_row[x / 2] << 8) | (y_row[x + 1] << 16) | ((uint32_t)v_row[x / 2] << 24);
+            }
+        } else {
+            for (int x = 0; x + 1 < width; x += 2) {
+                d[0] = y_row[x];
+                d[1] = u_row[x / 2];
+                d[2] = y_row[x + 1];
+                d[3] = v_row[x / 2];
+                d += 4;
+            }
+        }
+    }
+}
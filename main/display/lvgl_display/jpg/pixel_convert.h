@@ -0,0 +1,41 @@
+// pixel_convert.h - 摄像头预览与JPEG编码共用的像素格式转换
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * 所有函数逐行处理 width x height 个像素，源和目标各有自己的行跨度（stride，字节），
+ * 因此可以直接处理带行填充的缓冲区，或者把 src 指向裁剪区域的左上角来裁剪图像。
+ * 目标缓冲区由调用者提供，可在多次转换之间复用。
+ *
+ * 行首按4字节对齐时按32位字处理（每次两个16位像素），否则退回逐字节处理，结果相同。
+ * RGB565 均为本机字节序（小端）。YUYV 为 Y0 U Y1 V，起点和宽度需为偶数。
+ */
+
+// 交换每个16位像素的高低字节：大端RGB565与小端互转，UYVY与YUYV互转。src与dst可以相同
+void pixel_swap16(const uint8_t *src, size_t src_stride, uint8_t *dst, size_t dst_stride,
+                  uint16_t width, uint16_t height);
+
+// YUYV (BT.601, 有限范围) 转 RGB565
+void pixel_yuyv_to_rgb565(const uint8_t *src, size_t src_stride, uint8_t *dst, size_t dst_stride,
+                          uint16_t width, uint16_t height);
+
+// RGB24 (R G B) 转 RGB565，截断低位
+void pixel_rgb24_to_rgb565(const uint8_t *src, size_t src_stride, uint8_t *dst, size_t dst_stride,
+                           uint16_t width, uint16_t height);
+
+// RGB565 转 RGB24 (R G B)，低位按高位补齐
+void pixel_rgb565_to_rgb24(const uint8_t *src, size_t src_stride, uint8_t *dst, size_t dst_stride,
+                           uint16_t width, uint16_t height);
+
+// YUV422 平面格式 (Y平面, U平面, V平面，U/V 每行 width/2) 转 YUYV
+void pixel_yuv422p_to_yuyv(const uint8_t *src, uint8_t *dst, size_t dst_stride, uint16_t width, uint16_t height);
+
+#ifdef __cplusplus
+}
+#endif
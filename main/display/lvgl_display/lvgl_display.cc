@@ -3,18 +3,23 @@
 #include <string>
 #include <cstdlib>
 #include <cstring>
+#include <algorithm>
 #include <font_awesome.h>
 
 #include "lvgl_display.h"
 #include "board.h"
 #include "application.h"
 #include "audio_codec.h"
+#include "status_store.h"
 #include "settings.h"
 #include "assets/lang_config.h"
 #include "jpg/image_to_jpeg.h"
 
 #define TAG "Display"
 
+// Screen lines rendered at a time when taking a snapshot
+#define SNAPSHOT_STRIP_LINES 64
+
 LvglDisplay::LvglDisplay() {
     // Notification timer
     esp_timer_create_args_t notification_timer_args = {
@@ -31,6 +36,11 @@ LvglDisplay::LvglDisplay() {
     };
     ESP_ERROR_CHECK(esp_timer_create(&notification_timer_args, &notification_timer_));
 
+    // Redraw the status bar icons when the published values change
+    StatusStore::GetInstance().RegisterChangeCallback([this](uint32_t fields) {
+        OnStatusChanged(fields);
+    });
+
     // Create a power management lock
     auto ret = esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, "display_update", &pm_lock_);
     if (ret == ESP_ERR_NOT_SUPPORTED) {
@@ -98,26 +108,14 @@ void LvglDisplay::ShowNotification(const char* notification, int duration_ms) {
     ESP_ERROR_CHECK(esp_timer_start_once(notification_timer_, duration_ms * 1000));
 }
 
+// Only the clock is polled, the icons are redrawn by OnStatusChanged when their values change
 void LvglDisplay::UpdateStatusBar(bool update_all) {
     auto& app = Application::GetInstance();
-    auto& board = Board::GetInstance();
-    auto codec = board.GetAudioCodec();
-
-    // Update mute icon
-    {
-        DisplayLockGuard lock(this);
-        if (mute_label_ == nullptr) {
-            return;
-        }
 
-        // 如果静音状态改变，则更新图标
-        if (codec->output_volume() == 0 && !muted_) {
-            muted_ = true;
-            lv_label_set_text(mute_label_, FONT_AWESOME_VOLUME_XMARK);
-        } else if (codec->output_volume() > 0 && muted_) {
-            muted_ = false;
-            lv_label_set_text(mute_label_, "");
-        }
+    if (update_all) {
+        auto& status = StatusStore::GetInstance();
+        status.Refresh();
+        OnStatusChanged(kStatusFieldAll);
     }
 
     // Update time
@@ -136,14 +134,34 @@ void LvglDisplay::UpdateStatusBar(bool update_all) {
             }
         }
     }
+}
+
+void LvglDisplay::OnStatusChanged(uint32_t fields) {
+    auto& status = StatusStore::GetInstance();
+    if (mute_label_ == nullptr) {
+        return;
+    }
 
     esp_pm_lock_acquire(pm_lock_);
+    DisplayLockGuard lock(this);
+
+    // 如果静音状态改变，则更新图标
+    if (fields & kStatusFieldVolume) {
+        int volume = status.GetOutputVolume();
+        if (volume == 0 && !muted_) {
+            muted_ = true;
+            lv_label_set_text(mute_label_, FONT_AWESOME_VOLUME_XMARK);
+        } else if (volume > 0 && muted_) {
+            muted_ = false;
+            lv_label_set_text(mute_label_, "");
+        }
+    }
+
     // 更新电池图标
-    int battery_level;
-    bool charging, discharging;
-    const char* icon = nullptr;
-    if (board.GetBatteryLevel(battery_level, charging, discharging)) {
-        if (charging) {
+    auto battery = status.GetBattery();
+    if ((fields & kStatusFieldBattery) && battery.level >= 0) {
+        const char* icon = nullptr;
+        if (battery.charging) {
             icon = FONT_AWESOME_BATTERY_BOLT;
         } else {
             const char* levels[] = {
@@ -154,19 +172,18 @@ void LvglDisplay::UpdateStatusBar(bool update_all) {
                 FONT_AWESOME_BATTERY_FULL, // 80-99%
                 FONT_AWESOME_BATTERY_FULL, // 100%
             };
-            icon = levels[battery_level / 20];
+            icon = levels[std::clamp(battery.level, 0, 100) / 20];
         }
-        DisplayLockGuard lock(this);
         if (battery_label_ != nullptr && battery_icon_ != icon) {
             battery_icon_ = icon;
             lv_label_set_text(battery_label_, battery_icon_);
         }
 
         if (low_battery_popup_ != nullptr) {
-            if (strcmp(icon, FONT_AWESOME_BATTERY_EMPTY) == 0 && discharging) {
+            if (strcmp(icon, FONT_AWESOME_BATTERY_EMPTY) == 0 && battery.discharging) {
                 if (lv_obj_has_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN)) { // 如果低电量提示框隐藏，则显示
                     lv_obj_remove_flag(low_battery_popup_, LV_OBJ_FLAG_HIDDEN);
-                    app.PlaySound(Lang::Sounds::OGG_LOW_BATTERY);
+                    Application::GetInstance().PlaySound(Lang::Sounds::OGG_LOW_BATTERY);
                 }
             } else {
                 // Hide the low battery popup when the battery is not empty
@@ -177,28 +194,13 @@ void LvglDisplay::UpdateStatusBar(bool update_all) {
         }
     }
 
-    // 每 10 秒更新一次网络图标
-    static int seconds_counter = 0;
-    if (update_all || seconds_counter++ % 10 == 0) {
-        // 升级固件时，不读取 4G 网络状态，避免占用 UART 资源
-        auto device_state = Application::GetInstance().GetDeviceState();
-        static const std::vector<DeviceState> allowed_states = {
-            kDeviceStateIdle,
-            kDeviceStateStarting,
-            kDeviceStateWifiConfiguring,
-            kDeviceStateListening,
-            kDeviceStateActivating,
-        };
-        if (std::find(allowed_states.begin(), allowed_states.end(), device_state) != allowed_states.end()) {
-            icon = board.GetNetworkStateIcon();
-            if (network_label_ != nullptr && icon != nullptr && network_icon_ != icon) {
-                DisplayLockGuard lock(this);
-                network_icon_ = icon;
-                lv_label_set_text(network_label_, network_icon_);
-            }
+    if (fields & kStatusFieldNetwork) {
+        const char* icon = status.GetNetworkIcon();
+        if (network_label_ != nullptr && icon != nullptr && network_icon_ != icon) {
+            network_icon_ = icon;
+            lv_label_set_text(network_label_, network_icon_);
         }
     }
-
     esp_pm_lock_release(pm_lock_);
 }
 
@@ -216,40 +218,129 @@ void LvglDisplay::SetPowerSaveMode(bool on) {
 }
 
 bool LvglDisplay::SnapshotToJpeg(std::string& jpeg_data, int quality) {
+    jpeg_data.clear();
+    return SnapshotToJpegStream([&jpeg_data](const void* data, size_t len) {
+        jpeg_data.append(static_cast<const char*>(data), len);
+        return true;
+    }, quality);
+}
+
 #if CONFIG_LV_USE_SNAPSHOT
-    DisplayLockGuard lock(this);
+/*
+ * lv_snapshot_take only draws whole objects. Drawing a strip of the screen needs the layer setup
+ * that lv_snapshot_take does internally (the private _clip_area and phy_clip_area fields) and the
+ * draw dispatch loop of lv_canvas_finish_layer. Both are checked against LVGL 9.3 only, other
+ * versions take the whole screen with the public API into one full size buffer instead.
+ */
+#if LVGL_VERSION_MAJOR == 9 && LVGL_VERSION_MINOR == 3
+#define SNAPSHOT_DRAW_STRIPS 1
+#else
+#define SNAPSHOT_DRAW_STRIPS 0
+#endif
+
+struct SnapshotStrip {
+    Display* display;
+    int32_t width;
+    int32_t height;
+    lv_draw_buf_t* buffer = nullptr;
+    int32_t first_line = -1;    // Screen line at the top of the buffer, -1 before the first strip
+    int32_t lines = 0;
+};
 
+#if SNAPSHOT_DRAW_STRIPS
+// Draws the lines of the screen the strip starts at into its buffer, the way lv_snapshot_take does for the whole screen
+static void RenderSnapshotStrip(SnapshotStrip* strip, int32_t first_line) {
+    // Locked per strip, so the encoded output in between can go to the network
+    DisplayLockGuard lock(strip->display);
     lv_obj_t* screen = lv_screen_active();
-    lv_draw_buf_t* draw_buffer = lv_snapshot_take(screen, LV_COLOR_FORMAT_RGB565);
-    if (draw_buffer == nullptr) {
-        ESP_LOGE(TAG, "Failed to take snapshot, draw_buffer is nullptr");
-        return false;
-    }
+    lv_area_t coords;
+    lv_obj_get_coords(screen, &coords);
 
-    // swap bytes
-    uint16_t* data = (uint16_t*)draw_buffer->data;
-    size_t pixel_count = draw_buffer->data_size / 2;
-    for (size_t i = 0; i < pixel_count; i++) {
-        data[i] = __builtin_bswap16(data[i]);
-    }
+    strip->first_line = first_line;
+    strip->lines = std::min<int32_t>(strip->buffer->header.h, strip->height - first_line);
+    lv_draw_buf_clear(strip->buffer, nullptr);
 
-    // 清空输出字符串并使用回调版本，避免预分配大内存块
-    jpeg_data.clear();
+    lv_area_t buffer_area = coords;
+    buffer_area.y1 = coords.y1 + first_line;
+    buffer_area.y2 = buffer_area.y1 + strip->buffer->header.h - 1;
+    lv_area_t clip_area = buffer_area;
+    clip_area.y2 = buffer_area.y1 + strip->lines - 1;
 
-    // 🚀 使用回调版本的JPEG编码器，进一步节省内存
-    bool ret = image_to_jpeg_cb((uint8_t*)draw_buffer->data, draw_buffer->data_size, draw_buffer->header.w, draw_buffer->header.h, V4L2_PIX_FMT_RGB565, quality,
-        [](void *arg, size_t index, const void *data, size_t len) -> size_t {
-        std::string* output = static_cast<std::string*>(arg);
-        if (data && len > 0) {
-            output->append(static_cast<const char*>(data), len);
+    lv_layer_t layer;
+    lv_layer_init(&layer);
+    layer.draw_buf = strip->buffer;
+    layer.color_format = LV_COLOR_FORMAT_RGB565;
+    layer.buf_area = buffer_area;
+    layer._clip_area = clip_area;
+    layer.phy_clip_area = clip_area;
+    lv_obj_redraw(&layer, screen);
+
+    // Same as lv_canvas_finish_layer: run the draw tasks of this layer until none are left
+    lv_display_t* display = lv_obj_get_display(screen);
+    while (layer.draw_task_head) {
+        lv_draw_dispatch_wait_for_request();
+        if (!lv_draw_dispatch_layer(display, &layer)) {
+            lv_draw_wait_for_finish();
+            lv_draw_dispatch_request();
         }
-        return len;
-    }, &jpeg_data);
-    if (!ret) {
-        ESP_LOGE(TAG, "Failed to convert image to JPEG");
     }
+}
+#endif
+#endif
 
-    lv_draw_buf_destroy(draw_buffer);
+bool LvglDisplay::SnapshotToJpegStream(const std::function<bool(const void* data, size_t len)>& write, int quality) {
+#if CONFIG_LV_USE_SNAPSHOT
+    SnapshotStrip strip;
+    strip.display = this;
+    {
+        DisplayLockGuard lock(this);
+        lv_obj_t* screen = lv_screen_active();
+        strip.width = lv_obj_get_width(screen);
+        strip.height = lv_obj_get_height(screen);
+#if SNAPSHOT_DRAW_STRIPS
+        strip.buffer = lv_draw_buf_create(strip.width, std::min<int32_t>(SNAPSHOT_STRIP_LINES, strip.height),
+            LV_COLOR_FORMAT_RGB565, LV_STRIDE_AUTO);
+#else
+        strip.buffer = lv_snapshot_take(screen, LV_COLOR_FORMAT_RGB565);
+        strip.first_line = 0;
+        strip.lines = strip.height;
+#endif
+    }
+    if (strip.buffer == nullptr) {
+        ESP_LOGE(TAG, "Failed to create snapshot buffer");
+        return false;
+    }
+
+    // The encoder asks for a few lines at a time, a new strip is drawn once they run past the current one
+    auto rows = [](void* arg, uint16_t y, uint16_t lines, size_t* stride) -> const uint8_t* {
+        auto strip = static_cast<SnapshotStrip*>(arg);
+#if SNAPSHOT_DRAW_STRIPS
+        if (strip->first_line < 0 || y < strip->first_line || y + lines > strip->first_line + strip->lines) {
+            RenderSnapshotStrip(strip, y);
+        }
+#endif
+        *stride = strip->buffer->header.stride;
+        return strip->buffer->data + (y - strip->first_line) * strip->buffer->header.stride;
+    };
+    auto output = [](void* arg, size_t index, const void* data, size_t len) -> size_t {
+        auto write = static_cast<const std::function<bool(const void*, size_t)>*>(arg);
+        if (data == nullptr || len == 0) {
+            return 0;
+        }
+        return (*write)(data, len) ? len : 0;
+    };
+
+    int32_t width = strip.width;
+    int32_t height = strip.height;
+    size_t encoder_size = 0;
+    bool ret = rgb565_rows_to_jpeg_cb(width, height, quality, rows, &strip, output, const_cast<void*>(static_cast<const void*>(&write)), &encoder_size);
+    if (ret) {
+        ESP_LOGI(TAG, "Snapshot %ldx%ld encoded with %u bytes of buffers, a full frame copy alone is %u bytes", width, height,
+            static_cast<unsigned>(strip.buffer->data_size + encoder_size), static_cast<unsigned>(width * height * 2));
+    } else {
+        ESP_LOGE(TAG, "Failed to convert snapshot to JPEG");
+    }
+    lv_draw_buf_destroy(strip.buffer);
     return ret;
 #else
     ESP_LOGE(TAG, "LV_USE_SNAPSHOT is not enabled");
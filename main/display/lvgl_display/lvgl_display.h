@@ -3,6 +3,7 @@
 
 #include "display.h"
 #include "lvgl_image.h"
+#include "lvgl_theme.h"
 
 #include <lvgl.h>
 #include <esp_timer.h>
@@ -11,6 +12,7 @@
 
 #include <string>
 #include <chrono>
+#include <functional>
 
 class LvglDisplay : public Display {
 public:
@@ -24,6 +26,10 @@ public:
     virtual void UpdateStatusBar(bool update_all = false);
     virtual void SetPowerSaveMode(bool on);
     virtual bool SnapshotToJpeg(std::string& jpeg_data, int quality = 80);
+    // Renders and encodes the screen a strip at a time, handing each piece of JPEG to write as it is produced.
+    // A full copy of the screen is never made. The display is only locked while a strip is drawn, so write
+    // may send the data over the network; the strips can come from frames a moment apart.
+    virtual bool SnapshotToJpegStream(const std::function<bool(const void* data, size_t len)>& write, int quality = 80);
 
 protected:
     esp_pm_lock_handle_t pm_lock_ = nullptr;
@@ -36,6 +42,8 @@ protected:
     lv_obj_t *battery_label_ = nullptr;
     lv_obj_t* low_battery_popup_ = nullptr;
     lv_obj_t* low_battery_label_ = nullptr;
+    // Filled from the current theme and attached to the objects above
+    LvglThemeStyles styles_;
     
     const char* battery_icon_ = nullptr;
     const char* network_icon_ = nullptr;
@@ -44,6 +52,8 @@ protected:
     std::chrono::system_clock::time_point last_status_update_time_;
     esp_timer_handle_t notification_timer_ = nullptr;
 
+    void OnStatusChanged(uint32_t fields);
+
     friend class DisplayLockGuard;
     virtual bool Lock(int timeout_ms = 0) = 0;
     virtual void Unlock() = 0;
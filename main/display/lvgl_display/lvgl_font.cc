@@ -1,13 +1,344 @@
 #include "lvgl_font.h"
+#include "json_writer.h"
+
 #include <cbin_font.h>
+#include <esp_log.h>
+#include <esp_heap_caps.h>
+#include <cstring>
+
+#define TAG "LvglFont"
+
+/*
+ * Least recently used table with a fixed number of slots. The slots, the hash buckets and the
+ * list links are a single PSRAM allocation, so thousands of glyphs do not turn into thousands of
+ * small internal RAM allocations.
+ */
+template <typename Value>
+class LruTable {
+public:
+    ~LruTable() {
+        heap_caps_free(slots_);
+    }
+
+    bool Init(uint16_t capacity) {
+        uint16_t bucket_count = 1;
+        while (bucket_count < capacity) {
+            bucket_count <<= 1;
+        }
+        slots_ = (Slot*)heap_caps_calloc(1, capacity * sizeof(Slot) + bucket_count * sizeof(uint16_t), MALLOC_CAP_SPIRAM);
+        if (slots_ == nullptr) {
+            return false;
+        }
+        buckets_ = reinterpret_cast<uint16_t*>(slots_ + capacity);
+        memset(buckets_, 0xFF, bucket_count * sizeof(uint16_t));
+        bucket_mask_ = bucket_count - 1;
+        for (uint16_t i = 0; i < capacity; i++) {
+            slots_[i].chain = i + 1 < capacity ? i + 1 : kNone;
+        }
+        free_ = 0;
+        return true;
+    }
+
+    Value* Find(uint64_t key) {
+        for (uint16_t i = buckets_[Bucket(key)]; i != kNone; i = slots_[i].chain) {
+            if (slots_[i].key == key) {
+                Unlink(i);
+                PushFront(i);
+                return &slots_[i].value;
+            }
+        }
+        return nullptr;
+    }
+
+    // Slot for a key that is not in the table, taken from the least recently used one when all are in use.
+    // evict gets the value that is about to be overwritten.
+    template <typename Evict>
+    Value* Insert(uint64_t key, Evict evict) {
+        if (free_ == kNone) {
+            EvictOldest(evict);
+        }
+        uint16_t i = free_;
+        free_ = slots_[i].chain;
+        slots_[i].key = key;
+        slots_[i].value = Value();
+        uint16_t& bucket = buckets_[Bucket(key)];
+        slots_[i].chain = bucket;
+        bucket = i;
+        PushFront(i);
+        return &slots_[i].value;
+    }
+
+    template <typename Evict>
+    bool EvictOldest(Evict evict) {
+        if (tail_ == kNone) {
+            return false;
+        }
+        uint16_t i = tail_;
+        evict(slots_[i].value);
+        Unlink(i);
+        for (uint16_t* link = &buckets_[Bucket(slots_[i].key)]; *link != kNone; link = &slots_[*link].chain) {
+            if (*link == i) {
+                *link = slots_[i].chain;
+                break;
+            }
+        }
+        slots_[i].chain = free_;
+        free_ = i;
+        return true;
+    }
+
+    template <typename Visit>
+    void ForEach(Visit visit) {
+        for (uint16_t i = head_; i != kNone; i = slots_[i].next) {
+            visit(slots_[i].value);
+        }
+    }
+
+private:
+    static constexpr uint16_t kNone = 0xFFFF;
+
+    struct Slot {
+        uint64_t key;
+        Value value;
+        uint16_t prev;
+        uint16_t next;
+        uint16_t chain;     // Next slot in the same bucket, or in the free list
+    };
+
+    uint16_t Bucket(uint64_t key) const {
+        uint32_t hash = static_cast<uint32_t>(key ^ (key >> 32)) * 2654435761u;
+        return (hash >> 16) & bucket_mask_;
+    }
+
+    void Unlink(uint16_t i) {
+        Slot& slot = slots_[i];
+        (slot.prev != kNone ? slots_[slot.prev].next : head_) = slot.next;
+        (slot.next != kNone ? slots_[slot.next].prev : tail_) = slot.prev;
+    }
+
+    void PushFront(uint16_t i) {
+        slots_[i].prev = kNone;
+        slots_[i].next = head_;
+        (head_ != kNone ? slots_[head_].prev : tail_) = i;
+        head_ = i;
+    }
 
+    Slot* slots_ = nullptr;
+    uint16_t* buckets_ = nullptr;
+    uint16_t bucket_mask_ = 0;
+    uint16_t head_ = kNone;     // Most recently used
+    uint16_t tail_ = kNone;
+    uint16_t free_ = kNone;
+};
 
-LvglCBinFont::LvglCBinFont(void* data) {
+struct CachedGlyph {
+    lv_font_glyph_dsc_t dsc;
+    bool found;
+};
+
+struct CachedBitmap {
+    uint8_t* data;
+    uint32_t size;
+    uint32_t stride;
+};
+
+class GlyphTable {
+public:
+    LruTable<CachedGlyph> glyphs;       // By character, and the next one when the font has kerning
+    LruTable<CachedBitmap> bitmaps;     // By glyph index
+    size_t bitmap_bytes = 0;
+    size_t bitmap_count = 0;
+
+    ~GlyphTable() {
+        bitmaps.ForEach([](CachedBitmap& bitmap) {
+            heap_caps_free(bitmap.data);
+        });
+    }
+};
+
+
+int32_t LvglFont::GetTextWidth(const char* text) {
+    return lv_txt_get_width(text, strlen(text), font(), 0);
+}
+
+LvglCBinFont::LvglCBinFont(void* data, bool glyph_cache) {
     font_ = cbin_font_create(static_cast<uint8_t*>(data));
+    if (font_ == nullptr || !glyph_cache || FONT_GLYPH_CACHE_BUDGET == 0) {
+        return;
+    }
+
+    if (font_->kerning == LV_FONT_KERNING_NONE) {
+        kerning_ = false;
+    } else if (font_->get_glyph_dsc == lv_font_get_glyph_dsc_fmt_txt) {
+        auto fdsc = static_cast<const lv_font_fmt_txt_dsc_t*>(font_->dsc);
+        kerning_ = fdsc->kern_dsc != nullptr;
+    }
+
+    glyph_table_ = new GlyphTable();
+    if (!glyph_table_->glyphs.Init(FONT_GLYPH_CACHE_SLOTS) || !glyph_table_->bitmaps.Init(FONT_GLYPH_CACHE_SLOTS)) {
+        ESP_LOGW(TAG, "Failed to allocate the glyph cache");
+        delete glyph_table_;
+        glyph_table_ = nullptr;
+        return;
+    }
+
+    // The glyph lookups of the copy come back here, user_data finds this object again
+    cached_font_ = *font_;
+    cached_font_.get_glyph_dsc = GetGlyphDsc;
+    cached_font_.get_glyph_bitmap = GetGlyphBitmap;
+    cached_font_.release_glyph = font_->release_glyph != nullptr ? ReleaseGlyph : nullptr;
+    cached_font_.user_data = this;
 }
 
 LvglCBinFont::~LvglCBinFont() {
+    delete glyph_table_;
     if (font_ != nullptr) {
         cbin_font_delete(font_);
     }
-}
\ No newline at end of file
+}
+
+bool LvglCBinFont::GetGlyphDsc(const lv_font_t* font, lv_font_glyph_dsc_t* dsc, uint32_t letter, uint32_t letter_next) {
+    auto self = static_cast<LvglCBinFont*>(font->user_data);
+    uint64_t key = letter;
+    if (self->kerning_) {
+        key |= static_cast<uint64_t>(letter_next) << 32;
+    }
+
+    std::lock_guard<std::mutex> lock(self->mutex_);
+    auto cached = self->glyph_table_->glyphs.Find(key);
+    if (cached != nullptr) {
+        self->stats_.glyph_hits++;
+        *dsc = cached->dsc;
+        return cached->found;
+    }
+    self->stats_.glyph_misses++;
+
+    bool found = self->font_->get_glyph_dsc(self->font_, dsc, letter, letter_next);
+    // Glyphs that hold an entry of the font's own cache are looked up every time
+    if (dsc->entry == nullptr) {
+        cached = self->glyph_table_->glyphs.Insert(key, [](CachedGlyph&) {});
+        cached->dsc = *dsc;
+        cached->found = found;
+    }
+    return found;
+}
+
+const void* LvglCBinFont::GetGlyphBitmap(lv_font_glyph_dsc_t* dsc, lv_draw_buf_t* draw_buf) {
+    const lv_font_t* font = dsc->resolved_font;
+    auto self = static_cast<LvglCBinFont*>(font->user_data);
+
+    // The original font renders from its own descriptor
+    auto render = [self, font, dsc, draw_buf]() {
+        dsc->resolved_font = self->font_;
+        const void* result = self->font_->get_glyph_bitmap(dsc, draw_buf);
+        dsc->resolved_font = font;
+        return result;
+    };
+    if (dsc->req_raw_bitmap || draw_buf == nullptr) {
+        return render();
+    }
+
+    auto table = self->glyph_table_;
+    std::lock_guard<std::mutex> lock(self->mutex_);
+    auto cached = table->bitmaps.Find(dsc->gid.index);
+    if (cached != nullptr && cached->stride == draw_buf->header.stride && cached->size <= draw_buf->data_size) {
+        self->stats_.bitmap_hits++;
+        memcpy(draw_buf->data, cached->data, cached->size);
+        return draw_buf;
+    }
+    self->stats_.bitmap_misses++;
+
+    const void* result = render();
+    // Only glyphs rendered into the draw buffer can be copied back later
+    uint32_t size = draw_buf->header.stride * dsc->box_h;
+    if (result != draw_buf || cached != nullptr || size == 0 || size > FONT_GLYPH_CACHE_BUDGET / 16) {
+        return result;
+    }
+
+    auto evict = [self, table](CachedBitmap& bitmap) {
+        heap_caps_free(bitmap.data);
+        table->bitmap_bytes -= bitmap.size;
+        table->bitmap_count--;
+        self->stats_.bitmap_evictions++;
+    };
+    while (table->bitmap_bytes + size > FONT_GLYPH_CACHE_BUDGET && table->bitmaps.EvictOldest(evict)) {
+    }
+    uint8_t* data = (uint8_t*)heap_caps_malloc(size, MALLOC_CAP_SPIRAM);
+    if (data == nullptr) {
+        return result;
+    }
+    memcpy(data, draw_buf->data, size);
+    cached = table->bitmaps.Insert(dsc->gid.index, evict);
+    cached->data = data;
+    cached->size = size;
+    cached->stride = draw_buf->header.stride;
+    table->bitmap_bytes += size;
+    table->bitmap_count++;
+    return result;
+}
+
+void LvglCBinFont::ReleaseGlyph(const lv_font_t* font, lv_font_glyph_dsc_t* dsc) {
+    auto self = static_cast<LvglCBinFont*>(font->user_data);
+    dsc->resolved_font = self->font_;
+    self->font_->release_glyph(self->font_, dsc);
+    dsc->resolved_font = font;
+}
+
+int32_t LvglCBinFont::GetTextWidth(const char* text) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto it = text_widths_.begin(); it != text_widths_.end(); ++it) {
+            if (it->first == text) {
+                stats_.text_width_hits++;
+                text_widths_.splice(text_widths_.begin(), text_widths_, it);
+                return it->second;
+            }
+        }
+        stats_.text_width_misses++;
+    }
+
+    // Measured without the lock, the glyph lookups take it
+    int32_t width = LvglFont::GetTextWidth(text);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    text_widths_.emplace_front(text, width);
+    if (text_widths_.size() > FONT_TEXT_WIDTH_CACHE_SIZE) {
+        text_widths_.pop_back();
+    }
+    return width;
+}
+
+LvglFontCacheStats LvglCBinFont::GetCacheStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    LvglFontCacheStats stats = stats_;
+    if (glyph_table_ != nullptr) {
+        stats.bitmap_bytes = glyph_table_->bitmap_bytes;
+        stats.bitmap_count = glyph_table_->bitmap_count;
+    }
+    return stats;
+}
+
+std::string LvglCBinFont::GetCacheStatsJson() {
+    auto stats = GetCacheStats();
+    auto hit_rate = [](uint32_t hits, uint32_t misses) {
+        return hits + misses > 0 ? static_cast<float>(hits) / (hits + misses) : 0.0f;
+    };
+    JsonWriter json;
+    json.BeginObject();
+    json.Member("glyph_cache", glyph_table_ != nullptr);
+    json.Member("glyph_hit_rate", hit_rate(stats.glyph_hits, stats.glyph_misses));
+    json.Member("glyph_hits", stats.glyph_hits);
+    json.Member("glyph_misses", stats.glyph_misses);
+    json.Member("bitmap_hit_rate", hit_rate(stats.bitmap_hits, stats.bitmap_misses));
+    json.Member("bitmap_hits", stats.bitmap_hits);
+    json.Member("bitmap_misses", stats.bitmap_misses);
+    json.Member("bitmap_evictions", stats.bitmap_evictions);
+    json.Member("bitmap_count", stats.bitmap_count);
+    json.Member("bitmap_bytes", stats.bitmap_bytes);
+    json.Member("bitmap_budget", FONT_GLYPH_CACHE_BUDGET);
+    json.Member("text_width_hit_rate", hit_rate(stats.text_width_hits, stats.text_width_misses));
+    json.Member("text_width_hits", stats.text_width_hits);
+    json.Member("text_width_misses", stats.text_width_misses);
+    json.EndObject();
+    return json.Release();
+}
@@ -2,11 +2,29 @@
 
 #include <lvgl.h>
 
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+
+#if CONFIG_SPIRAM
+// PSRAM kept for rendered glyph bitmaps of a font loaded from the assets
+#define FONT_GLYPH_CACHE_BUDGET (256 * 1024)
+#define FONT_GLYPH_CACHE_SLOTS 2048
+#else
+#define FONT_GLYPH_CACHE_BUDGET 0
+#define FONT_GLYPH_CACHE_SLOTS 0
+#endif
+// Strings whose width is remembered per font
+#define FONT_TEXT_WIDTH_CACHE_SIZE 32
 
 class LvglFont {
 public:
     virtual const lv_font_t* font() const = 0;
     virtual ~LvglFont() = default;
+
+    // Width of a single line of text in this font
+    virtual int32_t GetTextWidth(const char* text);
 };
 
 // Built-in font
@@ -20,12 +38,50 @@ private:
 };
 
 
+struct LvglFontCacheStats {
+    uint32_t glyph_hits = 0;        // Glyph descriptions found in the cache
+    uint32_t glyph_misses = 0;
+    uint32_t bitmap_hits = 0;       // Glyph bitmaps copied from the cache instead of rendered from flash
+    uint32_t bitmap_misses = 0;
+    uint32_t bitmap_evictions = 0;
+    uint32_t text_width_hits = 0;   // Repeated strings measured from the cache
+    uint32_t text_width_misses = 0;
+    size_t bitmap_bytes = 0;
+    size_t bitmap_count = 0;
+};
+
+class GlyphTable;
+
+/*
+ * A font in the LVGL binary format, mapped from the assets partition.
+ *
+ * Large CJK fonts look up and render every glyph from flash each time a label is drawn. Unless
+ * disabled, font() returns a copy of the font whose glyph lookups go through caches in PSRAM:
+ * the glyph descriptions by character, and the rendered A8 bitmaps by glyph up to a byte budget.
+ * Both drop the least recently used glyphs first. GetTextWidth() remembers the widths of the last
+ * measured strings, which are mostly the same status texts over and over.
+ */
 class LvglCBinFont : public LvglFont {
 public:
-    LvglCBinFont(void* data);
+    LvglCBinFont(void* data, bool glyph_cache = true);
     virtual ~LvglCBinFont();
-    virtual const lv_font_t* font() const override { return font_; }
+    virtual const lv_font_t* font() const override { return glyph_table_ != nullptr ? &cached_font_ : font_; }
+    virtual int32_t GetTextWidth(const char* text) override;
+
+    LvglFontCacheStats GetCacheStats();
+    std::string GetCacheStatsJson();
 
 private:
+    static bool GetGlyphDsc(const lv_font_t* font, lv_font_glyph_dsc_t* dsc, uint32_t letter, uint32_t letter_next);
+    static const void* GetGlyphBitmap(lv_font_glyph_dsc_t* dsc, lv_draw_buf_t* draw_buf);
+    static void ReleaseGlyph(const lv_font_t* font, lv_font_glyph_dsc_t* dsc);
+
     lv_font_t* font_;
+    lv_font_t cached_font_ = {};
+    bool kerning_ = true;           // Glyph descriptions depend on the next character too
+
+    std::mutex mutex_;
+    GlyphTable* glyph_table_ = nullptr;
+    std::list<std::pair<std::string, int32_t>> text_widths_;   // Most recently used first
+    LvglFontCacheStats stats_;
 };
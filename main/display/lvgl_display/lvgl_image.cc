@@ -24,6 +24,29 @@ bool LvglRawImage::IsGif() const {
     return ptr[0] == 'G' && ptr[1] == 'I' && ptr[2] == 'F';
 }
 
+const LvglRawImage* LvglLazyImage::Load() const {
+    if (image_ == nullptr) {
+        void* data = nullptr;
+        size_t size = 0;
+        if (!loader_(data, size)) {
+            ESP_LOGE(TAG, "Failed to load image data");
+            return nullptr;
+        }
+        image_ = std::make_unique<LvglRawImage>(data, size);
+    }
+    return image_.get();
+}
+
+const lv_img_dsc_t* LvglLazyImage::image_dsc() const {
+    auto image = Load();
+    return image != nullptr ? image->image_dsc() : nullptr;
+}
+
+bool LvglLazyImage::IsGif() const {
+    auto image = Load();
+    return image != nullptr && image->IsGif();
+}
+
 LvglCBinImage::LvglCBinImage(void* data) {
     image_dsc_ = cbin_img_dsc_create(static_cast<uint8_t*>(data));
 }
@@ -1,6 +1,8 @@
 #pragma once
 
 #include <lvgl.h>
+#include <functional>
+#include <memory>
 
 
 // Wrap around lv_img_dsc_t
@@ -22,6 +24,20 @@ private:
     lv_img_dsc_t image_dsc_;
 };
 
+// Get the data on first use, for images that have to be decompressed before they can be shown
+class LvglLazyImage : public LvglImage {
+public:
+    LvglLazyImage(std::function<bool(void*& data, size_t& size)> loader) : loader_(loader) {}
+    virtual const lv_img_dsc_t* image_dsc() const override;
+    virtual bool IsGif() const override;
+
+private:
+    std::function<bool(void*& data, size_t& size)> loader_;
+    mutable std::unique_ptr<LvglRawImage> image_;
+
+    const LvglRawImage* Load() const;
+};
+
 class LvglCBinImage : public LvglImage {
 public:
     LvglCBinImage(void* data);
@@ -14,6 +14,101 @@ lv_color_t LvglTheme::ParseColor(const std::string& color) {
     return lv_color_black();
 }
 
+LvglThemeStyles::LvglThemeStyles() {
+    for (auto& style : styles_) {
+        lv_style_init(&style);
+    }
+
+    // Properties that do not depend on the theme are set once
+    lv_style_set_radius(&styles_[kLvglStylePlain], 0);
+    lv_style_set_pad_all(&styles_[kLvglStylePlain], 0);
+    lv_style_set_border_width(&styles_[kLvglStylePlain], 0);
+
+    lv_style_set_radius(&styles_[kLvglStyleStatusBar], 0);
+    lv_style_set_border_width(&styles_[kLvglStyleStatusBar], 0);
+    lv_style_set_pad_column(&styles_[kLvglStyleStatusBar], 0);
+
+    lv_style_set_text_color(&styles_[kLvglStylePopupText], lv_color_white());
+
+    auto chat_row = &styles_[kLvglStyleChatRow];
+    lv_style_set_width(chat_row, lv_pct(100));
+    lv_style_set_height(chat_row, LV_SIZE_CONTENT);
+    lv_style_set_bg_opa(chat_row, LV_OPA_TRANSP);
+    lv_style_set_border_width(chat_row, 0);
+    lv_style_set_pad_all(chat_row, 0);
+    lv_style_set_layout(chat_row, LV_LAYOUT_FLEX);
+    lv_style_set_flex_flow(chat_row, LV_FLEX_FLOW_ROW);
+
+    auto chat_bubble = &styles_[kLvglStyleChatBubble];
+    lv_style_set_radius(chat_bubble, 8);
+    lv_style_set_border_width(chat_bubble, 0);
+    lv_style_set_bg_opa(chat_bubble, LV_OPA_70);
+    lv_style_set_width(chat_bubble, LV_SIZE_CONTENT);
+    lv_style_set_height(chat_bubble, LV_SIZE_CONTENT);
+
+    // User messages are right-aligned, assistant messages left-aligned and system messages centered
+    lv_style_set_flex_main_place(&styles_[kLvglStyleUserRow], LV_FLEX_ALIGN_END);
+    lv_style_set_pad_right(&styles_[kLvglStyleUserRow], 25);
+    lv_style_set_flex_main_place(&styles_[kLvglStyleAssistantRow], LV_FLEX_ALIGN_START);
+    lv_style_set_flex_main_place(&styles_[kLvglStyleSystemRow], LV_FLEX_ALIGN_CENTER);
+}
+
+LvglThemeStyles::~LvglThemeStyles() {
+    for (auto& style : styles_) {
+        lv_style_reset(&style);
+    }
+}
+
+void LvglThemeStyles::Attach(lv_obj_t* obj, std::initializer_list<LvglStyleRole> roles) {
+    for (auto role : roles) {
+        lv_obj_add_style(obj, &styles_[role], 0);
+    }
+}
+
+void LvglThemeStyles::Apply(LvglTheme* theme) {
+    auto text_font = theme->text_font()->font();
+    // Large text fonts get the large icons, so the status bar icons match the text
+    auto icon_font = text_font->line_height >= 40 ? theme->large_icon_font()->font() : theme->icon_font()->font();
+
+    lv_style_set_bg_color(&styles_[kLvglStyleBackground], theme->background_color());
+    lv_style_set_border_color(&styles_[kLvglStyleBackground], theme->border_color());
+    if (theme->background_image() != nullptr) {
+        lv_style_set_bg_image_src(&styles_[kLvglStyleBackground], theme->background_image()->image_dsc());
+    } else {
+        lv_style_set_bg_image_src(&styles_[kLvglStyleBackground], nullptr);
+    }
+    lv_style_set_bg_color(&styles_[kLvglStyleChatBackground], theme->chat_background_color());
+
+    auto status_bar = &styles_[kLvglStyleStatusBar];
+    lv_style_set_bg_color(status_bar, theme->background_color());
+    lv_style_set_text_color(status_bar, theme->text_color());
+    lv_style_set_pad_top(status_bar, theme->spacing(2));
+    lv_style_set_pad_bottom(status_bar, theme->spacing(2));
+    lv_style_set_pad_left(status_bar, theme->spacing(4));
+    lv_style_set_pad_right(status_bar, theme->spacing(4));
+
+    lv_style_set_text_color(&styles_[kLvglStyleText], theme->text_color());
+    lv_style_set_text_color(&styles_[kLvglStyleIcon], theme->text_color());
+    lv_style_set_text_font(&styles_[kLvglStyleIcon], icon_font);
+    lv_style_set_text_color(&styles_[kLvglStyleLargeIcon], theme->text_color());
+    lv_style_set_text_font(&styles_[kLvglStyleLargeIcon], theme->large_icon_font()->font());
+
+    lv_style_set_bg_color(&styles_[kLvglStylePopup], theme->low_battery_color());
+    lv_style_set_radius(&styles_[kLvglStylePopup], theme->spacing(4));
+
+    lv_style_set_pad_all(&styles_[kLvglStyleChatBubble], theme->spacing(4));
+    lv_style_set_border_color(&styles_[kLvglStyleChatBubble], theme->border_color());
+    lv_style_set_bg_color(&styles_[kLvglStyleUserBubble], theme->user_bubble_color());
+    lv_style_set_bg_color(&styles_[kLvglStyleAssistantBubble], theme->assistant_bubble_color());
+    lv_style_set_bg_color(&styles_[kLvglStyleSystemBubble], theme->system_bubble_color());
+    lv_style_set_text_color(&styles_[kLvglStyleUserText], theme->text_color());
+    lv_style_set_text_color(&styles_[kLvglStyleAssistantText], theme->text_color());
+    lv_style_set_text_color(&styles_[kLvglStyleSystemText], theme->system_text_color());
+
+    // One refresh for every object that uses any of the styles
+    lv_obj_report_style_change(nullptr);
+}
+
 LvglThemeManager::LvglThemeManager() {
 }
 
@@ -9,6 +9,7 @@
 #include <memory>
 #include <map>
 #include <string>
+#include <initializer_list>
 
 
 class LvglTheme : public Theme {
@@ -76,6 +77,51 @@ private:
 };
 
 
+enum LvglStyleRole {
+    kLvglStylePlain,            // No padding, border or radius, for layout containers
+    kLvglStyleBackground,
+    kLvglStyleChatBackground,
+    kLvglStyleStatusBar,
+    kLvglStyleText,
+    kLvglStyleIcon,
+    kLvglStyleLargeIcon,
+    kLvglStylePopup,
+    kLvglStylePopupText,
+    kLvglStyleChatRow,
+    kLvglStyleChatBubble,
+    // One per chat role, in the order user, assistant, system
+    kLvglStyleUserRow,
+    kLvglStyleAssistantRow,
+    kLvglStyleSystemRow,
+    kLvglStyleUserBubble,
+    kLvglStyleAssistantBubble,
+    kLvglStyleSystemBubble,
+    kLvglStyleUserText,
+    kLvglStyleAssistantText,
+    kLvglStyleSystemText,
+    kLvglStyleCount,
+};
+
+/*
+ * Prebuilt styles filled from a theme. Objects get the style of their role attached once
+ * with lv_obj_add_style() instead of local style properties, so they carry no style data
+ * of their own, and switching themes is one Apply() instead of restyling every object.
+ */
+class LvglThemeStyles {
+public:
+    LvglThemeStyles();
+    ~LvglThemeStyles();
+
+    inline lv_style_t* get(LvglStyleRole role) { return &styles_[role]; }
+    // Added after the default theme styles of the object, so the role styles take precedence
+    void Attach(lv_obj_t* obj, std::initializer_list<LvglStyleRole> roles);
+    void Apply(LvglTheme* theme);
+
+private:
+    lv_style_t styles_[kLvglStyleCount];
+};
+
+
 class LvglThemeManager {
 public:
     static LvglThemeManager& GetInstance() {
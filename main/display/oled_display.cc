@@ -159,9 +159,7 @@ void OledDisplay::SetupUI_128x64() {
     /* Status bar */
     status_bar_ = lv_obj_create(container_);
     lv_obj_set_size(status_bar_, LV_HOR_RES, 16);
-    lv_obj_set_style_border_width(status_bar_, 0, 0);
-    lv_obj_set_style_pad_all(status_bar_, 0, 0);
-    lv_obj_set_style_radius(status_bar_, 0, 0);
+    styles_.Attach(status_bar_, {kLvglStylePlain});
 
     /* Content */
     content_ = lv_obj_create(container_);
@@ -210,8 +208,6 @@ void OledDisplay::SetupUI_128x64() {
 
     /* Status bar */
     lv_obj_set_flex_flow(status_bar_, LV_FLEX_FLOW_ROW);
-    lv_obj_set_style_pad_all(status_bar_, 0, 0);
-    lv_obj_set_style_border_width(status_bar_, 0, 0);
     lv_obj_set_style_pad_column(status_bar_, 0, 0);
 
     network_label_ = lv_label_create(status_bar_);
@@ -272,9 +268,7 @@ void OledDisplay::SetupUI_128x32() {
     /* Emotion label on the left side */
     content_ = lv_obj_create(container_);
     lv_obj_set_size(content_, 32, 32);
-    lv_obj_set_style_pad_all(content_, 0, 0);
-    lv_obj_set_style_border_width(content_, 0, 0);
-    lv_obj_set_style_radius(content_, 0, 0);
+    styles_.Attach(content_, {kLvglStylePlain});
 
     emotion_label_ = lv_label_create(content_);
     lv_obj_set_style_text_font(emotion_label_, large_icon_font, 0);
@@ -285,18 +279,14 @@ void OledDisplay::SetupUI_128x32() {
     side_bar_ = lv_obj_create(container_);
     lv_obj_set_size(side_bar_, width_ - 32, 32);
     lv_obj_set_flex_flow(side_bar_, LV_FLEX_FLOW_COLUMN);
-    lv_obj_set_style_pad_all(side_bar_, 0, 0);
-    lv_obj_set_style_border_width(side_bar_, 0, 0);
-    lv_obj_set_style_radius(side_bar_, 0, 0);
+    styles_.Attach(side_bar_, {kLvglStylePlain});
     lv_obj_set_style_pad_row(side_bar_, 0, 0);
 
     /* Status bar */
     status_bar_ = lv_obj_create(side_bar_);
     lv_obj_set_size(status_bar_, width_ - 32, 16);
-    lv_obj_set_style_radius(status_bar_, 0, 0);
     lv_obj_set_flex_flow(status_bar_, LV_FLEX_FLOW_ROW);
-    lv_obj_set_style_pad_all(status_bar_, 0, 0);
-    lv_obj_set_style_border_width(status_bar_, 0, 0);
+    styles_.Attach(status_bar_, {kLvglStylePlain});
     lv_obj_set_style_pad_column(status_bar_, 0, 0);
 
     status_label_ = lv_label_create(status_bar_);
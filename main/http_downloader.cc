@@ -0,0 +1,384 @@
+#include "http_downloader.h"
+#include "board.h"
+#include "settings.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <esp_rom_crc.h>
+#include <freertos/task.h>
+#include <algorithm>
+#include <cstdlib>
+
+#define TAG "HttpDownloader"
+
+static uint32_t HashUrl(const std::string& url) {
+    uint32_t hash = 2166136261u;
+    for (unsigned char c : url) {
+        hash = (hash ^ c) * 16777619u;
+    }
+    return hash;
+}
+
+// Content-Range: bytes 1024-4095/4096
+static size_t ParseContentRangeTotal(const std::string& content_range) {
+    auto slash = content_range.rfind('/');
+    if (slash == std::string::npos || slash + 1 >= content_range.size() || content_range[slash + 1] == '*') {
+        return 0;
+    }
+    return strtoul(content_range.c_str() + slash + 1, nullptr, 10);
+}
+
+HttpDownloader::HttpDownloader(const std::string& settings_ns) : settings_ns_(settings_ns) {
+}
+
+HttpDownloader::~HttpDownloader() {
+    FreeBuffers();
+}
+
+bool HttpDownloader::AllocateBuffers() {
+    // Large buffers in PSRAM keep the flash busy with few, long writes, otherwise use small internal ones
+    buffer_size_ = DOWNLOAD_BUFFER_SIZE;
+    for (int i = 0; i < DOWNLOAD_BUFFER_COUNT; i++) {
+        buffers_[i] = (char*)heap_caps_malloc(buffer_size_, MALLOC_CAP_SPIRAM);
+        if (buffers_[i] == nullptr) {
+            FreeBuffers();
+            break;
+        }
+    }
+    if (buffers_[0] == nullptr) {
+        buffer_size_ = DOWNLOAD_SMALL_BUFFER_SIZE;
+        for (int i = 0; i < DOWNLOAD_BUFFER_COUNT; i++) {
+            buffers_[i] = (char*)heap_caps_malloc(buffer_size_, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+            if (buffers_[i] == nullptr) {
+                ESP_LOGE(TAG, "Failed to allocate download buffers");
+                FreeBuffers();
+                return false;
+            }
+        }
+    }
+
+    free_queue_ = xQueueCreate(DOWNLOAD_BUFFER_COUNT, sizeof(char*));
+    full_queue_ = xQueueCreate(DOWNLOAD_BUFFER_COUNT + 1, sizeof(Chunk));
+    writer_done_ = xSemaphoreCreateBinary();
+    for (int i = 0; i < DOWNLOAD_BUFFER_COUNT; i++) {
+        xQueueSend(free_queue_, &buffers_[i], 0);
+    }
+    ESP_LOGI(TAG, "Using %d buffers of %u KB", DOWNLOAD_BUFFER_COUNT, buffer_size_ / 1024);
+    return true;
+}
+
+void HttpDownloader::FreeBuffers() {
+    for (int i = 0; i < DOWNLOAD_BUFFER_COUNT; i++) {
+        if (buffers_[i] != nullptr) {
+            heap_caps_free(buffers_[i]);
+            buffers_[i] = nullptr;
+        }
+    }
+    if (free_queue_ != nullptr) {
+        vQueueDelete(free_queue_);
+        free_queue_ = nullptr;
+    }
+    if (full_queue_ != nullptr) {
+        vQueueDelete(full_queue_);
+        full_queue_ = nullptr;
+    }
+    if (writer_done_ != nullptr) {
+        vSemaphoreDelete(writer_done_);
+        writer_done_ = nullptr;
+    }
+}
+
+void HttpDownloader::ClearProgress() {
+    Settings settings(settings_ns_, true);
+    settings.EraseAll();
+}
+
+size_t HttpDownloader::LoadResumeOffset(size_t& total_size) {
+    Settings settings(settings_ns_, false);
+    size_t offset = settings.GetInt("offset");
+    total_size = settings.GetInt("total");
+    uint32_t crc = (uint32_t)settings.GetInt("crc");
+    if ((uint32_t)settings.GetInt("url") != url_hash_ || offset == 0 || offset >= total_size ||
+        offset % DOWNLOAD_SMALL_BUFFER_SIZE != 0 || !callbacks_->on_read_back) {
+        return 0;
+    }
+
+    // The checkpoint is written after the data, but check that the flash still holds it
+    uint32_t read_crc = 0;
+    for (size_t position = 0; position < offset; position += buffer_size_) {
+        size_t size = std::min(buffer_size_, offset - position);
+        if (!callbacks_->on_read_back(position, buffers_[0], size)) {
+            return 0;
+        }
+        read_crc = esp_rom_crc32_le(read_crc, (const uint8_t*)buffers_[0], size);
+    }
+    if (read_crc != crc) {
+        ESP_LOGW(TAG, "Data of the interrupted download does not match, start over");
+        return 0;
+    }
+    crc32_ = crc;
+    ESP_LOGI(TAG, "Resuming download at %u/%u", offset, total_size);
+    return offset;
+}
+
+void HttpDownloader::SaveCheckpoint() {
+    checkpoint_ = written_;
+    if (!callbacks_->on_read_back) {
+        return;
+    }
+    Settings settings(settings_ns_, true);
+    settings.SetInt("url", (int32_t)url_hash_);
+    settings.SetInt("total", (int32_t)total_size_);
+    settings.SetInt("offset", (int32_t)written_);
+    settings.SetInt("crc", (int32_t)crc32_);
+}
+
+void HttpDownloader::WriteChunk(const Chunk& chunk) {
+    if (write_failed_) {
+        return;
+    }
+    if (callbacks_->on_data(chunk.offset, chunk.data, chunk.size)) {
+        crc32_ = esp_rom_crc32_le(crc32_, (const uint8_t*)chunk.data, chunk.size);
+        written_ = chunk.offset + chunk.size;
+        if (written_ - checkpoint_ >= DOWNLOAD_CHECKPOINT_INTERVAL && written_ < total_size_) {
+            SaveCheckpoint();
+        }
+    } else {
+        ESP_LOGE(TAG, "Failed to write %u bytes at %u", chunk.size, chunk.offset);
+        write_failed_ = true;
+    }
+}
+
+void HttpDownloader::FinishWrites() {
+    // Keep the progress for the next attempt
+    if (written_ > checkpoint_ && written_ < total_size_) {
+        SaveCheckpoint();
+    }
+}
+
+void HttpDownloader::WriterTask() {
+    Chunk chunk;
+    while (xQueueReceive(full_queue_, &chunk, portMAX_DELAY) == pdTRUE && chunk.size > 0) {
+        WriteChunk(chunk);
+        xQueueSend(free_queue_, &chunk.data, portMAX_DELAY);
+    }
+    FinishWrites();
+    xSemaphoreGive(writer_done_);
+}
+
+bool HttpDownloader::Download(const std::string& url, const DownloadCallbacks& callbacks) {
+    callbacks_ = &callbacks;
+    url_hash_ = HashUrl(url);
+    total_size_ = 0;
+    crc32_ = 0;
+    write_failed_ = false;
+    if (!AllocateBuffers()) {
+        return false;
+    }
+
+    size_t checkpoint_total = 0;
+    size_t offset = LoadResumeOffset(checkpoint_total);
+    if (offset > 0) {
+        total_size_ = checkpoint_total;
+    }
+    bool success = Receive(url, offset);
+    FreeBuffers();
+    if (success) {
+        ClearProgress();
+        ESP_LOGI(TAG, "Downloaded %u bytes, crc32 0x%08lx", total_size_, crc32_);
+    }
+    return success;
+}
+
+// Sleep until the bytes received in this window fit the rate limit, the window restarts
+// every second so a raised limit or a pause in reading does not turn into a burst
+void HttpDownloader::Throttle(size_t& window_bytes, int64_t& window_start) {
+    size_t rate = rate_limit_ ? rate_limit_() : 0;
+    auto now = esp_timer_get_time();
+    if (rate == 0) {
+        window_bytes = 0;
+        window_start = now;
+        return;
+    }
+    int64_t due = (int64_t)window_bytes * 1000000 / rate;
+    int64_t elapsed = now - window_start;
+    if (due > elapsed) {
+        vTaskDelay(pdMS_TO_TICKS((due - elapsed) / 1000) + 1);
+    }
+    if (esp_timer_get_time() - window_start >= 1000000) {
+        window_bytes = 0;
+        window_start = esp_timer_get_time();
+    }
+}
+
+bool HttpDownloader::Receive(const std::string& url, size_t offset) {
+    auto network = Board::GetInstance().GetNetwork();
+    size_t received = offset;
+    bool begun = false;
+    char* buffer = nullptr;
+    size_t filled = 0;
+    int retries = 0;
+    size_t recent_received = 0;
+    auto last_calc_time = esp_timer_get_time();
+    size_t throttle_bytes = 0;
+    int64_t throttle_start = last_calc_time;
+    bool write_inline = false;
+
+    while (!write_failed_) {
+        auto http = network->CreateHttp(0);
+        if (received > 0) {
+            http->SetHeader("Range", "bytes=" + std::to_string(received) + "-");
+        }
+        size_t skip = 0;
+        bool opened = http->Open("GET", url);
+        int status = opened ? http->GetStatusCode() : 0;
+        if (status == 206) {
+            size_t total = ParseContentRangeTotal(http->GetResponseHeader("Content-Range"));
+            if (total == 0) {
+                total = received + http->GetBodyLength();
+            }
+            if (total != total_size_) {
+                ESP_LOGW(TAG, "File size changed from %u to %u", total_size_, total);
+                http->Close();
+                if (begun) {
+                    break;
+                }
+                // The checkpoint belongs to another version of the file
+                received = 0;
+                crc32_ = 0;
+                continue;
+            }
+        } else if (status == 200) {
+            size_t total = http->GetBodyLength();
+            if (!begun) {
+                // Either a new download, or the server does not support ranges
+                received = 0;
+                crc32_ = 0;
+                total_size_ = total;
+            } else if (total != total_size_) {
+                ESP_LOGE(TAG, "File size changed from %u to %u", total_size_, total);
+                http->Close();
+                break;
+            } else {
+                skip = received;
+            }
+        } else {
+            if (opened) {
+                ESP_LOGE(TAG, "Unexpected status code: %d", status);
+                http->Close();
+            } else {
+                ESP_LOGE(TAG, "Failed to open HTTP connection");
+            }
+            if (status >= 400 && status < 500 && status != 408 && status != 429) {
+                break;
+            }
+        }
+
+        if (status == 200 || status == 206) {
+            if (!begun) {
+                if (total_size_ == 0) {
+                    ESP_LOGE(TAG, "Failed to get content length");
+                    http->Close();
+                    break;
+                }
+                if (!callbacks_->on_begin(received, total_size_)) {
+                    http->Close();
+                    break;
+                }
+                begun = true;
+                written_ = checkpoint_ = received;
+                if (xTaskCreate([](void* arg) {
+                    ((HttpDownloader*)arg)->WriterTask();
+                    vTaskDelete(NULL);
+                }, "download_writer", 4096 * 2, this, uxTaskPriorityGet(NULL), nullptr) != pdPASS) {
+                    // Slower, but the download still completes without the parallel writes
+                    ESP_LOGW(TAG, "Failed to create writer task, writing on this task");
+                    write_inline = true;
+                }
+            }
+
+            size_t received_before = received;
+            while (received < total_size_ && !write_failed_) {
+                if (buffer == nullptr) {
+                    xQueueReceive(free_queue_, &buffer, portMAX_DELAY);
+                    filled = 0;
+                }
+                size_t size = skip > 0 ? std::min(skip, buffer_size_ - filled)
+                                       : std::min(buffer_size_ - filled, total_size_ - received);
+                if (rate_limit_) {
+                    // Small reads, so the throttled connection is not drained in large bursts
+                    size = std::min(size, (size_t)DOWNLOAD_SMALL_BUFFER_SIZE);
+                }
+                int ret = http->Read(buffer + filled, size);
+                if (ret <= 0) {
+                    ESP_LOGW(TAG, "Connection lost at %u/%u", received, total_size_);
+                    break;
+                }
+                if (skip > 0) {
+                    // The server ignored the range, drop what was already received
+                    skip -= ret;
+                    continue;
+                }
+                filled += ret;
+                received += ret;
+                recent_received += ret;
+                if (rate_limit_) {
+                    throttle_bytes += ret;
+                    Throttle(throttle_bytes, throttle_start);
+                }
+
+                if (filled == buffer_size_ || received == total_size_) {
+                    Chunk chunk = { buffer, received - filled, filled };
+                    if (write_inline) {
+                        WriteChunk(chunk);
+                        filled = 0;
+                    } else {
+                        xQueueSend(full_queue_, &chunk, portMAX_DELAY);
+                        buffer = nullptr;
+                    }
+                }
+
+                if (esp_timer_get_time() - last_calc_time >= 1000000 || received == total_size_) {
+                    size_t progress = received * 100 / total_size_;
+                    ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Speed: %uB/s", progress, received, total_size_, recent_received);
+                    if (callbacks_->on_progress) {
+                        callbacks_->on_progress(progress, recent_received);
+                    }
+                    last_calc_time = esp_timer_get_time();
+                    recent_received = 0;
+                }
+            }
+            http->Close();
+            if (received == total_size_) {
+                break;
+            }
+            if (received > received_before) {
+                retries = 0;
+            }
+        }
+
+        if (++retries > DOWNLOAD_MAX_RETRIES) {
+            ESP_LOGE(TAG, "Too many retries, give up at %u/%u", received, total_size_);
+            break;
+        }
+        ESP_LOGW(TAG, "Retry in %d seconds (%d/%d)", retries, retries, DOWNLOAD_MAX_RETRIES);
+        vTaskDelay(pdMS_TO_TICKS(retries * 1000));
+    }
+
+    if (!begun) {
+        return false;
+    }
+    // Flush and stop the writer task
+    if (buffer != nullptr) {
+        xQueueSend(free_queue_, &buffer, portMAX_DELAY);
+    }
+    if (write_inline) {
+        FinishWrites();
+    } else {
+        Chunk stop = { nullptr, 0, 0 };
+        xQueueSend(full_queue_, &stop, portMAX_DELAY);
+        xSemaphoreTake(writer_done_, portMAX_DELAY);
+    }
+    return received == total_size_ && written_ == total_size_ && !write_failed_;
+}
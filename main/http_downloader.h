@@ -0,0 +1,91 @@
+#ifndef HTTP_DOWNLOADER_H
+#define HTTP_DOWNLOADER_H
+
+#include <string>
+#include <functional>
+#include <atomic>
+#include <cstdint>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+
+// A multiple of the flash sector size, so every checkpoint is sector aligned
+#define DOWNLOAD_BUFFER_SIZE (32 * 1024)
+#define DOWNLOAD_SMALL_BUFFER_SIZE (4 * 1024)   // Used when there is no PSRAM
+#define DOWNLOAD_BUFFER_COUNT 3
+#define DOWNLOAD_MAX_RETRIES 5
+#define DOWNLOAD_CHECKPOINT_INTERVAL (256 * 1024)
+
+struct DownloadCallbacks {
+    // Called once before any data, offset is 0 for a new download or where a previous one stopped
+    std::function<bool(size_t offset, size_t total_size)> on_begin;
+    // Consecutive chunks, called on the writer task while the next chunk is being received
+    std::function<bool(size_t offset, const char* data, size_t size)> on_data;
+    // Read back what a previous download wrote, so it is checked before being resumed. Without
+    // it a download never resumes after a reboot, so no checkpoints are written to NVS
+    std::function<bool(size_t offset, char* buffer, size_t size)> on_read_back;
+    std::function<void(int progress, size_t speed)> on_progress;
+};
+
+/*
+ * Downloads a file over HTTP into flash with the network and the flash writes overlapped.
+ *
+ * The calling task receives into a small pool of large buffers, while a writer task passes
+ * full buffers to on_data. If the writer task cannot be created, the calling task writes each
+ * buffer itself before receiving the next. A dropped connection is resumed with a Range
+ * request. The written offset and the CRC32 of the written data are checkpointed in NVS, so an
+ * interrupted download continues after a reboot once the data already in flash has been read
+ * back and matched.
+ */
+class HttpDownloader {
+public:
+    // Progress is kept in the given settings namespace, one per download target
+    explicit HttpDownloader(const std::string& settings_ns);
+    ~HttpDownloader();
+
+    bool Download(const std::string& url, const DownloadCallbacks& callbacks);
+    // Asked before every read, returns the allowed bytes per second or 0 for no limit
+    void SetRateLimit(std::function<size_t()> rate_limit) { rate_limit_ = rate_limit; }
+    // Forget the checkpoint, the next download starts from the beginning
+    void ClearProgress();
+
+    inline size_t total_size() const { return total_size_; }
+    inline uint32_t crc32() const { return crc32_; }
+
+private:
+    struct Chunk {
+        char* data;
+        size_t offset;
+        size_t size;        // 0 stops the writer task
+    };
+
+    std::string settings_ns_;
+    const DownloadCallbacks* callbacks_ = nullptr;
+    std::function<size_t()> rate_limit_;
+    uint32_t url_hash_ = 0;
+    size_t total_size_ = 0;
+    uint32_t crc32_ = 0;
+    size_t buffer_size_ = 0;
+    char* buffers_[DOWNLOAD_BUFFER_COUNT] = {};
+    QueueHandle_t free_queue_ = nullptr;
+    QueueHandle_t full_queue_ = nullptr;
+    SemaphoreHandle_t writer_done_ = nullptr;
+    std::atomic<bool> write_failed_ = false;
+
+    // Writer task state
+    size_t written_ = 0;
+    size_t checkpoint_ = 0;
+
+    bool AllocateBuffers();
+    void FreeBuffers();
+    size_t LoadResumeOffset(size_t& total_size);
+    void SaveCheckpoint();
+    void WriteChunk(const Chunk& chunk);
+    void FinishWrites();
+    void WriterTask();
+    bool Receive(const std::string& url, size_t offset);
+    void Throttle(size_t& window_bytes, int64_t& window_start);
+};
+
+#endif // HTTP_DOWNLOADER_H
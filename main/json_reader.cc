@@ -0,0 +1,367 @@
+#include "json_reader.h"
+
+#include <esp_log.h>
+#include <cstring>
+#include <cstdlib>
+
+#define TAG "JsonReader"
+
+// Decode the escaped contents of a JSON string into UTF-8
+static void UnescapeString(const char* text, size_t length, std::string& output) {
+    output.reserve(output.size() + length);
+    for (size_t i = 0; i < length; i++) {
+        char c = text[i];
+        if (c != '\\' || i + 1 >= length) {
+            output.push_back(c);
+            continue;
+        }
+        c = text[++i];
+        switch (c) {
+            case 'b': output.push_back('\b'); break;
+            case 'f': output.push_back('\f'); break;
+            case 'n': output.push_back('\n'); break;
+            case 'r': output.push_back('\r'); break;
+            case 't': output.push_back('\t'); break;
+            case 'u': {
+                auto parse_hex = [text, length](size_t offset, uint32_t& value) {
+                    if (offset + 4 > length) {
+                        return false;
+                    }
+                    value = 0;
+                    for (size_t j = offset; j < offset + 4; j++) {
+                        char h = text[j];
+                        value <<= 4;
+                        if (h >= '0' && h <= '9') value |= h - '0';
+                        else if (h >= 'a' && h <= 'f') value |= h - 'a' + 10;
+                        else if (h >= 'A' && h <= 'F') value |= h - 'A' + 10;
+                        else return false;
+                    }
+                    return true;
+                };
+                uint32_t code = 0;
+                if (!parse_hex(i + 1, code)) {
+                    return;
+                }
+                i += 4;
+                // Combine UTF-16 surrogate pairs
+                if (code >= 0xD800 && code <= 0xDBFF && i + 6 < length && text[i + 1] == '\\' && text[i + 2] == 'u') {
+                    uint32_t low = 0;
+                    if (parse_hex(i + 3, low) && low >= 0xDC00 && low <= 0xDFFF) {
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                        i += 6;
+                    }
+                }
+                if (code < 0x80) {
+                    output.push_back(static_cast<char>(code));
+                } else if (code < 0x800) {
+                    output.push_back(static_cast<char>(0xC0 | (code >> 6)));
+                    output.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+                } else if (code < 0x10000) {
+                    output.push_back(static_cast<char>(0xE0 | (code >> 12)));
+                    output.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+                    output.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+                } else {
+                    output.push_back(static_cast<char>(0xF0 | (code >> 18)));
+                    output.push_back(static_cast<char>(0x80 | ((code >> 12) & 0x3F)));
+                    output.push_back(static_cast<char>(0x80 | ((code >> 6) & 0x3F)));
+                    output.push_back(static_cast<char>(0x80 | (code & 0x3F)));
+                }
+                break;
+            }
+            default:
+                // \" \\ \/
+                output.push_back(c);
+                break;
+        }
+    }
+}
+
+bool JsonReader::Parse(const char* data, size_t length) {
+    data_ = data;
+    length_ = length;
+    pos_ = 0;
+    tokens_.clear();
+
+    if (data_ == nullptr) {
+        return false;
+    }
+    // Tolerate a trailing NUL terminator from transports that include it in the length
+    while (length_ > 0 && data_[length_ - 1] == '\0') {
+        length_--;
+    }
+
+    if (!ParseValue(0)) {
+        tokens_.clear();
+        return false;
+    }
+    SkipWhitespace();
+    if (pos_ != length_) {
+        tokens_.clear();
+        return false;
+    }
+    return true;
+}
+
+JsonValue JsonReader::root() const {
+    if (tokens_.empty()) {
+        return JsonValue();
+    }
+    return ValueAt(0);
+}
+
+void JsonReader::SkipWhitespace() {
+    while (pos_ < length_) {
+        char c = data_[pos_];
+        if (c != ' ' && c != '\t' && c != '\n' && c != '\r') {
+            break;
+        }
+        pos_++;
+    }
+}
+
+bool JsonReader::ParseValue(int depth) {
+    SkipWhitespace();
+    if (pos_ >= length_) {
+        return false;
+    }
+    switch (data_[pos_]) {
+        case '{':
+            return ParseContainer(depth, true);
+        case '[':
+            return ParseContainer(depth, false);
+        case '"':
+            return ParseString();
+        case 't':
+            return ParseLiteral("true", kJsonBool);
+        case 'f':
+            return ParseLiteral("false", kJsonBool);
+        case 'n':
+            return ParseLiteral("null", kJsonNull);
+        default:
+            return ParseNumber();
+    }
+}
+
+bool JsonReader::ParseString() {
+    uint32_t start = ++pos_;
+    bool escaped = false;
+    while (pos_ < length_) {
+        char c = data_[pos_];
+        if (c == '"') {
+            uint32_t index = tokens_.size();
+            tokens_.push_back(Token{start, static_cast<uint32_t>(pos_ - start), index + 1, kJsonString, escaped});
+            pos_++;
+            return true;
+        }
+        if (c == '\\') {
+            escaped = true;
+            pos_++;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            return false;
+        }
+        pos_++;
+    }
+    return false;
+}
+
+bool JsonReader::ParseNumber() {
+    uint32_t start = pos_;
+    if (pos_ < length_ && data_[pos_] == '-') {
+        pos_++;
+    }
+    bool has_digits = false;
+    while (pos_ < length_) {
+        char c = data_[pos_];
+        if ((c >= '0' && c <= '9')) {
+            has_digits = true;
+        } else if (c != '.' && c != 'e' && c != 'E' && c != '+' && c != '-') {
+            break;
+        }
+        pos_++;
+    }
+    if (!has_digits) {
+        return false;
+    }
+    uint32_t index = tokens_.size();
+    tokens_.push_back(Token{start, static_cast<uint32_t>(pos_ - start), index + 1, kJsonNumber, false});
+    return true;
+}
+
+bool JsonReader::ParseLiteral(const char* literal, JsonType type) {
+    size_t length = strlen(literal);
+    if (pos_ + length > length_ || memcmp(data_ + pos_, literal, length) != 0) {
+        return false;
+    }
+    uint32_t index = tokens_.size();
+    tokens_.push_back(Token{static_cast<uint32_t>(pos_), static_cast<uint32_t>(length), index + 1, type, false});
+    pos_ += length;
+    return true;
+}
+
+bool JsonReader::ParseContainer(int depth, bool object) {
+    if (depth >= kMaxDepth) {
+        ESP_LOGE(TAG, "Nesting is too deep");
+        return false;
+    }
+    char close = object ? '}' : ']';
+    uint32_t index = tokens_.size();
+    tokens_.push_back(Token{static_cast<uint32_t>(pos_), 0, 0, object ? kJsonObject : kJsonArray, false});
+    pos_++;
+
+    SkipWhitespace();
+    if (pos_ < length_ && data_[pos_] == close) {
+        pos_++;
+    } else {
+        while (true) {
+            if (object) {
+                SkipWhitespace();
+                if (pos_ >= length_ || data_[pos_] != '"' || !ParseString()) {
+                    return false;
+                }
+                SkipWhitespace();
+                if (pos_ >= length_ || data_[pos_] != ':') {
+                    return false;
+                }
+                pos_++;
+            }
+            if (!ParseValue(depth + 1)) {
+                return false;
+            }
+            SkipWhitespace();
+            if (pos_ >= length_) {
+                return false;
+            }
+            char c = data_[pos_++];
+            if (c == close) {
+                break;
+            }
+            if (c != ',') {
+                return false;
+            }
+        }
+    }
+
+    // tokens_ may have been reallocated by the children
+    tokens_[index].length = pos_ - tokens_[index].start;
+    tokens_[index].next = tokens_.size();
+    return true;
+}
+
+JsonValue JsonValue::operator[](std::string_view key) const {
+    JsonValue result;
+    ForEachMember([&result, key, this](std::string_view member_key, const JsonValue& value) {
+        if (result.valid() || member_key.size() < key.size()) {
+            return;
+        }
+        if (member_key == key) {
+            result = value;
+        } else if (member_key.find('\\') != std::string_view::npos) {
+            std::string decoded;
+            UnescapeString(member_key.data(), member_key.size(), decoded);
+            if (decoded == key) {
+                result = value;
+            }
+        }
+    });
+    return result;
+}
+
+JsonValue JsonValue::at(size_t index) const {
+    JsonValue result;
+    size_t i = 0;
+    ForEachElement([&result, &i, index](const JsonValue& value) {
+        if (i++ == index) {
+            result = value;
+        }
+    });
+    return result;
+}
+
+size_t JsonValue::size() const {
+    size_t count = 0;
+    if (type_ == kJsonObject) {
+        ForEachMember([&count](std::string_view, const JsonValue&) { count++; });
+    } else if (type_ == kJsonArray) {
+        ForEachElement([&count](const JsonValue&) { count++; });
+    }
+    return count;
+}
+
+std::string_view JsonValue::raw() const {
+    if (!valid()) {
+        return std::string_view();
+    }
+    auto& token = reader_->tokens_[index_];
+    return std::string_view(reader_->data_ + token.start, token.length);
+}
+
+bool JsonValue::Equals(std::string_view text) const {
+    if (type_ != kJsonString) {
+        return false;
+    }
+    auto& token = reader_->tokens_[index_];
+    if (!token.escaped) {
+        return raw() == text;
+    }
+    return GetString() == text;
+}
+
+std::string JsonValue::GetString(const std::string& default_value) const {
+    if (type_ != kJsonString) {
+        return default_value;
+    }
+    auto& token = reader_->tokens_[index_];
+    if (!token.escaped) {
+        return std::string(reader_->data_ + token.start, token.length);
+    }
+    std::string result;
+    UnescapeString(reader_->data_ + token.start, token.length, result);
+    return result;
+}
+
+double JsonValue::GetDouble(double default_value) const {
+    if (type_ != kJsonNumber) {
+        return default_value;
+    }
+    // The input buffer is not guaranteed to be NUL terminated after the number
+    char number[40];
+    auto text = raw();
+    if (text.size() >= sizeof(number)) {
+        return default_value;
+    }
+    memcpy(number, text.data(), text.size());
+    number[text.size()] = '\0';
+    return strtod(number, nullptr);
+}
+
+int JsonValue::GetInt(int default_value) const {
+    if (type_ != kJsonNumber) {
+        return default_value;
+    }
+    // Saturate like cJSON does for valueint
+    double value = GetDouble(default_value);
+    if (value >= 2147483647.0) {
+        return 2147483647;
+    } else if (value <= -2147483648.0) {
+        return -2147483647 - 1;
+    }
+    return static_cast<int>(value);
+}
+
+bool JsonValue::GetBool(bool default_value) const {
+    if (type_ != kJsonBool) {
+        return default_value;
+    }
+    return reader_->data_[reader_->tokens_[index_].start] == 't';
+}
+
+cJSON* JsonValue::ToCJSON() const {
+    if (!valid()) {
+        return nullptr;
+    }
+    auto& token = reader_->tokens_[index_];
+    if (type_ == kJsonString) {
+        return cJSON_ParseWithLength(reader_->data_ + token.start - 1, token.length + 2);
+    }
+    return cJSON_ParseWithLength(reader_->data_ + token.start, token.length);
+}
@@ -0,0 +1,146 @@
+#ifndef JSON_READER_H
+#define JSON_READER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+#include <cJSON.h>
+
+enum JsonType : uint8_t {
+    kJsonInvalid,
+    kJsonNull,
+    kJsonBool,
+    kJsonNumber,
+    kJsonString,
+    kJsonArray,
+    kJsonObject,
+};
+
+class JsonReader;
+
+/*
+ * A lightweight view of one value inside a document parsed by JsonReader.
+ * Values point into the original buffer, so they are only valid while the buffer
+ * and the reader are alive (i.e. inside the incoming message callback).
+ * Looking up a missing key returns an invalid value, which answers false to every Is*() check.
+ */
+class JsonValue {
+public:
+    JsonValue() = default;
+
+    inline JsonType type() const { return type_; }
+    inline bool valid() const { return type_ != kJsonInvalid; }
+    inline bool IsNull() const { return type_ == kJsonNull; }
+    inline bool IsBool() const { return type_ == kJsonBool; }
+    inline bool IsNumber() const { return type_ == kJsonNumber; }
+    inline bool IsString() const { return type_ == kJsonString; }
+    inline bool IsArray() const { return type_ == kJsonArray; }
+    inline bool IsObject() const { return type_ == kJsonObject; }
+
+    // Object member lookup, linear in the number of members
+    JsonValue operator[](std::string_view key) const;
+    JsonValue operator[](const char* key) const { return (*this)[std::string_view(key)]; }
+    // Array element lookup
+    JsonValue at(size_t index) const;
+    // Number of object members or array elements
+    size_t size() const;
+
+    // Iterate object members: callback(std::string_view key, const JsonValue& value)
+    template<typename F>
+    void ForEachMember(F&& callback) const;
+    // Iterate array elements: callback(const JsonValue& value)
+    template<typename F>
+    void ForEachElement(F&& callback) const;
+
+    // Compare a string value without unescaping or allocating when possible
+    bool Equals(std::string_view text) const;
+    // The source text of the value (string contents without quotes, still escaped)
+    std::string_view raw() const;
+    std::string GetString(const std::string& default_value = "") const;
+    int GetInt(int default_value = 0) const;
+    double GetDouble(double default_value = 0) const;
+    bool GetBool(bool default_value = false) const;
+
+    // Build a cJSON tree of this value for code that needs a full DOM, free it with cJSON_Delete
+    cJSON* ToCJSON() const;
+
+private:
+    friend class JsonReader;
+    JsonValue(const JsonReader* reader, uint32_t index, JsonType type) : reader_(reader), index_(index), type_(type) {}
+
+    const JsonReader* reader_ = nullptr;
+    uint32_t index_ = 0;
+    JsonType type_ = kJsonInvalid;
+};
+
+/*
+ * Tape based JSON parser for incoming server messages.
+ *
+ * Parse() validates the input and records one token per value (offsets into the input
+ * buffer) in a token vector that is reused between messages, so once warm a message
+ * is parsed without any heap allocation. Strings are only unescaped when GetString() asks for a copy.
+ */
+class JsonReader {
+public:
+    JsonReader() = default;
+
+    bool Parse(const char* data, size_t length);
+    bool Parse(std::string_view data) { return Parse(data.data(), data.size()); }
+    JsonValue root() const;
+
+private:
+    friend class JsonValue;
+
+    struct Token {
+        uint32_t start;     // Offset of the value (string contents for strings)
+        uint32_t length;    // Length of the value text
+        uint32_t next;      // Index of the token following this value and its children
+        JsonType type;
+        bool escaped;       // String contains escape sequences
+    };
+
+    static constexpr int kMaxDepth = 32;
+
+    const char* data_ = nullptr;
+    size_t length_ = 0;
+    size_t pos_ = 0;
+    std::vector<Token> tokens_;
+
+    void SkipWhitespace();
+    bool ParseValue(int depth);
+    bool ParseString();
+    bool ParseNumber();
+    bool ParseLiteral(const char* literal, JsonType type);
+    bool ParseContainer(int depth, bool object);
+
+    inline JsonValue ValueAt(uint32_t index) const { return JsonValue(this, index, tokens_[index].type); }
+};
+
+template<typename F>
+void JsonValue::ForEachMember(F&& callback) const {
+    if (type_ != kJsonObject) {
+        return;
+    }
+    auto& tokens = reader_->tokens_;
+    uint32_t end = tokens[index_].next;
+    for (uint32_t key = index_ + 1; key < end; key = tokens[key + 1].next) {
+        auto& key_token = tokens[key];
+        callback(std::string_view(reader_->data_ + key_token.start, key_token.length), reader_->ValueAt(key + 1));
+    }
+}
+
+template<typename F>
+void JsonValue::ForEachElement(F&& callback) const {
+    if (type_ != kJsonArray) {
+        return;
+    }
+    auto& tokens = reader_->tokens_;
+    uint32_t end = tokens[index_].next;
+    for (uint32_t item = index_ + 1; item < end; item = tokens[item].next) {
+        callback(reader_->ValueAt(item));
+    }
+}
+
+#endif // JSON_READER_H
@@ -0,0 +1,191 @@
+#include "json_writer.h"
+
+#include <esp_log.h>
+#include <cmath>
+#include <cstdio>
+
+#define TAG "JsonWriter"
+
+JsonWriter::JsonWriter(size_t reserve_size) {
+    buffer_.reserve(reserve_size);
+}
+
+void JsonWriter::Clear() {
+    buffer_.clear();
+    depth_ = 0;
+    has_items_ = 0;
+    after_key_ = false;
+    failed_ = false;
+}
+
+std::string JsonWriter::Release() {
+    std::string result = std::move(buffer_);
+    Clear();
+    return result;
+}
+
+bool JsonWriter::BeforeValue() {
+    if (failed_) {
+        return false;
+    }
+    if (after_key_) {
+        after_key_ = false;
+        return true;
+    }
+    if (depth_ > 0) {
+        uint32_t bit = 1u << (depth_ - 1);
+        if (has_items_ & bit) {
+            buffer_.push_back(',');
+        }
+        has_items_ |= bit;
+    }
+    return true;
+}
+
+void JsonWriter::Open(char c) {
+    if (depth_ >= kMaxDepth && !failed_) {
+        ESP_LOGE(TAG, "Nesting is too deep");
+        failed_ = true;
+    }
+    if (!BeforeValue()) {
+        return;
+    }
+    buffer_.push_back(c);
+    depth_++;
+    has_items_ &= ~(1u << (depth_ - 1));
+}
+
+void JsonWriter::Close(char c) {
+    if (failed_) {
+        return;
+    }
+    if (depth_ == 0) {
+        ESP_LOGE(TAG, "Close without a matching open");
+        failed_ = true;
+        return;
+    }
+    depth_--;
+    buffer_.push_back(c);
+}
+
+JsonWriter& JsonWriter::BeginObject() {
+    Open('{');
+    return *this;
+}
+
+JsonWriter& JsonWriter::EndObject() {
+    Close('}');
+    return *this;
+}
+
+JsonWriter& JsonWriter::BeginArray() {
+    Open('[');
+    return *this;
+}
+
+JsonWriter& JsonWriter::EndArray() {
+    Close(']');
+    return *this;
+}
+
+JsonWriter& JsonWriter::Key(std::string_view key) {
+    if (!BeforeValue()) {
+        return *this;
+    }
+    AppendEscaped(buffer_, key);
+    buffer_.push_back(':');
+    after_key_ = true;
+    return *this;
+}
+
+JsonWriter& JsonWriter::String(std::string_view value) {
+    if (!BeforeValue()) {
+        return *this;
+    }
+    AppendEscaped(buffer_, value);
+    return *this;
+}
+
+JsonWriter& JsonWriter::Int(int64_t value) {
+    if (!BeforeValue()) {
+        return *this;
+    }
+    char number[24];
+    int length = snprintf(number, sizeof(number), "%lld", (long long)value);
+    buffer_.append(number, length);
+    return *this;
+}
+
+JsonWriter& JsonWriter::Number(double value) {
+    if (!std::isfinite(value)) {
+        // JSON has no representation for NaN or infinity, same as cJSON
+        return Null();
+    }
+    if (!BeforeValue()) {
+        return *this;
+    }
+    char number[32];
+    int length;
+    if (std::fabs(value) < 1e15 && value == (double)(int64_t)value) {
+        length = snprintf(number, sizeof(number), "%lld", (long long)value);
+    } else {
+        length = snprintf(number, sizeof(number), "%.15g", value);
+    }
+    buffer_.append(number, length);
+    return *this;
+}
+
+JsonWriter& JsonWriter::Bool(bool value) {
+    if (!BeforeValue()) {
+        return *this;
+    }
+    buffer_.append(value ? "true" : "false");
+    return *this;
+}
+
+JsonWriter& JsonWriter::Null() {
+    if (!BeforeValue()) {
+        return *this;
+    }
+    buffer_.append("null");
+    return *this;
+}
+
+JsonWriter& JsonWriter::Raw(std::string_view json) {
+    if (!BeforeValue()) {
+        return *this;
+    }
+    buffer_.append(json.data(), json.size());
+    return *this;
+}
+
+void JsonWriter::AppendEscaped(std::string& output, std::string_view value) {
+    static const char hex_chars[] = "0123456789abcdef";
+    output.push_back('"');
+    // Copy runs of characters that need no escaping in one go
+    size_t run_start = 0;
+    for (size_t i = 0; i < value.size(); i++) {
+        unsigned char c = value[i];
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        output.append(value.data() + run_start, i - run_start);
+        run_start = i + 1;
+        switch (c) {
+            case '"': output.append("\\\""); break;
+            case '\\': output.append("\\\\"); break;
+            case '\b': output.append("\\b"); break;
+            case '\f': output.append("\\f"); break;
+            case '\n': output.append("\\n"); break;
+            case '\r': output.append("\\r"); break;
+            case '\t': output.append("\\t"); break;
+            default: {
+                char escaped[6] = {'\\', 'u', '0', '0', hex_chars[c >> 4], hex_chars[c & 0x0F]};
+                output.append(escaped, sizeof(escaped));
+                break;
+            }
+        }
+    }
+    output.append(value.data() + run_start, value.size() - run_start);
+    output.push_back('"');
+}
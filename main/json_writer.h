@@ -0,0 +1,83 @@
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <type_traits>
+
+/*
+ * A small streaming JSON writer that appends directly into a reusable std::string.
+ *
+ * Unlike building a cJSON tree and printing it, nothing is allocated per node: once the
+ * buffer has grown to the size of the largest message, Clear() + rewrite is allocation free.
+ * Commas and string escaping are handled by the writer, so callers cannot produce
+ * invalid JSON by concatenating unescaped values. Nesting deeper than kMaxDepth or closing
+ * more than was opened fails the writer: nothing more is written until Clear(), and failed()
+ * tells the caller not to send the truncated document.
+ *
+ *   JsonWriter writer;
+ *   writer.BeginObject();
+ *   writer.Member("type", "listen");
+ *   writer.Member("state", "start");
+ *   writer.EndObject();
+ *   SendText(writer.str());
+ */
+class JsonWriter {
+public:
+    explicit JsonWriter(size_t reserve_size = 256);
+
+    // Reset the writer for a new document, keeping the buffer capacity
+    void Clear();
+
+    JsonWriter& BeginObject();
+    JsonWriter& EndObject();
+    JsonWriter& BeginArray();
+    JsonWriter& EndArray();
+    JsonWriter& Key(std::string_view key);
+
+    JsonWriter& String(std::string_view value);
+    JsonWriter& String(const char* value) { return String(std::string_view(value ? value : "")); }
+    JsonWriter& Int(int64_t value);
+    JsonWriter& Number(double value);
+    JsonWriter& Bool(bool value);
+    JsonWriter& Null();
+    // Append an already serialized JSON value as is
+    JsonWriter& Raw(std::string_view json);
+
+    // Shortcuts for "key": value pairs inside an object
+    JsonWriter& Member(std::string_view key, std::string_view value) { return Key(key).String(value); }
+    JsonWriter& Member(std::string_view key, const char* value) { return Key(key).String(value); }
+    JsonWriter& Member(std::string_view key, const std::string& value) { return Key(key).String(value); }
+    JsonWriter& Member(std::string_view key, bool value) { return Key(key).Bool(value); }
+    template<typename T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>, int> = 0>
+    JsonWriter& Member(std::string_view key, T value) { return Key(key).Int(static_cast<int64_t>(value)); }
+    template<typename T, std::enable_if_t<std::is_floating_point_v<T>, int> = 0>
+    JsonWriter& Member(std::string_view key, T value) { return Key(key).Number(static_cast<double>(value)); }
+
+    inline const std::string& str() const { return buffer_; }
+    inline size_t size() const { return buffer_.size(); }
+    inline int depth() const { return depth_; }
+    inline bool failed() const { return failed_; }
+
+    // Move the finished document out, the writer starts over with an empty buffer
+    std::string Release();
+
+    // Escape a string as a JSON string literal (including the quotes) into output
+    static void AppendEscaped(std::string& output, std::string_view value);
+
+private:
+    static constexpr int kMaxDepth = 32;
+
+    std::string buffer_;
+    int depth_ = 0;
+    uint32_t has_items_ = 0;    // One bit per nesting level: a value was written at this level
+    bool after_key_ = false;
+    bool failed_ = false;
+
+    bool BeforeValue();
+    void Open(char c);
+    void Close(char c);
+};
+
+#endif // JSON_WRITER_H
@@ -9,6 +9,8 @@
 
 #include "application.h"
 #include "system_info.h"
+#include "boot_trace.h"
+#include "settings_schema.h"
 
 #define TAG "main"
 
@@ -18,6 +20,7 @@ extern "C" void app_main(void)
     ESP_ERROR_CHECK(esp_event_loop_create_default());
 
     // Initialize NVS flash for WiFi configuration
+    int nvs_trace = BootTrace::GetInstance().Begin("nvs_init");
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
         ESP_LOGW(TAG, "Erasing NVS flash to fix corruption");
@@ -25,6 +28,13 @@ extern "C" void app_main(void)
         ret = nvs_flash_init();
     }
     ESP_ERROR_CHECK(ret);
+    BootTrace::GetInstance().End(nvs_trace);
+
+    // Every namespace in the schema is read once here, before the board reads its settings
+    {
+        BootTraceScope trace("settings.preload");
+        SettingsSchema::Preload();
+    }
 
     // Launch the application
     auto& app = Application::GetInstance();
@@ -13,8 +13,11 @@
 #include "application.h"
 #include "display.h"
 #include "oled_display.h"
+#include "lcd_display.h"
 #include "board.h"
-#include "settings.h"
+#include "settings_schema.h"
+#include "boot_trace.h"
+#include "animation_scheduler.h"
 #include "lvgl_theme.h"
 #include "lvgl_display.h"
 
@@ -135,6 +138,34 @@ void McpServer::AddUserOnlyTools() {
             return board.GetSystemInfoJson();
         });
 
+    AddUserOnlyTool("self.get_settings",
+        "Get the device settings, such as volume, brightness, theme and server addresses. Secrets are not included.",
+        PropertyList(),
+        [](const PropertyList& properties) -> ReturnValue {
+            return SettingsSchema::ToJson();
+        });
+
+    AddUserOnlyTool("self.get_boot_trace",
+        "Get the startup phase timings and heap usage in Chrome trace event format",
+        PropertyList(),
+        [](const PropertyList& properties) -> ReturnValue {
+            return BootTrace::GetInstance().GetChromeTrace();
+        });
+
+    AddUserOnlyTool("self.get_upgrade_status",
+        "Get the progress of the firmware upgrade downloaded in the background, and how audio playback fared meanwhile",
+        PropertyList(),
+        [](const PropertyList& properties) -> ReturnValue {
+            return Application::GetInstance().GetUpgradeStatusJson();
+        });
+
+    AddUserOnlyTool("self.screen.get_animation_stats",
+        "Get how smoothly the emotion animations play: frames per second, dropped frames and flush time per frame",
+        PropertyList(),
+        [](const PropertyList& properties) -> ReturnValue {
+            return AnimationScheduler::GetInstance().GetMetricsJson();
+        });
+
     AddUserOnlyTool("self.reboot", "Reboot the system",
         PropertyList(),
         [this](const PropertyList& properties) -> ReturnValue {
@@ -158,6 +189,9 @@ void McpServer::AddUserOnlyTools() {
             ESP_LOGI(TAG, "User requested firmware upgrade from URL: %s", url.c_str());
             
             auto& app = Application::GetInstance();
+            if (app.IsUpgrading()) {
+                throw std::runtime_error("A firmware upgrade is already in progress");
+            }
             app.Schedule([url, &app]() {
                 auto ota = std::make_unique<Ota>();
                 
@@ -188,6 +222,32 @@ void McpServer::AddUserOnlyTools() {
                 return json;
             });
 
+        AddUserOnlyTool("self.screen.get_font_cache_stats",
+            "Get the hit rates of the glyph and text width caches of the text font loaded from the assets",
+            PropertyList(),
+            [display](const PropertyList& properties) -> ReturnValue {
+                auto theme = static_cast<LvglTheme*>(display->GetTheme());
+                auto font = theme != nullptr ? std::dynamic_pointer_cast<LvglCBinFont>(theme->text_font()) : nullptr;
+                if (font == nullptr) {
+                    throw std::runtime_error("The text font is not loaded from the assets");
+                }
+                return font->GetCacheStatsJson();
+            });
+
+        auto lcd_display = dynamic_cast<LcdDisplay*>(display);
+        if (lcd_display) {
+            AddUserOnlyTool("self.screen.get_flush_stats",
+                "Get how fast the screen is flushed: throughput in MB/s, time spent rendering and waiting for transfers, and how much rendering overlaps the transfers",
+                PropertyList(),
+                [lcd_display](const PropertyList& properties) -> ReturnValue {
+                    auto json = lcd_display->GetFlushStatsJson();
+                    if (json.empty()) {
+                        throw std::runtime_error("Flush statistics are not available for this screen");
+                    }
+                    return json;
+                });
+        }
+
 #if CONFIG_LV_USE_SNAPSHOT
         AddUserOnlyTool("self.screen.snapshot", "Snapshot the screen and upload it to a specific URL",
             PropertyList({
@@ -198,16 +258,9 @@ void McpServer::AddUserOnlyTools() {
                 auto url = properties["url"].value<std::string>();
                 auto quality = properties["quality"].value<int>();
 
-                std::string jpeg_data;
-                if (!display->SnapshotToJpeg(jpeg_data, quality)) {
-                    throw std::runtime_error("Failed to snapshot screen");
-                }
-
-                ESP_LOGI(TAG, "Upload snapshot %u bytes to %s", jpeg_data.size(), url.c_str());
-                
-                // 构造multipart/form-data请求体
+                // 构造multipart/form-data请求体，JPEG边编码边写入请求体，不在内存中保留完整图片
                 std::string boundary = "----ESP32_SCREEN_SNAPSHOT_BOUNDARY";
-                
+
                 auto http = Board::GetInstance().GetNetwork()->CreateHttp(3);
                 http->SetHeader("Content-Type", "multipart/form-data; boundary=" + boundary);
                 if (!http->Open("POST", url)) {
@@ -223,8 +276,17 @@ void McpServer::AddUserOnlyTools() {
                     http->Write(file_header.c_str(), file_header.size());
                 }
 
-                // JPEG数据
-                http->Write((const char*)jpeg_data.data(), jpeg_data.size());
+                // JPEG数据，显示锁只在绘制每个条带时持有，写入网络时不持有
+                size_t jpeg_size = 0;
+                bool encoded = display->SnapshotToJpegStream([&http, &jpeg_size](const void* data, size_t len) {
+                    jpeg_size += len;
+                    return http->Write(static_cast<const char*>(data), len) >= 0;
+                }, quality);
+                if (!encoded) {
+                    http->Close();
+                    throw std::runtime_error("Failed to snapshot screen");
+                }
+                ESP_LOGI(TAG, "Streamed snapshot of %u bytes to %s", jpeg_size, url.c_str());
 
                 {
                     // multipart尾部
@@ -295,8 +357,7 @@ void McpServer::AddUserOnlyTools() {
             }),
             [](const PropertyList& properties) -> ReturnValue {
                 auto url = properties["url"].value<std::string>();
-                Settings settings("assets", true);
-                settings.SetString("download_url", url);
+                SettingsSchema::kAssetsDownloadUrl.Set(url);
                 return true;
             });
     }
@@ -394,10 +455,18 @@ void McpServer::ParseMessage(const cJSON* json) {
             }
         }
         auto app_desc = esp_app_get_description();
-        std::string message = "{\"protocolVersion\":\"2024-11-05\",\"capabilities\":{\"tools\":{}},\"serverInfo\":{\"name\":\"" BOARD_NAME "\",\"version\":\"";
-        message += app_desc->version;
-        message += "\"}}";
-        ReplyResult(id_int, message);
+        JsonWriter writer;
+        writer.BeginObject();
+        writer.Member("protocolVersion", "2024-11-05");
+        writer.Key("capabilities").BeginObject();
+        writer.Key("tools").BeginObject().EndObject();
+        writer.EndObject();
+        writer.Key("serverInfo").BeginObject();
+        writer.Member("name", BOARD_NAME);
+        writer.Member("version", app_desc->version);
+        writer.EndObject();
+        writer.EndObject();
+        ReplyResult(id_int, writer.str());
     } else if (method_str == "tools/list") {
         std::string cursor_str = "";
         bool list_user_only_tools = false;
@@ -438,29 +507,38 @@ void McpServer::ParseMessage(const cJSON* json) {
 }
 
 void McpServer::ReplyResult(int id, const std::string& result) {
-    std::string payload = "{\"jsonrpc\":\"2.0\",\"id\":";
-    payload += std::to_string(id) + ",\"result\":";
-    payload += result;
-    payload += "}";
-    Application::GetInstance().SendMcpMessage(payload);
+    JsonWriter writer(result.size() + 64);
+    writer.BeginObject();
+    writer.Member("jsonrpc", "2.0");
+    writer.Member("id", id);
+    writer.Key("result").Raw(result);
+    writer.EndObject();
+    Application::GetInstance().SendMcpMessage(writer.Release());
 }
 
 void McpServer::ReplyError(int id, const std::string& message) {
-    std::string payload = "{\"jsonrpc\":\"2.0\",\"id\":";
-    payload += std::to_string(id);
-    payload += ",\"error\":{\"message\":\"";
-    payload += message;
-    payload += "\"}}";
-    Application::GetInstance().SendMcpMessage(payload);
+    JsonWriter writer;
+    writer.BeginObject();
+    writer.Member("jsonrpc", "2.0");
+    writer.Member("id", id);
+    writer.Key("error").BeginObject();
+    writer.Member("message", message);
+    writer.EndObject();
+    writer.EndObject();
+    Application::GetInstance().SendMcpMessage(writer.Release());
 }
 
 void McpServer::GetToolsList(int id, const std::string& cursor, bool list_user_only_tools) {
-    const int max_payload_size = 8000;
-    std::string json = "{\"tools\":[";
+    const size_t max_payload_size = 8000;
+    JsonWriter json(max_payload_size);
+    JsonWriter tool_json(1024);
+    json.BeginObject();
+    json.Key("tools").BeginArray();
     
     bool found_cursor = cursor.empty();
     auto it = tools_.begin();
     std::string next_cursor = "";
+    int tool_count = 0;
     
     while (it != tools_.end()) {
         // 如果我们还没有找到起始位置，继续搜索
@@ -479,35 +557,33 @@ void McpServer::GetToolsList(int id, const std::string& cursor, bool list_user_o
         }
         
         // 添加tool前检查大小
-        std::string tool_json = (*it)->to_json() + ",";
-        if (json.length() + tool_json.length() + 30 > max_payload_size) {
+        tool_json.Clear();
+        (*it)->to_json(tool_json);
+        if (json.size() + tool_json.size() + 31 > max_payload_size) {
             // 如果添加这个tool会超出大小限制，设置next_cursor并退出循环
             next_cursor = (*it)->name();
             break;
         }
         
-        json += tool_json;
+        json.Raw(tool_json.str());
+        tool_count++;
         ++it;
     }
     
-    if (json.back() == ',') {
-        json.pop_back();
-    }
-    
-    if (json.back() == '[' && !tools_.empty()) {
+    if (tool_count == 0 && !tools_.empty()) {
         // 如果没有添加任何tool，返回错误
         ESP_LOGE(TAG, "tools/list: Failed to add tool %s because of payload size limit", next_cursor.c_str());
         ReplyError(id, "Failed to add tool " + next_cursor + " because of payload size limit");
         return;
     }
 
-    if (next_cursor.empty()) {
-        json += "]}";
-    } else {
-        json += "],\"nextCursor\":\"" + next_cursor + "\"}";
+    json.EndArray();
+    if (!next_cursor.empty()) {
+        json.Member("nextCursor", next_cursor);
     }
+    json.EndObject();
     
-    ReplyResult(id, json);
+    ReplyResult(id, json.str());
 }
 
 void McpServer::DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments) {
@@ -13,6 +13,8 @@
 
 #include <cJSON.h>
 
+#include "json_writer.h"
+
 class ImageContent {
 private:
     std::string encoded_data_;
@@ -33,16 +35,18 @@ public:
         encoded_data_ = Base64Encode(data);
     }
 
+    void to_json(JsonWriter& writer) const {
+        writer.BeginObject();
+        writer.Member("type", "image");
+        writer.Member("mimeType", mime_type_);
+        writer.Member("data", encoded_data_);
+        writer.EndObject();
+    }
+
     std::string to_json() const {
-        cJSON *json = cJSON_CreateObject();
-        cJSON_AddStringToObject(json, "type", "image");
-        cJSON_AddStringToObject(json, "mimeType", mime_type_.c_str());
-        cJSON_AddStringToObject(json, "data", encoded_data_.c_str());
-        char* json_str = cJSON_PrintUnformatted(json);
-        std::string result(json_str);
-        cJSON_free(json_str);
-        cJSON_Delete(json);
-        return result;
+        JsonWriter writer(encoded_data_.size() + 64);
+        to_json(writer);
+        return writer.Release();
     }
 };
 
@@ -120,38 +124,37 @@ public:
         value_ = value;
     }
 
-    std::string to_json() const {
-        cJSON *json = cJSON_CreateObject();
-        
+    void to_json(JsonWriter& writer) const {
+        writer.BeginObject();
         if (type_ == kPropertyTypeBoolean) {
-            cJSON_AddStringToObject(json, "type", "boolean");
+            writer.Member("type", "boolean");
             if (has_default_value_) {
-                cJSON_AddBoolToObject(json, "default", value<bool>());
+                writer.Member("default", value<bool>());
             }
         } else if (type_ == kPropertyTypeInteger) {
-            cJSON_AddStringToObject(json, "type", "integer");
+            writer.Member("type", "integer");
             if (has_default_value_) {
-                cJSON_AddNumberToObject(json, "default", value<int>());
+                writer.Member("default", value<int>());
             }
             if (min_value_.has_value()) {
-                cJSON_AddNumberToObject(json, "minimum", min_value_.value());
+                writer.Member("minimum", min_value_.value());
             }
             if (max_value_.has_value()) {
-                cJSON_AddNumberToObject(json, "maximum", max_value_.value());
+                writer.Member("maximum", max_value_.value());
             }
         } else if (type_ == kPropertyTypeString) {
-            cJSON_AddStringToObject(json, "type", "string");
+            writer.Member("type", "string");
             if (has_default_value_) {
-                cJSON_AddStringToObject(json, "default", value<std::string>().c_str());
+                writer.Member("default", value<std::string>());
             }
         }
-        
-        char *json_str = cJSON_PrintUnformatted(json);
-        std::string result(json_str);
-        cJSON_free(json_str);
-        cJSON_Delete(json);
-        
-        return result;
+        writer.EndObject();
+    }
+
+    std::string to_json() const {
+        JsonWriter writer;
+        to_json(writer);
+        return writer.Release();
     }
 };
 
@@ -188,20 +191,19 @@ public:
         return required;
     }
 
-    std::string to_json() const {
-        cJSON *json = cJSON_CreateObject();
-        
+    void to_json(JsonWriter& writer) const {
+        writer.BeginObject();
         for (const auto& property : properties_) {
-            cJSON *prop_json = cJSON_Parse(property.to_json().c_str());
-            cJSON_AddItemToObject(json, property.name().c_str(), prop_json);
+            writer.Key(property.name());
+            property.to_json(writer);
         }
-        
-        char *json_str = cJSON_PrintUnformatted(json);
-        std::string result(json_str);
-        cJSON_free(json_str);
-        cJSON_Delete(json);
-        
-        return result;
+        writer.EndObject();
+    }
+
+    std::string to_json() const {
+        JsonWriter writer;
+        to_json(writer);
+        return writer.Release();
     }
 };
 
@@ -229,85 +231,74 @@ public:
     inline const PropertyList& properties() const { return properties_; }
     inline bool user_only() const { return user_only_; }
 
-    std::string to_json() const {
+    void to_json(JsonWriter& writer) const {
+        writer.BeginObject();
+        writer.Member("name", name_);
+        writer.Member("description", description_);
+
+        writer.Key("inputSchema").BeginObject();
+        writer.Member("type", "object");
+        writer.Key("properties");
+        properties_.to_json(writer);
+
         std::vector<std::string> required = properties_.GetRequired();
-        
-        cJSON *json = cJSON_CreateObject();
-        cJSON_AddStringToObject(json, "name", name_.c_str());
-        cJSON_AddStringToObject(json, "description", description_.c_str());
-        
-        cJSON *input_schema = cJSON_CreateObject();
-        cJSON_AddStringToObject(input_schema, "type", "object");
-        
-        cJSON *properties = cJSON_Parse(properties_.to_json().c_str());
-        cJSON_AddItemToObject(input_schema, "properties", properties);
-        
         if (!required.empty()) {
-            cJSON *required_array = cJSON_CreateArray();
+            writer.Key("required").BeginArray();
             for (const auto& property : required) {
-                cJSON_AddItemToArray(required_array, cJSON_CreateString(property.c_str()));
+                writer.String(property);
             }
-            cJSON_AddItemToObject(input_schema, "required", required_array);
+            writer.EndArray();
         }
-        
-        cJSON_AddItemToObject(json, "inputSchema", input_schema);
+        writer.EndObject();
 
         // Add audience annotation if the tool is user only (invisible to AI)
         if (user_only_) {
-            cJSON *annotations = cJSON_CreateObject();
-            cJSON *audience = cJSON_CreateArray();
-            cJSON_AddItemToArray(audience, cJSON_CreateString("user"));
-            cJSON_AddItemToObject(annotations, "audience", audience);
-            cJSON_AddItemToObject(json, "annotations", annotations);
+            writer.Key("annotations").BeginObject();
+            writer.Key("audience").BeginArray().String("user").EndArray();
+            writer.EndObject();
         }
-        
-        char *json_str = cJSON_PrintUnformatted(json);
-        std::string result(json_str);
-        cJSON_free(json_str);
-        cJSON_Delete(json);
-        
-        return result;
+        writer.EndObject();
+    }
+
+    std::string to_json() const {
+        JsonWriter writer;
+        to_json(writer);
+        return writer.Release();
     }
 
     std::string Call(const PropertyList& properties) {
         ReturnValue return_value = callback_(properties);
         // 返回结果
-        cJSON* result = cJSON_CreateObject();
-        cJSON* content = cJSON_CreateArray();
-
+        JsonWriter writer;
+        writer.BeginObject();
+        writer.Key("content").BeginArray();
+        writer.BeginObject();
         if (std::holds_alternative<ImageContent*>(return_value)) {
             auto image_content = std::get<ImageContent*>(return_value);
-            cJSON* image = cJSON_CreateObject();
-            cJSON_AddStringToObject(image, "type", "image");
-            cJSON_AddStringToObject(image, "image", image_content->to_json().c_str());
-            cJSON_AddItemToArray(content, image);
+            writer.Member("type", "image");
+            writer.Member("image", image_content->to_json());
             delete image_content;
         } else {
-            cJSON* text = cJSON_CreateObject();
-            cJSON_AddStringToObject(text, "type", "text");
+            writer.Member("type", "text");
             if (std::holds_alternative<std::string>(return_value)) {
-                cJSON_AddStringToObject(text, "text", std::get<std::string>(return_value).c_str());
+                writer.Member("text", std::get<std::string>(return_value));
             } else if (std::holds_alternative<bool>(return_value)) {
-                cJSON_AddStringToObject(text, "text", std::get<bool>(return_value) ? "true" : "false");
+                writer.Member("text", std::get<bool>(return_value) ? "true" : "false");
             } else if (std::holds_alternative<int>(return_value)) {
-                cJSON_AddStringToObject(text, "text", std::to_string(std::get<int>(return_value)).c_str());
+                writer.Member("text", std::to_string(std::get<int>(return_value)));
             } else if (std::holds_alternative<cJSON*>(return_value)) {
                 cJSON* json = std::get<cJSON*>(return_value);
                 char* json_str = cJSON_PrintUnformatted(json);
-                cJSON_AddStringToObject(text, "text", json_str);
+                writer.Member("text", json_str);
                 cJSON_free(json_str);
                 cJSON_Delete(json);
             }
-            cJSON_AddItemToArray(content, text);
         }
-        cJSON_AddItemToObject(result, "content", content);
-        cJSON_AddBoolToObject(result, "isError", false);
-
-        auto json_str = cJSON_PrintUnformatted(result);
-        std::string result_str(json_str);
-        cJSON_free(json_str);
-        cJSON_Delete(result);
-        return result_str;
+        writer.EndObject();
+        writer.EndArray();
+        writer.Member("isError", false);
+        writer.EndObject();
+        return writer.Release();
     }
 };
 
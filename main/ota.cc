@@ -1,6 +1,9 @@
 #include "ota.h"
 #include "system_info.h"
-#include "settings.h"
+#include "settings_schema.h"
+#include "boot_trace.h"
+#include "http_downloader.h"
+#include "delta_patcher.h"
 #include "assets/lang_config.h"
 
 #include <cJSON.h>
@@ -21,6 +24,62 @@
 
 #define TAG "Ota"
 
+static std::string JoinStringArray(cJSON* array) {
+    std::string result;
+    cJSON* element = NULL;
+    cJSON_ArrayForEach(element, array) {
+        if (cJSON_IsString(element)) {
+            if (!result.empty()) {
+                result.push_back('\n');
+            }
+            result += element->valuestring;
+        }
+    }
+    return result;
+}
+
+// Write a server config section into its namespace, returns the number of keys that changed
+static int ApplyServerConfig(const char* ns, cJSON* config) {
+    Settings settings(ns, true);
+    int changed = 0;
+    cJSON* item = NULL;
+    cJSON_ArrayForEach(item, config) {
+        if (cJSON_IsString(item)) {
+            if (settings.GetString(item->string) != item->valuestring) {
+                settings.SetString(item->string, item->valuestring);
+                changed++;
+            }
+        } else if (cJSON_IsNumber(item)) {
+            int32_t value = item->valueint;
+            auto setting = SettingsSchema::Find(ns, item->string);
+            if (setting != nullptr && setting->type == kSettingInt) {
+                // Keep a bad server value from silently falling back to the default
+                auto int_setting = static_cast<const Setting<int32_t>*>(setting);
+                int32_t clamped = int_setting->Clamp(value);
+                if (clamped != value) {
+                    ESP_LOGW(TAG, "%s.%s = %ld is out of range, clamped to %ld", ns, item->string, (long)value, (long)clamped);
+                    value = clamped;
+                }
+                if (!int_setting->IsValid(value)) {
+                    ESP_LOGW(TAG, "%s.%s = %ld is invalid, ignored", ns, item->string, (long)value);
+                    continue;
+                }
+            }
+            if (settings.GetInt(item->string) != value) {
+                settings.SetInt(item->string, value);
+                changed++;
+            }
+        } else if (cJSON_IsArray(item)) {
+            // Server lists are stored one item per line
+            std::string value = JoinStringArray(item);
+            if (settings.GetString(item->string) != value) {
+                settings.SetString(item->string, value);
+                changed++;
+            }
+        }
+    }
+    return changed;
+}
 
 Ota::Ota() {
 #ifdef ESP_EFUSE_BLOCK_USR_DATA
@@ -41,8 +100,7 @@ Ota::~Ota() {
 }
 
 std::string Ota::GetCheckVersionUrl() {
-    Settings settings("wifi", false);
-    std::string url = settings.GetString("ota_url");
+    std::string url = SettingsSchema::kOtaUrl.Get();
     if (url.empty()) {
         url = CONFIG_OTA_URL;
     }
@@ -72,6 +130,7 @@ std::unique_ptr<Http> Ota::SetupHttp() {
  * Specification: https://ccnphfhqs21z.feishu.cn/wiki/FjW6wZmisimNBBkov6OcmfvknVd
  */
 bool Ota::CheckVersion() {
+    BootTraceScope trace("ota.check_version");
     auto& board = Board::GetInstance();
     auto app_desc = esp_app_get_description();
 
@@ -105,7 +164,7 @@ bool Ota::CheckVersion() {
     data = http->ReadAll();
     http->Close();
 
-    // Response: { "firmware": { "version": "1.0.0", "url": "http://" } }
+    // Response: { "firmware": { "version": "1.0.0", "url": "http://", "delta_url": "http://" (optional) } }
     // Parse the JSON response and check if the version is newer
     // If it is, set has_new_version_ to true and store the new version and URL
     
@@ -139,22 +198,13 @@ bool Ota::CheckVersion() {
         }
     }
 
+    // The server sends its whole config on every check, only keys that differ are written,
+    // and they are committed together below
+    int changed_settings = 0;
     has_mqtt_config_ = false;
     cJSON *mqtt = cJSON_GetObjectItem(root, "mqtt");
     if (cJSON_IsObject(mqtt)) {
-        Settings settings("mqtt", true);
-        cJSON *item = NULL;
-        cJSON_ArrayForEach(item, mqtt) {
-            if (cJSON_IsString(item)) {
-                if (settings.GetString(item->string) != item->valuestring) {
-                    settings.SetString(item->string, item->valuestring);
-                }
-            } else if (cJSON_IsNumber(item)) {
-                if (settings.GetInt(item->string) != item->valueint) {
-                    settings.SetInt(item->string, item->valueint);
-                }
-            }
-        }
+        changed_settings += ApplyServerConfig("mqtt", mqtt);
         has_mqtt_config_ = true;
     } else {
         ESP_LOGI(TAG, "No mqtt section found !");
@@ -163,23 +213,15 @@ bool Ota::CheckVersion() {
     has_websocket_config_ = false;
     cJSON *websocket = cJSON_GetObjectItem(root, "websocket");
     if (cJSON_IsObject(websocket)) {
-        Settings settings("websocket", true);
-        cJSON *item = NULL;
-        cJSON_ArrayForEach(item, websocket) {
-            if (cJSON_IsString(item)) {
-                if (settings.GetString(item->string) != item->valuestring) {
-                    settings.SetString(item->string, item->valuestring);
-                }
-            } else if (cJSON_IsNumber(item)) {
-                if (settings.GetInt(item->string) != item->valueint) {
-                    settings.SetInt(item->string, item->valueint);
-                }
-            }
-        }
+        changed_settings += ApplyServerConfig("websocket", websocket);
         has_websocket_config_ = true;
     } else {
         ESP_LOGI(TAG, "No websocket section found!");
     }
+    if (changed_settings > 0) {
+        ESP_LOGI(TAG, "Server config changed %d settings", changed_settings);
+        Settings::Flush();
+    }
 
     has_server_time_ = false;
     cJSON *server_time = cJSON_GetObjectItem(root, "server_time");
@@ -217,6 +259,12 @@ bool Ota::CheckVersion() {
         if (cJSON_IsString(url)) {
             firmware_url_ = url->valuestring;
         }
+        // Optional patch from the running firmware (identified by elf_sha256 in the system info)
+        firmware_delta_url_.clear();
+        cJSON *delta_url = cJSON_GetObjectItem(firmware, "delta_url");
+        if (cJSON_IsString(delta_url)) {
+            firmware_delta_url_ = delta_url->valuestring;
+        }
 
         if (cJSON_IsString(version) && cJSON_IsString(url)) {
             // Check if the version is newer, for example, 0.1.0 is newer than 0.0.1
@@ -270,82 +318,61 @@ bool Ota::Upgrade(const std::string& firmware_url) {
     }
 
     ESP_LOGI(TAG, "Writing to partition %s at offset 0x%lx", update_partition->label, update_partition->address);
-    bool image_header_checked = false;
-    std::string image_header;
-
-    auto network = Board::GetInstance().GetNetwork();
-    auto http = network->CreateHttp(0);
-    if (!http->Open("GET", firmware_url)) {
-        ESP_LOGE(TAG, "Failed to open HTTP connection");
-        return false;
-    }
-
-    if (http->GetStatusCode() != 200) {
-        ESP_LOGE(TAG, "Failed to get firmware, status code: %d", http->GetStatusCode());
-        return false;
-    }
-
-    size_t content_length = http->GetBodyLength();
-    if (content_length == 0) {
-        ESP_LOGE(TAG, "Failed to get content length");
-        return false;
-    }
 
-    char buffer[512];
-    size_t total_read = 0, recent_read = 0;
-    auto last_calc_time = esp_timer_get_time();
-    while (true) {
-        int ret = http->Read(buffer, sizeof(buffer));
-        if (ret < 0) {
-            ESP_LOGE(TAG, "Failed to read HTTP data: %s", esp_err_to_name(ret));
+    // The download of the same url into the same partition continues after a disconnect or reboot
+    HttpDownloader downloader("dl_ota");
+    downloader.SetRateLimit(rate_limit_);
+    bool ota_begun = false;
+    DownloadCallbacks callbacks;
+    callbacks.on_begin = [&](size_t offset, size_t total_size) {
+        if (total_size > update_partition->size) {
+            ESP_LOGE(TAG, "Firmware size (%u) is larger than partition size (%lu)", total_size, update_partition->size);
             return false;
         }
-
-        // Calculate speed and progress every second
-        recent_read += ret;
-        total_read += ret;
-        if (esp_timer_get_time() - last_calc_time >= 1000000 || ret == 0) {
-            size_t progress = total_read * 100 / content_length;
-            ESP_LOGI(TAG, "Progress: %u%% (%u/%u), Speed: %uB/s", progress, total_read, content_length, recent_read);
-            if (upgrade_callback_) {
-                upgrade_callback_(progress, recent_read);
-            }
-            last_calc_time = esp_timer_get_time();
-            recent_read = 0;
+        esp_err_t err;
+        if (offset == 0) {
+            err = esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &update_handle);
+        } else {
+            err = esp_ota_resume(update_partition, OTA_WITH_SEQUENTIAL_WRITES, offset, &update_handle);
         }
-
-        if (ret == 0) {
-            break;
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to begin OTA: %s", esp_err_to_name(err));
+            return false;
         }
-
-        if (!image_header_checked) {
-            image_header.append(buffer, ret);
-            if (image_header.size() >= sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t)) {
-                esp_app_desc_t new_app_info;
-                memcpy(&new_app_info, image_header.data() + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t), sizeof(esp_app_desc_t));
-                
-                auto current_version = esp_app_get_description()->version;
-                ESP_LOGI(TAG, "Current version: %s, New version: %s", current_version, new_app_info.version);
-
-                if (esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &update_handle)) {
-                    esp_ota_abort(update_handle);
-                    ESP_LOGE(TAG, "Failed to begin OTA");
-                    return false;
-                }
-
-                image_header_checked = true;
-                std::string().swap(image_header);
-            }
+        ota_begun = true;
+        return true;
+    };
+    callbacks.on_data = [&](size_t offset, const char* data, size_t size) {
+        const size_t header_size = sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t);
+        if (offset == 0 && size >= header_size) {
+            esp_app_desc_t new_app_info;
+            memcpy(&new_app_info, data + sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t), sizeof(esp_app_desc_t));
+            auto current_version = esp_app_get_description()->version;
+            ESP_LOGI(TAG, "Current version: %s, New version: %s", current_version, new_app_info.version);
         }
-        auto err = esp_ota_write(update_handle, buffer, ret);
+        auto err = esp_ota_write(update_handle, data, size);
         if (err != ESP_OK) {
             ESP_LOGE(TAG, "Failed to write OTA data: %s", esp_err_to_name(err));
-            esp_ota_abort(update_handle);
             return false;
         }
+        return true;
+    };
+    callbacks.on_read_back = [update_partition](size_t offset, char* buffer, size_t size) {
+        return esp_partition_read(update_partition, offset, buffer, size) == ESP_OK;
+    };
+    callbacks.on_progress = upgrade_callback_;
+
+    if (!downloader.Download(firmware_url, callbacks)) {
+        if (ota_begun) {
+            esp_ota_abort(update_handle);
+        }
+        return false;
     }
-    http->Close();
 
+    return FinishUpgrade(update_handle, update_partition);
+}
+
+bool Ota::FinishUpgrade(esp_ota_handle_t update_handle, const esp_partition_t* update_partition) {
     esp_err_t err = esp_ota_end(update_handle);
     if (err != ESP_OK) {
         if (err == ESP_ERR_OTA_VALIDATE_FAILED) {
@@ -362,12 +389,88 @@ bool Ota::Upgrade(const std::string& firmware_url) {
         return false;
     }
 
+    // The new firmware boots as pending verify, and the bootloader rolls back unless MarkCurrentVersionValid is called
     ESP_LOGI(TAG, "Firmware upgrade successful");
     return true;
 }
 
+/*
+ * Rebuild the new firmware from the running partition and a patch made by scripts/delta_ota.py.
+ * The patch is applied while it is downloaded, the output goes straight into the next OTA partition.
+ */
+bool Ota::UpgradeDelta(const std::string& delta_url) {
+    ESP_LOGI(TAG, "Upgrading firmware with patch from %s", delta_url.c_str());
+    auto running_partition = esp_ota_get_running_partition();
+    auto update_partition = esp_ota_get_next_update_partition(NULL);
+    if (running_partition == NULL || update_partition == NULL) {
+        ESP_LOGE(TAG, "Failed to get OTA partitions");
+        return false;
+    }
+
+    esp_ota_handle_t update_handle = 0;
+    bool ota_begun = false;
+    DeltaPatcher patcher(
+        [running_partition](size_t offset, uint8_t* buffer, size_t size) {
+            return esp_partition_read(running_partition, offset, buffer, size) == ESP_OK;
+        },
+        [&update_handle](const uint8_t* data, size_t size) {
+            auto err = esp_ota_write(update_handle, data, size);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to write OTA data: %s", esp_err_to_name(err));
+                return false;
+            }
+            return true;
+        });
+    patcher.SetSourceElfSha256(esp_app_get_description()->app_elf_sha256);
+
+    // The patch output cannot be read back to check a checkpoint, so without on_read_back the
+    // download only resumes within this attempt and saves no checkpoints
+    HttpDownloader downloader("dl_delta");
+    downloader.SetRateLimit(rate_limit_);
+    DownloadCallbacks callbacks;
+    callbacks.on_begin = [&](size_t offset, size_t total_size) {
+        if (offset != 0) {
+            return false;
+        }
+        auto err = esp_ota_begin(update_partition, OTA_WITH_SEQUENTIAL_WRITES, &update_handle);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to begin OTA: %s", esp_err_to_name(err));
+            return false;
+        }
+        ota_begun = true;
+        return true;
+    };
+    callbacks.on_data = [&](size_t offset, const char* data, size_t size) {
+        if (!patcher.Feed((const uint8_t*)data, size)) {
+            return false;
+        }
+        if (patcher.target_size() > update_partition->size) {
+            ESP_LOGE(TAG, "Firmware size (%u) is larger than partition size (%lu)", patcher.target_size(), update_partition->size);
+            return false;
+        }
+        return true;
+    };
+    callbacks.on_progress = upgrade_callback_;
+
+    if (!downloader.Download(delta_url, callbacks) || !patcher.Finish()) {
+        downloader.ClearProgress();
+        if (ota_begun) {
+            esp_ota_abort(update_handle);
+        }
+        return false;
+    }
+    ESP_LOGI(TAG, "Patch of %u bytes rebuilt %u bytes of firmware", downloader.total_size(), patcher.written());
+    return FinishUpgrade(update_handle, update_partition);
+}
+
 bool Ota::StartUpgrade(std::function<void(int progress, size_t speed)> callback) {
     upgrade_callback_ = callback;
+    if (!firmware_delta_url_.empty()) {
+        if (UpgradeDelta(firmware_delta_url_)) {
+            return true;
+        }
+        ESP_LOGW(TAG, "Delta upgrade failed, download the full firmware instead");
+    }
     return Upgrade(firmware_url_);
 }
 
@@ -5,6 +5,7 @@
 #include <string>
 
 #include <esp_err.h>
+#include <esp_ota_ops.h>
 #include "board.h"
 
 class Ota {
@@ -23,6 +24,8 @@ public:
     bool StartUpgrade(std::function<void(int progress, size_t speed)> callback);
     bool StartUpgradeFromUrl(const std::string& url, std::function<void(int progress, size_t speed)> callback);
     void MarkCurrentVersionValid();
+    // Limit the download speed of the upgrades, see HttpDownloader::SetRateLimit
+    void SetRateLimit(std::function<size_t()> rate_limit) { rate_limit_ = rate_limit; }
 
     const std::string& GetFirmwareVersion() const { return firmware_version_; }
     const std::string& GetCurrentVersion() const { return current_version_; }
@@ -44,12 +47,16 @@ private:
     std::string current_version_;
     std::string firmware_version_;
     std::string firmware_url_;
+    std::string firmware_delta_url_;
     std::string activation_challenge_;
     std::string serial_number_;
     int activation_timeout_ms_ = 30000;
 
     bool Upgrade(const std::string& firmware_url);
+    bool UpgradeDelta(const std::string& delta_url);
+    bool FinishUpgrade(esp_ota_handle_t update_handle, const esp_partition_t* update_partition);
     std::function<void(int progress, size_t speed)> upgrade_callback_;
+    std::function<size_t()> rate_limit_;
     std::vector<int> ParseVersion(const std::string& version);
     bool IsNewVersionAvailable(const std::string& currentVersion, const std::string& newVersion);
     std::string GetActivationPayload();
@@ -0,0 +1,207 @@
+#include "endpoint_selector.h"
+#include "settings.h"
+
+#include <esp_log.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#define TAG "EndpointSelector"
+
+EndpointSelector::EndpointSelector(const std::string& settings_ns) : settings_ns_(settings_ns) {
+}
+
+std::vector<std::string> EndpointSelector::Split(const std::string& text) {
+    std::vector<std::string> result;
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find_first_of("\n,", start);
+        if (end == std::string::npos) {
+            end = text.size();
+        }
+        // Only newlines and commas separate endpoints, the spaces around them are trimmed
+        size_t first = text.find_first_not_of(" \t\r", start);
+        size_t last = text.find_last_not_of(" \t\r", end - 1);
+        if (first < end && last != std::string::npos && last >= first) {
+            auto endpoint = text.substr(first, last - first + 1);
+            if (std::find(result.begin(), result.end(), endpoint) == result.end()) {
+                result.push_back(endpoint);
+            }
+        }
+        start = end + 1;
+    }
+    return result;
+}
+
+uint32_t EndpointSelector::Hash(const std::string& endpoint) {
+    // FNV-1a, only used to match persisted statistics with the configured endpoints
+    uint32_t hash = 2166136261u;
+    for (unsigned char c : endpoint) {
+        hash = (hash ^ c) * 16777619u;
+    }
+    return hash;
+}
+
+void EndpointSelector::SetEndpoints(const std::vector<std::string>& endpoints) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<Entry> entries;
+    for (auto& endpoint : endpoints) {
+        if (entries.size() >= ENDPOINT_MAX_COUNT) {
+            ESP_LOGW(TAG, "Too many endpoints, ignore %s", endpoint.c_str());
+            continue;
+        }
+        auto existing = Find(endpoint);
+        if (existing != nullptr) {
+            entries.push_back(*existing);
+        } else {
+            entries.push_back(Entry{endpoint, Hash(endpoint), 0, 0});
+        }
+    }
+    entries_ = std::move(entries);
+    if (!loaded_) {
+        loaded_ = true;
+        Load();
+    }
+}
+
+EndpointSelector::Entry* EndpointSelector::Find(const std::string& endpoint) {
+    for (auto& entry : entries_) {
+        if (entry.endpoint == endpoint) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+int EndpointSelector::Score(const Entry& entry) const {
+    int rtt = entry.rtt_ms > 0 ? entry.rtt_ms : ENDPOINT_UNMEASURED_MS;
+    return rtt + std::min(entry.failures, ENDPOINT_MAX_FAILURES) * ENDPOINT_FAILURE_PENALTY_MS;
+}
+
+std::vector<const EndpointSelector::Entry*> EndpointSelector::Rank() const {
+    std::vector<const Entry*> ranking;
+    for (auto& entry : entries_) {
+        ranking.push_back(&entry);
+    }
+    // Stable sort keeps the configured order between endpoints with the same score
+    std::stable_sort(ranking.begin(), ranking.end(), [this](const Entry* a, const Entry* b) {
+        return Score(*a) < Score(*b);
+    });
+
+    // Keep using the current endpoint while it is healthy and close enough to the best one
+    for (size_t i = 1; i < ranking.size(); i++) {
+        auto entry = ranking[i];
+        if (entry->hash == current_ && entry->failures == 0 &&
+            Score(*entry) * 100 <= Score(*ranking[0]) * (100 + ENDPOINT_STICKY_PERCENT)) {
+            ranking.erase(ranking.begin() + i);
+            ranking.insert(ranking.begin(), entry);
+            break;
+        }
+    }
+    return ranking;
+}
+
+std::vector<std::string> EndpointSelector::GetRanking() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::string> result;
+    for (auto entry : Rank()) {
+        result.push_back(entry->endpoint);
+    }
+    return result;
+}
+
+int EndpointSelector::GetRaceDelay() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int best = 0;
+    for (auto& entry : entries_) {
+        if (entry.rtt_ms > 0 && entry.failures == 0 && (best == 0 || entry.rtt_ms < best)) {
+            best = entry.rtt_ms;
+        }
+    }
+    // Give the best candidate a little more than its usual handshake time, like happy eyeballs
+    return std::clamp(best * 3 / 2, 250, 2000);
+}
+
+void EndpointSelector::ReportSuccess(const std::string& endpoint, int elapsed_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto entry = Find(endpoint);
+    if (entry == nullptr) {
+        return;
+    }
+    entry->rtt_ms = entry->rtt_ms > 0 ? (entry->rtt_ms * 3 + elapsed_ms) / 4 : elapsed_ms;
+    if (entry->rtt_ms < 1) {
+        entry->rtt_ms = 1;
+    }
+    entry->failures = 0;
+    current_ = entry->hash;
+    ESP_LOGI(TAG, "%s connected in %dms, smoothed %dms", endpoint.c_str(), elapsed_ms, entry->rtt_ms);
+    SaveIfPreferredChanged();
+}
+
+void EndpointSelector::ReportFailure(const std::string& endpoint) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto entry = Find(endpoint);
+    if (entry == nullptr) {
+        return;
+    }
+    if (entry->failures < ENDPOINT_MAX_FAILURES) {
+        entry->failures++;
+    }
+    if (entry->hash == current_) {
+        current_ = 0;
+    }
+    ESP_LOGW(TAG, "%s failed %d times", endpoint.c_str(), entry->failures);
+    SaveIfPreferredChanged();
+}
+
+void EndpointSelector::Load() {
+    Settings settings(settings_ns_, false);
+    current_ = (uint32_t)settings.GetInt("current");
+    // Format: |hash hex|,|rtt_ms|,|failures|; ...
+    auto ranking = settings.GetString("ranking");
+    const char* p = ranking.c_str();
+    while (*p != '\0') {
+        unsigned long hash = 0;
+        int rtt_ms = 0, failures = 0, length = 0;
+        if (sscanf(p, "%lx,%d,%d;%n", &hash, &rtt_ms, &failures, &length) != 3 || length == 0) {
+            break;
+        }
+        for (auto& entry : entries_) {
+            if (entry.hash == hash) {
+                entry.rtt_ms = rtt_ms;
+                entry.failures = failures;
+            }
+        }
+        p += length;
+    }
+    auto best = Rank();
+    saved_best_ = best.empty() ? 0 : best[0]->hash;
+}
+
+// While the ranking written last still puts the same endpoint first, a reboot picks it anyway,
+// so smoothed times and failure counts stay in memory until another endpoint takes the lead
+void EndpointSelector::SaveIfPreferredChanged() {
+    auto ranking = Rank();
+    if (ranking.empty() || ranking[0]->hash == saved_best_) {
+        return;
+    }
+    ESP_LOGI(TAG, "Preferred endpoint is now %s", ranking[0]->endpoint.c_str());
+    saved_best_ = ranking[0]->hash;
+    Save();
+}
+
+void EndpointSelector::Save() {
+    std::string ranking;
+    char item[32];
+    for (auto& entry : entries_) {
+        snprintf(item, sizeof(item), "%lx,%d,%d;", (unsigned long)entry.hash, entry.rtt_ms, entry.failures);
+        ranking += item;
+    }
+    Settings settings(settings_ns_, true);
+    if (settings.GetString("ranking") != ranking) {
+        settings.SetString("ranking", ranking);
+    }
+    if ((uint32_t)settings.GetInt("current") != current_) {
+        settings.SetInt("current", (int32_t)current_);
+    }
+}
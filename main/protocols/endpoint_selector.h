@@ -0,0 +1,67 @@
+#ifndef ENDPOINT_SELECTOR_H
+#define ENDPOINT_SELECTOR_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <cstdint>
+
+#define ENDPOINT_MAX_COUNT 8
+#define ENDPOINT_UNMEASURED_MS 1000     // Assumed handshake time of an endpoint that never connected
+#define ENDPOINT_FAILURE_PENALTY_MS 3000
+#define ENDPOINT_MAX_FAILURES 5
+#define ENDPOINT_STICKY_PERCENT 20      // The current endpoint is kept unless another one is this much faster
+
+/*
+ * Ranks the configured server endpoints by measured handshake time and recent failures.
+ *
+ * Every connection attempt reports its result. The ranking is persisted in NVS whenever the
+ * preferred endpoint changes, so that it is tried first after a reboot without a flash write
+ * per connection. The endpoint that connected
+ * last is sticky, so devices do not flap between two servers with similar latency.
+ * Thread safe, results of connection races may be reported from any task.
+ */
+class EndpointSelector {
+public:
+    // Ranking is stored in the given settings namespace
+    explicit EndpointSelector(const std::string& settings_ns);
+
+    // Endpoints in configured order, statistics of endpoints that are still listed are kept
+    void SetEndpoints(const std::vector<std::string>& endpoints);
+    // Candidates, best first
+    std::vector<std::string> GetRanking();
+    // How long to wait for the best candidate before racing the next one
+    int GetRaceDelay();
+
+    void ReportSuccess(const std::string& endpoint, int elapsed_ms);
+    void ReportFailure(const std::string& endpoint);
+
+    // Split an endpoint list stored as one endpoint per line or separated by commas, spaces
+    // around each endpoint are trimmed
+    static std::vector<std::string> Split(const std::string& text);
+
+private:
+    struct Entry {
+        std::string endpoint;
+        uint32_t hash;
+        int rtt_ms;         // Smoothed handshake time, 0 if never measured
+        int failures;       // Consecutive failures
+    };
+
+    std::mutex mutex_;
+    std::string settings_ns_;
+    std::vector<Entry> entries_;
+    uint32_t current_ = 0;  // Hash of the endpoint that connected last
+    uint32_t saved_best_ = 0;   // Hash of the preferred endpoint in the persisted ranking
+    bool loaded_ = false;
+
+    static uint32_t Hash(const std::string& endpoint);
+    int Score(const Entry& entry) const;
+    Entry* Find(const std::string& endpoint);
+    std::vector<const Entry*> Rank() const;
+    void SaveIfPreferredChanged();
+    void Load();
+    void Save();
+};
+
+#endif // ENDPOINT_SELECTOR_H
@@ -1,16 +1,35 @@
 #include "mqtt_protocol.h"
 #include "board.h"
 #include "application.h"
-#include "settings.h"
+#include "settings_schema.h"
 
 #include <esp_log.h>
 #include <cstring>
+#include <cstdlib>
+#include <algorithm>
 #include <arpa/inet.h>
 #include "assets/lang_config.h"
 
 #define TAG "MQTT"
 
-MqttProtocol::MqttProtocol() {
+// host[:port], the port defaults to 8883. Endpoints come from the server, so a bad one is rejected, not thrown on
+static bool ParseEndpoint(const std::string& endpoint, std::string& address, int& port) {
+    size_t pos = endpoint.find(':');
+    address = endpoint.substr(0, pos);
+    port = 8883;
+    if (pos != std::string::npos) {
+        const char* text = endpoint.c_str() + pos + 1;
+        char* end = nullptr;
+        long value = strtol(text, &end, 10);
+        if (end == text || *end != '\0' || value < 1 || value > 65535) {
+            return false;
+        }
+        port = (int)value;
+    }
+    return !address.empty();
+}
+
+MqttProtocol::MqttProtocol() : endpoint_selector_("mqtt_rank") {
     event_group_handle_ = xEventGroupCreate();
 
     // Initialize reconnect timer
@@ -28,6 +47,18 @@ MqttProtocol::MqttProtocol() {
         .arg = this,
     };
     esp_timer_create(&reconnect_timer_args, &reconnect_timer_);
+
+    esp_timer_create_args_t reliability_timer_args = {
+        .callback = [](void* arg) {
+            MqttProtocol* protocol = (MqttProtocol*)arg;
+            protocol->PollReliability();
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "udp_reliability",
+        .skip_unhandled_events = true,
+    };
+    esp_timer_create(&reliability_timer_args, &reliability_timer_);
 }
 
 MqttProtocol::~MqttProtocol() {
@@ -36,6 +67,10 @@ MqttProtocol::~MqttProtocol() {
         esp_timer_stop(reconnect_timer_);
         esp_timer_delete(reconnect_timer_);
     }
+    if (reliability_timer_ != nullptr) {
+        esp_timer_stop(reliability_timer_);
+        esp_timer_delete(reliability_timer_);
+    }
 
     udp_.reset();
     mqtt_.reset();
@@ -55,15 +90,15 @@ bool MqttProtocol::StartMqttClient(bool report_error) {
         mqtt_.reset();
     }
 
-    Settings settings("mqtt", false);
-    auto endpoint = settings.GetString("endpoint");
-    auto client_id = settings.GetString("client_id");
-    auto username = settings.GetString("username");
-    auto password = settings.GetString("password");
-    int keepalive_interval = settings.GetInt("keepalive", 240);
-    publish_topic_ = settings.GetString("publish_topic");
+    // Optional list of alternative brokers, in addition to endpoint
+    auto endpoints = EndpointSelector::Split(SettingsSchema::kMqttEndpoint.Get() + "\n" + SettingsSchema::kMqttEndpoints.Get());
+    auto client_id = SettingsSchema::kMqttClientId.Get();
+    auto username = SettingsSchema::kMqttUsername.Get();
+    auto password = SettingsSchema::kMqttPassword.Get();
+    int keepalive_interval = SettingsSchema::kMqttKeepalive.Get();
+    publish_topic_ = SettingsSchema::kMqttPublishTopic.Get();
 
-    if (endpoint.empty()) {
+    if (endpoints.empty()) {
         ESP_LOGW(TAG, "MQTT endpoint is not specified");
         if (report_error) {
             SetError(Lang::Strings::SERVER_NOT_FOUND);
@@ -79,8 +114,9 @@ bool MqttProtocol::StartMqttClient(bool report_error) {
         if (on_disconnected_ != nullptr) {
             on_disconnected_();
         }
-        ESP_LOGI(TAG, "MQTT disconnected, schedule reconnect in %d seconds", MQTT_RECONNECT_INTERVAL_MS / 1000);
-        esp_timer_start_once(reconnect_timer_, MQTT_RECONNECT_INTERVAL_MS * 1000);
+        ESP_LOGI(TAG, "MQTT disconnected, schedule reconnect in %d seconds", reconnect_interval_ms_ / 1000);
+        esp_timer_start_once(reconnect_timer_, reconnect_interval_ms_ * 1000);
+        reconnect_interval_ms_ = std::min(reconnect_interval_ms_ * 2, MQTT_RECONNECT_INTERVAL_MS);
     });
 
     mqtt_->OnConnected([this]() {
@@ -88,27 +124,27 @@ bool MqttProtocol::StartMqttClient(bool report_error) {
             on_connected_();
         }
         esp_timer_stop(reconnect_timer_);
+        reconnect_interval_ms_ = MQTT_RECONNECT_MIN_INTERVAL_MS;
     });
 
     mqtt_->OnMessage([this](const std::string& topic, const std::string& payload) {
-        cJSON* root = cJSON_Parse(payload.c_str());
-        if (root == nullptr) {
+        if (!json_reader_.Parse(payload)) {
             ESP_LOGE(TAG, "Failed to parse json message %s", payload.c_str());
             return;
         }
-        cJSON* type = cJSON_GetObjectItem(root, "type");
-        if (!cJSON_IsString(type)) {
+        auto root = json_reader_.root();
+        auto type = root["type"];
+        if (!type.IsString()) {
             ESP_LOGE(TAG, "Message type is invalid");
-            cJSON_Delete(root);
             return;
         }
 
-        if (strcmp(type->valuestring, "hello") == 0) {
+        if (type.Equals("hello")) {
             ParseServerHello(root);
-        } else if (strcmp(type->valuestring, "goodbye") == 0) {
-            auto session_id = cJSON_GetObjectItem(root, "session_id");
-            ESP_LOGI(TAG, "Received goodbye message, session_id: %s", session_id ? session_id->valuestring : "null");
-            if (session_id == nullptr || session_id_ == session_id->valuestring) {
+        } else if (type.Equals("goodbye")) {
+            auto session_id = root["session_id"];
+            ESP_LOGI(TAG, "Received goodbye message, session_id: %s", session_id.GetString("null").c_str());
+            if (!session_id.IsString() || session_id.Equals(session_id_)) {
                 Application::GetInstance().Schedule([this]() {
                     CloseAudioChannel();
                 });
@@ -116,28 +152,42 @@ bool MqttProtocol::StartMqttClient(bool report_error) {
         } else if (on_incoming_json_ != nullptr) {
             on_incoming_json_(root);
         }
-        cJSON_Delete(root);
         last_incoming_time_ = std::chrono::steady_clock::now();
     });
 
-    ESP_LOGI(TAG, "Connecting to endpoint %s", endpoint.c_str());
-    std::string broker_address;
-    int broker_port = 8883;
-    size_t pos = endpoint.find(':');
-    if (pos != std::string::npos) {
-        broker_address = endpoint.substr(0, pos);
-        broker_port = std::stoi(endpoint.substr(pos + 1));
-    } else {
-        broker_address = endpoint;
-    }
-    if (!mqtt_->Connect(broker_address, broker_port, client_id, username, password)) {
-        ESP_LOGE(TAG, "Failed to connect to endpoint");
-        SetError(Lang::Strings::SERVER_NOT_CONNECTED);
-        return false;
+    /*
+     * Brokers are tried one after another in ranked order. Unlike the websocket servers they are
+     * not raced, two sessions with the same client id would kick each other off the broker.
+     */
+    std::vector<std::string> valid_endpoints;
+    for (auto& endpoint : endpoints) {
+        std::string broker_address;
+        int broker_port;
+        if (ParseEndpoint(endpoint, broker_address, broker_port)) {
+            valid_endpoints.push_back(endpoint);
+        } else {
+            ESP_LOGW(TAG, "Invalid endpoint %s, skipped", endpoint.c_str());
+        }
+    }
+    endpoint_selector_.SetEndpoints(valid_endpoints);
+    for (auto& endpoint : endpoint_selector_.GetRanking()) {
+        ESP_LOGI(TAG, "Connecting to endpoint %s", endpoint.c_str());
+        std::string broker_address;
+        int broker_port;
+        ParseEndpoint(endpoint, broker_address, broker_port);
+        auto start_time = esp_timer_get_time();
+        if (mqtt_->Connect(broker_address, broker_port, client_id, username, password)) {
+            endpoint_selector_.ReportSuccess(endpoint, (esp_timer_get_time() - start_time) / 1000);
+            ESP_LOGI(TAG, "Connected to endpoint");
+            return true;
+        }
+        ESP_LOGW(TAG, "Failed to connect to endpoint %s", endpoint.c_str());
+        endpoint_selector_.ReportFailure(endpoint);
     }
 
-    ESP_LOGI(TAG, "Connected to endpoint");
-    return true;
+    ESP_LOGE(TAG, "Failed to connect to endpoint");
+    SetError(Lang::Strings::SERVER_NOT_CONNECTED);
+    return false;
 }
 
 bool MqttProtocol::SendText(const std::string& text) {
@@ -152,43 +202,120 @@ bool MqttProtocol::SendText(const std::string& text) {
     return true;
 }
 
+bool MqttProtocol::EncryptPacket(uint8_t type, uint32_t timestamp, uint32_t sequence, const uint8_t* payload, size_t size, std::string& output) {
+    output.resize(aes_nonce_.size() + size);
+    memcpy(output.data(), aes_nonce_.data(), aes_nonce_.size());
+    if (type != UDP_PACKET_TYPE_AUDIO) {
+        // Audio keeps the type byte of the server nonce
+        output[0] = type;
+    }
+    *(uint16_t*)&output[2] = htons(size);
+    *(uint32_t*)&output[8] = htonl(timestamp);
+    *(uint32_t*)&output[12] = htonl(sequence);
+
+    uint8_t nonce[16];
+    memcpy(nonce, output.data(), sizeof(nonce));
+    size_t nc_off = 0;
+    uint8_t stream_block[16] = {0};
+    return mbedtls_aes_crypt_ctr(&aes_ctx_, size, &nc_off, nonce, stream_block, payload, (uint8_t*)&output[aes_nonce_.size()]) == 0;
+}
+
+bool MqttProtocol::DecryptPacket(const std::string& data, std::vector<uint8_t>& payload) {
+    size_t decrypted_size = data.size() - aes_nonce_.size();
+    uint8_t nonce[16];
+    memcpy(nonce, data.data(), sizeof(nonce));
+    size_t nc_off = 0;
+    uint8_t stream_block[16] = {0};
+    auto encrypted = (uint8_t*)data.data() + aes_nonce_.size();
+    payload.resize(decrypted_size);
+    int ret = mbedtls_aes_crypt_ctr(&aes_ctx_, decrypted_size, &nc_off, nonce, stream_block, encrypted, payload.data());
+    if (ret != 0) {
+        ESP_LOGE(TAG, "Failed to decrypt audio data, ret: %d", ret);
+        return false;
+    }
+    return true;
+}
+
 bool MqttProtocol::SendAudio(std::unique_ptr<AudioStreamPacket> packet) {
     std::lock_guard<std::mutex> lock(channel_mutex_);
     if (udp_ == nullptr) {
         return false;
     }
 
-    std::string nonce(aes_nonce_);
-    *(uint16_t*)&nonce[2] = htons(packet->payload.size());
-    *(uint32_t*)&nonce[8] = htonl(packet->timestamp);
-    *(uint32_t*)&nonce[12] = htonl(++local_sequence_);
-
+    uint32_t sequence = ++local_sequence_;
     std::string encrypted;
-    encrypted.resize(aes_nonce_.size() + packet->payload.size());
-    memcpy(encrypted.data(), nonce.data(), nonce.size());
-
-    size_t nc_off = 0;
-    uint8_t stream_block[16] = {0};
-    if (mbedtls_aes_crypt_ctr(&aes_ctx_, packet->payload.size(), &nc_off, (uint8_t*)nonce.c_str(), stream_block,
-        (uint8_t*)packet->payload.data(), (uint8_t*)&encrypted[nonce.size()]) != 0) {
+    if (!EncryptPacket(UDP_PACKET_TYPE_AUDIO, packet->timestamp, sequence, packet->payload.data(), packet->payload.size(), encrypted)) {
         ESP_LOGE(TAG, "Failed to encrypt audio data");
         return false;
     }
+    if (udp_->Send(encrypted) <= 0) {
+        return false;
+    }
 
-    return udp_->Send(encrypted) > 0;
+    if (reliability_ != nullptr) {
+        std::lock_guard<std::mutex> reliability_lock(reliability_mutex_);
+        if (reliability_->OnAudioSent(sequence, packet->timestamp, packet->payload, std::move(encrypted))) {
+            auto& parity = reliability_->parity();
+            std::string datagram;
+            if (EncryptPacket(UDP_PACKET_TYPE_PARITY, 0, reliability_->parity_sequence(), (const uint8_t*)parity.data(), parity.size(), datagram)) {
+                udp_->Send(datagram);
+            }
+        }
+    }
+    return true;
+}
+
+void MqttProtocol::PollReliability() {
+    std::lock_guard<std::mutex> lock(channel_mutex_);
+    if (udp_ == nullptr || reliability_ == nullptr) {
+        return;
+    }
+    std::lock_guard<std::mutex> reliability_lock(reliability_mutex_);
+    reliability_->TakeRetransmits([this](const std::string& datagram) {
+        udp_->Send(datagram);
+    });
+    if (reliability_->Poll(esp_timer_get_time() / 1000, nack_buffer_)) {
+        std::string datagram;
+        if (EncryptPacket(UDP_PACKET_TYPE_NACK, 0, ++nack_sequence_, (const uint8_t*)nack_buffer_.data(), nack_buffer_.size(), datagram)) {
+            udp_->Send(datagram);
+        }
+    }
+}
+
+UdpReliabilityStats MqttProtocol::GetUdpStats() {
+    std::lock_guard<std::mutex> lock(reliability_mutex_);
+    if (reliability_ == nullptr) {
+        return UdpReliabilityStats();
+    }
+    return reliability_->stats();
 }
 
 void MqttProtocol::CloseAudioChannel() {
+    esp_timer_stop(reliability_timer_);
     {
         std::lock_guard<std::mutex> lock(channel_mutex_);
         udp_.reset();
+
+        std::lock_guard<std::mutex> reliability_lock(reliability_mutex_);
+        if (reliability_ != nullptr) {
+            auto& stats = reliability_->stats();
+            ESP_LOGI(TAG, "UDP received: %lu, lost: %lu, late: %lu, duplicates: %lu, recovered by NACK: %lu, by parity: %lu",
+                stats.received, stats.lost, stats.late, stats.duplicates, stats.recovered_nack, stats.recovered_parity);
+            ESP_LOGI(TAG, "UDP NACKs sent: %lu, received: %lu, retransmitted: %lu, parity sent: %lu",
+                stats.nacks_sent, stats.nacks_received, stats.retransmitted, stats.parity_sent);
+            reliability_.reset();
+        }
     }
 
-    std::string message = "{";
-    message += "\"session_id\":\"" + session_id_ + "\",";
-    message += "\"type\":\"goodbye\"";
-    message += "}";
-    SendText(message);
+    {
+        std::lock_guard<std::mutex> lock(json_writer_mutex_);
+        json_writer_.Clear();
+        json_writer_.BeginObject();
+        json_writer_.Member("session_id", session_id_);
+        json_writer_.Member("type", "goodbye");
+        json_writer_.EndObject();
+        SendText(json_writer_.str());
+    }
 
     if (on_audio_channel_closed_ != nullptr) {
         on_audio_channel_closed_();
@@ -205,6 +332,7 @@ bool MqttProtocol::OpenAudioChannel() {
 
     error_occurred_ = false;
     session_id_ = "";
+    reliability_config_ = UdpReliabilityConfig();
     xEventGroupClearBits(event_group_handle_, MQTT_PROTOCOL_SERVER_HELLO_EVENT);
 
     auto message = GetHelloMessage();
@@ -221,6 +349,24 @@ bool MqttProtocol::OpenAudioChannel() {
     }
 
     std::lock_guard<std::mutex> lock(channel_mutex_);
+    if (reliability_config_.nack || reliability_config_.fec_group > 0) {
+        ESP_LOGI(TAG, "UDP reliability enabled, nack: %d, fec group: %d, max delay: %dms",
+            reliability_config_.nack, reliability_config_.fec_group, reliability_config_.max_delay_ms);
+        std::lock_guard<std::mutex> reliability_lock(reliability_mutex_);
+        reliability_ = std::make_unique<UdpReliability>(reliability_config_);
+        reliability_->OnDeliver([this](uint32_t timestamp, std::vector<uint8_t>&& payload) {
+            if (on_incoming_audio_ != nullptr) {
+                on_incoming_audio_(std::make_unique<AudioStreamPacket>(AudioStreamPacket{
+                    .sample_rate = server_sample_rate_,
+                    .frame_duration = server_frame_duration_,
+                    .timestamp = timestamp,
+                    .payload = std::move(payload)
+                }));
+            }
+        });
+        nack_sequence_ = 0;
+    }
+
     auto network = Board::GetInstance().GetNetwork();
     udp_ = network->CreateUdp(2);
     udp_->OnMessage([this](const std::string& data) {
@@ -228,17 +374,42 @@ bool MqttProtocol::OpenAudioChannel() {
          * UDP Encrypted OPUS Packet Format:
          * |type 1u|flags 1u|payload_len 2u|ssrc 4u|timestamp 4u|sequence 4u|
          * |payload payload_len|
+         *
+         * With the reliability extension the same header also carries NACK and parity packets,
+         * see udp_reliability.h
          */
-        if (data.size() < sizeof(aes_nonce_)) {
+        if (data.size() < aes_nonce_.size()) {
             ESP_LOGE(TAG, "Invalid audio packet size: %u", data.size());
             return;
         }
-        if (data[0] != 0x01) {
-            ESP_LOGE(TAG, "Invalid audio packet type: %x", data[0]);
-            return;
-        }
+        uint8_t type = data[0];
         uint32_t timestamp = ntohl(*(uint32_t*)&data[8]);
         uint32_t sequence = ntohl(*(uint32_t*)&data[12]);
+
+        {
+            std::lock_guard<std::mutex> reliability_lock(reliability_mutex_);
+            if (reliability_ != nullptr && (type == UDP_PACKET_TYPE_AUDIO || type == UDP_PACKET_TYPE_NACK || type == UDP_PACKET_TYPE_PARITY)) {
+                std::vector<uint8_t> payload;
+                if (!DecryptPacket(data, payload)) {
+                    return;
+                }
+                int64_t now_ms = esp_timer_get_time() / 1000;
+                if (type == UDP_PACKET_TYPE_AUDIO) {
+                    reliability_->OnAudioReceived(sequence, timestamp, std::move(payload), now_ms);
+                } else if (type == UDP_PACKET_TYPE_NACK) {
+                    reliability_->OnNackReceived(payload.data(), payload.size());
+                } else {
+                    reliability_->OnParityReceived(payload.data(), payload.size(), now_ms);
+                }
+                last_incoming_time_ = std::chrono::steady_clock::now();
+                return;
+            }
+        }
+
+        if (type != UDP_PACKET_TYPE_AUDIO) {
+            ESP_LOGE(TAG, "Invalid audio packet type: %x", type);
+            return;
+        }
         if (sequence < remote_sequence_) {
             ESP_LOGW(TAG, "Received audio packet with old sequence: %lu, expected: %lu", sequence, remote_sequence_);
             return;
@@ -247,19 +418,11 @@ bool MqttProtocol::OpenAudioChannel() {
             ESP_LOGW(TAG, "Received audio packet with wrong sequence: %lu, expected: %lu", sequence, remote_sequence_ + 1);
         }
 
-        size_t decrypted_size = data.size() - aes_nonce_.size();
-        size_t nc_off = 0;
-        uint8_t stream_block[16] = {0};
-        auto nonce = (uint8_t*)data.data();
-        auto encrypted = (uint8_t*)data.data() + aes_nonce_.size();
         auto packet = std::make_unique<AudioStreamPacket>();
         packet->sample_rate = server_sample_rate_;
         packet->frame_duration = server_frame_duration_;
         packet->timestamp = timestamp;
-        packet->payload.resize(decrypted_size);
-        int ret = mbedtls_aes_crypt_ctr(&aes_ctx_, decrypted_size, &nc_off, nonce, stream_block, encrypted, (uint8_t*)packet->payload.data());
-        if (ret != 0) {
-            ESP_LOGE(TAG, "Failed to decrypt audio data, ret: %d", ret);
+        if (!DecryptPacket(data, packet->payload)) {
             return;
         }
         if (on_incoming_audio_ != nullptr) {
@@ -270,6 +433,9 @@ bool MqttProtocol::OpenAudioChannel() {
     });
 
     udp_->Connect(udp_server_, udp_port_);
+    if (reliability_ != nullptr) {
+        esp_timer_start_periodic(reliability_timer_, UDP_RELIABILITY_POLL_INTERVAL_MS * 1000);
+    }
 
     if (on_audio_channel_opened_ != nullptr) {
         on_audio_channel_opened_();
@@ -279,70 +445,85 @@ bool MqttProtocol::OpenAudioChannel() {
 
 std::string MqttProtocol::GetHelloMessage() {
     // 发送 hello 消息申请 UDP 通道
-    cJSON* root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "type", "hello");
-    cJSON_AddNumberToObject(root, "version", 3);
-    cJSON_AddStringToObject(root, "transport", "udp");
-    cJSON* features = cJSON_CreateObject();
+    std::lock_guard<std::mutex> lock(json_writer_mutex_);
+    json_writer_.Clear();
+    json_writer_.BeginObject();
+    json_writer_.Member("type", "hello");
+    json_writer_.Member("version", 3);
+    json_writer_.Member("transport", "udp");
+    json_writer_.Key("features").BeginObject();
 #if CONFIG_USE_SERVER_AEC
-    cJSON_AddBoolToObject(features, "aec", true);
+    json_writer_.Member("aec", true);
+#endif
+    json_writer_.Member("mcp", true);
+#if CONFIG_USE_UDP_RELIABILITY
+    json_writer_.Member("udp_reliability", true);
 #endif
-    cJSON_AddBoolToObject(features, "mcp", true);
-    cJSON_AddItemToObject(root, "features", features);
-    cJSON* audio_params = cJSON_CreateObject();
-    cJSON_AddStringToObject(audio_params, "format", "opus");
-    cJSON_AddNumberToObject(audio_params, "sample_rate", 16000);
-    cJSON_AddNumberToObject(audio_params, "channels", 1);
-    cJSON_AddNumberToObject(audio_params, "frame_duration", OPUS_FRAME_DURATION_MS);
-    cJSON_AddItemToObject(root, "audio_params", audio_params);
-    auto json_str = cJSON_PrintUnformatted(root);
-    std::string message(json_str);
-    cJSON_free(json_str);
-    cJSON_Delete(root);
-    return message;
+    json_writer_.EndObject();
+    json_writer_.Key("audio_params").BeginObject();
+    json_writer_.Member("format", "opus");
+    json_writer_.Member("sample_rate", 16000);
+    json_writer_.Member("channels", 1);
+    json_writer_.Member("frame_duration", OPUS_FRAME_DURATION_MS);
+    json_writer_.EndObject();
+    json_writer_.EndObject();
+    return json_writer_.str();
 }
 
-void MqttProtocol::ParseServerHello(const cJSON* root) {
-    auto transport = cJSON_GetObjectItem(root, "transport");
-    if (transport == nullptr || strcmp(transport->valuestring, "udp") != 0) {
-        ESP_LOGE(TAG, "Unsupported transport: %s", transport->valuestring);
+void MqttProtocol::ParseServerHello(const JsonValue& root) {
+    auto transport = root["transport"];
+    if (!transport.Equals("udp")) {
+        ESP_LOGE(TAG, "Unsupported transport: %s", transport.GetString("null").c_str());
         return;
     }
 
-    auto session_id = cJSON_GetObjectItem(root, "session_id");
-    if (cJSON_IsString(session_id)) {
-        session_id_ = session_id->valuestring;
+    auto session_id = root["session_id"];
+    if (session_id.IsString()) {
+        session_id_ = session_id.GetString();
         ESP_LOGI(TAG, "Session ID: %s", session_id_.c_str());
     }
 
     // Get sample rate from hello message
-    auto audio_params = cJSON_GetObjectItem(root, "audio_params");
-    if (cJSON_IsObject(audio_params)) {
-        auto sample_rate = cJSON_GetObjectItem(audio_params, "sample_rate");
-        if (cJSON_IsNumber(sample_rate)) {
-            server_sample_rate_ = sample_rate->valueint;
+    auto audio_params = root["audio_params"];
+    if (audio_params.IsObject()) {
+        auto sample_rate = audio_params["sample_rate"];
+        if (sample_rate.IsNumber()) {
+            server_sample_rate_ = sample_rate.GetInt();
         }
-        auto frame_duration = cJSON_GetObjectItem(audio_params, "frame_duration");
-        if (cJSON_IsNumber(frame_duration)) {
-            server_frame_duration_ = frame_duration->valueint;
+        auto frame_duration = audio_params["frame_duration"];
+        if (frame_duration.IsNumber()) {
+            server_frame_duration_ = frame_duration.GetInt();
         }
     }
 
-    auto udp = cJSON_GetObjectItem(root, "udp");
-    if (!cJSON_IsObject(udp)) {
+    auto udp = root["udp"];
+    if (!udp.IsObject()) {
         ESP_LOGE(TAG, "UDP is not specified");
         return;
     }
-    udp_server_ = cJSON_GetObjectItem(udp, "server")->valuestring;
-    udp_port_ = cJSON_GetObjectItem(udp, "port")->valueint;
-    auto key = cJSON_GetObjectItem(udp, "key")->valuestring;
-    auto nonce = cJSON_GetObjectItem(udp, "nonce")->valuestring;
+    auto key = udp["key"];
+    auto nonce = udp["nonce"];
+    if (!key.IsString() || !nonce.IsString()) {
+        ESP_LOGE(TAG, "UDP key or nonce is not specified");
+        return;
+    }
+    udp_server_ = udp["server"].GetString();
+    udp_port_ = udp["port"].GetInt();
+
+#if CONFIG_USE_UDP_RELIABILITY
+    // Only enable the parts of the reliability extension that the server confirms
+    auto reliability = udp["reliability"];
+    if (reliability.IsObject()) {
+        reliability_config_.nack = reliability["nack"].GetBool();
+        reliability_config_.fec_group = reliability["fec_group"].GetInt(0);
+        reliability_config_.max_delay_ms = reliability["max_delay"].GetInt(reliability_config_.max_delay_ms);
+        reliability_config_.nack_delay_ms = reliability["nack_delay"].GetInt(reliability_config_.nack_delay_ms);
+    }
+#endif
 
-    // auto encryption = cJSON_GetObjectItem(udp, "encryption")->valuestring;
-    // ESP_LOGI(TAG, "UDP server: %s, port: %d, encryption: %s", udp_server_.c_str(), udp_port_, encryption);
-    aes_nonce_ = DecodeHexString(nonce);
+    aes_nonce_ = DecodeHexString(nonce.GetString());
     mbedtls_aes_init(&aes_ctx_);
-    mbedtls_aes_setkey_enc(&aes_ctx_, (const unsigned char*)DecodeHexString(key).c_str(), 128);
+    mbedtls_aes_setkey_enc(&aes_ctx_, (const unsigned char*)DecodeHexString(key.GetString()).c_str(), 128);
     local_sequence_ = 0;
     remote_sequence_ = 0;
     xEventGroupSetBits(event_group_handle_, MQTT_PROTOCOL_SERVER_HELLO_EVENT);
@@ -3,6 +3,8 @@
 
 
 #include "protocol.h"
+#include "udp_reliability.h"
+#include "endpoint_selector.h"
 #include <mqtt.h>
 #include <udp.h>
 #include <cJSON.h>
@@ -18,6 +20,8 @@
 
 #define MQTT_PING_INTERVAL_SECONDS 90
 #define MQTT_RECONNECT_INTERVAL_MS 60000
+#define MQTT_RECONNECT_MIN_INTERVAL_MS 5000
+#define UDP_RELIABILITY_POLL_INTERVAL_MS 20
 
 #define MQTT_PROTOCOL_SERVER_HELLO_EVENT (1 << 0)
 
@@ -31,6 +35,8 @@ public:
     bool OpenAudioChannel() override;
     void CloseAudioChannel() override;
     bool IsAudioChannelOpened() const override;
+    // Loss and recovery counters of the UDP channel, all zero when the reliability layer is off
+    UdpReliabilityStats GetUdpStats();
 
 private:
     EventGroupHandle_t event_group_handle_;
@@ -47,10 +53,24 @@ private:
     uint32_t local_sequence_;
     uint32_t remote_sequence_;
     esp_timer_handle_t reconnect_timer_;
+    // Doubles after every disconnect up to MQTT_RECONNECT_INTERVAL_MS, reset once connected
+    int reconnect_interval_ms_ = MQTT_RECONNECT_MIN_INTERVAL_MS;
+    EndpointSelector endpoint_selector_;
+
+    // Optional reliability layer, lock order is channel_mutex_ then reliability_mutex_
+    UdpReliabilityConfig reliability_config_;
+    std::unique_ptr<UdpReliability> reliability_;
+    std::mutex reliability_mutex_;
+    esp_timer_handle_t reliability_timer_ = nullptr;
+    uint32_t nack_sequence_ = 0;
+    std::string nack_buffer_;
 
     bool StartMqttClient(bool report_error=false);
-    void ParseServerHello(const cJSON* root);
+    void ParseServerHello(const JsonValue& root);
     std::string DecodeHexString(const std::string& hex_string);
+    bool EncryptPacket(uint8_t type, uint32_t timestamp, uint32_t sequence, const uint8_t* payload, size_t size, std::string& output);
+    bool DecryptPacket(const std::string& data, std::vector<uint8_t>& payload);
+    void PollReliability();
 
     bool SendText(const std::string& text) override;
     std::string GetHelloMessage();
@@ -0,0 +1,280 @@
+#include "msgpack.h"
+
+#include <esp_log.h>
+#include <cstring>
+#include <cmath>
+
+#define TAG "MsgPack"
+
+#define MSGPACK_MAX_DEPTH 32
+
+static void AppendBigEndian(std::string& output, uint64_t value, int bytes) {
+    for (int i = bytes - 1; i >= 0; i--) {
+        output.push_back(static_cast<char>((value >> (i * 8)) & 0xFF));
+    }
+}
+
+static uint64_t ReadBigEndian(const uint8_t* data, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value = (value << 8) | data[i];
+    }
+    return value;
+}
+
+static void EncodeString(std::string_view text, std::string& output) {
+    size_t length = text.size();
+    if (length < 32) {
+        output.push_back(static_cast<char>(0xA0 | length));
+    } else if (length <= 0xFF) {
+        output.push_back(static_cast<char>(0xD9));
+        AppendBigEndian(output, length, 1);
+    } else if (length <= 0xFFFF) {
+        output.push_back(static_cast<char>(0xDA));
+        AppendBigEndian(output, length, 2);
+    } else {
+        output.push_back(static_cast<char>(0xDB));
+        AppendBigEndian(output, length, 4);
+    }
+    output.append(text.data(), length);
+}
+
+static void EncodeContainerHeader(size_t count, bool map, std::string& output) {
+    if (count < 16) {
+        output.push_back(static_cast<char>((map ? 0x80 : 0x90) | count));
+    } else if (count <= 0xFFFF) {
+        output.push_back(static_cast<char>(map ? 0xDE : 0xDC));
+        AppendBigEndian(output, count, 2);
+    } else {
+        output.push_back(static_cast<char>(map ? 0xDF : 0xDD));
+        AppendBigEndian(output, count, 4);
+    }
+}
+
+static void EncodeInteger(int64_t value, std::string& output) {
+    if (value >= 0) {
+        if (value < 128) {
+            output.push_back(static_cast<char>(value));
+        } else if (value <= 0xFF) {
+            output.push_back(static_cast<char>(0xCC));
+            AppendBigEndian(output, value, 1);
+        } else if (value <= 0xFFFF) {
+            output.push_back(static_cast<char>(0xCD));
+            AppendBigEndian(output, value, 2);
+        } else if (value <= 0xFFFFFFFFLL) {
+            output.push_back(static_cast<char>(0xCE));
+            AppendBigEndian(output, value, 4);
+        } else {
+            output.push_back(static_cast<char>(0xCF));
+            AppendBigEndian(output, value, 8);
+        }
+    } else {
+        if (value >= -32) {
+            output.push_back(static_cast<char>(value));
+        } else if (value >= INT8_MIN) {
+            output.push_back(static_cast<char>(0xD0));
+            AppendBigEndian(output, static_cast<uint8_t>(value), 1);
+        } else if (value >= INT16_MIN) {
+            output.push_back(static_cast<char>(0xD1));
+            AppendBigEndian(output, static_cast<uint16_t>(value), 2);
+        } else if (value >= INT32_MIN) {
+            output.push_back(static_cast<char>(0xD2));
+            AppendBigEndian(output, static_cast<uint32_t>(value), 4);
+        } else {
+            output.push_back(static_cast<char>(0xD3));
+            AppendBigEndian(output, static_cast<uint64_t>(value), 8);
+        }
+    }
+}
+
+bool MsgPack::Encode(const JsonValue& value, std::string& output) {
+    switch (value.type()) {
+        case kJsonNull:
+            output.push_back(static_cast<char>(0xC0));
+            return true;
+        case kJsonBool:
+            output.push_back(static_cast<char>(value.GetBool() ? 0xC3 : 0xC2));
+            return true;
+        case kJsonNumber: {
+            auto text = value.raw();
+            double number = value.GetDouble();
+            bool integral = text.find_first_of(".eE") == std::string_view::npos;
+            if (integral && std::fabs(number) < 9.2e18) {
+                EncodeInteger(static_cast<int64_t>(number), output);
+            } else {
+                uint64_t bits;
+                memcpy(&bits, &number, sizeof(bits));
+                output.push_back(static_cast<char>(0xCB));
+                AppendBigEndian(output, bits, 8);
+            }
+            return true;
+        }
+        case kJsonString:
+            EncodeString(value.GetString(), output);
+            return true;
+        case kJsonArray: {
+            EncodeContainerHeader(value.size(), false, output);
+            bool success = true;
+            value.ForEachElement([&output, &success](const JsonValue& item) {
+                success = success && Encode(item, output);
+            });
+            return success;
+        }
+        case kJsonObject: {
+            EncodeContainerHeader(value.size(), true, output);
+            bool success = true;
+            value.ForEachMember([&output, &success](std::string_view key, const JsonValue& item) {
+                if (key.find('\\') != std::string_view::npos) {
+                    // Escaped keys never appear in protocol messages
+                    success = false;
+                    return;
+                }
+                EncodeString(key, output);
+                success = success && Encode(item, output);
+            });
+            return success;
+        }
+        default:
+            return false;
+    }
+}
+
+bool MsgPack::Decode(const uint8_t* data, size_t size, JsonWriter& writer) {
+    size_t pos = 0;
+    if (!DecodeValue(data, size, pos, writer, 0)) {
+        ESP_LOGE(TAG, "Invalid MessagePack data at offset %u", (unsigned)pos);
+        return false;
+    }
+    return pos == size;
+}
+
+bool MsgPack::DecodeValue(const uint8_t* data, size_t size, size_t& pos, JsonWriter& writer, int depth) {
+    if (pos >= size || depth >= MSGPACK_MAX_DEPTH) {
+        return false;
+    }
+    uint8_t type = data[pos++];
+
+    // pos never passes size, so the remaining length cannot wrap around even for 32-bit lengths
+    auto need = [&pos, size](uint64_t bytes) { return bytes <= size - pos; };
+    auto read_uint = [&](int bytes, uint64_t& value) {
+        if (!need(bytes)) {
+            return false;
+        }
+        value = ReadBigEndian(data + pos, bytes);
+        pos += bytes;
+        return true;
+    };
+    auto read_string = [&](uint64_t length, bool is_key) {
+        if (!need(length)) {
+            return false;
+        }
+        std::string_view text(reinterpret_cast<const char*>(data + pos), static_cast<size_t>(length));
+        pos += length;
+        if (is_key) {
+            writer.Key(text);
+        } else {
+            writer.String(text);
+        }
+        return true;
+    };
+    auto read_container = [&](size_t count, bool map) {
+        if (map) {
+            writer.BeginObject();
+        } else {
+            writer.BeginArray();
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (map) {
+                // Keys must be strings to map onto JSON
+                if (pos >= size) {
+                    return false;
+                }
+                uint8_t key_type = data[pos++];
+                uint64_t length = 0;
+                if ((key_type & 0xE0) == 0xA0) {
+                    length = key_type & 0x1F;
+                } else if (key_type == 0xD9) {
+                    if (!read_uint(1, length)) return false;
+                } else if (key_type == 0xDA) {
+                    if (!read_uint(2, length)) return false;
+                } else if (key_type == 0xDB) {
+                    if (!read_uint(4, length)) return false;
+                } else {
+                    return false;
+                }
+                if (!read_string(length, true)) {
+                    return false;
+                }
+            }
+            if (!DecodeValue(data, size, pos, writer, depth + 1)) {
+                return false;
+            }
+        }
+        if (map) {
+            writer.EndObject();
+        } else {
+            writer.EndArray();
+        }
+        return true;
+    };
+
+    uint64_t value = 0;
+    if (type <= 0x7F) {
+        writer.Int(type);
+        return true;
+    } else if (type >= 0xE0) {
+        writer.Int(static_cast<int8_t>(type));
+        return true;
+    } else if ((type & 0xF0) == 0x80) {
+        return read_container(type & 0x0F, true);
+    } else if ((type & 0xF0) == 0x90) {
+        return read_container(type & 0x0F, false);
+    } else if ((type & 0xE0) == 0xA0) {
+        return read_string(type & 0x1F, false);
+    }
+
+    switch (type) {
+        case 0xC0:
+            writer.Null();
+            return true;
+        case 0xC2:
+            writer.Bool(false);
+            return true;
+        case 0xC3:
+            writer.Bool(true);
+            return true;
+        case 0xCA: {
+            if (!read_uint(4, value)) return false;
+            uint32_t bits = static_cast<uint32_t>(value);
+            float number;
+            memcpy(&number, &bits, sizeof(number));
+            writer.Number(number);
+            return true;
+        }
+        case 0xCB: {
+            if (!read_uint(8, value)) return false;
+            double number;
+            memcpy(&number, &value, sizeof(number));
+            writer.Number(number);
+            return true;
+        }
+        case 0xCC: if (!read_uint(1, value)) return false; writer.Int(value); return true;
+        case 0xCD: if (!read_uint(2, value)) return false; writer.Int(value); return true;
+        case 0xCE: if (!read_uint(4, value)) return false; writer.Int(value); return true;
+        case 0xCF: if (!read_uint(8, value)) return false; writer.Int(static_cast<int64_t>(value)); return true;
+        case 0xD0: if (!read_uint(1, value)) return false; writer.Int(static_cast<int8_t>(value)); return true;
+        case 0xD1: if (!read_uint(2, value)) return false; writer.Int(static_cast<int16_t>(value)); return true;
+        case 0xD2: if (!read_uint(4, value)) return false; writer.Int(static_cast<int32_t>(value)); return true;
+        case 0xD3: if (!read_uint(8, value)) return false; writer.Int(static_cast<int64_t>(value)); return true;
+        case 0xD9: if (!read_uint(1, value)) return false; return read_string(value, false);
+        case 0xDA: if (!read_uint(2, value)) return false; return read_string(value, false);
+        case 0xDB: if (!read_uint(4, value)) return false; return read_string(value, false);
+        case 0xDC: if (!read_uint(2, value)) return false; return read_container(value, false);
+        case 0xDD: if (!read_uint(4, value)) return false; return read_container(value, false);
+        case 0xDE: if (!read_uint(2, value)) return false; return read_container(value, true);
+        case 0xDF: if (!read_uint(4, value)) return false; return read_container(value, true);
+        default:
+            // bin, ext and reserved types
+            return false;
+    }
+}
@@ -0,0 +1,28 @@
+#ifndef MSGPACK_H
+#define MSGPACK_H
+
+#include <string>
+#include <cstdint>
+
+#include "json_reader.h"
+#include "json_writer.h"
+
+/*
+ * Minimal MessagePack <-> JSON transcoder for compact control messages.
+ *
+ * Control messages are still produced with JsonWriter and consumed with JsonReader,
+ * so the protocol code has a single message path; MessagePack is only a wire encoding.
+ * Binary (bin) and extension types are not used by the protocol and are rejected.
+ */
+class MsgPack {
+public:
+    // Encode a parsed JSON value, appending the MessagePack bytes to output
+    static bool Encode(const JsonValue& value, std::string& output);
+    // Decode one MessagePack value and write it as JSON into writer
+    static bool Decode(const uint8_t* data, size_t size, JsonWriter& writer);
+
+private:
+    static bool DecodeValue(const uint8_t* data, size_t size, size_t& pos, JsonWriter& writer, int depth);
+};
+
+#endif // MSGPACK_H
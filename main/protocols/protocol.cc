@@ -4,7 +4,7 @@
 
 #define TAG "Protocol"
 
-void Protocol::OnIncomingJson(std::function<void(const cJSON* root)> callback) {
+void Protocol::OnIncomingJson(std::function<void(const JsonValue& root)> callback) {
     on_incoming_json_ = callback;
 }
 
@@ -40,42 +40,68 @@ void Protocol::SetError(const std::string& message) {
 }
 
 void Protocol::SendAbortSpeaking(AbortReason reason) {
-    std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"abort\"";
+    std::lock_guard<std::mutex> lock(json_writer_mutex_);
+    json_writer_.Clear();
+    json_writer_.BeginObject();
+    json_writer_.Member("session_id", session_id_);
+    json_writer_.Member("type", "abort");
     if (reason == kAbortReasonWakeWordDetected) {
-        message += ",\"reason\":\"wake_word_detected\"";
+        json_writer_.Member("reason", "wake_word_detected");
     }
-    message += "}";
-    SendText(message);
+    json_writer_.EndObject();
+    SendText(json_writer_.str());
 }
 
 void Protocol::SendWakeWordDetected(const std::string& wake_word) {
-    std::string json = "{\"session_id\":\"" + session_id_ + 
-                      "\",\"type\":\"listen\",\"state\":\"detect\",\"text\":\"" + wake_word + "\"}";
-    SendText(json);
+    std::lock_guard<std::mutex> lock(json_writer_mutex_);
+    json_writer_.Clear();
+    json_writer_.BeginObject();
+    json_writer_.Member("session_id", session_id_);
+    json_writer_.Member("type", "listen");
+    json_writer_.Member("state", "detect");
+    json_writer_.Member("text", wake_word);
+    json_writer_.EndObject();
+    SendText(json_writer_.str());
 }
 
 void Protocol::SendStartListening(ListeningMode mode) {
-    std::string message = "{\"session_id\":\"" + session_id_ + "\"";
-    message += ",\"type\":\"listen\",\"state\":\"start\"";
+    std::lock_guard<std::mutex> lock(json_writer_mutex_);
+    json_writer_.Clear();
+    json_writer_.BeginObject();
+    json_writer_.Member("session_id", session_id_);
+    json_writer_.Member("type", "listen");
+    json_writer_.Member("state", "start");
     if (mode == kListeningModeRealtime) {
-        message += ",\"mode\":\"realtime\"";
+        json_writer_.Member("mode", "realtime");
     } else if (mode == kListeningModeAutoStop) {
-        message += ",\"mode\":\"auto\"";
+        json_writer_.Member("mode", "auto");
     } else {
-        message += ",\"mode\":\"manual\"";
+        json_writer_.Member("mode", "manual");
     }
-    message += "}";
-    SendText(message);
+    json_writer_.EndObject();
+    SendText(json_writer_.str());
 }
 
 void Protocol::SendStopListening() {
-    std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"listen\",\"state\":\"stop\"}";
-    SendText(message);
+    std::lock_guard<std::mutex> lock(json_writer_mutex_);
+    json_writer_.Clear();
+    json_writer_.BeginObject();
+    json_writer_.Member("session_id", session_id_);
+    json_writer_.Member("type", "listen");
+    json_writer_.Member("state", "stop");
+    json_writer_.EndObject();
+    SendText(json_writer_.str());
 }
 
 void Protocol::SendMcpMessage(const std::string& payload) {
-    std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"mcp\",\"payload\":" + payload + "}";
-    SendText(message);
+    std::lock_guard<std::mutex> lock(json_writer_mutex_);
+    json_writer_.Clear();
+    json_writer_.BeginObject();
+    json_writer_.Member("session_id", session_id_);
+    json_writer_.Member("type", "mcp");
+    json_writer_.Key("payload").Raw(payload);
+    json_writer_.EndObject();
+    SendText(json_writer_.str());
 }
 
 bool Protocol::IsTimeout() const {
@@ -6,6 +6,10 @@
 #include <functional>
 #include <chrono>
 #include <vector>
+#include <mutex>
+
+#include "json_writer.h"
+#include "json_reader.h"
 
 struct AudioStreamPacket {
     int sample_rate = 0;
@@ -30,6 +34,24 @@ struct BinaryProtocol3 {
     uint8_t payload[];
 } __attribute__((packed));
 
+// Multiplexed framing: audio, control and MCP messages share one ordered binary stream
+struct BinaryProtocol4 {
+    uint8_t type;           // Frame type (see BinaryFrameType)
+    uint8_t flags;          // BINARY_FRAME_FLAG_*
+    uint16_t reserved;      // Reserved for future use
+    uint32_t timestamp;     // Timestamp in milliseconds (used for server-side AEC)
+    uint32_t payload_size;  // Payload size in bytes
+    uint8_t payload[];      // Payload data
+} __attribute__((packed));
+
+enum BinaryFrameType {
+    kBinaryFrameOpus = 0,   // Opus audio packet
+    kBinaryFrameJson = 1,   // Control message, same schema as the text JSON messages
+    kBinaryFrameMcp = 2,    // MCP JSON-RPC payload without the session envelope
+};
+
+#define BINARY_FRAME_FLAG_MSGPACK (1 << 0)  // Payload is MessagePack instead of JSON text
+
 enum AbortReason {
     kAbortReasonNone,
     kAbortReasonWakeWordDetected
@@ -56,7 +78,7 @@ public:
     }
 
     void OnIncomingAudio(std::function<void(std::unique_ptr<AudioStreamPacket> packet)> callback);
-    void OnIncomingJson(std::function<void(const cJSON* root)> callback);
+    void OnIncomingJson(std::function<void(const JsonValue& root)> callback);
     void OnAudioChannelOpened(std::function<void()> callback);
     void OnAudioChannelClosed(std::function<void()> callback);
     void OnNetworkError(std::function<void(const std::string& message)> callback);
@@ -75,7 +97,7 @@ public:
     virtual void SendMcpMessage(const std::string& message);
 
 protected:
-    std::function<void(const cJSON* root)> on_incoming_json_;
+    std::function<void(const JsonValue& root)> on_incoming_json_;
     std::function<void(std::unique_ptr<AudioStreamPacket> packet)> on_incoming_audio_;
     std::function<void()> on_audio_channel_opened_;
     std::function<void()> on_audio_channel_closed_;
@@ -88,6 +110,12 @@ protected:
     bool error_occurred_ = false;
     std::string session_id_;
     std::chrono::time_point<std::chrono::steady_clock> last_incoming_time_;
+    // Reused for outgoing control messages. They are also sent off the main event loop, e.g.
+    // goodbye from an upgrade or MCP replies, so every use holds json_writer_mutex_
+    std::mutex json_writer_mutex_;
+    JsonWriter json_writer_;
+    // Reused for incoming text messages, only touched from the network receive callback
+    JsonReader json_reader_;
 
     virtual bool SendText(const std::string& text) = 0;
     virtual void SetError(const std::string& message);
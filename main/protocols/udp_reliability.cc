@@ -0,0 +1,316 @@
+#include "udp_reliability.h"
+
+#include <esp_log.h>
+#include <arpa/inet.h>
+#include <cstring>
+
+#define TAG "UdpReliability"
+
+// A jump larger than this is treated as a stream restart instead of a burst loss
+#define UDP_MAX_SEQUENCE_GAP 64
+
+static inline uint32_t ReadUint32(const uint8_t* data) {
+    uint32_t value;
+    memcpy(&value, data, sizeof(value));
+    return ntohl(value);
+}
+
+static inline void AppendUint32(std::string& output, uint32_t value) {
+    value = htonl(value);
+    output.append((const char*)&value, sizeof(value));
+}
+
+UdpReliability::UdpReliability(const UdpReliabilityConfig& config) : config_(config) {
+    if (config_.history_size < 1) {
+        config_.history_size = 1;
+    }
+    if (config_.fec_group > UDP_PARITY_MAX_GROUP) {
+        config_.fec_group = UDP_PARITY_MAX_GROUP;
+    }
+    if (config_.fec_group == 1) {
+        // A group of one is just a copy of every packet
+        config_.fec_group = 2;
+    }
+    if (config_.nack) {
+        history_.resize(config_.history_size);
+    }
+}
+
+void UdpReliability::OnDeliver(std::function<void(uint32_t timestamp, std::vector<uint8_t>&& payload)> callback) {
+    on_deliver_ = callback;
+}
+
+bool UdpReliability::OnAudioSent(uint32_t sequence, uint32_t timestamp, const std::vector<uint8_t>& payload, std::string&& datagram) {
+    if (!history_.empty()) {
+        auto& slot = history_[sequence % history_.size()];
+        slot.sequence = sequence;
+        slot.datagram = std::move(datagram);
+    }
+    if (config_.fec_group <= 0) {
+        return false;
+    }
+
+    auto& group = building_parity_;
+    if (group.count == 0) {
+        parity_first_ = sequence;
+        group.length_xor = 0;
+        group.timestamp_xor = 0;
+        group.payload_xor.clear();
+    }
+    group.count++;
+    group.length_xor ^= payload.size();
+    group.timestamp_xor ^= timestamp;
+    if (group.payload_xor.size() < payload.size()) {
+        group.payload_xor.resize(payload.size(), 0);
+    }
+    for (size_t i = 0; i < payload.size(); i++) {
+        group.payload_xor[i] ^= payload[i];
+    }
+    if (group.count < config_.fec_group) {
+        return false;
+    }
+
+    parity_.clear();
+    AppendUint32(parity_, parity_first_);
+    parity_.push_back(group.count);
+    parity_.push_back(0);
+    uint16_t length_xor = htons(group.length_xor);
+    parity_.append((const char*)&length_xor, sizeof(length_xor));
+    AppendUint32(parity_, group.timestamp_xor);
+    parity_.append((const char*)group.payload_xor.data(), group.payload_xor.size());
+    group.count = 0;
+    stats_.parity_sent++;
+    return true;
+}
+
+void UdpReliability::OnNackReceived(const uint8_t* data, size_t size) {
+    stats_.nacks_received++;
+    if (history_.empty()) {
+        return;
+    }
+    for (size_t offset = 0; offset + 4 <= size && retransmit_queue_.size() < UDP_NACK_MAX_SEQUENCES; offset += 4) {
+        retransmit_queue_.push_back(ReadUint32(data + offset));
+    }
+}
+
+void UdpReliability::TakeRetransmits(const std::function<void(const std::string& datagram)>& send) {
+    for (auto sequence : retransmit_queue_) {
+        auto& slot = history_[sequence % history_.size()];
+        if (slot.sequence == sequence && !slot.datagram.empty()) {
+            send(slot.datagram);
+            stats_.retransmitted++;
+        }
+    }
+    retransmit_queue_.clear();
+}
+
+void UdpReliability::OnAudioReceived(uint32_t sequence, uint32_t timestamp, std::vector<uint8_t>&& payload, int64_t now_ms) {
+    if (!started_) {
+        started_ = true;
+        expected_ = sequence;
+        highest_ = sequence;
+    }
+    if (sequence < expected_) {
+        if (received_.find(sequence) != received_.end()) {
+            stats_.duplicates++;
+        } else {
+            stats_.late++;
+        }
+        return;
+    }
+    if (received_.find(sequence) != received_.end()) {
+        stats_.duplicates++;
+        return;
+    }
+
+    if (sequence > highest_ + UDP_MAX_SEQUENCE_GAP) {
+        ESP_LOGW(TAG, "Sequence jumped from %lu to %lu, resync", (unsigned long)highest_, (unsigned long)sequence);
+        stats_.lost += missing_.size();
+        missing_.clear();
+        parity_groups_.clear();
+        // Flush whatever is still waiting, it is older than the new packet
+        for (auto& [seq, packet] : received_) {
+            if (!packet.delivered && on_deliver_) {
+                on_deliver_(packet.timestamp, std::move(packet.payload));
+            }
+        }
+        received_.clear();
+        expected_ = sequence;
+        highest_ = sequence;
+    }
+
+    auto it = missing_.find(sequence);
+    if (it != missing_.end()) {
+        if (it->second.nacks > 0) {
+            stats_.recovered_nack++;
+        }
+        missing_.erase(it);
+    }
+    stats_.received++;
+    Insert(sequence, timestamp, std::move(payload), now_ms);
+    TryParityRecovery(now_ms);
+    Deliver();
+}
+
+void UdpReliability::Insert(uint32_t sequence, uint32_t timestamp, std::vector<uint8_t>&& payload, int64_t now_ms) {
+    if (sequence > highest_) {
+        for (uint32_t s = highest_ + 1; s < sequence; s++) {
+            if (s >= expected_ && received_.find(s) == received_.end()) {
+                missing_[s] = MissingPacket{now_ms, 0, 0};
+            }
+        }
+        highest_ = sequence;
+    }
+    received_[sequence] = ReceivedPacket{timestamp, std::move(payload), false};
+}
+
+void UdpReliability::OnParityReceived(const uint8_t* data, size_t size, int64_t now_ms) {
+    if (config_.fec_group <= 0 || size < UDP_PARITY_HEADER_SIZE) {
+        return;
+    }
+    uint32_t first = ReadUint32(data);
+    uint8_t count = data[4];
+    if (count < 2 || count > UDP_PARITY_MAX_GROUP || !started_ || first + count <= expected_) {
+        return;
+    }
+    uint16_t length_xor;
+    memcpy(&length_xor, data + 6, sizeof(length_xor));
+
+    ParityGroup group;
+    group.count = count;
+    group.length_xor = ntohs(length_xor);
+    group.timestamp_xor = ReadUint32(data + 8);
+    group.payload_xor.assign(data + UDP_PARITY_HEADER_SIZE, data + size);
+    parity_groups_[first] = std::move(group);
+
+    TryParityRecovery(now_ms);
+    Deliver();
+}
+
+void UdpReliability::TryParityRecovery(int64_t now_ms) {
+    for (auto it = parity_groups_.begin(); it != parity_groups_.end();) {
+        uint32_t first = it->first;
+        auto& group = it->second;
+
+        int missing_count = 0;
+        uint32_t target = 0;
+        bool recoverable = true;
+        for (uint32_t s = first; s < first + group.count; s++) {
+            if (received_.find(s) != received_.end()) {
+                continue;
+            }
+            if (s < expected_) {
+                // Already given up, or no longer kept
+                recoverable = false;
+                break;
+            }
+            missing_count++;
+            target = s;
+        }
+        if (!recoverable || missing_count == 0) {
+            it = parity_groups_.erase(it);
+            continue;
+        }
+        if (missing_count > 1 || target > highest_) {
+            // Wait for more packets, the tail of a group only counts as missing once a later packet arrived
+            ++it;
+            continue;
+        }
+
+        uint16_t length = group.length_xor;
+        uint32_t timestamp = group.timestamp_xor;
+        std::vector<uint8_t> payload = std::move(group.payload_xor);
+        for (uint32_t s = first; s < first + group.count; s++) {
+            if (s == target) {
+                continue;
+            }
+            auto& packet = received_[s];
+            length ^= packet.payload.size();
+            timestamp ^= packet.timestamp;
+            for (size_t i = 0; i < packet.payload.size() && i < payload.size(); i++) {
+                payload[i] ^= packet.payload[i];
+            }
+        }
+        it = parity_groups_.erase(it);
+        if (length == 0 || length > payload.size()) {
+            ESP_LOGW(TAG, "Invalid parity for sequence %lu", (unsigned long)target);
+            continue;
+        }
+        payload.resize(length);
+        missing_.erase(target);
+        stats_.recovered_parity++;
+        Insert(target, timestamp, std::move(payload), now_ms);
+    }
+}
+
+void UdpReliability::Deliver() {
+    while (true) {
+        auto it = received_.find(expected_);
+        if (it == received_.end()) {
+            break;
+        }
+        if (on_deliver_) {
+            if (config_.fec_group > 0) {
+                // Keep a copy, it may be needed to rebuild another packet of the group
+                std::vector<uint8_t> payload = it->second.payload;
+                on_deliver_(it->second.timestamp, std::move(payload));
+            } else {
+                on_deliver_(it->second.timestamp, std::move(it->second.payload));
+            }
+        }
+        it->second.delivered = true;
+        expected_++;
+    }
+
+    // Drop delivered packets that no parity group can refer to any more
+    uint32_t keep = config_.fec_group > 0 ? UDP_PARITY_MAX_GROUP : 0;
+    while (!received_.empty()) {
+        auto it = received_.begin();
+        if (!it->second.delivered || it->first + keep >= expected_) {
+            break;
+        }
+        received_.erase(it);
+    }
+}
+
+bool UdpReliability::Poll(int64_t now_ms, std::string& nack) {
+    // Give up on gaps that exceed the latency budget, oldest first
+    while (!missing_.empty()) {
+        auto it = missing_.begin();
+        if (it->first < expected_) {
+            missing_.erase(it);
+            continue;
+        }
+        if (now_ms - it->second.detected_ms < config_.max_delay_ms) {
+            break;
+        }
+        stats_.lost++;
+        expected_ = it->first + 1;
+        missing_.erase(it);
+        Deliver();
+    }
+
+    nack.clear();
+    if (!config_.nack) {
+        return false;
+    }
+    for (auto& [sequence, missing] : missing_) {
+        if (nack.size() >= UDP_NACK_MAX_SEQUENCES * 4) {
+            break;
+        }
+        if (now_ms - missing.detected_ms < config_.nack_delay_ms || missing.nacks >= config_.max_nack_retries) {
+            continue;
+        }
+        if (missing.nacks > 0 && now_ms - missing.last_nack_ms < config_.nack_interval_ms) {
+            continue;
+        }
+        missing.nacks++;
+        missing.last_nack_ms = now_ms;
+        AppendUint32(nack, sequence);
+    }
+    if (nack.empty()) {
+        return false;
+    }
+    stats_.nacks_sent++;
+    return true;
+}
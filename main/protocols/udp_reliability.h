@@ -0,0 +1,125 @@
+#ifndef UDP_RELIABILITY_H
+#define UDP_RELIABILITY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+
+/*
+ * UDP packet types, the first byte of the packet header and of the AES-CTR nonce.
+ * Different types never share a nonce, so they never reuse the same key stream.
+ */
+#define UDP_PACKET_TYPE_AUDIO   0x01
+#define UDP_PACKET_TYPE_NACK    0x02    // payload: |sequence 4u|... missing sequences
+#define UDP_PACKET_TYPE_PARITY  0x03    // payload: |first_sequence 4u|count 1u|reserved 1u|length_xor 2u|timestamp_xor 4u|payload_xor|
+
+#define UDP_NACK_MAX_SEQUENCES  16
+#define UDP_PARITY_MAX_GROUP    8
+#define UDP_PARITY_HEADER_SIZE  12
+
+struct UdpReliabilityConfig {
+    bool nack = false;              // Request retransmission of missing packets
+    int fec_group = 0;              // Send one XOR parity packet every N audio packets, 0 to disable
+    int nack_delay_ms = 20;         // Reordering tolerance before a gap is reported
+    int nack_interval_ms = 40;      // Interval between repeated NACKs of the same packet
+    int max_nack_retries = 2;
+    int max_delay_ms = 120;         // Latency budget, a gap older than this is given up
+    int history_size = 32;          // Sent packets kept for retransmission
+};
+
+struct UdpReliabilityStats {
+    uint32_t received = 0;          // Unique audio packets received
+    uint32_t duplicates = 0;
+    uint32_t late = 0;              // Arrived after its slot was given up or already delivered
+    uint32_t lost = 0;              // Given up after the latency budget
+    uint32_t recovered_nack = 0;
+    uint32_t recovered_parity = 0;
+    uint32_t nacks_sent = 0;
+    uint32_t nacks_received = 0;
+    uint32_t retransmitted = 0;
+    uint32_t parity_sent = 0;
+};
+
+/*
+ * Optional reliability layer for the UDP audio channel.
+ *
+ * The receiving side detects sequence gaps, holds later packets for at most max_delay_ms
+ * while the gap is repaired by a retransmission or an XOR parity packet, and delivers the
+ * packets in sequence order. The sending side keeps recent encrypted datagrams so that
+ * NACKed packets can be resent unchanged.
+ *
+ * This class is not thread safe and never touches the network or the cipher; the owner
+ * encrypts, sends, and serializes calls. Times are in milliseconds from any monotonic clock.
+ */
+class UdpReliability {
+public:
+    explicit UdpReliability(const UdpReliabilityConfig& config);
+
+    inline const UdpReliabilityConfig& config() const { return config_; }
+    inline const UdpReliabilityStats& stats() const { return stats_; }
+
+    void OnDeliver(std::function<void(uint32_t timestamp, std::vector<uint8_t>&& payload)> callback);
+
+    // Sender: keep the datagram for retransmission, returns true when a parity payload is ready
+    bool OnAudioSent(uint32_t sequence, uint32_t timestamp, const std::vector<uint8_t>& payload, std::string&& datagram);
+    inline const std::string& parity() const { return parity_; }
+    inline uint32_t parity_sequence() const { return parity_first_; }
+    void OnNackReceived(const uint8_t* data, size_t size);
+    // Resend the datagrams requested by the peer since the last call
+    void TakeRetransmits(const std::function<void(const std::string& datagram)>& send);
+
+    // Receiver
+    void OnAudioReceived(uint32_t sequence, uint32_t timestamp, std::vector<uint8_t>&& payload, int64_t now_ms);
+    void OnParityReceived(const uint8_t* data, size_t size, int64_t now_ms);
+    // Give up expired gaps, returns true if nack is filled with a NACK payload to send
+    bool Poll(int64_t now_ms, std::string& nack);
+
+private:
+    struct SentPacket {
+        uint32_t sequence;
+        std::string datagram;
+    };
+    struct ReceivedPacket {
+        uint32_t timestamp;
+        std::vector<uint8_t> payload;
+        bool delivered;
+    };
+    struct MissingPacket {
+        int64_t detected_ms;
+        int64_t last_nack_ms;
+        int nacks;
+    };
+    struct ParityGroup {
+        uint8_t count;
+        uint16_t length_xor;
+        uint32_t timestamp_xor;
+        std::vector<uint8_t> payload_xor;
+    };
+
+    UdpReliabilityConfig config_;
+    UdpReliabilityStats stats_;
+    std::function<void(uint32_t timestamp, std::vector<uint8_t>&& payload)> on_deliver_;
+
+    // Sender state
+    std::vector<SentPacket> history_;
+    std::vector<uint32_t> retransmit_queue_;
+    std::string parity_;
+    uint32_t parity_first_ = 0;
+    ParityGroup building_parity_ = {};
+
+    // Receiver state
+    bool started_ = false;
+    uint32_t expected_ = 0;         // Next sequence to deliver
+    uint32_t highest_ = 0;          // Highest sequence seen
+    std::map<uint32_t, ReceivedPacket> received_;
+    std::map<uint32_t, MissingPacket> missing_;
+    std::map<uint32_t, ParityGroup> parity_groups_;
+
+    void Insert(uint32_t sequence, uint32_t timestamp, std::vector<uint8_t>&& payload, int64_t now_ms);
+    void TryParityRecovery(int64_t now_ms);
+    void Deliver();
+};
+
+#endif // UDP_RELIABILITY_H
@@ -2,18 +2,78 @@
 #include "board.h"
 #include "system_info.h"
 #include "application.h"
-#include "settings.h"
+#include "settings_schema.h"
+#include "msgpack.h"
 
 #include <cstring>
 #include <cJSON.h>
 #include <esp_log.h>
 #include <arpa/inet.h>
+#include <esp_timer.h>
+#include <mutex>
 #include "assets/lang_config.h"
 
 #define TAG "WS"
 
+#define CONNECT_RACE_FINISHED_EVENT (1 << 0)
+
+// Modem connect id of each racing slot, the first one is the id used without racing
+static const int kRaceConnectIds[WEBSOCKET_RACE_MAX_ATTEMPTS] = {1, 4};
+
+// State shared between OpenAudioChannel and the connection attempts of one race
+struct ConnectRace {
+    std::mutex mutex;
+    EventGroupHandle_t event_group;
+    std::unique_ptr<WebSocket> winner;
+    std::string winner_url;
+    uint32_t busy_slots = 0;
+    bool done = false;
+
+    ConnectRace() { event_group = xEventGroupCreate(); }
+    ~ConnectRace() { vEventGroupDelete(event_group); }
+};
+
+struct ConnectAttempt {
+    std::shared_ptr<ConnectRace> race;
+    std::shared_ptr<EndpointSelector> selector;
+    std::unique_ptr<WebSocket> websocket;
+    std::string url;
+    int slot;
+};
+
+static void ConnectAttemptTask(void* arg) {
+    auto attempt = (ConnectAttempt*)arg;
+    auto start_time = esp_timer_get_time();
+    bool connected = attempt->websocket->Connect(attempt->url.c_str());
+    int elapsed_ms = (esp_timer_get_time() - start_time) / 1000;
+
+    // Losers still report their handshake time, it keeps the ranking of the other servers fresh
+    if (connected) {
+        attempt->selector->ReportSuccess(attempt->url, elapsed_ms);
+    } else {
+        ESP_LOGW(TAG, "Failed to connect to %s", attempt->url.c_str());
+        attempt->selector->ReportFailure(attempt->url);
+    }
+
+    auto race = attempt->race;
+    {
+        std::lock_guard<std::mutex> lock(race->mutex);
+        race->busy_slots &= ~(1u << attempt->slot);
+        if (connected && race->winner == nullptr && !race->done) {
+            race->winner = std::move(attempt->websocket);
+            race->winner_url = attempt->url;
+        }
+    }
+    xEventGroupSetBits(race->event_group, CONNECT_RACE_FINISHED_EVENT);
+
+    // A losing connection is closed here
+    delete attempt;
+    vTaskDelete(NULL);
+}
+
 WebsocketProtocol::WebsocketProtocol() {
     event_group_handle_ = xEventGroupCreate();
+    endpoint_selector_ = std::make_shared<EndpointSelector>("ws_rank");
 }
 
 WebsocketProtocol::~WebsocketProtocol() {
@@ -52,16 +112,72 @@ bool WebsocketProtocol::SendAudio(std::unique_ptr<AudioStreamPacket> packet) {
         memcpy(bp3->payload, packet->payload.data(), packet->payload.size());
 
         return websocket_->Send(serialized.data(), serialized.size(), true);
+    } else if (version_ == 4) {
+        frame_buffer_.resize(sizeof(BinaryProtocol4) + packet->payload.size());
+        auto bp4 = (BinaryProtocol4*)frame_buffer_.data();
+        bp4->type = kBinaryFrameOpus;
+        bp4->flags = 0;
+        bp4->reserved = 0;
+        bp4->timestamp = htonl(packet->timestamp);
+        bp4->payload_size = htonl(packet->payload.size());
+        memcpy(bp4->payload, packet->payload.data(), packet->payload.size());
+
+        return websocket_->Send(frame_buffer_.data(), frame_buffer_.size(), true);
     } else {
         return websocket_->Send(packet->payload.data(), packet->payload.size(), true);
     }
 }
 
+bool WebsocketProtocol::SendFrame(BinaryFrameType type, const std::string& payload) {
+    frame_buffer_.resize(sizeof(BinaryProtocol4));
+    uint8_t flags = 0;
+    if (msgpack_) {
+        if (encode_reader_.Parse(payload) && MsgPack::Encode(encode_reader_.root(), frame_buffer_)) {
+            flags |= BINARY_FRAME_FLAG_MSGPACK;
+        } else {
+            ESP_LOGW(TAG, "Failed to encode MessagePack, sending JSON instead");
+            frame_buffer_.resize(sizeof(BinaryProtocol4));
+        }
+    }
+    if (!(flags & BINARY_FRAME_FLAG_MSGPACK)) {
+        frame_buffer_.append(payload);
+    }
+
+    auto bp4 = (BinaryProtocol4*)frame_buffer_.data();
+    bp4->type = type;
+    bp4->flags = flags;
+    bp4->reserved = 0;
+    bp4->timestamp = 0;
+    bp4->payload_size = htonl(frame_buffer_.size() - sizeof(BinaryProtocol4));
+
+    if (!websocket_->Send(frame_buffer_.data(), frame_buffer_.size(), true)) {
+        ESP_LOGE(TAG, "Failed to send frame type %d: %s", type, payload.c_str());
+        SetError(Lang::Strings::SERVER_ERROR);
+        return false;
+    }
+    return true;
+}
+
+void WebsocketProtocol::SendMcpMessage(const std::string& message) {
+    if (!multiplex_) {
+        Protocol::SendMcpMessage(message);
+        return;
+    }
+    if (websocket_ == nullptr || !websocket_->IsConnected()) {
+        return;
+    }
+    SendFrame(kBinaryFrameMcp, message);
+}
+
 bool WebsocketProtocol::SendText(const std::string& text) {
     if (websocket_ == nullptr || !websocket_->IsConnected()) {
         return false;
     }
 
+    if (multiplex_) {
+        return SendFrame(kBinaryFrameJson, text);
+    }
+
     if (!websocket_->Send(text)) {
         ESP_LOGE(TAG, "Failed to send text: %s", text.c_str());
         SetError(Lang::Strings::SERVER_ERROR);
@@ -79,38 +195,147 @@ void WebsocketProtocol::CloseAudioChannel() {
     websocket_.reset();
 }
 
+std::unique_ptr<WebSocket> WebsocketProtocol::CreateWebSocket(int connect_id, const std::string& token) {
+    auto network = Board::GetInstance().GetNetwork();
+    auto websocket = network->CreateWebSocket(connect_id);
+    if (websocket == nullptr) {
+        ESP_LOGE(TAG, "Failed to create websocket");
+        return nullptr;
+    }
+
+    if (!token.empty()) {
+        websocket->SetHeader("Authorization", token.c_str());
+    }
+    websocket->SetHeader("Protocol-Version", std::to_string(version_).c_str());
+    websocket->SetHeader("Device-Id", SystemInfo::GetMacAddress().c_str());
+    websocket->SetHeader("Client-Id", Board::GetInstance().GetUuid().c_str());
+    return websocket;
+}
+
+std::unique_ptr<WebSocket> WebsocketProtocol::ConnectFastest(const std::vector<std::string>& urls, const std::string& token) {
+    if (urls.size() == 1) {
+        auto websocket = CreateWebSocket(kRaceConnectIds[0], token);
+        if (websocket == nullptr) {
+            return nullptr;
+        }
+        auto start_time = esp_timer_get_time();
+        if (!websocket->Connect(urls[0].c_str())) {
+            endpoint_selector_->ReportFailure(urls[0]);
+            return nullptr;
+        }
+        endpoint_selector_->ReportSuccess(urls[0], (esp_timer_get_time() - start_time) / 1000);
+        endpoint_ = urls[0];
+        return websocket;
+    }
+
+    /*
+     * Happy eyeballs: start with the best ranked server, and start the next candidate whenever
+     * an attempt fails or the running one takes longer than the race delay. The first handshake
+     * that completes wins, the other attempts close their connection when they finish.
+     */
+    auto race = std::make_shared<ConnectRace>();
+    int race_delay_ms = endpoint_selector_->GetRaceDelay();
+    size_t next = 0;
+    int64_t last_start_time = 0;
+    while (true) {
+        int free_slot = -1;
+        bool running = false;
+        {
+            std::lock_guard<std::mutex> lock(race->mutex);
+            if (race->winner != nullptr) {
+                race->done = true;
+                endpoint_ = race->winner_url;
+                return std::move(race->winner);
+            }
+            running = race->busy_slots != 0;
+            if (next >= urls.size() && !running) {
+                race->done = true;
+                return nullptr;
+            }
+            for (int i = 0; i < WEBSOCKET_RACE_MAX_ATTEMPTS; i++) {
+                if (!(race->busy_slots & (1u << i))) {
+                    free_slot = i;
+                    break;
+                }
+            }
+        }
+
+        int wait_ms = -1;
+        if (next < urls.size() && free_slot >= 0) {
+            int waited_ms = (esp_timer_get_time() - last_start_time) / 1000;
+            if (!running || waited_ms >= race_delay_ms) {
+                auto websocket = CreateWebSocket(kRaceConnectIds[free_slot], token);
+                auto& url = urls[next++];
+                if (websocket == nullptr) {
+                    continue;
+                }
+                ESP_LOGI(TAG, "Racing websocket server: %s", url.c_str());
+                auto attempt = new ConnectAttempt{race, endpoint_selector_, std::move(websocket), url, free_slot};
+                {
+                    std::lock_guard<std::mutex> lock(race->mutex);
+                    race->busy_slots |= 1u << free_slot;
+                }
+                if (xTaskCreate(ConnectAttemptTask, "ws_connect", 4096 * 2, attempt, 5, NULL) != pdPASS) {
+                    ESP_LOGE(TAG, "Failed to create connect task");
+                    std::lock_guard<std::mutex> lock(race->mutex);
+                    race->busy_slots &= ~(1u << free_slot);
+                    delete attempt;
+                    continue;
+                }
+                last_start_time = esp_timer_get_time();
+                continue;
+            }
+            wait_ms = race_delay_ms - waited_ms;
+        }
+        xEventGroupWaitBits(race->event_group, CONNECT_RACE_FINISHED_EVENT, pdTRUE, pdFALSE,
+            wait_ms < 0 ? portMAX_DELAY : pdMS_TO_TICKS(wait_ms));
+    }
+}
+
 bool WebsocketProtocol::OpenAudioChannel() {
-    Settings settings("websocket", false);
-    std::string url = settings.GetString("url");
-    std::string token = settings.GetString("token");
-    int version = settings.GetInt("version");
+    std::string url = SettingsSchema::kWebsocketUrl.Get();
+    std::string token = SettingsSchema::kWebsocketToken.Get();
+    int version = SettingsSchema::kWebsocketVersion.Get();
     if (version != 0) {
         version_ = version;
     }
+    // Optional list of alternative servers, in addition to url
+    auto urls = EndpointSelector::Split(url + "\n" + SettingsSchema::kWebsocketUrls.Get());
 
     error_occurred_ = false;
-
-    auto network = Board::GetInstance().GetNetwork();
-    websocket_ = network->CreateWebSocket(1);
-    if (websocket_ == nullptr) {
-        ESP_LOGE(TAG, "Failed to create websocket");
-        return false;
-    }
+    // The hello exchange always uses text frames, framing is upgraded after the server hello
+    multiplex_ = false;
+    msgpack_ = false;
 
     if (!token.empty()) {
         // If token not has a space, add "Bearer " prefix
         if (token.find(" ") == std::string::npos) {
             token = "Bearer " + token;
         }
-        websocket_->SetHeader("Authorization", token.c_str());
     }
-    websocket_->SetHeader("Protocol-Version", std::to_string(version_).c_str());
-    websocket_->SetHeader("Device-Id", SystemInfo::GetMacAddress().c_str());
-    websocket_->SetHeader("Client-Id", Board::GetInstance().GetUuid().c_str());
+
+    endpoint_selector_->SetEndpoints(urls);
+    auto candidates = endpoint_selector_->GetRanking();
+    if (candidates.empty()) {
+        ESP_LOGE(TAG, "Websocket url is not specified");
+        SetError(Lang::Strings::SERVER_NOT_FOUND);
+        return false;
+    }
+
+    ESP_LOGI(TAG, "Connecting to websocket server: %s with version: %d", candidates[0].c_str(), version_);
+    websocket_ = ConnectFastest(candidates, token);
+    if (websocket_ == nullptr) {
+        ESP_LOGE(TAG, "Failed to connect to websocket server");
+        SetError(Lang::Strings::SERVER_NOT_CONNECTED);
+        return false;
+    }
+    ESP_LOGI(TAG, "Connected to websocket server: %s", endpoint_.c_str());
 
     websocket_->OnData([this](const char* data, size_t len, bool binary) {
         if (binary) {
-            if (on_incoming_audio_ != nullptr) {
+            if (version_ == 4) {
+                HandleBinaryFrame(data, len);
+            } else if (on_incoming_audio_ != nullptr) {
                 if (version_ == 2) {
                     BinaryProtocol2* bp2 = (BinaryProtocol2*)data;
                     bp2->version = ntohs(bp2->version);
@@ -145,21 +370,7 @@ bool WebsocketProtocol::OpenAudioChannel() {
                 }
             }
         } else {
-            // Parse JSON data
-            auto root = cJSON_Parse(data);
-            auto type = cJSON_GetObjectItem(root, "type");
-            if (cJSON_IsString(type)) {
-                if (strcmp(type->valuestring, "hello") == 0) {
-                    ParseServerHello(root);
-                } else {
-                    if (on_incoming_json_ != nullptr) {
-                        on_incoming_json_(root);
-                    }
-                }
-            } else {
-                ESP_LOGE(TAG, "Missing message type, data: %s", data);
-            }
-            cJSON_Delete(root);
+            HandleJsonMessage(data, len);
         }
         last_incoming_time_ = std::chrono::steady_clock::now();
     });
@@ -171,13 +382,6 @@ bool WebsocketProtocol::OpenAudioChannel() {
         }
     });
 
-    ESP_LOGI(TAG, "Connecting to websocket server: %s with version: %d", url.c_str(), version_);
-    if (!websocket_->Connect(url.c_str())) {
-        ESP_LOGE(TAG, "Failed to connect to websocket server");
-        SetError(Lang::Strings::SERVER_NOT_CONNECTED);
-        return false;
-    }
-
     // Send hello message to describe the client
     auto message = GetHelloMessage();
     if (!SendText(message)) {
@@ -188,6 +392,7 @@ bool WebsocketProtocol::OpenAudioChannel() {
     EventBits_t bits = xEventGroupWaitBits(event_group_handle_, WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT, pdTRUE, pdFALSE, pdMS_TO_TICKS(10000));
     if (!(bits & WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT)) {
         ESP_LOGE(TAG, "Failed to receive server hello");
+        endpoint_selector_->ReportFailure(endpoint_);
         SetError(Lang::Strings::SERVER_TIMEOUT);
         return false;
     }
@@ -201,53 +406,149 @@ bool WebsocketProtocol::OpenAudioChannel() {
 
 std::string WebsocketProtocol::GetHelloMessage() {
     // keys: message type, version, audio_params (format, sample_rate, channels)
-    cJSON* root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "type", "hello");
-    cJSON_AddNumberToObject(root, "version", version_);
-    cJSON* features = cJSON_CreateObject();
+    std::lock_guard<std::mutex> lock(json_writer_mutex_);
+    json_writer_.Clear();
+    json_writer_.BeginObject();
+    json_writer_.Member("type", "hello");
+    json_writer_.Member("version", version_);
+    json_writer_.Key("features").BeginObject();
 #if CONFIG_USE_SERVER_AEC
-    cJSON_AddBoolToObject(features, "aec", true);
+    json_writer_.Member("aec", true);
 #endif
-    cJSON_AddBoolToObject(features, "mcp", true);
-    cJSON_AddItemToObject(root, "features", features);
-    cJSON_AddStringToObject(root, "transport", "websocket");
-    cJSON* audio_params = cJSON_CreateObject();
-    cJSON_AddStringToObject(audio_params, "format", "opus");
-    cJSON_AddNumberToObject(audio_params, "sample_rate", 16000);
-    cJSON_AddNumberToObject(audio_params, "channels", 1);
-    cJSON_AddNumberToObject(audio_params, "frame_duration", OPUS_FRAME_DURATION_MS);
-    cJSON_AddItemToObject(root, "audio_params", audio_params);
-    auto json_str = cJSON_PrintUnformatted(root);
-    std::string message(json_str);
-    cJSON_free(json_str);
-    cJSON_Delete(root);
-    return message;
-}
-
-void WebsocketProtocol::ParseServerHello(const cJSON* root) {
-    auto transport = cJSON_GetObjectItem(root, "transport");
-    if (transport == nullptr || strcmp(transport->valuestring, "websocket") != 0) {
-        ESP_LOGE(TAG, "Unsupported transport: %s", transport->valuestring);
+    json_writer_.Member("mcp", true);
+    json_writer_.EndObject();
+    json_writer_.Member("transport", "websocket");
+    if (version_ == 4) {
+        // Control message encodings the device accepts in multiplexed frames
+        json_writer_.Key("encodings").BeginArray().String("json").String("msgpack").EndArray();
+    }
+    json_writer_.Key("audio_params").BeginObject();
+    json_writer_.Member("format", "opus");
+    json_writer_.Member("sample_rate", 16000);
+    json_writer_.Member("channels", 1);
+    json_writer_.Member("frame_duration", OPUS_FRAME_DURATION_MS);
+    json_writer_.EndObject();
+    json_writer_.EndObject();
+    return json_writer_.str();
+}
+
+void WebsocketProtocol::HandleJsonMessage(const char* data, size_t len) {
+    // Parse JSON data in place, without building a cJSON tree
+    if (!json_reader_.Parse(data, len)) {
+        ESP_LOGE(TAG, "Failed to parse json message, data: %.*s", (int)len, data);
+        return;
+    }
+    auto root = json_reader_.root();
+    auto type = root["type"];
+    if (type.IsString()) {
+        if (type.Equals("hello")) {
+            ParseServerHello(root);
+        } else {
+            if (on_incoming_json_ != nullptr) {
+                on_incoming_json_(root);
+            }
+        }
+    } else {
+        ESP_LOGE(TAG, "Missing message type, data: %.*s", (int)len, data);
+    }
+}
+
+void WebsocketProtocol::HandleBinaryFrame(const char* data, size_t len) {
+    if (len < sizeof(BinaryProtocol4)) {
+        ESP_LOGE(TAG, "Invalid frame size: %u", len);
+        return;
+    }
+    auto bp4 = (const BinaryProtocol4*)data;
+    size_t payload_size = ntohl(bp4->payload_size);
+    if (payload_size > len - sizeof(BinaryProtocol4)) {
+        ESP_LOGE(TAG, "Invalid frame payload size: %u, frame size: %u", payload_size, len);
+        return;
+    }
+    auto payload = (const char*)bp4->payload;
+
+    if (bp4->type == kBinaryFrameOpus) {
+        if (on_incoming_audio_ != nullptr) {
+            on_incoming_audio_(std::make_unique<AudioStreamPacket>(AudioStreamPacket{
+                .sample_rate = server_sample_rate_,
+                .frame_duration = server_frame_duration_,
+                .timestamp = ntohl(bp4->timestamp),
+                .payload = std::vector<uint8_t>((const uint8_t*)payload, (const uint8_t*)payload + payload_size)
+            }));
+        }
+        return;
+    }
+
+    bool is_msgpack = bp4->flags & BINARY_FRAME_FLAG_MSGPACK;
+    if (bp4->type == kBinaryFrameJson) {
+        if (!is_msgpack) {
+            HandleJsonMessage(payload, payload_size);
+            return;
+        }
+        decode_writer_.Clear();
+        if (!MsgPack::Decode((const uint8_t*)payload, payload_size, decode_writer_)) {
+            ESP_LOGE(TAG, "Failed to decode MessagePack control frame");
+            return;
+        }
+    } else if (bp4->type == kBinaryFrameMcp) {
+        // Restore the session envelope so MCP frames share the regular message path
+        decode_writer_.Clear();
+        decode_writer_.BeginObject();
+        decode_writer_.Member("session_id", session_id_);
+        decode_writer_.Member("type", "mcp");
+        decode_writer_.Key("payload");
+        if (is_msgpack) {
+            if (!MsgPack::Decode((const uint8_t*)payload, payload_size, decode_writer_)) {
+                ESP_LOGE(TAG, "Failed to decode MessagePack MCP frame");
+                return;
+            }
+        } else {
+            decode_writer_.Raw(std::string_view(payload, payload_size));
+        }
+        decode_writer_.EndObject();
+    } else {
+        ESP_LOGW(TAG, "Unknown frame type: %d", bp4->type);
         return;
     }
+    HandleJsonMessage(decode_writer_.str().data(), decode_writer_.size());
+}
 
-    auto session_id = cJSON_GetObjectItem(root, "session_id");
-    if (cJSON_IsString(session_id)) {
-        session_id_ = session_id->valuestring;
+void WebsocketProtocol::ParseServerHello(const JsonValue& root) {
+    auto transport = root["transport"];
+    if (!transport.Equals("websocket")) {
+        ESP_LOGE(TAG, "Unsupported transport: %s", transport.GetString("null").c_str());
+        return;
+    }
+
+    auto session_id = root["session_id"];
+    if (session_id.IsString()) {
+        session_id_ = session_id.GetString();
         ESP_LOGI(TAG, "Session ID: %s", session_id_.c_str());
     }
 
-    auto audio_params = cJSON_GetObjectItem(root, "audio_params");
-    if (cJSON_IsObject(audio_params)) {
-        auto sample_rate = cJSON_GetObjectItem(audio_params, "sample_rate");
-        if (cJSON_IsNumber(sample_rate)) {
-            server_sample_rate_ = sample_rate->valueint;
+    auto audio_params = root["audio_params"];
+    if (audio_params.IsObject()) {
+        auto sample_rate = audio_params["sample_rate"];
+        if (sample_rate.IsNumber()) {
+            server_sample_rate_ = sample_rate.GetInt();
+        }
+        auto frame_duration = audio_params["frame_duration"];
+        if (frame_duration.IsNumber()) {
+            server_frame_duration_ = frame_duration.GetInt();
         }
-        auto frame_duration = cJSON_GetObjectItem(audio_params, "frame_duration");
-        if (cJSON_IsNumber(frame_duration)) {
-            server_frame_duration_ = frame_duration->valueint;
+    }
+
+    // Version 4 is only used if the server confirms it, otherwise fall back to the framing it answers with
+    if (version_ == 4) {
+        int server_version = root["version"].GetInt(1);
+        if (server_version == 4) {
+            multiplex_ = true;
+            msgpack_ = root["encoding"].Equals("msgpack");
+        } else {
+            version_ = (server_version >= 1 && server_version <= 3) ? server_version : 1;
+            ESP_LOGW(TAG, "Server does not support multiplexed framing, fallback to version %d", version_);
         }
     }
+    ESP_LOGI(TAG, "Binary protocol version: %d, multiplex: %d, msgpack: %d", version_, multiplex_, msgpack_);
 
     xEventGroupSetBits(event_group_handle_, WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT);
 }
@@ -3,12 +3,15 @@
 
 
 #include "protocol.h"
+#include "endpoint_selector.h"
 
 #include <web_socket.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/event_groups.h>
 
 #define WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT (1 << 0)
+// Parallel connection attempts when racing several servers, each one needs its own modem socket
+#define WEBSOCKET_RACE_MAX_ATTEMPTS 2
 
 class WebsocketProtocol : public Protocol {
 public:
@@ -20,13 +23,29 @@ public:
     bool OpenAudioChannel() override;
     void CloseAudioChannel() override;
     bool IsAudioChannelOpened() const override;
+    void SendMcpMessage(const std::string& message) override;
 
 private:
     EventGroupHandle_t event_group_handle_;
     std::unique_ptr<WebSocket> websocket_;
+    // Shared with connection attempts that may outlive a race
+    std::shared_ptr<EndpointSelector> endpoint_selector_;
+    std::string endpoint_;
     int version_ = 1;
-
-    void ParseServerHello(const cJSON* root);
+    // Set when the server accepted the version 4 multiplexed framing
+    bool multiplex_ = false;
+    bool msgpack_ = false;
+    // Buffers for version 4 frames, the send side is only used from the main event loop
+    std::string frame_buffer_;
+    JsonReader encode_reader_;
+    JsonWriter decode_writer_;
+
+    std::unique_ptr<WebSocket> CreateWebSocket(int connect_id, const std::string& token);
+    std::unique_ptr<WebSocket> ConnectFastest(const std::vector<std::string>& urls, const std::string& token);
+    void ParseServerHello(const JsonValue& root);
+    void HandleJsonMessage(const char* data, size_t len);
+    void HandleBinaryFrame(const char* data, size_t len);
+    bool SendFrame(BinaryFrameType type, const std::string& payload);
     bool SendText(const std::string& text) override;
     std::string GetHelloMessage();
 };
@@ -1,108 +1,347 @@
 #include "settings.h"
 
 #include <esp_log.h>
+#include <esp_system.h>
 #include <nvs_flash.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <map>
+#include <mutex>
+#include <vector>
 
 #define TAG "Settings"
 
-Settings::Settings(const std::string& ns, bool read_write) : ns_(ns), read_write_(read_write) {
-    nvs_open(ns.c_str(), read_write_ ? NVS_READWRITE : NVS_READONLY, &nvs_handle_);
-}
+struct CachedValue {
+    nvs_type_t type = NVS_TYPE_ANY;     // NVS_TYPE_ANY marks an erased key
+    int32_t number = 0;
+    std::string text;
+    bool dirty = false;
+};
+
+struct CachedNamespace {
+    std::map<std::string, CachedValue> values;
+    bool erase_all = false;
+};
+
+class SettingsCache {
+public:
+    static SettingsCache& GetInstance() {
+        static SettingsCache instance;
+        return instance;
+    }
 
-Settings::~Settings() {
-    if (nvs_handle_ != 0) {
-        if (read_write_ && dirty_) {
-            ESP_ERROR_CHECK(nvs_commit(nvs_handle_));
+    bool Get(const std::string& ns, const std::string& key, nvs_type_t type, CachedValue& value) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& values = Load(ns).values;
+        auto it = values.find(key);
+        if (it == values.end() || it->second.type != type) {
+            return false;
         }
-        nvs_close(nvs_handle_);
+        value = it->second;
+        return true;
     }
-}
 
-std::string Settings::GetString(const std::string& key, const std::string& default_value) {
-    if (nvs_handle_ == 0) {
-        return default_value;
+    void Preload(const std::string& ns) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Load(ns);
     }
 
-    size_t length = 0;
-    if (nvs_get_str(nvs_handle_, key.c_str(), nullptr, &length) != ESP_OK) {
-        return default_value;
+    void Set(const std::string& ns, const std::string& key, nvs_type_t type, int32_t number, const std::string& text) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto& value = Load(ns).values[key];
+            if (value.type == type && value.number == number && value.text == text) {
+                return;
+            }
+            value.type = type;
+            value.number = number;
+            value.text = text;
+            value.dirty = true;
+        }
+        ScheduleFlush();
+    }
+
+    void Erase(const std::string& ns, const std::string& key) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto& values = Load(ns).values;
+            auto it = values.find(key);
+            if (it == values.end() || it->second.type == NVS_TYPE_ANY) {
+                return;
+            }
+            it->second = CachedValue();
+            it->second.dirty = true;
+        }
+        ScheduleFlush();
+    }
+
+    void EraseAll(const std::string& ns) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto& cached = Load(ns);
+            cached.values.clear();
+            cached.erase_all = true;
+        }
+        ScheduleFlush();
     }
 
-    std::string value;
-    value.resize(length);
-    ESP_ERROR_CHECK(nvs_get_str(nvs_handle_, key.c_str(), value.data(), &length));
-    while (!value.empty() && value.back() == '\0') {
-        value.pop_back();
+    void Flush() {
+        // Flushes run one at a time, so a later one never commits before an earlier one
+        std::lock_guard<std::mutex> flush_lock(flush_mutex_);
+        struct Pending {
+            std::string ns;
+            bool erase_all;
+            std::vector<std::pair<std::string, CachedValue>> values;
+            std::vector<bool> written;
+        };
+        std::vector<Pending> pending;
+        {
+            // Keys stay dirty until they are committed, a failed write is retried by the next flush
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto& [ns, cached] : namespaces_) {
+                Pending item = { ns, cached.erase_all, {}, {} };
+                for (auto& [key, value] : cached.values) {
+                    if (value.dirty) {
+                        item.values.emplace_back(key, value);
+                    }
+                }
+                cached.erase_all = false;
+                if (item.erase_all || !item.values.empty()) {
+                    pending.push_back(std::move(item));
+                }
+            }
+        }
+
+        for (auto& item : pending) {
+            item.written.assign(item.values.size(), false);
+            bool committed = CommitNamespace(item.ns, item.erase_all, item.values, item.written);
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto& cached = namespaces_[item.ns];
+            if (!committed && item.erase_all) {
+                cached.erase_all = true;
+            }
+            for (size_t i = 0; i < item.values.size(); i++) {
+                if (!committed || !item.written[i]) {
+                    continue;
+                }
+                // A value changed again since the snapshot still has to be written
+                auto& [key, written] = item.values[i];
+                auto it = cached.values.find(key);
+                if (it != cached.values.end() && it->second.type == written.type &&
+                    it->second.number == written.number && it->second.text == written.text) {
+                    it->second.dirty = false;
+                }
+            }
+        }
+    }
+
+private:
+    std::mutex mutex_;
+    std::mutex flush_mutex_;
+    std::map<std::string, CachedNamespace> namespaces_;
+    TaskHandle_t flush_task_ = nullptr;
+
+    // Writes one namespace, written tells which keys were set, returns whether the commit succeeded
+    bool CommitNamespace(const std::string& ns, bool erase_all,
+                         const std::vector<std::pair<std::string, CachedValue>>& values, std::vector<bool>& written) {
+        nvs_handle_t handle;
+        esp_err_t err = nvs_open(ns.c_str(), NVS_READWRITE, &handle);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to open namespace %s: %s", ns.c_str(), esp_err_to_name(err));
+            return false;
+        }
+        if (erase_all) {
+            err = nvs_erase_all(handle);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to erase namespace %s: %s", ns.c_str(), esp_err_to_name(err));
+                nvs_close(handle);
+                return false;
+            }
+        }
+        for (size_t i = 0; i < values.size(); i++) {
+            auto& [key, value] = values[i];
+            switch (value.type) {
+            case NVS_TYPE_I32:
+                err = nvs_set_i32(handle, key.c_str(), value.number);
+                break;
+            case NVS_TYPE_U8:
+                err = nvs_set_u8(handle, key.c_str(), (uint8_t)value.number);
+                break;
+            case NVS_TYPE_STR:
+                err = nvs_set_str(handle, key.c_str(), value.text.c_str());
+                break;
+            default:
+                err = nvs_erase_key(handle, key.c_str());
+                if (err == ESP_ERR_NVS_NOT_FOUND) {
+                    err = ESP_OK;
+                }
+                break;
+            }
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to write %s.%s: %s", ns.c_str(), key.c_str(), esp_err_to_name(err));
+            } else {
+                written[i] = true;
+            }
+        }
+        err = nvs_commit(handle);
+        nvs_close(handle);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to commit namespace %s: %s", ns.c_str(), esp_err_to_name(err));
+            return false;
+        }
+        ESP_LOGD(TAG, "Committed %u changes to %s", values.size(), ns.c_str());
+        return true;
+    }
+
+    SettingsCache() {
+        // Changes that are still waiting for the settings task survive esp_restart()
+        esp_register_shutdown_handler([]() {
+            SettingsCache::GetInstance().Flush();
+        });
     }
-    return value;
+
+    // Must be called with mutex_ held
+    CachedNamespace& Load(const std::string& ns) {
+        auto it = namespaces_.find(ns);
+        if (it != namespaces_.end()) {
+            return it->second;
+        }
+        auto& cached = namespaces_[ns];
+        nvs_handle_t handle;
+        if (nvs_open(ns.c_str(), NVS_READONLY, &handle) != ESP_OK) {
+            return cached;  // Not created yet
+        }
+        nvs_iterator_t iterator = nullptr;
+        esp_err_t err = nvs_entry_find(NVS_DEFAULT_PART_NAME, ns.c_str(), NVS_TYPE_ANY, &iterator);
+        while (err == ESP_OK) {
+            nvs_entry_info_t info;
+            nvs_entry_info(iterator, &info);
+            CachedValue value;
+            value.type = info.type;
+            if (info.type == NVS_TYPE_I32) {
+                err = nvs_get_i32(handle, info.key, &value.number);
+            } else if (info.type == NVS_TYPE_U8) {
+                uint8_t number = 0;
+                err = nvs_get_u8(handle, info.key, &number);
+                value.number = number;
+            } else if (info.type == NVS_TYPE_STR) {
+                size_t length = 0;
+                err = nvs_get_str(handle, info.key, nullptr, &length);
+                if (err == ESP_OK) {
+                    value.text.resize(length);
+                    err = nvs_get_str(handle, info.key, value.text.data(), &length);
+                    while (!value.text.empty() && value.text.back() == '\0') {
+                        value.text.pop_back();
+                    }
+                }
+            } else {
+                err = ESP_ERR_NOT_SUPPORTED;    // Settings does not read other types
+            }
+            if (err == ESP_OK) {
+                cached.values[info.key] = std::move(value);
+            }
+            err = nvs_entry_next(&iterator);
+        }
+        nvs_release_iterator(iterator);
+        nvs_close(handle);
+        ESP_LOGD(TAG, "Loaded %u keys from %s", cached.values.size(), ns.c_str());
+        return cached;
+    }
+
+    void ScheduleFlush() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (flush_task_ == nullptr) {
+                xTaskCreate([](void* arg) {
+                    ((SettingsCache*)arg)->FlushTask();
+                }, "settings", 4096, this, 2, &flush_task_);
+            }
+        }
+        xTaskNotifyGive(flush_task_);
+    }
+
+    void FlushTask() {
+        while (true) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            // Wait until the changes stop for a while, but not longer than the max delay
+            auto start = xTaskGetTickCount();
+            while (xTaskGetTickCount() - start < pdMS_TO_TICKS(SETTINGS_FLUSH_MAX_DELAY_MS) &&
+                   ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SETTINGS_FLUSH_DELAY_MS)) > 0) {
+            }
+            Flush();
+        }
+    }
+};
+
+Settings::Settings(const std::string& ns, bool read_write) : ns_(ns), read_write_(read_write) {
 }
 
-void Settings::SetString(const std::string& key, const std::string& value) {
-    if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_str(nvs_handle_, key.c_str(), value.c_str()));
-        dirty_ = true;
-    } else {
+bool Settings::CheckWritable() {
+    if (!read_write_) {
         ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
     }
+    return read_write_;
 }
 
-int32_t Settings::GetInt(const std::string& key, int32_t default_value) {
-    if (nvs_handle_ == 0) {
+std::string Settings::GetString(const std::string& key, const std::string& default_value) {
+    CachedValue value;
+    if (!SettingsCache::GetInstance().Get(ns_, key, NVS_TYPE_STR, value)) {
         return default_value;
     }
+    return value.text;
+}
 
-    int32_t value;
-    if (nvs_get_i32(nvs_handle_, key.c_str(), &value) != ESP_OK) {
+void Settings::SetString(const std::string& key, const std::string& value) {
+    if (CheckWritable()) {
+        SettingsCache::GetInstance().Set(ns_, key, NVS_TYPE_STR, 0, value);
+    }
+}
+
+int32_t Settings::GetInt(const std::string& key, int32_t default_value) {
+    CachedValue value;
+    if (!SettingsCache::GetInstance().Get(ns_, key, NVS_TYPE_I32, value)) {
         return default_value;
     }
-    return value;
+    return value.number;
 }
 
 void Settings::SetInt(const std::string& key, int32_t value) {
-    if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_i32(nvs_handle_, key.c_str(), value));
-        dirty_ = true;
-    } else {
-        ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
+    if (CheckWritable()) {
+        SettingsCache::GetInstance().Set(ns_, key, NVS_TYPE_I32, value, "");
     }
 }
 
 bool Settings::GetBool(const std::string& key, bool default_value) {
-    if (nvs_handle_ == 0) {
+    CachedValue value;
+    if (!SettingsCache::GetInstance().Get(ns_, key, NVS_TYPE_U8, value)) {
         return default_value;
     }
-
-    uint8_t value;
-    if (nvs_get_u8(nvs_handle_, key.c_str(), &value) != ESP_OK) {
-        return default_value;
-    }
-    return value != 0;
+    return value.number != 0;
 }
 
 void Settings::SetBool(const std::string& key, bool value) {
-    if (read_write_) {
-        ESP_ERROR_CHECK(nvs_set_u8(nvs_handle_, key.c_str(), value ? 1 : 0));
-        dirty_ = true;
-    } else {
-        ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
+    if (CheckWritable()) {
+        SettingsCache::GetInstance().Set(ns_, key, NVS_TYPE_U8, value ? 1 : 0, "");
     }
 }
 
 void Settings::EraseKey(const std::string& key) {
-    if (read_write_) {
-        auto ret = nvs_erase_key(nvs_handle_, key.c_str());
-        if (ret != ESP_ERR_NVS_NOT_FOUND) {
-            ESP_ERROR_CHECK(ret);
-        }
-    } else {
-        ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
+    if (CheckWritable()) {
+        SettingsCache::GetInstance().Erase(ns_, key);
     }
 }
 
 void Settings::EraseAll() {
-    if (read_write_) {
-        ESP_ERROR_CHECK(nvs_erase_all(nvs_handle_));
-    } else {
-        ESP_LOGW(TAG, "Namespace %s is not open for writing", ns_.c_str());
+    if (CheckWritable()) {
+        SettingsCache::GetInstance().EraseAll(ns_);
     }
 }
+
+void Settings::Flush() {
+    SettingsCache::GetInstance().Flush();
+}
+
+void Settings::Preload(const std::string& ns) {
+    SettingsCache::GetInstance().Preload(ns);
+}
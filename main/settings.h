@@ -4,10 +4,22 @@
 #include <string>
 #include <nvs_flash.h>
 
+// Writes are committed this long after the last change, so a burst of changes costs one commit
+#define SETTINGS_FLUSH_DELAY_MS 1500
+// A steady stream of changes is still committed at least this often
+#define SETTINGS_FLUSH_MAX_DELAY_MS 5000
+
+/*
+ * A view of one NVS namespace. All instances share a process-wide cache: a namespace is
+ * read from NVS once on first use, reads are served from RAM, and writes are committed
+ * in the background by a settings task after SETTINGS_FLUSH_DELAY_MS. Flush() commits
+ * right away and is also called before esp_restart().
+ *
+ * Code that writes the same namespaces through the NVS API directly should reboot afterwards.
+ */
 class Settings {
 public:
     Settings(const std::string& ns, bool read_write = false);
-    ~Settings();
 
     std::string GetString(const std::string& key, const std::string& default_value = "");
     void SetString(const std::string& key, const std::string& value);
@@ -18,11 +30,16 @@ public:
     void EraseKey(const std::string& key);
     void EraseAll();
 
+    // Commit every pending change to NVS now
+    static void Flush();
+    // Read a namespace into the cache now instead of on first use
+    static void Preload(const std::string& ns);
+
 private:
     std::string ns_;
-    nvs_handle_t nvs_handle_ = 0;
     bool read_write_ = false;
-    bool dirty_ = false;
+
+    bool CheckWritable();
 };
 
 #endif
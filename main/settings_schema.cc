@@ -0,0 +1,73 @@
+#include "settings_schema.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <cstring>
+#include <iterator>
+
+#define TAG "SettingsSchema"
+
+namespace SettingsSchema {
+
+void Preload() {
+    auto start_time = esp_timer_get_time();
+    int count = 0;
+    for (size_t i = 0; i < std::size(kAll); i++) {
+        // The schema is grouped by namespace, so a namespace starts where it differs from the previous one
+        if (i > 0 && strcmp(kAll[i]->ns, kAll[i - 1]->ns) == 0) {
+            continue;
+        }
+        Settings::Preload(kAll[i]->ns);
+        count++;
+    }
+    ESP_LOGI(TAG, "Loaded %d namespaces in %lld us", count, esp_timer_get_time() - start_time);
+}
+
+const SettingBase* Find(const char* ns, const char* key) {
+    for (auto setting : kAll) {
+        if (strcmp(setting->ns, ns) == 0 && strcmp(setting->key, key) == 0) {
+            return setting;
+        }
+    }
+    return nullptr;
+}
+
+void WriteJson(JsonWriter& json) {
+    json.BeginObject();
+    const char* ns = nullptr;
+    for (auto setting : kAll) {
+        if (!setting->exported) {
+            continue;
+        }
+        if (ns == nullptr || strcmp(ns, setting->ns) != 0) {
+            if (ns != nullptr) {
+                json.EndObject();
+            }
+            ns = setting->ns;
+            json.Key(ns).BeginObject();
+        }
+        switch (setting->type) {
+        case kSettingInt:
+            json.Member(setting->key, static_cast<const Setting<int32_t>*>(setting)->Get());
+            break;
+        case kSettingBool:
+            json.Member(setting->key, static_cast<const Setting<bool>*>(setting)->Get());
+            break;
+        case kSettingString:
+            json.Member(setting->key, static_cast<const Setting<std::string>*>(setting)->Get());
+            break;
+        }
+    }
+    if (ns != nullptr) {
+        json.EndObject();
+    }
+    json.EndObject();
+}
+
+std::string ToJson() {
+    JsonWriter json(512);
+    WriteJson(json);
+    return json.Release();
+}
+
+} // namespace SettingsSchema
@@ -0,0 +1,171 @@
+#ifndef SETTINGS_SCHEMA_H
+#define SETTINGS_SCHEMA_H
+
+#include "settings.h"
+#include "json_writer.h"
+
+#include <string>
+#include <cstdint>
+
+enum SettingType {
+    kSettingInt,
+    kSettingBool,
+    kSettingString,
+};
+
+// What every setting has in common, so the schema can be walked without knowing the value types
+struct SettingBase {
+    const char* ns;
+    const char* key;
+    SettingType type;
+    bool exported;      // Included in the system info and the settings JSON, secrets are not
+};
+
+template <typename T> struct SettingTraits;
+template <> struct SettingTraits<int32_t> {
+    using Default = int32_t;
+    static constexpr SettingType kType = kSettingInt;
+    static int32_t Read(Settings& settings, const char* key, int32_t fallback) { return settings.GetInt(key, fallback); }
+    static void Write(Settings& settings, const char* key, int32_t value) { settings.SetInt(key, value); }
+};
+template <> struct SettingTraits<bool> {
+    using Default = bool;
+    static constexpr SettingType kType = kSettingBool;
+    static bool Read(Settings& settings, const char* key, bool fallback) { return settings.GetBool(key, fallback); }
+    static void Write(Settings& settings, const char* key, bool value) { settings.SetBool(key, value); }
+};
+template <> struct SettingTraits<std::string> {
+    using Default = const char*;
+    static constexpr SettingType kType = kSettingString;
+    static std::string Read(Settings& settings, const char* key, const std::string& fallback) { return settings.GetString(key, fallback); }
+    static void Write(Settings& settings, const char* key, const std::string& value) { settings.SetString(key, value); }
+};
+
+/*
+ * A setting declared once with its namespace, key, type, default and validation:
+ *
+ *   int volume = SettingsSchema::kOutputVolume.Get();
+ *   SettingsSchema::kOutputVolume.Set(80);
+ *
+ * A stored value that fails validation reads as the default, and Set() refuses it. A setting with
+ * a clamp brings out-of-range values into range instead, for values the server may send.
+ */
+template <typename T>
+struct Setting : SettingBase {
+    using Default = typename SettingTraits<T>::Default;
+    Default default_value;
+    bool (*validate)(const T& value);
+    T (*clamp)(const T& value);
+
+    constexpr Setting(const char* ns, const char* key, Default default_value, bool exported = true,
+                      bool (*validate)(const T& value) = nullptr, T (*clamp)(const T& value) = nullptr)
+        : SettingBase{ ns, key, SettingTraits<T>::kType, exported }, default_value(default_value), validate(validate),
+          clamp(clamp) {}
+
+    T Get() const { return Get(T(default_value)); }
+
+    // For defaults that depend on the board, such as the codec's initial volume
+    T Get(const T& fallback) const {
+        Settings settings(ns);
+        T value = Clamp(SettingTraits<T>::Read(settings, key, fallback));
+        if (!IsValid(value)) {
+            return fallback;
+        }
+        return value;
+    }
+
+    bool Set(const T& value) const {
+        T clamped = Clamp(value);
+        if (!IsValid(clamped)) {
+            return false;
+        }
+        Settings settings(ns, true);
+        SettingTraits<T>::Write(settings, key, clamped);
+        return true;
+    }
+
+    T Clamp(const T& value) const { return clamp != nullptr ? clamp(value) : value; }
+    bool IsValid(const T& value) const { return validate == nullptr || validate(value); }
+
+    void Erase() const {
+        Settings settings(ns, true);
+        settings.EraseKey(key);
+    }
+};
+
+template <int32_t Min, int32_t Max>
+constexpr bool InRange(const int32_t& value) {
+    return value >= Min && value <= Max;
+}
+
+template <int32_t Min, int32_t Max>
+constexpr int32_t ClampToRange(const int32_t& value) {
+    return value < Min ? Min : (value > Max ? Max : value);
+}
+
+namespace SettingsSchema {
+
+// audio
+inline constexpr Setting<int32_t> kOutputVolume("audio", "output_volume", 70, true, InRange<0, 100>);
+
+// display
+inline constexpr Setting<std::string> kTheme("display", "theme", "light");
+inline constexpr Setting<int32_t> kBrightness("display", "brightness", 75, true, InRange<0, 100>);
+
+// wifi
+inline constexpr Setting<std::string> kOtaUrl("wifi", "ota_url", "");
+inline constexpr Setting<int32_t> kForceAp("wifi", "force_ap", 0, false, InRange<0, 1>);
+inline constexpr Setting<bool> kSleepMode("wifi", "sleep_mode", true);
+
+// network
+inline constexpr Setting<std::string> kProtocol("network", "protocol", "");
+
+// mqtt, written by Ota::CheckVersion from the server config
+inline constexpr Setting<std::string> kMqttEndpoint("mqtt", "endpoint", "");
+inline constexpr Setting<std::string> kMqttEndpoints("mqtt", "endpoints", "");
+inline constexpr Setting<std::string> kMqttClientId("mqtt", "client_id", "", false);
+inline constexpr Setting<std::string> kMqttUsername("mqtt", "username", "", false);
+inline constexpr Setting<std::string> kMqttPassword("mqtt", "password", "", false);
+inline constexpr Setting<std::string> kMqttPublishTopic("mqtt", "publish_topic", "");
+inline constexpr Setting<int32_t> kMqttKeepalive("mqtt", "keepalive", 240, true, nullptr, ClampToRange<10, 7200>);
+
+// websocket, written by Ota::CheckVersion from the server config
+inline constexpr Setting<std::string> kWebsocketUrl("websocket", "url", "");
+inline constexpr Setting<std::string> kWebsocketUrls("websocket", "urls", "");
+inline constexpr Setting<std::string> kWebsocketToken("websocket", "token", "", false);
+inline constexpr Setting<int32_t> kWebsocketVersion("websocket", "version", 0);
+
+// assets
+inline constexpr Setting<std::string> kAssetsDownloadUrl("assets", "download_url", "");
+inline constexpr Setting<int32_t> kAssetsVerified("assets", "verified", 0, false);
+
+// vendor
+inline constexpr Setting<int32_t> kPressToTalk("vendor", "press_to_talk", 0, true, InRange<0, 1>);
+
+// board, already part of the system info
+inline constexpr Setting<std::string> kBoardUuid("board", "uuid", "", false);
+
+// Every setting above, in the order they appear in the JSON
+inline constexpr const SettingBase* kAll[] = {
+    &kOutputVolume,
+    &kTheme, &kBrightness,
+    &kOtaUrl, &kForceAp, &kSleepMode,
+    &kProtocol,
+    &kMqttEndpoint, &kMqttEndpoints, &kMqttClientId, &kMqttUsername, &kMqttPassword, &kMqttPublishTopic, &kMqttKeepalive,
+    &kWebsocketUrl, &kWebsocketUrls, &kWebsocketToken, &kWebsocketVersion,
+    &kAssetsDownloadUrl, &kAssetsVerified,
+    &kPressToTalk,
+    &kBoardUuid,
+};
+
+// The schema entry of ns.key, nullptr for keys the schema does not declare
+const SettingBase* Find(const char* ns, const char* key);
+// Read every namespace of the schema from NVS, one iteration per namespace
+void Preload();
+// {"audio":{"output_volume":70},"display":{...}}, the values in effect of the exported settings
+void WriteJson(JsonWriter& json);
+std::string ToJson();
+
+} // namespace SettingsSchema
+
+#endif // SETTINGS_SCHEMA_H
@@ -0,0 +1,121 @@
+#include "status_store.h"
+#include "board.h"
+#include "application.h"
+
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+
+#define TAG "StatusStore"
+
+StatusStore& StatusStore::GetInstance() {
+    static StatusStore instance;
+    return instance;
+}
+
+void StatusStore::SetBattery(int level, bool charging, bool discharging) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (battery_.level == level && battery_.charging == charging && battery_.discharging == discharging) {
+            return;
+        }
+        battery_ = { level, charging, discharging };
+    }
+    MarkChanged(kStatusFieldBattery);
+}
+
+void StatusStore::SetNetworkIcon(const char* icon) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (icon == nullptr || network_icon_ == icon) {
+            return;
+        }
+        network_icon_ = icon;
+    }
+    MarkChanged(kStatusFieldNetwork);
+}
+
+void StatusStore::SetOutputVolume(int volume) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (output_volume_ == volume) {
+            return;
+        }
+        output_volume_ = volume;
+    }
+    MarkChanged(kStatusFieldVolume);
+}
+
+BatteryStatus StatusStore::GetBattery() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return battery_;
+}
+
+const char* StatusStore::GetNetworkIcon() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return network_icon_;
+}
+
+int StatusStore::GetOutputVolume() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return output_volume_;
+}
+
+void StatusStore::Refresh() {
+    auto& board = Board::GetInstance();
+    if (pm_lock_ != nullptr) {
+        esp_pm_lock_acquire(pm_lock_);
+    }
+    int level;
+    bool charging, discharging;
+    if (board.GetBatteryLevel(level, charging, discharging)) {
+        SetBattery(level, charging, discharging);
+    }
+    if (pm_lock_ != nullptr) {
+        esp_pm_lock_release(pm_lock_);
+    }
+}
+
+void StatusStore::RegisterChangeCallback(std::function<void(uint32_t)> callback) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    callbacks_.push_back(callback);
+}
+
+std::vector<std::function<void(uint32_t)>> StatusStore::GetCallbacks() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return callbacks_;
+}
+
+uint32_t StatusStore::TakeChanges() {
+    return changes_.exchange(0);
+}
+
+// Only the first change of a batch schedules the callbacks, later ones are picked up by the same run.
+// Changes often come from Wi-Fi and IP event handlers on the default event loop, whose small stack
+// must not wait for the display lock, so the callbacks run on the main task
+void StatusStore::MarkChanged(uint32_t fields) {
+    if (changes_.fetch_or(fields) != 0) {
+        return;
+    }
+    Application::GetInstance().Schedule([this]() {
+        uint32_t changes = TakeChanges();
+        if (changes == 0) {
+            return;
+        }
+        for (const auto& callback : GetCallbacks()) {
+            callback(changes);
+        }
+    });
+}
+
+StatusStore::StatusStore() {
+    esp_err_t err = esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, "status_refresh", &pm_lock_);
+    if (err != ESP_OK && err != ESP_ERR_NOT_SUPPORTED) {
+        ESP_ERROR_CHECK(err);
+    }
+}
+
+StatusStore::~StatusStore() {
+    if (pm_lock_ != nullptr) {
+        esp_pm_lock_delete(pm_lock_);
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef _STATUS_STORE_H_
+#define _STATUS_STORE_H_
+
+#include <esp_pm.h>
+#include <functional>
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+// Bits of the changed mask passed to the callbacks
+enum StatusField : uint32_t {
+    kStatusFieldBattery = 1 << 0,
+    kStatusFieldNetwork = 1 << 1,
+    kStatusFieldVolume = 1 << 2,
+    kStatusFieldAll = kStatusFieldBattery | kStatusFieldNetwork | kStatusFieldVolume,
+};
+
+struct BatteryStatus {
+    int level = -1;     // -1 if the board has no battery
+    bool charging = false;
+    bool discharging = false;
+};
+
+/*
+ * The values shown in the status bar. Battery monitors, network boards and the codec publish
+ * into the store when something changes, and the callbacks run once per batch of changes on
+ * the main task, so several updates in a row cause one redraw.
+ */
+class StatusStore {
+public:
+    static StatusStore& GetInstance();
+    StatusStore(const StatusStore&) = delete;
+    StatusStore& operator=(const StatusStore&) = delete;
+
+    void SetBattery(int level, bool charging, bool discharging);
+    void SetNetworkIcon(const char* icon);
+    void SetOutputVolume(int volume);
+
+    BatteryStatus GetBattery();
+    const char* GetNetworkIcon();
+    int GetOutputVolume();
+
+    // Read the battery of boards that have no battery monitor publishing it
+    void Refresh();
+
+    void RegisterChangeCallback(std::function<void(uint32_t)> callback);
+    std::vector<std::function<void(uint32_t)>> GetCallbacks();
+    uint32_t TakeChanges();
+
+private:
+    StatusStore();
+    ~StatusStore();
+
+    void MarkChanged(uint32_t fields);
+
+    std::mutex mutex_;
+    BatteryStatus battery_;
+    const char* network_icon_ = nullptr;
+    int output_volume_ = -1;
+    std::atomic<uint32_t> changes_ = 0;
+    std::vector<std::function<void(uint32_t)>> callbacks_;
+    esp_pm_lock_handle_t pm_lock_ = nullptr;
+};
+
+#endif // _STATUS_STORE_H_
@@ -0,0 +1,81 @@
+import argparse
+import json
+import sys
+
+
+'''
+  Extract the boot trace printed by the device (CONFIG_PRINT_BOOT_TRACE) from a serial log,
+  save it as a Chrome trace file and print the slowest startup phases.
+  Open the saved file in https://ui.perfetto.dev or chrome://tracing.
+
+  Usage: idf.py monitor | tee boot.log
+         python boot_trace.py boot.log -o boot_trace.json
+     or: python boot_trace.py --port /dev/ttyUSB0 -o boot_trace.json   (requires pyserial)
+  The JSON returned by the MCP tool self.get_boot_trace can be passed directly with --json.
+'''
+
+
+def read_lines_from_port(port, baudrate):
+    import serial
+    with serial.Serial(port, baudrate, timeout=1) as ser:
+        print(f"Waiting for the boot trace on {port}, reset the device...")
+        while True:
+            line = ser.readline()
+            if line:
+                yield line.decode('utf-8', errors='replace')
+
+
+def extract_trace(lines):
+    chunks = None
+    for line in lines:
+        line = line.rstrip('\r\n')
+        if line.endswith('BOOT_TRACE_BEGIN'):
+            chunks = []
+        elif line.endswith('BOOT_TRACE_END') and chunks is not None:
+            return json.loads(''.join(chunks))
+        elif chunks is not None and 'BOOT_TRACE ' in line:
+            chunks.append(line.split('BOOT_TRACE ', 1)[1])
+    raise SystemExit('No complete boot trace found')
+
+
+def print_summary(trace, top):
+    events = [e for e in trace['traceEvents'] if e.get('ph') == 'X']
+    tasks = {e['tid']: e['args']['name'] for e in trace['traceEvents'] if e.get('ph') == 'M'}
+    ready = [e['ts'] for e in trace['traceEvents'] if e.get('name') == 'ready']
+    if ready:
+        print(f"Ready at {ready[0] / 1000:.1f} ms")
+    print(f"{'phase':<24} {'task':<16} {'start_ms':>9} {'dur_ms':>9} {'used_kb':>8}")
+    for e in sorted(events, key=lambda e: e['dur'], reverse=True)[:top]:
+        used = (e['args']['free_heap_before'] - e['args']['free_heap_after']) / 1024
+        print(f"{e['name']:<24} {tasks.get(e['tid'], '?'):<16} {e['ts'] / 1000:>9.1f} {e['dur'] / 1000:>9.1f} {used:>8.1f}")
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('log', nargs='?', help='Serial log file, stdin if omitted')
+    parser.add_argument('--port', help='Read directly from a serial port')
+    parser.add_argument('--baudrate', type=int, default=115200)
+    parser.add_argument('--json', help='A trace returned by the MCP tool self.get_boot_trace')
+    parser.add_argument('-o', '--output', default='boot_trace.json')
+    parser.add_argument('--top', type=int, default=15, help='Number of phases to print')
+    args = parser.parse_args()
+
+    if args.json:
+        with open(args.json, encoding='utf-8') as f:
+            trace = json.load(f)
+    elif args.port:
+        trace = extract_trace(read_lines_from_port(args.port, args.baudrate))
+    elif args.log:
+        with open(args.log, encoding='utf-8', errors='replace') as f:
+            trace = extract_trace(f)
+    else:
+        trace = extract_trace(sys.stdin)
+
+    with open(args.output, 'w', encoding='utf-8') as f:
+        json.dump(trace, f, indent=1)
+    print(f"Saved {len(trace['traceEvents'])} events to {args.output}")
+    print_summary(trace, args.top)
+
+
+if __name__ == "__main__":
+    main()
@@ -16,6 +16,7 @@ import os
 import shutil
 import sys
 import json
+import zlib
 import struct
 from datetime import datetime
 
@@ -338,6 +339,23 @@ def compute_checksum(data):
     checksum = sum(data) & 0xFFFF
     return checksum
 
+HASH_TABLE_MAGIC = b'AHT1'
+HASH_BLOCK_SIZE = 64 * 1024
+
+def build_hash_table(data, block_size=HASH_BLOCK_SIZE):
+    """
+    Build the block hash table appended after the assets data, so the device can verify
+    the blocks it uses lazily instead of summing the whole partition on every boot.
+    Layout: |magic 4|block_size 4|block_count 4|table_crc 4|crc32 of each block 4 * block_count|
+    Firmware without support only checks the 16-bit checksum in the header and ignores it.
+    """
+    block_crcs = bytearray()
+    for offset in range(0, len(data), block_size):
+        block_crcs.extend(zlib.crc32(data[offset:offset + block_size]).to_bytes(4, byteorder='little'))
+    body = block_size.to_bytes(4, byteorder='little') + (len(block_crcs) // 4).to_bytes(4, byteorder='little')
+    table_crc = zlib.crc32(body + block_crcs)
+    return HASH_TABLE_MAGIC + body + table_crc.to_bytes(4, byteorder='little') + block_crcs
+
 
 def sort_key(filename):
     basename, extension = os.path.splitext(filename)
@@ -379,6 +397,9 @@ def pack_assets_simple(target_path, include_path, out_file, assets_path, max_nam
 
     total_files = len(file_info_list)
 
+    # The device binary searches the table in flash, so it is sorted by the zero padded name
+    file_info_list.sort(key=lambda info: info[0].ljust(max_name_len, '\0')[:max_name_len].encode('utf-8'))
+
     mmap_table = bytearray()
     for file_name, offset, file_size, width, height in file_info_list:
         if len(file_name) > max_name_len:
@@ -395,6 +416,9 @@ def pack_assets_simple(target_path, include_path, out_file, assets_path, max_nam
     combined_data_length = len(combined_data).to_bytes(4, byteorder='little')
     header_data = total_files.to_bytes(4, byteorder='little') + combined_checksum.to_bytes(4, byteorder='little')
     final_data = header_data + combined_data_length + combined_data
+    # The hash table starts 4 bytes aligned
+    final_data += b'\x00' * (-len(final_data) % 4)
+    final_data += build_hash_table(combined_data)
 
     with open(out_file, 'wb') as output_bin:
         output_bin.write(final_data)
@@ -0,0 +1,189 @@
+import argparse
+import hashlib
+import os
+import struct
+
+
+'''
+  Generate a delta patch from the running firmware to a new firmware, for Ota::UpgradeDelta.
+  The device rebuilds the new image from its running partition plus the patch and checks
+  the SHA-256 of the result, see main/delta_patcher.h for the format.
+
+  Usage: python delta_ota.py --old releases/v1.8.0/xiaozhi.bin --new build/xiaozhi.bin --output xiaozhi-1.8.0.patch
+  Serve the patch as firmware.delta_url to devices whose elf_sha256 matches the old image,
+  the full url is still needed as a fallback.
+'''
+
+DELTA_PATCH_MAGIC = 0x31544C44
+DEFAULT_WINDOW_SIZE = 32 * 1024
+KEY_SIZE = 16           # Length of the keys indexed from the old image
+SOURCE_STRIDE = 8       # Every SOURCE_STRIDE bytes of the old image is indexed
+MIN_COPY = 24           # Shorter matches cost more than a literal
+
+OP_END = 0x00
+OP_LITERAL = 0x01
+OP_COPY_SOURCE = 0x02
+OP_COPY_TARGET = 0x03
+
+# esp_image_header_t (24) + esp_image_segment_header_t (8), then esp_app_desc_t
+APP_DESC_OFFSET = 32
+APP_DESC_MAGIC = 0xABCD5432
+APP_ELF_SHA256_OFFSET = APP_DESC_OFFSET + 144
+
+
+def varint(value):
+    out = bytearray()
+    while True:
+        byte = value & 0x7F
+        value >>= 7
+        if value:
+            out.append(byte | 0x80)
+        else:
+            out.append(byte)
+            return bytes(out)
+
+
+def zigzag(value):
+    return (value << 1) if value >= 0 else ((-value) << 1) - 1
+
+
+def get_elf_sha256(image):
+    magic, = struct.unpack_from('<I', image, APP_DESC_OFFSET)
+    if magic != APP_DESC_MAGIC:
+        raise ValueError('Not an ESP-IDF application image')
+    return image[APP_ELF_SHA256_OFFSET:APP_ELF_SHA256_OFFSET + 32]
+
+
+def match_length(a, a_pos, b, b_pos, limit):
+    length = 0
+    # Compare in blocks first, long matches are common between two builds
+    while length + 64 <= limit and a[a_pos + length:a_pos + length + 64] == b[b_pos + length:b_pos + length + 64]:
+        length += 64
+    while length < limit and a[a_pos + length] == b[b_pos + length]:
+        length += 1
+    return length
+
+
+class PatchWriter:
+    def __init__(self):
+        self.out = bytearray()
+        self.literal = bytearray()
+        self.source_position = 0
+        self.stats = {'literal': 0, 'source': 0, 'target': 0}
+
+    def add_literal(self, data):
+        self.literal += data
+
+    def flush_literal(self):
+        if self.literal:
+            self.out += bytes([OP_LITERAL]) + varint(len(self.literal)) + self.literal
+            self.stats['literal'] += len(self.literal)
+            self.literal = bytearray()
+
+    def copy_source(self, offset, length):
+        self.flush_literal()
+        self.out += bytes([OP_COPY_SOURCE]) + varint(length) + varint(zigzag(offset - self.source_position))
+        self.source_position = offset + length
+        self.stats['source'] += length
+
+    def copy_target(self, distance, length):
+        self.flush_literal()
+        self.out += bytes([OP_COPY_TARGET]) + varint(length) + varint(distance)
+        self.stats['target'] += length
+
+    def end(self):
+        self.flush_literal()
+        self.out.append(OP_END)
+
+
+def make_patch(old, new, window_size):
+    # Index the old image, keep the first offset of each key
+    source_index = {}
+    for offset in range(0, len(old) - KEY_SIZE + 1, SOURCE_STRIDE):
+        source_index.setdefault(old[offset:offset + KEY_SIZE], offset)
+
+    target_index = {}
+    writer = PatchWriter()
+    position = 0
+    # The next source copy is expected where the last one ended, code that only moved keeps matching there
+    while position < len(new):
+        best_length, best_op, best_arg = 0, None, 0
+        remaining = len(new) - position
+
+        expected = writer.source_position
+        if expected < len(old):
+            length = match_length(old, expected, new, position, min(remaining, len(old) - expected))
+            if length >= MIN_COPY:
+                best_length, best_op, best_arg = length, OP_COPY_SOURCE, expected
+
+        key = new[position:position + KEY_SIZE]
+        if len(key) == KEY_SIZE:
+            # A key in the old image may start up to SOURCE_STRIDE - 1 bytes before the current position
+            for back in range(min(SOURCE_STRIDE, position + 1)):
+                candidate = source_index.get(new[position - back:position - back + KEY_SIZE])
+                if candidate is None or candidate + back >= len(old):
+                    continue
+                start = candidate + back
+                length = match_length(old, start, new, position, min(remaining, len(old) - start))
+                if length > best_length:
+                    best_length, best_op, best_arg = length, OP_COPY_SOURCE, start
+
+            candidate = target_index.get(key)
+            if candidate is not None and position - candidate <= window_size:
+                length = match_length(new, candidate, new, position, remaining)
+                if length > best_length + 4:
+                    best_length, best_op, best_arg = length, OP_COPY_TARGET, position - candidate
+
+        if best_length >= MIN_COPY:
+            if best_op == OP_COPY_SOURCE:
+                writer.copy_source(best_arg, best_length)
+            else:
+                writer.copy_target(best_arg, best_length)
+            step = best_length
+        else:
+            writer.add_literal(new[position:position + 1])
+            step = 1
+
+        for p in range(position, min(position + step, len(new) - KEY_SIZE + 1)):
+            target_index[new[p:p + KEY_SIZE]] = p
+        position += step
+
+    writer.end()
+    return bytes(writer.out), writer.stats
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--old', required=True, help='Firmware running on the devices')
+    parser.add_argument('--new', required=True, help='Firmware to upgrade to')
+    parser.add_argument('--output', required=True, help='Patch file')
+    parser.add_argument('--window', type=int, default=DEFAULT_WINDOW_SIZE,
+                        help='Target window in bytes, the device allocates this much, at most 65536')
+    args = parser.parse_args()
+
+    if args.window <= 0 or args.window > 64 * 1024:
+        parser.error('--window must be between 1 and 65536')
+
+    with open(args.old, 'rb') as f:
+        old = f.read()
+    with open(args.new, 'rb') as f:
+        new = f.read()
+
+    source_elf_sha256 = get_elf_sha256(old)
+    get_elf_sha256(new)
+    body, stats = make_patch(old, new, args.window)
+    header = struct.pack('<IIII', DELTA_PATCH_MAGIC, args.window, len(old), len(new))
+    header += source_elf_sha256 + hashlib.sha256(new).digest()
+
+    with open(args.output, 'wb') as f:
+        f.write(header + body)
+
+    patch_size = len(header) + len(body)
+    print(f"Source elf_sha256: {source_elf_sha256.hex()}")
+    print(f"Copied {stats['source']} bytes from the old image, {stats['target']} from the new one, "
+          f"{stats['literal']} literal bytes")
+    print(f"Wrote {args.output}: {patch_size} bytes, {patch_size * 100 / len(new):.1f}% of {os.path.basename(args.new)}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,111 @@
+import argparse
+import os
+import random
+import re
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+
+'''
+  A stand-in HTTP server for firmware and assets downloads, with bandwidth throttling,
+  random disconnects and optional Range support, to test resumable downloads on a device.
+  Every request is logged with its range and measured throughput.
+
+  Usage: python download_test_server.py --file build/xiaozhi.bin --rate 200 --drop-every 300
+  Then upgrade with the MCP tool self.upgrade_firmware, url http://<host>:8080/xiaozhi.bin,
+  or set the assets url with self.assets.set_download_url.
+'''
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = 'HTTP/1.1'
+
+    def do_GET(self):
+        args = self.server.args
+        if os.path.basename(self.path) != os.path.basename(args.file):
+            self.send_error(404)
+            return
+
+        with open(args.file, 'rb') as f:
+            data = f.read()
+        total = len(data)
+        start, end = 0, total - 1
+
+        range_header = self.headers.get('Range')
+        match = re.match(r'bytes=(\d+)-(\d*)', range_header or '')
+        if match and not args.no_range:
+            start = int(match.group(1))
+            if match.group(2):
+                end = min(int(match.group(2)), total - 1)
+            if start >= total:
+                self.send_response(416)
+                self.send_header('Content-Range', f'bytes */{total}')
+                self.send_header('Content-Length', '0')
+                self.end_headers()
+                return
+            self.send_response(206)
+            self.send_header('Content-Range', f'bytes {start}-{end}/{total}')
+        else:
+            self.send_response(200)
+        self.send_header('Content-Type', 'application/octet-stream')
+        self.send_header('Content-Length', str(end - start + 1))
+        self.send_header('Accept-Ranges', 'none' if args.no_range else 'bytes')
+        self.end_headers()
+
+        # Drop the connection after a random amount of data, around --drop-every KB
+        drop_after = None
+        if args.drop_every > 0:
+            drop_after = int(random.uniform(0.5, 1.5) * args.drop_every * 1024)
+
+        sent = 0
+        begin = time.monotonic()
+        position = start
+        chunk_size = 4096
+        try:
+            while position <= end:
+                chunk = data[position:min(position + chunk_size, end + 1)]
+                if drop_after is not None and sent + len(chunk) > drop_after:
+                    self.wfile.write(chunk[:drop_after - sent])
+                    sent = drop_after
+                    print(f"{self.client_address[0]} bytes {start}-{end}/{total}: dropped after {sent} bytes")
+                    self.close_connection = True
+                    return
+                self.wfile.write(chunk)
+                sent += len(chunk)
+                position += len(chunk)
+                if args.rate > 0:
+                    # Sleep until the average rate is back under the limit
+                    ahead = sent / (args.rate * 1024) - (time.monotonic() - begin)
+                    if ahead > 0:
+                        time.sleep(ahead)
+        except (BrokenPipeError, ConnectionResetError):
+            print(f"{self.client_address[0]} closed the connection after {sent} bytes")
+            return
+        elapsed = max(time.monotonic() - begin, 1e-6)
+        print(f"{self.client_address[0]} bytes {start}-{end}/{total}: {sent} bytes in {elapsed:.1f}s, "
+              f"{sent / 1024 / elapsed:.1f} KB/s")
+
+    def log_message(self, format, *args):
+        pass
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--file', required=True, help='File to serve, requested by its base name')
+    parser.add_argument('--port', type=int, default=8080)
+    parser.add_argument('--rate', type=float, default=0, help='Bandwidth limit in KB/s per connection, 0 for none')
+    parser.add_argument('--drop-every', type=float, default=0, help='Drop the connection after about this many KB')
+    parser.add_argument('--no-range', action='store_true', help='Ignore Range requests, like some CDNs')
+    args = parser.parse_args()
+
+    server = ThreadingHTTPServer(('0.0.0.0', args.port), Handler)
+    server.args = args
+    print(f"Serving {args.file} ({os.path.getsize(args.file)} bytes) on port {args.port}")
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,84 @@
+import asyncio
+import argparse
+import json
+
+import websockets
+
+
+'''
+  Start several stand-in websocket servers with injected handshake latency, to test
+  multi-server failover and latency-based endpoint selection on a device.
+
+  Each --server argument is PORT[:DELAY_MS[:MODE]], MODE is one of
+    ok       answer the hello normally (default)
+    refuse   reject the websocket handshake
+    silent   accept the connection but never answer the hello
+
+  Usage: python endpoint_test_servers.py --server 8001:50 --server 8002:400 --server 8003:0:refuse
+  Then configure "urls": ["ws://<host>:8001/", "ws://<host>:8002/", "ws://<host>:8003/"] in the OTA response.
+'''
+
+
+def parse_server(text):
+    parts = text.split(':')
+    port = int(parts[0])
+    delay_ms = int(parts[1]) if len(parts) > 1 else 0
+    mode = parts[2] if len(parts) > 2 else 'ok'
+    if mode not in ('ok', 'refuse', 'silent'):
+        raise argparse.ArgumentTypeError(f"unknown mode {mode}")
+    return port, delay_ms, mode
+
+
+async def run_server(port, delay_ms, mode):
+    name = f"[{port} {delay_ms}ms {mode}]"
+
+    async def process_request(*_):
+        # Delay the handshake response to emulate a far away or overloaded server
+        await asyncio.sleep(delay_ms / 1000)
+        if mode == 'refuse':
+            print(f"{name} refused handshake")
+            return (503, [], b"unavailable\n")
+        return None
+
+    async def handler(websocket, *_):
+        print(f"{name} connection from {websocket.remote_address}")
+        try:
+            async for data in websocket:
+                if isinstance(data, bytes):
+                    continue
+                message = json.loads(data)
+                if message.get("type") == "hello" and mode == 'ok':
+                    await websocket.send(json.dumps({
+                        "type": "hello",
+                        "transport": "websocket",
+                        "session_id": f"endpoint-{port}",
+                        "audio_params": message.get("audio_params", {}),
+                    }))
+                else:
+                    print(f"{name} {message}")
+        except websockets.ConnectionClosed:
+            pass
+        print(f"{name} connection closed")
+
+    async with websockets.serve(handler, '0.0.0.0', port, process_request=process_request):
+        print(f"{name} listening")
+        await asyncio.Future()
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--server', type=parse_server, action='append', required=True,
+                        help='PORT[:DELAY_MS[:MODE]], may be repeated')
+    args = parser.parse_args()
+
+    async def run_all():
+        await asyncio.gather(*(run_server(*server) for server in args.server))
+
+    try:
+        asyncio.run(run_all())
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
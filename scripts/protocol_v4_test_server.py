@@ -0,0 +1,150 @@
+import asyncio
+import argparse
+import json
+import struct
+
+import websockets
+
+try:
+    import msgpack
+except ImportError:
+    msgpack = None
+
+
+'''
+  A minimal WebSocket server for testing the version 4 multiplexed binary framing.
+  Accepts the device hello, negotiates version 4 (and MessagePack if requested),
+  prints every frame it receives and echoes received audio back to the device.
+
+  Usage: python protocol_v4_test_server.py --port 8765 [--msgpack] [--version 3]
+  Point the device websocket url to ws://<host>:<port>/ and set version 4 in the OTA config.
+'''
+
+FRAME_OPUS = 0
+FRAME_JSON = 1
+FRAME_MCP = 2
+FLAG_MSGPACK = 0x01
+HEADER = struct.Struct('>BBHII')
+
+
+def pack_frame(frame_type, payload, flags=0, timestamp=0):
+    return HEADER.pack(frame_type, flags, 0, timestamp, len(payload)) + payload
+
+
+def unpack_frame(data):
+    if len(data) < HEADER.size:
+        raise ValueError(f"frame too short: {len(data)}")
+    frame_type, flags, _, timestamp, size = HEADER.unpack_from(data)
+    payload = data[HEADER.size:HEADER.size + size]
+    if len(payload) != size:
+        raise ValueError(f"payload size mismatch: {len(payload)} != {size}")
+    return frame_type, flags, timestamp, payload
+
+
+class Session:
+    def __init__(self, websocket, args):
+        self.websocket = websocket
+        self.version = args.version
+        self.use_msgpack = args.msgpack
+        self.multiplex = False
+        self.echo = args.echo
+        self.audio_frames = 0
+
+    def decode(self, flags, payload):
+        if flags & FLAG_MSGPACK:
+            return msgpack.unpackb(payload, raw=False)
+        return json.loads(payload)
+
+    async def send_json(self, message, frame_type=FRAME_JSON):
+        if not self.multiplex:
+            await self.websocket.send(json.dumps(message))
+            return
+        if self.use_msgpack:
+            await self.websocket.send(pack_frame(frame_type, msgpack.packb(message), FLAG_MSGPACK))
+        else:
+            await self.websocket.send(pack_frame(frame_type, json.dumps(message).encode()))
+
+    async def on_hello(self, message):
+        print(f"Hello: {message}")
+        device_version = message.get("version", 1)
+        encodings = message.get("encodings", ["json"])
+        reply = {
+            "type": "hello",
+            "transport": "websocket",
+            "session_id": "v4-test",
+            "version": self.version if device_version == 4 else device_version,
+            "audio_params": message.get("audio_params", {"sample_rate": 16000, "frame_duration": 60}),
+        }
+        self.use_msgpack = self.use_msgpack and "msgpack" in encodings
+        if reply["version"] == 4 and self.use_msgpack:
+            reply["encoding"] = "msgpack"
+        # The hello reply is always a text frame, framing switches after it
+        await self.websocket.send(json.dumps(reply))
+        self.multiplex = reply["version"] == 4
+        print(f"Negotiated version {reply['version']}, msgpack: {self.use_msgpack and self.multiplex}")
+
+    async def on_message(self, message):
+        if message.get("type") == "hello":
+            await self.on_hello(message)
+        elif message.get("type") == "listen" and message.get("state") == "detect":
+            await self.send_json({"type": "stt", "text": message.get("text", "")})
+        elif message.get("type") == "mcp":
+            print(f"MCP: {message.get('payload')}")
+        else:
+            print(f"JSON: {message}")
+
+    async def on_frame(self, data):
+        if not self.multiplex:
+            self.audio_frames += 1
+            return
+        frame_type, flags, timestamp, payload = unpack_frame(data)
+        if frame_type == FRAME_OPUS:
+            self.audio_frames += 1
+            if self.audio_frames % 50 == 0:
+                print(f"Received {self.audio_frames} audio frames, last timestamp {timestamp}")
+            if self.echo:
+                await self.websocket.send(pack_frame(FRAME_OPUS, payload, timestamp=timestamp))
+        elif frame_type == FRAME_JSON:
+            await self.on_message(self.decode(flags, payload))
+        elif frame_type == FRAME_MCP:
+            payload = self.decode(flags, payload)
+            print(f"MCP: {payload}")
+            if payload.get("id") == 1 and "result" in payload:
+                await self.send_json({"jsonrpc": "2.0", "method": "tools/list", "params": {}, "id": 2}, FRAME_MCP)
+        else:
+            print(f"Unknown frame type {frame_type}")
+
+    async def run(self):
+        async for data in self.websocket:
+            if isinstance(data, bytes):
+                await self.on_frame(data)
+            else:
+                await self.on_message(json.loads(data))
+        print(f"Connection closed, {self.audio_frames} audio frames received")
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--port', type=int, default=8765)
+    parser.add_argument('--version', type=int, default=4, help='Version to answer when the device asks for 4')
+    parser.add_argument('--msgpack', action='store_true', help='Use MessagePack for control messages')
+    parser.add_argument('--echo', action='store_true', help='Echo received audio back to the device')
+    args = parser.parse_args()
+
+    if args.msgpack and msgpack is None:
+        parser.error("--msgpack requires the msgpack package")
+
+    async def handler(websocket, *_):
+        print(f"Connection from {websocket.remote_address}")
+        await Session(websocket, args).run()
+
+    async def serve():
+        async with websockets.serve(handler, '0.0.0.0', args.port, max_size=None):
+            print(f"Listening on 0.0.0.0:{args.port}")
+            await asyncio.Future()
+
+    asyncio.run(serve())
+
+
+if __name__ == "__main__":
+    main()
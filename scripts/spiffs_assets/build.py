@@ -305,7 +305,7 @@ def generate_index_json(assets_dir, srmodels, text_font, emoji_collection, icon_
     print(f"Generated: {index_path}")
 
 
-def generate_config_json(build_dir, assets_dir):
+def generate_config_json(build_dir, assets_dir, compress=False, decode_budget_ms=50, decode_rate=20):
     """Generate config.json file"""
     # Get absolute path of current working directory
     workspace_dir = os.path.abspath(os.path.join(os.path.dirname(__file__)))
@@ -325,7 +325,10 @@ def generate_config_json(build_dir, assets_dir):
         "support_sqoi": False,
         "support_raw": False,
         "support_raw_dither": False,
-        "support_raw_bgr": False
+        "support_raw_bgr": False,
+        "compress": compress,
+        "decode_budget_ms": decode_budget_ms,
+        "decode_rate": decode_rate
     }
     
     # Write config.json
@@ -345,6 +348,9 @@ def main():
 
     parser.add_argument('--res_path', help='Path to res directory')
     parser.add_argument('--target_board', help='Path to target board directory')
+    parser.add_argument('--compress', action='store_true', help='Compress the assets that fit in the decode budget')
+    parser.add_argument('--decode_budget_ms', type=float, default=50, help='Longest first access decode time of a compressed asset')
+    parser.add_argument('--decode_rate', type=float, default=20, help='Device decompression speed in KB per ms')
     
     args = parser.parse_args()
     
@@ -378,7 +384,7 @@ def main():
     generate_index_json(assets_dir, srmodels, text_font, emoji_collection, icon_collection, layout_json)
     
     # Generate config.json
-    config_path = generate_config_json(build_dir, assets_dir)
+    config_path = generate_config_json(build_dir, assets_dir, args.compress, args.decode_budget_ms, args.decode_rate)
     
     # Use spiffs_assets_gen.py to package final build/assets.bin
     try:
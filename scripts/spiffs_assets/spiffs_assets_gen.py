@@ -4,6 +4,7 @@ import io
 import os
 import argparse
 import json
+import zlib
 import shutil
 import math
 import sys
@@ -45,6 +46,9 @@ class PackModelsConfig:
     image_file: str
     assets_path: str
     name_length: int
+    compress: bool = False
+    decode_budget_ms: float = 50.0
+    decode_rate: float = 20.0
 
 def generate_header_filename(path):
     asset_name = os.path.basename(path)
@@ -56,6 +60,117 @@ def compute_checksum(data):
     checksum = sum(data) & 0xFFFF
     return checksum
 
+HASH_TABLE_MAGIC = b'AHT1'
+HASH_BLOCK_SIZE = 64 * 1024
+
+def build_hash_table(data, block_size=HASH_BLOCK_SIZE):
+    """
+    Build the block hash table appended after the assets data, so the device can verify
+    the blocks it uses lazily instead of summing the whole partition on every boot.
+    Layout: |magic 4|block_size 4|block_count 4|table_crc 4|crc32 of each block 4 * block_count|
+    Firmware without support only checks the 16-bit checksum in the header and ignores it.
+    """
+    block_crcs = bytearray()
+    for offset in range(0, len(data), block_size):
+        block_crcs.extend(zlib.crc32(data[offset:offset + block_size]).to_bytes(4, byteorder='little'))
+    body = block_size.to_bytes(4, byteorder='little') + (len(block_crcs) // 4).to_bytes(4, byteorder='little')
+    table_crc = zlib.crc32(body + block_crcs)
+    return HASH_TABLE_MAGIC + body + table_crc.to_bytes(4, byteorder='little') + block_crcs
+
+COMPRESSED_BLOCK_SIZE = 16 * 1024
+COMPRESS_MIN_SAVING = 0.1
+# Assets the firmware reads before it knows about compression, or that are read in place by design
+COMPRESS_SKIP_FILES = ['index.json', 'srmodels.bin']
+
+def lz4_compress_block(data):
+    """
+    Compress one LZ4 block (no frame), greedy matching on 4-byte hashes.
+    The python lz4 package is used when installed, the output format is the same.
+    """
+    try:
+        import lz4.block
+        return lz4.block.compress(data, store_size=False)
+    except ImportError:
+        pass
+
+    def put_length(out, value):
+        while value >= 255:
+            out.append(255)
+            value -= 255
+        out.append(value)
+
+    out = bytearray()
+    table = {}
+    size = len(data)
+    anchor = 0
+    position = 0
+    # The format requires the last match to start 12 bytes before the end and end 5 bytes before it
+    while position < size - 12:
+        key = data[position:position + 4]
+        candidate = table.get(key)
+        table[key] = position
+        if candidate is None or position - candidate > 65535:
+            position += 1
+            continue
+        length = 4
+        limit = size - 5 - position
+        while length + 32 <= limit and data[candidate + length:candidate + length + 32] == data[position + length:position + length + 32]:
+            length += 32
+        while length < limit and data[candidate + length] == data[position + length]:
+            length += 1
+
+        literal_length = position - anchor
+        out.append((min(literal_length, 15) << 4) | min(length - 4, 15))
+        if literal_length >= 15:
+            put_length(out, literal_length - 15)
+        out += data[anchor:position]
+        out += (position - candidate).to_bytes(2, byteorder='little')
+        if length - 4 >= 15:
+            put_length(out, length - 4 - 15)
+        position += length
+        anchor = position
+
+    literal_length = size - anchor
+    out.append(min(literal_length, 15) << 4)
+    if literal_length >= 15:
+        put_length(out, literal_length - 15)
+    out += data[anchor:]
+    return bytes(out)
+
+def compress_asset(data, block_size=COMPRESSED_BLOCK_SIZE):
+    """
+    Compress an asset into independent LZ4 blocks, so the device can decompress it one block at a time.
+    Layout after the "ZL" magic: |raw_size 4|block_size 4|block_count 4|end offset of each block 4 * block_count|blocks|
+    A block that does not shrink is stored as is.
+    """
+    blocks = bytearray()
+    ends = bytearray()
+    for offset in range(0, len(data), block_size):
+        raw = data[offset:offset + block_size]
+        compressed = lz4_compress_block(raw)
+        blocks += compressed if len(compressed) < len(raw) else raw
+        ends += len(blocks).to_bytes(4, byteorder='little')
+    block_count = len(ends) // 4
+    header = len(data).to_bytes(4, byteorder='little') + block_size.to_bytes(4, byteorder='little') + block_count.to_bytes(4, byteorder='little')
+    return header + bytes(ends) + bytes(blocks)
+
+def choose_compression(file_name, data, config: PackModelsConfig):
+    """
+    Return the compressed payload if it is worth it, or None to store the asset as is.
+    The device decompresses an asset into PSRAM when it is first used, so only assets whose
+    decode time fits in decode_budget_ms are compressed. decode_rate is the device LZ4 throughput
+    in KB per ms, calibrate it from the "Decompressed ... in N us" lines in the device log.
+    """
+    if not config.compress or file_name in COMPRESS_SKIP_FILES or len(data) < 1024:
+        return None
+    decode_ms = len(data) / 1024 / config.decode_rate
+    if decode_ms > config.decode_budget_ms:
+        return None
+    payload = compress_asset(data)
+    if len(payload) > len(data) * (1 - COMPRESS_MIN_SAVING):
+        return None
+    return payload
+
 def sort_key(filename):
     basename, extension = os.path.splitext(filename)
     return extension, basename
@@ -401,6 +516,7 @@ def pack_assets(config: PackModelsConfig):
 
     merged_data = bytearray()
     file_info_list = []
+    compressed_files = []
     skip_files = ['config.json', 'lvgl_image_converter']
 
     file_list = sorted(os.listdir(target_path), key=sort_key)
@@ -429,17 +545,36 @@ def pack_assets(config: PackModelsConfig):
             else:
                 width, height = 0, 0
 
-        file_info_list.append((file_name, len(merged_data), file_size, width, height))
-        # Add 0x5A5A prefix to merged_data
-        merged_data.extend(b'\x5A' * 2)
-
         with open(file_path, 'rb') as bin_file:
             bin_data = bin_file.read()
 
-        merged_data.extend(bin_data)
+        payload = choose_compression(file_name, bin_data, config)
+        if payload is not None:
+            decode_ms = file_size / 1024 / config.decode_rate
+            compressed_files.append((file_name, file_size, len(payload), decode_ms))
+            file_info_list.append((file_name, len(merged_data), len(payload), width, height))
+            # "ZL" marks a compressed asset
+            merged_data.extend(b'ZL')
+            merged_data.extend(payload)
+        else:
+            file_info_list.append((file_name, len(merged_data), file_size, width, height))
+            # Add 0x5A5A prefix to merged_data
+            merged_data.extend(b'\x5A' * 2)
+            merged_data.extend(bin_data)
 
     total_files = len(file_info_list)
 
+    if compressed_files:
+        raw_total = sum(info[1] for info in compressed_files)
+        saved_total = raw_total - sum(info[2] for info in compressed_files)
+        for file_name, raw_size, stored_size, decode_ms in compressed_files:
+            print(f'Compressed {file_name}: {raw_size} -> {stored_size} bytes, estimated first access {decode_ms:.1f} ms')
+        print(f'{"Compressed assets:":<30} {GREEN}{len(compressed_files)} files, saved {saved_total / 1024:.2f}K of flash, '
+              f'{raw_total / 1024:.2f}K of PSRAM when all are used{RESET}')
+
+    # The device binary searches the table in flash, so it is sorted by the zero padded name
+    file_info_list.sort(key=lambda info: info[0].ljust(int(max_name_len), '\0')[:int(max_name_len)].encode('utf-8'))
+
     mmap_table = bytearray()
     for file_name, offset, file_size, width, height in file_info_list:
         if len(file_name) > int(max_name_len):
@@ -456,6 +591,9 @@ def pack_assets(config: PackModelsConfig):
     combined_data_length = len(combined_data).to_bytes(4, byteorder='little')
     header_data = total_files.to_bytes(4, byteorder='little') + combined_checksum.to_bytes(4, byteorder='little')
     final_data = header_data + combined_data_length + combined_data
+    # The hash table starts 4 bytes aligned
+    final_data += b'\x00' * (-len(final_data) % 4)
+    final_data += build_hash_table(combined_data)
 
     with open(out_file, 'wb') as output_bin:
         output_bin.write(final_data)
@@ -557,7 +695,10 @@ def process_assets_build(config_data):
         include_path=include_path,
         image_file=image_file,
         assets_path=assets_path,
-        name_length=name_length
+        name_length=name_length,
+        compress=config_data.get('compress', False),
+        decode_budget_ms=float(config_data.get('decode_budget_ms', 50)),
+        decode_rate=float(config_data.get('decode_rate', 20))
     )
 
     print('--support_format:', support_format)
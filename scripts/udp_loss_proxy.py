@@ -0,0 +1,134 @@
+import asyncio
+import argparse
+import random
+import time
+
+
+'''
+  A UDP proxy that emulates a lossy network between the device and the UDP audio server.
+  Point the "udp.server" / "udp.port" in the server hello to this proxy, and the proxy
+  forwards packets to the real server with random loss, burst loss, delay and jitter.
+
+  Usage: python udp_loss_proxy.py --listen 0.0.0.0:8888 --server 192.168.1.100:8889 --loss 0.05 --burst 3
+'''
+
+
+def parse_address(text):
+    host, port = text.rsplit(':', 1)
+    return host, int(port)
+
+
+class LossModel:
+    def __init__(self, loss, burst, delay_ms, jitter_ms):
+        self.loss = loss
+        self.burst = max(1, burst)
+        self.delay_ms = delay_ms
+        self.jitter_ms = jitter_ms
+        self.burst_left = 0
+
+    def should_drop(self):
+        # Start a burst with probability loss / burst, so the average loss rate stays at `loss`
+        if self.burst_left > 0:
+            self.burst_left -= 1
+            return True
+        if random.random() < self.loss / self.burst:
+            self.burst_left = self.burst - 1
+            return True
+        return False
+
+    def delay(self):
+        return max(0.0, self.delay_ms + random.uniform(-self.jitter_ms, self.jitter_ms)) / 1000
+
+
+class Direction:
+    NAMES = {0x01: 'audio', 0x02: 'nack', 0x03: 'parity'}
+
+    def __init__(self, name, model):
+        self.name = name
+        self.model = model
+        self.counters = {}
+        self.dropped = 0
+
+    def count(self, data):
+        kind = self.NAMES.get(data[0], 'unknown') if data else 'empty'
+        self.counters[kind] = self.counters.get(kind, 0) + 1
+
+    def summary(self):
+        total = sum(self.counters.values())
+        counters = ', '.join(f"{k}: {v}" for k, v in sorted(self.counters.items()))
+        return f"{self.name}: {total} packets ({counters}), dropped {self.dropped}"
+
+
+class ServerSide(asyncio.DatagramProtocol):
+    def __init__(self, proxy):
+        self.proxy = proxy
+
+    def datagram_received(self, data, addr):
+        self.proxy.forward(self.proxy.downlink, data, lambda d: self.proxy.device_transport.sendto(d, self.proxy.device_address))
+
+
+class DeviceSide(asyncio.DatagramProtocol):
+    def __init__(self, proxy):
+        self.proxy = proxy
+
+    def connection_made(self, transport):
+        self.proxy.device_transport = transport
+
+    def datagram_received(self, data, addr):
+        self.proxy.device_address = addr
+        self.proxy.forward(self.proxy.uplink, data, lambda d: self.proxy.server_transport.sendto(d))
+
+
+class Proxy:
+    def __init__(self, args):
+        self.args = args
+        self.uplink = Direction('device -> server', LossModel(args.loss, args.burst, args.delay, args.jitter))
+        self.downlink = Direction('server -> device', LossModel(args.loss, args.burst, args.delay, args.jitter))
+        self.device_transport = None
+        self.device_address = None
+        self.server_transport = None
+
+    def forward(self, direction, data, send):
+        direction.count(data)
+        # Only audio packets are dropped unless --drop-all, so the NACK path itself can be tested separately
+        if (self.args.drop_all or data[:1] == b'\x01') and direction.model.should_drop():
+            direction.dropped += 1
+            return
+        asyncio.get_running_loop().call_later(direction.model.delay(), send, data)
+
+    async def run(self):
+        loop = asyncio.get_running_loop()
+        await loop.create_datagram_endpoint(lambda: DeviceSide(self), local_addr=parse_address(self.args.listen))
+        self.server_transport, _ = await loop.create_datagram_endpoint(
+            lambda: ServerSide(self), remote_addr=parse_address(self.args.server))
+        print(f"Forwarding {self.args.listen} -> {self.args.server}, loss {self.args.loss:.1%}, burst {self.args.burst}, "
+              f"delay {self.args.delay}ms +/- {self.args.jitter}ms")
+        last_report = time.monotonic()
+        while True:
+            await asyncio.sleep(1)
+            if time.monotonic() - last_report >= self.args.report:
+                last_report = time.monotonic()
+                print(self.uplink.summary())
+                print(self.downlink.summary())
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--listen', default='0.0.0.0:8888', help='Address the device sends to')
+    parser.add_argument('--server', required=True, help='Address of the real UDP audio server')
+    parser.add_argument('--loss', type=float, default=0.05, help='Average packet loss rate')
+    parser.add_argument('--burst', type=int, default=1, help='Packets lost in a row per loss event')
+    parser.add_argument('--delay', type=float, default=20, help='One way delay in milliseconds')
+    parser.add_argument('--jitter', type=float, default=10, help='Delay jitter in milliseconds')
+    parser.add_argument('--drop-all', action='store_true', help='Also drop NACK and parity packets')
+    parser.add_argument('--report', type=float, default=10, help='Statistics interval in seconds')
+    args = parser.parse_args()
+
+    try:
+        asyncio.run(Proxy(args).run())
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,217 @@
+#!/usr/bin/env python3
+"""
+Generate the GIF corpus of the host GIF benchmarks
+
+The GIFs cover what the decoder meets in emotion animations: a face whose eyes and mouth
+change in small sub-frames, the same animation stored as full frames, transparency with
+the restore-to-background and restore-to-previous disposals, interlacing, odd sizes and
+256 color noise as the LZW worst case. The output is deterministic.
+
+Usage:
+    ./gif_corpus.py <output_dir>
+"""
+
+import os
+import random
+import struct
+import sys
+
+
+def lzw_encode(pixels, min_code_size):
+    """LZW compress a list of palette indices into GIF sub-blocks"""
+    clear = 1 << min_code_size
+    end = clear + 1
+    output = bytearray()
+    bit_buffer = 0
+    bit_count = 0
+
+    def put(code, size):
+        nonlocal bit_buffer, bit_count
+        bit_buffer |= code << bit_count
+        bit_count += size
+        while bit_count >= 8:
+            output.append(bit_buffer & 0xFF)
+            bit_buffer >>= 8
+            bit_count -= 8
+
+    code_size = min_code_size + 1
+    table = {}
+    next_code = end + 1
+    put(clear, code_size)
+    prefix = pixels[0]
+    for pixel in pixels[1:]:
+        key = (prefix, pixel)
+        if key in table:
+            prefix = table[key]
+            continue
+        put(prefix, code_size)
+        if next_code < 0x1000:
+            if next_code == 1 << code_size:
+                code_size += 1
+            table[key] = next_code
+            next_code += 1
+        else:
+            put(clear, code_size)
+            table = {}
+            next_code = end + 1
+            code_size = min_code_size + 1
+        prefix = pixel
+    put(prefix, code_size)
+    put(end, code_size)
+    if bit_count > 0:
+        output.append(bit_buffer & 0xFF)
+
+    blocks = bytearray()
+    for i in range(0, len(output), 255):
+        chunk = output[i:i + 255]
+        blocks.append(len(chunk))
+        blocks += chunk
+    blocks.append(0)
+    return bytes(blocks)
+
+
+def interlace_rows(rows):
+    """Reorder rows into the four GIF interlace passes"""
+    order = []
+    for start, step in ((0, 8), (4, 8), (2, 4), (1, 2)):
+        order += range(start, len(rows), step)
+    return [rows[i] for i in order]
+
+
+def write_gif(path, width, height, palette, frames, loop=0):
+    """
+    frames is a list of dicts with x, y, w, h, rows (lists of palette indices) and
+    optionally delay (1/100 s), disposal, transparent (palette index) and interlace
+    """
+    color_bits = max(1, (len(palette) - 1).bit_length())
+    palette = palette + [(0, 0, 0)] * ((1 << color_bits) - len(palette))
+    data = bytearray(b"GIF89a")
+    data += struct.pack("<HHBBB", width, height, 0x80 | ((color_bits - 1) << 4) | (color_bits - 1), 0, 0)
+    for r, g, b in palette:
+        data += bytes((r, g, b))
+    data += b"\x21\xFF\x0BNETSCAPE2.0\x03\x01" + struct.pack("<H", loop) + b"\x00"
+
+    for frame in frames:
+        transparent = frame.get("transparent")
+        flags = (frame.get("disposal", 1) << 2) | (1 if transparent is not None else 0)
+        data += b"\x21\xF9\x04" + struct.pack("<BHB", flags, frame.get("delay", 10), transparent or 0) + b"\x00"
+        interlace = frame.get("interlace", False)
+        data += b"\x2C" + struct.pack("<HHHHB", frame["x"], frame["y"], frame["w"], frame["h"], 0x40 if interlace else 0)
+        rows = interlace_rows(frame["rows"]) if interlace else frame["rows"]
+        min_code_size = max(2, color_bits)
+        data += bytes((min_code_size,)) + lzw_encode([p for row in rows for p in row], min_code_size)
+    data += b"\x3B"
+
+    with open(path, "wb") as f:
+        f.write(data)
+
+
+def crop(canvas, x, y, w, h):
+    return [row[x:x + w] for row in canvas[y:y + h]]
+
+
+def face_frames(size, count, full_frames):
+    """A round face that blinks and talks, in 16 colors"""
+    background, skin, outline, eye, mouth, cheek = 0, 1, 2, 3, 4, 5
+    center = size // 2
+    radius = size * 2 // 5
+
+    def draw(step):
+        canvas = [[background] * size for _ in range(size)]
+        for y in range(size):
+            for x in range(size):
+                d = (x - center) ** 2 + (y - center) ** 2
+                if d <= radius * radius:
+                    canvas[y][x] = outline if d >= (radius - 3) ** 2 else skin
+        eye_open = max(1, size // 16 - abs(step % 6 - 3) * size // 64)
+        for eye_x in (center - radius // 2, center + radius // 2):
+            for y in range(center - radius // 3 - eye_open, center - radius // 3 + eye_open + 1):
+                for x in range(eye_x - size // 32, eye_x + size // 32 + 1):
+                    canvas[y][x] = eye
+        for cheek_x in (center - radius * 2 // 3, center + radius * 2 // 3):
+            for y in range(center + radius // 6 - 3, center + radius // 6 + 4):
+                for x in range(cheek_x - 5, cheek_x + 6):
+                    canvas[y][x] = cheek
+        mouth_open = 2 + (step * 5 % 7)
+        for y in range(center + radius // 3, center + radius // 3 + mouth_open):
+            for x in range(center - radius // 3, center + radius // 3 + 1):
+                canvas[y][x] = mouth
+        return canvas
+
+    frames = []
+    previous = None
+    for step in range(count):
+        canvas = draw(step)
+        if full_frames or previous is None:
+            frames.append({"x": 0, "y": 0, "w": size, "h": size, "rows": canvas})
+        else:
+            # Only the bounding box of what changed, as GIF optimizers store emotion animations
+            changed = [(x, y) for y in range(size) for x in range(size) if canvas[y][x] != previous[y][x]]
+            if not changed:
+                changed = [(0, 0)]
+            x1 = min(x for x, _ in changed)
+            y1 = min(y for _, y in changed)
+            x2 = max(x for x, _ in changed)
+            y2 = max(y for _, y in changed)
+            frames.append({"x": x1, "y": y1, "w": x2 - x1 + 1, "h": y2 - y1 + 1,
+                           "rows": crop(canvas, x1, y1, x2 - x1 + 1, y2 - y1 + 1)})
+        previous = canvas
+    return frames
+
+
+FACE_PALETTE = [(255, 255, 255), (255, 214, 102), (120, 72, 0), (40, 40, 40), (200, 40, 60), (255, 150, 150),
+                (0, 0, 255), (0, 255, 0), (255, 0, 255), (0, 255, 255), (128, 128, 128), (64, 64, 64),
+                (192, 192, 192), (255, 128, 0), (128, 0, 255), (0, 128, 128)]
+
+
+def main():
+    if len(sys.argv) != 2:
+        print(__doc__)
+        sys.exit(1)
+    output = sys.argv[1]
+    os.makedirs(output, exist_ok=True)
+    rng = random.Random(20251019)
+
+    write_gif(os.path.join(output, "face_delta.gif"), 160, 160, FACE_PALETTE, face_frames(160, 12, False))
+    write_gif(os.path.join(output, "face_full.gif"), 160, 160, FACE_PALETTE, face_frames(160, 12, True))
+
+    # A dot circling on a transparent background, cleared after every frame
+    frames = []
+    for step in range(8):
+        rows = [[0] * 40 for _ in range(40)]
+        for y in range(40):
+            for x in range(40):
+                if (x - 20) ** 2 + (y - 20) ** 2 <= 16 ** 2:
+                    rows[y][x] = 1 + (step + (x + y) // 8) % 3
+        frames.append({"x": 40 + (step % 4) * 10, "y": 40 + (step // 4) * 20, "w": 40, "h": 40, "rows": rows,
+                       "disposal": 2, "transparent": 0, "delay": 8})
+    write_gif(os.path.join(output, "spinner_transparent.gif"), 120, 120,
+              [(0, 0, 0), (255, 80, 80), (80, 255, 80), (80, 80, 255)], frames)
+
+    # Overlays that restore the previous canvas, with an odd size
+    frames = [{"x": 0, "y": 0, "w": 37, "h": 23, "rows": [[(x * y) % 7 for x in range(37)] for y in range(23)]}]
+    for step in range(5):
+        frames.append({"x": step * 5, "y": step * 3, "w": 11, "h": 7, "disposal": 3, "transparent": 7,
+                       "rows": [[7 if (x + y + step) % 3 == 0 else step % 7 for x in range(11)] for y in range(7)]})
+    write_gif(os.path.join(output, "odd_previous.gif"), 37, 23,
+              [(i * 36, 255 - i * 36, (i * 80) % 256) for i in range(8)], frames)
+
+    # Interlaced gradients
+    frames = []
+    for step in range(6):
+        rows = [[(x // 5 + y // 5 + step) % 32 for x in range(160)] for y in range(120)]
+        frames.append({"x": 0, "y": 0, "w": 160, "h": 120, "rows": rows, "interlace": True})
+    write_gif(os.path.join(output, "gradient_interlaced.gif"), 160, 120,
+              [(i * 8, 255 - i * 8, (i * 40) % 256) for i in range(32)], frames)
+
+    # Noise does not compress, every code is a new table entry and the table is reset often
+    frames = []
+    for step in range(6):
+        rows = [[rng.randrange(256) for _ in range(96)] for _ in range(96)]
+        frames.append({"x": 0, "y": 0, "w": 96, "h": 96, "rows": rows, "interlace": step % 2 == 1})
+    write_gif(os.path.join(output, "noise_256.gif"), 96, 96,
+              [(i, (i * 7) % 256, (i * 13) % 256) for i in range(256)], frames)
+
+
+if __name__ == "__main__":
+    main()
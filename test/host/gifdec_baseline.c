@@ -0,0 +1,37 @@
+/*
+ * An earlier gifdec behind an opaque handle, built against its own gifdec.h since the
+ * gd_GIF layout changes between revisions. The gd_* symbols are renamed by CMake.
+ */
+#include "gifdec.h"
+#include "gifdec_baseline.h"
+
+void * gifdec_baseline_open(const void * data)
+{
+    return gd_open_gif_data(data);
+}
+
+int gifdec_baseline_next_frame(void * handle, uint32_t * frame_pixels)
+{
+    gd_GIF * gif = (gd_GIF *) handle;
+    int result = gd_get_frame(gif);
+    if(result == 1) {
+        gd_render_frame(gif, gif->canvas);
+        *frame_pixels = gif->fw * gif->fh;
+    }
+    return result;
+}
+
+const uint8_t * gifdec_baseline_canvas(void * handle)
+{
+    return ((gd_GIF *) handle)->canvas;
+}
+
+void gifdec_baseline_rewind(void * handle)
+{
+    gd_rewind((gd_GIF *) handle);
+}
+
+void gifdec_baseline_close(void * handle)
+{
+    gd_close_gif((gd_GIF *) handle);
+}
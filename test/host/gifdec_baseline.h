@@ -0,0 +1,21 @@
+#ifndef GIFDEC_BASELINE_H
+#define GIFDEC_BASELINE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void * gifdec_baseline_open(const void * data);
+/* Decode and compose the next frame into the canvas, returns 1 like gd_get_frame() if there was one */
+int gifdec_baseline_next_frame(void * handle, uint32_t * frame_pixels);
+const uint8_t * gifdec_baseline_canvas(void * handle);
+void gifdec_baseline_rewind(void * handle);
+void gifdec_baseline_close(void * handle);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
+
+#endif /* GIFDEC_BASELINE_H */
@@ -0,0 +1,174 @@
+/*
+ * gifdec decode throughput on every .gif in the directory given as the first argument.
+ *
+ * Each frame is decoded with gd_get_frame() and composed into the ARGB8888 canvas with
+ * gd_render_frame(), the same work LvglGif::DecodeNextFrame() does on the LVGL task.
+ * Reported per GIF: frames per second, and megapixels per second of the decoded frame rectangles.
+ *
+ * Built with GIFDEC_BASELINE_DIR, the same is measured for an earlier gifdec, and every
+ * canvas of the first two loops must be the same with both decoders.
+ */
+#include "gifdec.h"
+#ifdef GIFDEC_BASELINE
+#include "gifdec_baseline.h"
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+uint32_t lv_host_tick = 0;
+lv_timer_t* lv_host_timers = nullptr;
+
+struct Decoder {
+    void* (*open)(const void* data);
+    int (*next_frame)(void* handle, uint32_t* frame_pixels);
+    const uint8_t* (*canvas)(void* handle);
+    void (*rewind)(void* handle);
+    void (*close)(void* handle);
+};
+
+static const Decoder kGifdec = {
+    [](const void* data) -> void* { return gd_open_gif_data(data); },
+    [](void* handle, uint32_t* frame_pixels) {
+        auto gif = static_cast<gd_GIF*>(handle);
+        int result = gd_get_frame(gif);
+        if (result == 1) {
+            gd_render_frame(gif, gif->canvas);
+            *frame_pixels = gif->fw * gif->fh;
+        }
+        return result;
+    },
+    [](void* handle) -> const uint8_t* { return static_cast<gd_GIF*>(handle)->canvas; },
+    [](void* handle) { gd_rewind(static_cast<gd_GIF*>(handle)); },
+    [](void* handle) { gd_close_gif(static_cast<gd_GIF*>(handle)); },
+};
+
+#ifdef GIFDEC_BASELINE
+static const Decoder kBaseline = {
+    gifdec_baseline_open,
+    gifdec_baseline_next_frame,
+    gifdec_baseline_canvas,
+    gifdec_baseline_rewind,
+    gifdec_baseline_close,
+};
+
+// The frames of the first two loops, or until a GIF that does not loop forever ends, must be the same
+static bool SameFrames(const std::vector<uint8_t>& data) {
+    void* gif = gd_open_gif_data(data.data());
+    void* baseline = gifdec_baseline_open(data.data());
+    bool same = gif != nullptr && baseline != nullptr;
+    if (same) {
+        size_t size = static_cast<gd_GIF*>(gif)->width * static_cast<gd_GIF*>(gif)->height * 4;
+        int frame = 0;
+        while (static_cast<gd_GIF*>(gif)->loops < 2) {
+            uint32_t pixels;
+            int result = kGifdec.next_frame(gif, &pixels);
+            if (result != kBaseline.next_frame(baseline, &pixels)) {
+                printf("  frame %d: the decoders disagree on the end of the GIF\n", frame);
+                same = false;
+                break;
+            }
+            if (result != 1) {
+                break;
+            }
+            if (memcmp(kGifdec.canvas(gif), kBaseline.canvas(baseline), size) != 0) {
+                printf("  frame %d: the canvas differs\n", frame);
+                same = false;
+                break;
+            }
+            frame++;
+        }
+    }
+    if (gif != nullptr) {
+        gd_close_gif(static_cast<gd_GIF*>(gif));
+    }
+    if (baseline != nullptr) {
+        gifdec_baseline_close(baseline);
+    }
+    return same;
+}
+#endif
+
+struct Result {
+    double frames_per_second;
+    double megapixels_per_second;
+};
+
+// Decode frames for about 200 ms, rewinding at the end of GIFs that do not loop forever
+static Result Measure(const Decoder& decoder, const std::vector<uint8_t>& data) {
+    using Clock = std::chrono::steady_clock;
+    void* gif = decoder.open(data.data());
+    if (gif == nullptr) {
+        return {};
+    }
+    size_t frames = 0;
+    double pixels = 0;
+    auto start = Clock::now();
+    auto elapsed = Clock::duration::zero();
+    do {
+        for (int i = 0; i < 16; i++) {
+            uint32_t frame_pixels;
+            if (decoder.next_frame(gif, &frame_pixels) != 1) {
+                decoder.rewind(gif);
+                continue;
+            }
+            frames++;
+            pixels += frame_pixels;
+        }
+        elapsed = Clock::now() - start;
+    } while (elapsed < std::chrono::milliseconds(200));
+    decoder.close(gif);
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    return { frames / seconds, pixels / seconds / 1e6 };
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        printf("Usage: %s gif_directory\n", argv[0]);
+        return 1;
+    }
+    std::vector<std::filesystem::path> paths;
+    for (auto& entry : std::filesystem::directory_iterator(argv[1])) {
+        if (entry.path().extension() == ".gif") {
+            paths.push_back(entry.path());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+    if (paths.empty()) {
+        printf("No GIFs in %s\n", argv[1]);
+        return 1;
+    }
+
+    bool ok = true;
+    for (auto& path : paths) {
+        std::ifstream file(path, std::ios::binary);
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        auto result = Measure(kGifdec, data);
+        if (result.frames_per_second == 0) {
+            printf("%-28s failed to decode\n", path.filename().c_str());
+            ok = false;
+            continue;
+        }
+        printf("%-28s %8.0f frames/s %7.1f Mpixel/s", path.filename().c_str(),
+            result.frames_per_second, result.megapixels_per_second);
+#ifdef GIFDEC_BASELINE
+        auto baseline = Measure(kBaseline, data);
+        printf(" | baseline %8.0f frames/s %7.1f Mpixel/s | x%.1f\n", baseline.frames_per_second,
+            baseline.megapixels_per_second, result.frames_per_second / baseline.frames_per_second);
+        if (!SameFrames(data)) {
+            printf("%-28s differs from the baseline decoder\n", path.filename().c_str());
+            ok = false;
+        }
+#else
+        printf("\n");
+#endif
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,246 @@
+/*
+ * JsonReader against cJSON on the messages the server sends during a conversation,
+ * one JSON document per line of the file given as the first argument.
+ *
+ * Both sides do what the firmware does with a text frame: parse it, dispatch on "type"
+ * and copy out the strings that Application schedules (chat text, emotion, command),
+ * or hand the MCP payload over as a cJSON tree. The baseline is the code before JsonReader:
+ * cJSON_ParseWithLength on the whole frame and cJSON_GetObjectItem lookups.
+ * The dispatch results must agree. Times and heap allocations are per message, once warm.
+ */
+#include "json_reader.h"
+
+#include <cJSON.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <string>
+#include <vector>
+
+static size_t allocations = 0;
+
+void* operator new(size_t size) {
+    allocations++;
+    if (void* p = malloc(size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+static void* CountingMalloc(size_t size) {
+    allocations++;
+    return malloc(size);
+}
+
+// McpServer::ParseMessage starts from the method and the id
+static std::string DispatchMcp(const cJSON* payload) {
+    auto method = cJSON_GetObjectItem(payload, "method");
+    auto id = cJSON_GetObjectItem(payload, "id");
+    if (!cJSON_IsString(method) || !cJSON_IsNumber(id)) {
+        return "mcp invalid";
+    }
+    return std::string("mcp ") + method->valuestring + " " + std::to_string(id->valueint);
+}
+
+// WebsocketProtocol::OnData + Application's OnIncomingJson before JsonReader
+static std::string BaselineDispatch(const std::string& data) {
+    std::string result;
+    auto root = cJSON_ParseWithLength(data.data(), data.size());
+    auto type = cJSON_GetObjectItem(root, "type");
+    if (!cJSON_IsString(type)) {
+        result = "invalid";
+    } else if (strcmp(type->valuestring, "hello") == 0) {
+        auto transport = cJSON_GetObjectItem(root, "transport");
+        auto session_id = cJSON_GetObjectItem(root, "session_id");
+        auto audio_params = cJSON_GetObjectItem(root, "audio_params");
+        auto sample_rate = cJSON_GetObjectItem(audio_params, "sample_rate");
+        if (cJSON_IsString(transport) && cJSON_IsString(session_id) && cJSON_IsNumber(sample_rate)) {
+            result = std::string("hello ") + transport->valuestring + " " + session_id->valuestring;
+            result += " " + std::to_string(sample_rate->valueint);
+        }
+    } else if (strcmp(type->valuestring, "tts") == 0) {
+        auto state = cJSON_GetObjectItem(root, "state");
+        if (strcmp(state->valuestring, "start") == 0) {
+            result = "tts start";
+        } else if (strcmp(state->valuestring, "stop") == 0) {
+            result = "tts stop";
+        } else if (strcmp(state->valuestring, "sentence_start") == 0) {
+            auto text = cJSON_GetObjectItem(root, "text");
+            if (cJSON_IsString(text)) {
+                result = std::string("assistant ") + text->valuestring;
+            }
+        }
+    } else if (strcmp(type->valuestring, "stt") == 0) {
+        auto text = cJSON_GetObjectItem(root, "text");
+        if (cJSON_IsString(text)) {
+            result = std::string("user ") + text->valuestring;
+        }
+    } else if (strcmp(type->valuestring, "llm") == 0) {
+        auto emotion = cJSON_GetObjectItem(root, "emotion");
+        if (cJSON_IsString(emotion)) {
+            result = std::string("emotion ") + emotion->valuestring;
+        }
+    } else if (strcmp(type->valuestring, "mcp") == 0) {
+        auto payload = cJSON_GetObjectItem(root, "payload");
+        if (cJSON_IsObject(payload)) {
+            result = DispatchMcp(payload);
+        }
+    } else if (strcmp(type->valuestring, "system") == 0) {
+        auto command = cJSON_GetObjectItem(root, "command");
+        if (cJSON_IsString(command)) {
+            result = std::string("system ") + command->valuestring;
+        }
+    } else if (strcmp(type->valuestring, "alert") == 0) {
+        auto status = cJSON_GetObjectItem(root, "status");
+        auto message = cJSON_GetObjectItem(root, "message");
+        auto emotion = cJSON_GetObjectItem(root, "emotion");
+        if (cJSON_IsString(status) && cJSON_IsString(message) && cJSON_IsString(emotion)) {
+            result = std::string("alert ") + status->valuestring + " " + message->valuestring + " " + emotion->valuestring;
+        }
+    }
+    cJSON_Delete(root);
+    return result;
+}
+
+// WebsocketProtocol::OnData + Application's OnIncomingJson
+static std::string ReaderDispatch(JsonReader& reader, const std::string& data) {
+    std::string result;
+    if (!reader.Parse(data)) {
+        return "invalid";
+    }
+    auto root = reader.root();
+    auto type = root["type"];
+    if (!type.IsString()) {
+        result = "invalid";
+    } else if (type.Equals("hello")) {
+        auto transport = root["transport"];
+        auto session_id = root["session_id"];
+        auto sample_rate = root["audio_params"]["sample_rate"];
+        if (transport.IsString() && session_id.IsString() && sample_rate.IsNumber()) {
+            result = "hello " + transport.GetString() + " " + session_id.GetString();
+            result += " " + std::to_string(sample_rate.GetInt());
+        }
+    } else if (type.Equals("tts")) {
+        auto state = root["state"];
+        if (state.Equals("start")) {
+            result = "tts start";
+        } else if (state.Equals("stop")) {
+            result = "tts stop";
+        } else if (state.Equals("sentence_start")) {
+            auto text = root["text"];
+            if (text.IsString()) {
+                result = "assistant " + text.GetString();
+            }
+        }
+    } else if (type.Equals("stt")) {
+        auto text = root["text"];
+        if (text.IsString()) {
+            result = "user " + text.GetString();
+        }
+    } else if (type.Equals("llm")) {
+        auto emotion = root["emotion"];
+        if (emotion.IsString()) {
+            result = "emotion " + emotion.GetString();
+        }
+    } else if (type.Equals("mcp")) {
+        auto payload = root["payload"];
+        if (payload.IsObject()) {
+            cJSON* json = payload.ToCJSON();
+            if (json != nullptr) {
+                result = DispatchMcp(json);
+                cJSON_Delete(json);
+            }
+        }
+    } else if (type.Equals("system")) {
+        auto command = root["command"];
+        if (command.IsString()) {
+            result = "system " + command.GetString();
+        }
+    } else if (type.Equals("alert")) {
+        auto status = root["status"];
+        auto message = root["message"];
+        auto emotion = root["emotion"];
+        if (status.IsString() && message.IsString() && emotion.IsString()) {
+            result = "alert " + status.GetString() + " " + message.GetString() + " " + emotion.GetString();
+        }
+    }
+    return result;
+}
+
+struct Sample {
+    double ns;
+    double allocations;
+};
+
+static volatile size_t sink;
+
+// Runs f over all messages for about 200 ms after one warm-up pass
+template <typename F>
+static Sample Measure(const std::vector<std::string>& messages, F&& f) {
+    using Clock = std::chrono::steady_clock;
+    for (auto& message : messages) {
+        sink += f(message).size();
+    }
+    size_t count = 0;
+    size_t start_allocations = allocations;
+    auto start = Clock::now();
+    auto elapsed = Clock::duration::zero();
+    do {
+        for (auto& message : messages) {
+            sink += f(message).size();
+        }
+        count += messages.size();
+        elapsed = Clock::now() - start;
+    } while (elapsed < std::chrono::milliseconds(200));
+    double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+    return { ns / count, double(allocations - start_allocations) / count };
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        printf("Usage: %s messages.jsonl\n", argv[0]);
+        return 1;
+    }
+    std::vector<std::string> messages;
+    std::ifstream file(argv[1]);
+    std::string line;
+    size_t bytes = 0;
+    while (std::getline(file, line)) {
+        if (!line.empty()) {
+            bytes += line.size();
+            messages.push_back(std::move(line));
+        }
+    }
+    if (messages.empty()) {
+        printf("No messages in %s\n", argv[1]);
+        return 1;
+    }
+
+    cJSON_Hooks hooks = { CountingMalloc, free };
+    cJSON_InitHooks(&hooks);
+
+    JsonReader reader;
+    bool ok = true;
+    for (auto& message : messages) {
+        auto expected = BaselineDispatch(message);
+        auto actual = ReaderDispatch(reader, message);
+        if (expected != actual) {
+            printf("Dispatch differs for %s\n  baseline: %s\n  reader:   %s\n", message.c_str(), expected.c_str(), actual.c_str());
+            ok = false;
+        }
+    }
+
+    auto before = Measure(messages, BaselineDispatch);
+    auto after = Measure(messages, [&reader](const std::string& message) { return ReaderDispatch(reader, message); });
+    double average = double(bytes) / messages.size();
+    printf("%zu messages, %.0f bytes on average\n", messages.size(), average);
+    printf("baseline %6.0f ns %6.1f MB/s %5.1f allocs | reader %6.0f ns %6.1f MB/s %5.1f allocs | x%.1f\n",
+        before.ns, average * 1000 / before.ns, before.allocations,
+        after.ns, average * 1000 / after.ns, after.allocations, before.ns / after.ns);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,343 @@
+/*
+ * JsonWriter against the code it replaced, for the messages on the hot paths:
+ * the listen message, the websocket hello and an MCP tools/list reply.
+ *
+ * The baselines below are the code before JsonWriter: string concatenation in Protocol,
+ * and cJSON build + print (with the properties parsed back) in the MCP server.
+ * Both sides must produce the same text. Times and heap allocations are per message,
+ * once the buffers are warm. cJSON allocations are counted through cJSON_InitHooks.
+ */
+#include "json_writer.h"
+#include "mcp_server.h"
+
+#include <cJSON.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+#define OPUS_FRAME_DURATION_MS 60
+
+static size_t allocations = 0;
+
+void* operator new(size_t size) {
+    allocations++;
+    if (void* p = malloc(size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+static void* CountingMalloc(size_t size) {
+    allocations++;
+    return malloc(size);
+}
+
+static const std::string kSessionId = "a1b2c3d4-e5f6-7890-abcd-ef1234567890";
+
+// Protocol::SendStartListening
+static std::string BaselineListen() {
+    std::string message = "{\"session_id\":\"" + kSessionId + "\"";
+    message += ",\"type\":\"listen\",\"state\":\"start\"";
+    message += ",\"mode\":\"auto\"";
+    message += "}";
+    return message;
+}
+
+static void WriteListen(JsonWriter& writer) {
+    writer.Clear();
+    writer.BeginObject();
+    writer.Member("session_id", kSessionId);
+    writer.Member("type", "listen");
+    writer.Member("state", "start");
+    writer.Member("mode", "auto");
+    writer.EndObject();
+}
+
+// WebsocketProtocol::GetHelloMessage
+static std::string BaselineHello() {
+    cJSON* root = cJSON_CreateObject();
+    cJSON_AddStringToObject(root, "type", "hello");
+    cJSON_AddNumberToObject(root, "version", 1);
+    cJSON* features = cJSON_CreateObject();
+    cJSON_AddBoolToObject(features, "mcp", true);
+    cJSON_AddItemToObject(root, "features", features);
+    cJSON_AddStringToObject(root, "transport", "websocket");
+    cJSON* audio_params = cJSON_CreateObject();
+    cJSON_AddStringToObject(audio_params, "format", "opus");
+    cJSON_AddNumberToObject(audio_params, "sample_rate", 16000);
+    cJSON_AddNumberToObject(audio_params, "channels", 1);
+    cJSON_AddNumberToObject(audio_params, "frame_duration", OPUS_FRAME_DURATION_MS);
+    cJSON_AddItemToObject(root, "audio_params", audio_params);
+    auto json_str = cJSON_PrintUnformatted(root);
+    std::string message(json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(root);
+    return message;
+}
+
+static void WriteHello(JsonWriter& writer) {
+    writer.Clear();
+    writer.BeginObject();
+    writer.Member("type", "hello");
+    writer.Member("version", 1);
+    writer.Key("features").BeginObject();
+    writer.Member("mcp", true);
+    writer.EndObject();
+    writer.Member("transport", "websocket");
+    writer.Key("audio_params").BeginObject();
+    writer.Member("format", "opus");
+    writer.Member("sample_rate", 16000);
+    writer.Member("channels", 1);
+    writer.Member("frame_duration", OPUS_FRAME_DURATION_MS);
+    writer.EndObject();
+    writer.EndObject();
+}
+
+// Property::to_json, PropertyList::to_json and McpTool::to_json
+static std::string BaselinePropertyJson(const Property& property) {
+    cJSON* json = cJSON_CreateObject();
+    if (property.type() == kPropertyTypeBoolean) {
+        cJSON_AddStringToObject(json, "type", "boolean");
+        if (property.has_default_value()) {
+            cJSON_AddBoolToObject(json, "default", property.value<bool>());
+        }
+    } else if (property.type() == kPropertyTypeInteger) {
+        cJSON_AddStringToObject(json, "type", "integer");
+        if (property.has_default_value()) {
+            cJSON_AddNumberToObject(json, "default", property.value<int>());
+        }
+        if (property.has_range()) {
+            cJSON_AddNumberToObject(json, "minimum", property.min_value());
+            cJSON_AddNumberToObject(json, "maximum", property.max_value());
+        }
+    } else if (property.type() == kPropertyTypeString) {
+        cJSON_AddStringToObject(json, "type", "string");
+        if (property.has_default_value()) {
+            cJSON_AddStringToObject(json, "default", property.value<std::string>().c_str());
+        }
+    }
+    char* json_str = cJSON_PrintUnformatted(json);
+    std::string result(json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(json);
+    return result;
+}
+
+static std::string BaselinePropertyListJson(const PropertyList& properties) {
+    cJSON* json = cJSON_CreateObject();
+    // PropertyList only has non-const begin() and end()
+    for (const auto& property : const_cast<PropertyList&>(properties)) {
+        cJSON* prop_json = cJSON_Parse(BaselinePropertyJson(property).c_str());
+        cJSON_AddItemToObject(json, property.name().c_str(), prop_json);
+    }
+    char* json_str = cJSON_PrintUnformatted(json);
+    std::string result(json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(json);
+    return result;
+}
+
+static std::string BaselineToolJson(const McpTool& tool) {
+    std::vector<std::string> required = tool.properties().GetRequired();
+
+    cJSON* json = cJSON_CreateObject();
+    cJSON_AddStringToObject(json, "name", tool.name().c_str());
+    cJSON_AddStringToObject(json, "description", tool.description().c_str());
+
+    cJSON* input_schema = cJSON_CreateObject();
+    cJSON_AddStringToObject(input_schema, "type", "object");
+
+    cJSON* properties = cJSON_Parse(BaselinePropertyListJson(tool.properties()).c_str());
+    cJSON_AddItemToObject(input_schema, "properties", properties);
+
+    if (!required.empty()) {
+        cJSON* required_array = cJSON_CreateArray();
+        for (const auto& property : required) {
+            cJSON_AddItemToArray(required_array, cJSON_CreateString(property.c_str()));
+        }
+        cJSON_AddItemToObject(input_schema, "required", required_array);
+    }
+
+    cJSON_AddItemToObject(json, "inputSchema", input_schema);
+
+    if (tool.user_only()) {
+        cJSON* annotations = cJSON_CreateObject();
+        cJSON* audience = cJSON_CreateArray();
+        cJSON_AddItemToArray(audience, cJSON_CreateString("user"));
+        cJSON_AddItemToObject(annotations, "audience", audience);
+        cJSON_AddItemToObject(json, "annotations", annotations);
+    }
+
+    char* json_str = cJSON_PrintUnformatted(json);
+    std::string result(json_str);
+    cJSON_free(json_str);
+    cJSON_Delete(json);
+    return result;
+}
+
+// McpServer::GetToolsList + ReplyResult + Protocol::SendMcpMessage
+static std::string BaselineToolsList(const std::vector<McpTool*>& tools) {
+    std::string json = "{\"tools\":[";
+    for (auto tool : tools) {
+        json += BaselineToolJson(*tool) + ",";
+    }
+    json.pop_back();
+    json += "]}";
+
+    std::string payload = "{\"jsonrpc\":\"2.0\",\"id\":";
+    payload += std::to_string(2) + ",\"result\":";
+    payload += json;
+    payload += "}";
+
+    return "{\"session_id\":\"" + kSessionId + "\",\"type\":\"mcp\",\"payload\":" + payload + "}";
+}
+
+static void WriteToolsList(const std::vector<McpTool*>& tools, JsonWriter& json, JsonWriter& tool_json,
+                           JsonWriter& reply, JsonWriter& message) {
+    json.Clear();
+    json.BeginObject();
+    json.Key("tools").BeginArray();
+    for (auto tool : tools) {
+        tool_json.Clear();
+        tool->to_json(tool_json);
+        json.Raw(tool_json.str());
+    }
+    json.EndArray();
+    json.EndObject();
+
+    reply.Clear();
+    reply.BeginObject();
+    reply.Member("jsonrpc", "2.0");
+    reply.Member("id", 2);
+    reply.Key("result").Raw(json.str());
+    reply.EndObject();
+
+    message.Clear();
+    message.BeginObject();
+    message.Member("session_id", kSessionId);
+    message.Member("type", "mcp");
+    message.Key("payload").Raw(reply.str());
+    message.EndObject();
+}
+
+// The tools McpServer::AddCommonTools and AddUserOnlyTools register on a board with a screen and a camera
+static std::vector<McpTool*> CreateTools() {
+    auto callback = [](const PropertyList&) -> ReturnValue { return true; };
+    std::vector<McpTool*> tools;
+    tools.push_back(new McpTool("self.get_device_status",
+        "Provides the real-time information of the device, including the current status of the audio speaker, screen, battery, network, etc.\n"
+        "Use this tool for: \n"
+        "1. Answering questions about current condition (e.g. what is the current volume of the audio speaker?)\n"
+        "2. As the first step to control the device (e.g. turn up / down the volume of the audio speaker, etc.)",
+        PropertyList(), callback));
+    tools.push_back(new McpTool("self.audio_speaker.set_volume",
+        "Set the volume of the audio speaker. If the current volume is unknown, you must call `self.get_device_status` tool first and then call this tool.",
+        PropertyList({ Property("volume", kPropertyTypeInteger, 0, 100) }), callback));
+    tools.push_back(new McpTool("self.screen.set_brightness",
+        "Set the brightness of the screen.",
+        PropertyList({ Property("brightness", kPropertyTypeInteger, 0, 100) }), callback));
+    tools.push_back(new McpTool("self.screen.set_theme",
+        "Set the theme of the screen. The theme can be `light` or `dark`.",
+        PropertyList({ Property("theme", kPropertyTypeString) }), callback));
+    tools.push_back(new McpTool("self.camera.take_photo",
+        "Take a photo and explain it. Use this tool after the user asks you to see something.\n"
+        "Args:\n"
+        "  `question`: The question that you want to ask about the photo.\n"
+        "Return:\n"
+        "  A JSON object that provides the photo information.",
+        PropertyList({ Property("question", kPropertyTypeString) }), callback));
+    const char* user_tools[][2] = {
+        { "self.get_system_info", "Get the system information" },
+        { "self.get_settings", "Get the device settings, such as volume, brightness, theme and server addresses. Secrets are not included." },
+        { "self.reboot", "Reboot the system" },
+    };
+    for (auto& user_tool : user_tools) {
+        auto tool = new McpTool(user_tool[0], user_tool[1], PropertyList(), callback);
+        tool->set_user_only(true);
+        tools.push_back(tool);
+    }
+    auto upgrade = new McpTool("self.upgrade_firmware",
+        "Upgrade firmware from a specific URL. This will download and install the firmware, then reboot the device.",
+        PropertyList({ Property("url", kPropertyTypeString, "The URL of the firmware binary file to download and install") }),
+        callback);
+    upgrade->set_user_only(true);
+    tools.push_back(upgrade);
+    auto snapshot = new McpTool("self.screen.snapshot", "Snapshot the screen and upload it to a specific URL",
+        PropertyList({ Property("url", kPropertyTypeString), Property("quality", kPropertyTypeInteger, 80, 1, 100) }),
+        callback);
+    snapshot->set_user_only(true);
+    tools.push_back(snapshot);
+    return tools;
+}
+
+struct Sample {
+    double ns;
+    double allocations;
+};
+
+static volatile size_t sink;
+
+// Runs f for about 200 ms after one warm-up call
+template <typename F>
+static Sample Measure(F&& f) {
+    using Clock = std::chrono::steady_clock;
+    f();
+    size_t count = 0;
+    size_t start_allocations = allocations;
+    auto start = Clock::now();
+    auto elapsed = Clock::duration::zero();
+    do {
+        for (int i = 0; i < 100; i++) {
+            f();
+        }
+        count += 100;
+        elapsed = Clock::now() - start;
+    } while (elapsed < std::chrono::milliseconds(200));
+    double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+    return { ns / count, double(allocations - start_allocations) / count };
+}
+
+static bool Compare(const char* name, const std::string& baseline, const std::string& writer,
+                    const Sample& before, const Sample& after) {
+    if (baseline != writer) {
+        printf("%s: output differs\n  baseline: %s\n  writer:   %s\n", name, baseline.c_str(), writer.c_str());
+        return false;
+    }
+    double bytes = writer.size();
+    printf("%-12s %5zu bytes | baseline %8.0f ns %6.1f MB/s %5.1f allocs | writer %8.0f ns %6.1f MB/s %5.1f allocs | x%.1f\n",
+        name, writer.size(), before.ns, bytes * 1000 / before.ns, before.allocations,
+        after.ns, bytes * 1000 / after.ns, after.allocations, before.ns / after.ns);
+    return true;
+}
+
+int main() {
+    cJSON_Hooks hooks = { CountingMalloc, free };
+    cJSON_InitHooks(&hooks);
+
+    bool ok = true;
+    JsonWriter writer;
+
+    auto before = Measure([]() { sink += BaselineListen().size(); });
+    auto after = Measure([&writer]() { WriteListen(writer); sink += writer.size(); });
+    ok &= Compare("listen", BaselineListen(), writer.str(), before, after);
+
+    before = Measure([]() { sink += BaselineHello().size(); });
+    after = Measure([&writer]() { WriteHello(writer); sink += writer.size(); });
+    ok &= Compare("hello", BaselineHello(), writer.str(), before, after);
+
+    auto tools = CreateTools();
+    JsonWriter json(8000), tool_json(1024), reply(8000), message(8000);
+    before = Measure([&tools]() { sink += BaselineToolsList(tools).size(); });
+    after = Measure([&]() { WriteToolsList(tools, json, tool_json, reply, message); sink += message.size(); });
+    ok &= Compare("tools/list", BaselineToolsList(tools), message.str(), before, after);
+    for (auto tool : tools) {
+        delete tool;
+    }
+
+    return ok ? 0 : 1;
+}
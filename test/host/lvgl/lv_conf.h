@@ -0,0 +1,22 @@
+#ifndef LV_CONF_H
+#define LV_CONF_H
+
+/*
+ * LVGL configuration of the host benchmarks. Everything not set here keeps the LVGL default.
+ * The builtin allocator is used, unlike on the device, so lv_mem_monitor() reports the heap
+ * high-water mark and fragmentation of what the benchmark allocates through LVGL.
+ */
+#define LV_COLOR_DEPTH 16
+
+#define LV_USE_STDLIB_MALLOC LV_STDLIB_BUILTIN
+#define LV_USE_STDLIB_STRING LV_STDLIB_CLIB
+#define LV_USE_STDLIB_SPRINTF LV_STDLIB_CLIB
+#define LV_MEM_SIZE (1024 * 1024)
+
+#define LV_USE_OS LV_OS_NONE
+#define LV_DEF_REFR_PERIOD 33
+#define LV_USE_LOG 0
+
+#define LV_FONT_MONTSERRAT_14 1
+
+#endif // LV_CONF_H
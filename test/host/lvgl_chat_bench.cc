@@ -0,0 +1,107 @@
+/*
+ * The WeChat style chat list of LcdDisplay on a headless LVGL display: 1000 messages are
+ * streamed the way a conversation sends them, once with the previous SetChatMessage (a new
+ * container, bubble and label with local styles per message, the oldest deleted past the limit)
+ * and once with the recycled rows and the shared LvglThemeStyles used now.
+ *
+ * The two SetChatMessage versions are in lvgl_chat_list.h. After every message the LVGL
+ * timers run once with the tick advanced by one refresh period, so every message is rendered.
+ * Reported: time in SetChatMessage and in rendering, and the LVGL heap high-water mark and
+ * fragmentation, each run starting from a fresh lv_init(). Both runs must end with the same latest
+ * messages; the previous code could show fewer, as it deleted the oldest message even when the
+ * new one only collapsed a system message.
+ */
+#include "lvgl_chat_list.h"
+
+#include <chrono>
+#include <cstdio>
+
+#define HOR_RES 320
+#define VER_RES 240
+#define MESSAGE_COUNT 1000
+
+static uint32_t tick = 0;
+
+static void Flush(lv_display_t* display, const lv_area_t* area, uint8_t* pixels) {
+    lv_display_flush_ready(display);
+}
+
+struct Result {
+    double update_us = 0;
+    double render_us = 0;
+    size_t max_used = 0;
+    size_t used = 0;
+    int frag_pct = 0;
+    std::vector<std::string> texts;
+};
+
+template <typename List>
+static Result Run(const std::vector<std::pair<const char*, std::string>>& messages) {
+    using Clock = std::chrono::steady_clock;
+    lv_init();
+    lv_tick_set_cb([]() { return tick; });
+    lv_display_t* display = lv_display_create(HOR_RES, VER_RES);
+    static uint8_t buffer[HOR_RES * VER_RES / 10 * 2];
+    lv_display_set_buffers(display, buffer, nullptr, sizeof(buffer), LV_DISPLAY_RENDER_MODE_PARTIAL);
+    lv_display_set_flush_cb(display, Flush);
+
+    Result result;
+    {
+        LvglTheme theme("light");
+        theme.set_background_color(lv_color_white());
+        theme.set_text_color(lv_color_black());
+        theme.set_chat_background_color(lv_color_hex(0xE0E0E0));
+        theme.set_user_bubble_color(lv_color_hex(0x00FF00));
+        theme.set_assistant_bubble_color(lv_color_hex(0xDDDDDD));
+        theme.set_system_bubble_color(lv_color_hex(0xFFFFFF));
+        theme.set_system_text_color(lv_color_hex(0x666666));
+        theme.set_border_color(lv_color_hex(0x000000));
+        theme.set_low_battery_color(lv_color_black());
+        auto font = std::make_shared<LvglBuiltInFont>(&lv_font_montserrat_14);
+        theme.set_text_font(font);
+        theme.set_icon_font(font);
+        theme.set_large_icon_font(font);
+
+        List list(&theme);
+        Clock::duration update{}, render{};
+        for (auto& [role, text] : messages) {
+            auto start = Clock::now();
+            list.SetChatMessage(role, text.c_str());
+            auto updated = Clock::now();
+            tick += LV_DEF_REFR_PERIOD;
+            lv_timer_handler();
+            update += updated - start;
+            render += Clock::now() - updated;
+        }
+        result.update_us = std::chrono::duration<double, std::micro>(update).count() / messages.size();
+        result.render_us = std::chrono::duration<double, std::micro>(render).count() / messages.size();
+        result.texts = list.GetTexts();
+
+        lv_mem_monitor_t monitor;
+        lv_mem_monitor(&monitor);
+        result.max_used = monitor.max_used;
+        result.used = monitor.total_size - monitor.free_size;
+        result.frag_pct = monitor.frag_pct;
+    }
+    lv_deinit();
+    return result;
+}
+
+int main() {
+    auto messages = CreateMessages(MESSAGE_COUNT);
+    auto before = Run<BaselineChatList>(messages);
+    auto after = Run<RecycledChatList>(messages);
+
+    printf("%d messages, at most %d shown\n", MESSAGE_COUNT, MAX_CHAT_MESSAGES);
+    printf("%-10s %12s %12s %14s %12s %8s\n", "", "update us", "render us", "heap max KB", "heap KB", "frag %");
+    for (auto& [name, result] : { std::make_pair("create", &before), std::make_pair("recycle", &after) }) {
+        printf("%-10s %12.1f %12.1f %14.1f %12.1f %8d\n", name, result->update_us, result->render_us,
+            result->max_used / 1024.0, result->used / 1024.0, result->frag_pct);
+    }
+    if (before.texts.empty() || before.texts.size() > after.texts.size() ||
+        !std::equal(before.texts.begin(), before.texts.end(), after.texts.end() - before.texts.size())) {
+        printf("The messages shown differ\n");
+        return 1;
+    }
+    return 0;
+}
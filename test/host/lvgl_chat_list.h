@@ -0,0 +1,333 @@
+/*
+ * The WeChat style chat list of LcdDisplay for the host LVGL benchmarks, without the display
+ * lock and the emoji label, since LcdDisplay itself needs the panel drivers: once as it was before
+ * the rows were recycled and the styles shared, and once as it is now.
+ */
+#pragma once
+
+#include "lvgl_theme.h"
+
+#include <lvgl.h>
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#define MAX_CHAT_MESSAGES 20
+#define CHAT_ROW_FLAG LV_OBJ_FLAG_USER_1
+
+enum ChatRole {
+    kChatRoleUser,
+    kChatRoleAssistant,
+    kChatRoleSystem,
+    kChatRoleCount,
+};
+
+static const char* const kChatRoles[] = { "user", "assistant", "system" };
+
+static int GetChatRole(const char* role) {
+    for (int i = 0; i < kChatRoleCount; i++) {
+        if (strcmp(role, kChatRoles[i]) == 0) {
+            return i;
+        }
+    }
+    return kChatRoleAssistant;
+}
+
+class ChatList {
+public:
+    virtual ~ChatList() = default;
+    virtual void SetChatMessage(const char* role, const char* content) = 0;
+
+    inline lv_obj_t* content() const { return content_; }
+
+    // Texts of the visible messages, oldest first
+    std::vector<std::string> GetTexts() {
+        std::vector<std::string> texts;
+        CollectTexts(content_, texts);
+        return texts;
+    }
+
+protected:
+    lv_obj_t* content_ = nullptr;
+    LvglTheme* theme_ = nullptr;
+
+    void CollectTexts(lv_obj_t* obj, std::vector<std::string>& texts) {
+        if (lv_obj_has_flag(obj, LV_OBJ_FLAG_HIDDEN)) {
+            return;
+        }
+        if (lv_obj_check_type(obj, &lv_label_class)) {
+            texts.push_back(lv_label_get_text(obj));
+            return;
+        }
+        for (uint32_t i = 0; i < lv_obj_get_child_cnt(obj); i++) {
+            CollectTexts(lv_obj_get_child(obj, i), texts);
+        }
+    }
+};
+
+// LcdDisplay::SetupUI and SetChatMessage before the rows were recycled
+class BaselineChatList : public ChatList {
+public:
+    BaselineChatList(LvglTheme* theme) {
+        theme_ = theme;
+        content_ = lv_obj_create(lv_screen_active());
+        lv_obj_set_width(content_, LV_HOR_RES);
+        lv_obj_set_height(content_, LV_VER_RES);
+        lv_obj_set_style_radius(content_, 0, 0);
+        lv_obj_set_style_pad_all(content_, theme->spacing(4), 0);
+        lv_obj_set_style_border_width(content_, 0, 0);
+        lv_obj_set_style_bg_color(content_, theme->chat_background_color(), 0);
+        lv_obj_set_scrollbar_mode(content_, LV_SCROLLBAR_MODE_OFF);
+        lv_obj_set_scroll_dir(content_, LV_DIR_VER);
+        lv_obj_set_flex_flow(content_, LV_FLEX_FLOW_COLUMN);
+        lv_obj_set_flex_align(content_, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_START);
+        lv_obj_set_style_pad_row(content_, theme->spacing(4), 0);
+    }
+
+    void SetChatMessage(const char* role, const char* content) override {
+        uint32_t child_count = lv_obj_get_child_cnt(content_);
+        if (child_count >= MAX_CHAT_MESSAGES) {
+            lv_obj_t* first_child = lv_obj_get_child(content_, 0);
+            lv_obj_t* last_child = lv_obj_get_child(content_, child_count - 1);
+            if (first_child != nullptr) {
+                lv_obj_del(first_child);
+            }
+            if (last_child != nullptr) {
+                lv_obj_scroll_to_view_recursive(last_child, LV_ANIM_OFF);
+            }
+        }
+
+        if (strcmp(role, "system") == 0) {
+            if (child_count > 0) {
+                lv_obj_t* last_container = lv_obj_get_child(content_, child_count - 1);
+                if (last_container != nullptr && lv_obj_get_child_cnt(last_container) > 0) {
+                    lv_obj_t* last_bubble = lv_obj_get_child(last_container, 0);
+                    if (last_bubble != nullptr) {
+                        void* bubble_type_ptr = lv_obj_get_user_data(last_bubble);
+                        if (bubble_type_ptr != nullptr && strcmp((const char*)bubble_type_ptr, "system") == 0) {
+                            lv_obj_del(last_container);
+                        }
+                    }
+                }
+            }
+        }
+
+        if (strlen(content) == 0) {
+            return;
+        }
+
+        auto text_font = theme_->text_font()->font();
+
+        lv_obj_t* msg_bubble = lv_obj_create(content_);
+        lv_obj_set_style_radius(msg_bubble, 8, 0);
+        lv_obj_set_scrollbar_mode(msg_bubble, LV_SCROLLBAR_MODE_OFF);
+        lv_obj_set_style_border_width(msg_bubble, 0, 0);
+        lv_obj_set_style_pad_all(msg_bubble, theme_->spacing(4), 0);
+
+        lv_obj_t* msg_text = lv_label_create(msg_bubble);
+        lv_label_set_text(msg_text, content);
+
+        lv_coord_t text_width = lv_txt_get_width(content, strlen(content), text_font, 0);
+        lv_coord_t max_width = LV_HOR_RES * 85 / 100 - 16;
+        lv_coord_t min_width = 20;
+        lv_coord_t bubble_width;
+        if (text_width < min_width) {
+            text_width = min_width;
+        }
+        if (text_width < max_width) {
+            bubble_width = text_width;
+        } else {
+            bubble_width = max_width;
+        }
+
+        lv_obj_set_width(msg_text, bubble_width);
+        lv_label_set_long_mode(msg_text, LV_LABEL_LONG_WRAP);
+        lv_obj_set_width(msg_bubble, bubble_width);
+        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
+
+        lv_color_t bubble_color = theme_->assistant_bubble_color();
+        lv_color_t text_color = theme_->text_color();
+        const char* bubble_type = "assistant";
+        if (strcmp(role, "user") == 0) {
+            bubble_color = theme_->user_bubble_color();
+            bubble_type = "user";
+        } else if (strcmp(role, "system") == 0) {
+            bubble_color = theme_->system_bubble_color();
+            text_color = theme_->system_text_color();
+            bubble_type = "system";
+        }
+        lv_obj_set_style_bg_color(msg_bubble, bubble_color, 0);
+        lv_obj_set_style_bg_opa(msg_bubble, LV_OPA_70, 0);
+        lv_obj_set_style_text_color(msg_text, text_color, 0);
+        lv_obj_set_user_data(msg_bubble, (void*)bubble_type);
+        lv_obj_set_width(msg_bubble, LV_SIZE_CONTENT);
+        lv_obj_set_height(msg_bubble, LV_SIZE_CONTENT);
+        lv_obj_set_style_flex_grow(msg_bubble, 0, 0);
+
+        if (strcmp(role, "user") == 0 || strcmp(role, "system") == 0) {
+            lv_obj_t* container = lv_obj_create(content_);
+            lv_obj_set_width(container, LV_HOR_RES);
+            lv_obj_set_height(container, LV_SIZE_CONTENT);
+            lv_obj_set_style_bg_opa(container, LV_OPA_TRANSP, 0);
+            lv_obj_set_style_border_width(container, 0, 0);
+            lv_obj_set_style_pad_all(container, 0, 0);
+            lv_obj_set_parent(msg_bubble, container);
+            if (strcmp(role, "user") == 0) {
+                lv_obj_align(msg_bubble, LV_ALIGN_RIGHT_MID, -25, 0);
+            } else {
+                lv_obj_align(msg_bubble, LV_ALIGN_CENTER, 0, 0);
+            }
+            lv_obj_scroll_to_view_recursive(container, LV_ANIM_ON);
+        } else {
+            lv_obj_align(msg_bubble, LV_ALIGN_LEFT_MID, 0, 0);
+            lv_obj_scroll_to_view_recursive(msg_bubble, LV_ANIM_ON);
+        }
+    }
+};
+
+// LcdDisplay::SetupUI and SetChatMessage with recycled rows and shared styles
+class RecycledChatList : public ChatList {
+public:
+    RecycledChatList(LvglTheme* theme) {
+        theme_ = theme;
+        styles_.Apply(theme);
+        content_ = lv_obj_create(lv_screen_active());
+        lv_obj_set_width(content_, LV_HOR_RES);
+        lv_obj_set_height(content_, LV_VER_RES);
+        styles_.Attach(content_, {kLvglStylePlain, kLvglStyleChatBackground});
+        lv_obj_set_style_pad_all(content_, theme->spacing(4), 0);
+        lv_obj_set_scrollbar_mode(content_, LV_SCROLLBAR_MODE_OFF);
+        lv_obj_set_scroll_dir(content_, LV_DIR_VER);
+        lv_obj_set_flex_flow(content_, LV_FLEX_FLOW_COLUMN);
+        lv_obj_set_flex_align(content_, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_START, LV_FLEX_ALIGN_START);
+        lv_obj_set_style_pad_row(content_, theme->spacing(4), 0);
+    }
+
+    ~RecycledChatList() {
+        // The objects use the styles, so they go first
+        lv_obj_delete(content_);
+    }
+
+    void SetChatMessage(const char* role, const char* content) override {
+        int chat_role = GetChatRole(role);
+        lv_obj_t* row = nullptr;
+        uint32_t child_count = lv_obj_get_child_cnt(content_);
+        lv_obj_t* last = child_count > 0 ? lv_obj_get_child(content_, child_count - 1) : nullptr;
+        if (chat_role == kChatRoleSystem && last != nullptr && lv_obj_has_flag(last, CHAT_ROW_FLAG) &&
+            !lv_obj_has_flag(last, LV_OBJ_FLAG_HIDDEN) && (int)(intptr_t)lv_obj_get_user_data(last) == kChatRoleSystem) {
+            row = last;
+            if (content[0] == '\0') {
+                ReleaseChatRow(row);
+                return;
+            }
+        }
+
+        if (content[0] == '\0') {
+            return;
+        }
+        if (row == nullptr) {
+            row = AcquireChatRow();
+        }
+        SetChatRowRole(row, chat_role);
+
+        lv_coord_t text_width = theme_->text_font()->GetTextWidth(content);
+        lv_coord_t max_width = LV_HOR_RES * 85 / 100 - 16;
+        text_width = std::clamp<lv_coord_t>(text_width, 20, max_width);
+
+        lv_obj_t* label = lv_obj_get_child(lv_obj_get_child(row, 0), 0);
+        lv_label_set_text(label, content);
+        lv_obj_set_width(label, text_width);
+
+        lv_obj_scroll_to_view_recursive(row, LV_ANIM_ON);
+    }
+
+protected:
+    LvglThemeStyles styles_;
+
+    lv_obj_t* CreateChatRow() {
+        lv_obj_t* row = lv_obj_create(content_);
+        lv_obj_remove_style_all(row);
+        lv_obj_add_style(row, styles_.get(kLvglStyleChatRow), 0);
+        lv_obj_remove_flag(row, LV_OBJ_FLAG_SCROLLABLE);
+        lv_obj_add_flag(row, CHAT_ROW_FLAG);
+
+        lv_obj_t* bubble = lv_obj_create(row);
+        lv_obj_remove_style_all(bubble);
+        lv_obj_add_style(bubble, styles_.get(kLvglStyleChatBubble), 0);
+        lv_obj_remove_flag(bubble, LV_OBJ_FLAG_SCROLLABLE);
+
+        lv_obj_t* label = lv_label_create(bubble);
+        lv_label_set_long_mode(label, LV_LABEL_LONG_WRAP);
+
+        lv_obj_set_user_data(row, (void*)(intptr_t)-1);
+        return row;
+    }
+
+    lv_obj_t* AcquireChatRow() {
+        uint32_t child_count = lv_obj_get_child_cnt(content_);
+        lv_obj_t* first = child_count > 0 ? lv_obj_get_child(content_, 0) : nullptr;
+        if (first != nullptr && (child_count >= MAX_CHAT_MESSAGES || lv_obj_has_flag(first, LV_OBJ_FLAG_HIDDEN))) {
+            if (lv_obj_has_flag(first, CHAT_ROW_FLAG)) {
+                lv_obj_move_to_index(first, -1);
+                lv_obj_remove_flag(first, LV_OBJ_FLAG_HIDDEN);
+                return first;
+            }
+            lv_obj_delete(first);
+        }
+        return CreateChatRow();
+    }
+
+    void ReleaseChatRow(lv_obj_t* row) {
+        lv_obj_add_flag(row, LV_OBJ_FLAG_HIDDEN);
+        lv_obj_move_to_index(row, 0);
+        lv_label_set_text_static(lv_obj_get_child(lv_obj_get_child(row, 0), 0), "");
+    }
+
+    void SetChatRowRole(lv_obj_t* row, int role) {
+        int old_role = (int)(intptr_t)lv_obj_get_user_data(row);
+        if (old_role == role) {
+            return;
+        }
+        lv_obj_t* bubble = lv_obj_get_child(row, 0);
+        lv_obj_t* label = lv_obj_get_child(bubble, 0);
+        if (old_role >= 0) {
+            lv_obj_remove_style(row, styles_.get(LvglStyleRole(kLvglStyleUserRow + old_role)), 0);
+            lv_obj_remove_style(bubble, styles_.get(LvglStyleRole(kLvglStyleUserBubble + old_role)), 0);
+            lv_obj_remove_style(label, styles_.get(LvglStyleRole(kLvglStyleUserText + old_role)), 0);
+        }
+        lv_obj_add_style(row, styles_.get(LvglStyleRole(kLvglStyleUserRow + role)), 0);
+        lv_obj_add_style(bubble, styles_.get(LvglStyleRole(kLvglStyleUserBubble + role)), 0);
+        lv_obj_add_style(label, styles_.get(LvglStyleRole(kLvglStyleUserText + role)), 0);
+        lv_obj_set_user_data(row, (void*)(intptr_t)role);
+    }
+};
+
+// One turn: the listening status, the user's words, then the assistant's sentences as TTS streams them
+static std::vector<std::pair<const char*, std::string>> CreateMessages(size_t count) {
+    static const char* const kWords[] = { "the", "weather", "is", "sunny", "today", "with", "a", "light",
+        "breeze", "and", "temperatures", "around", "twenty", "degrees", "so", "enjoy", "your", "walk" };
+    std::vector<std::pair<const char*, std::string>> messages;
+    uint32_t seed = 1;
+    auto sentence = [&]() {
+        seed = seed * 1103515245 + 12345;
+        int words = 2 + (seed >> 16) % 16;
+        std::string text;
+        for (int i = 0; i < words; i++) {
+            seed = seed * 1103515245 + 12345;
+            text += (i > 0 ? " " : "") + std::string(kWords[(seed >> 16) % 18]);
+        }
+        return text + ".";
+    };
+    while (messages.size() < count) {
+        messages.emplace_back("system", "Listening...");
+        messages.emplace_back("system", "");
+        messages.emplace_back("user", sentence());
+        for (int i = 0; i < 3; i++) {
+            messages.emplace_back("assistant", sentence());
+        }
+    }
+    messages.resize(count);
+    return messages;
+}
@@ -0,0 +1,126 @@
+/*
+ * LvglGif playback with and without the decoded frame cache, on every .gif in the
+ * directory given as the first argument.
+ *
+ * The LVGL timer is driven in 10 ms ticks and every presented frame is counted, so
+ * frames/s is how many frames the LVGL task could compose per second of CPU time.
+ * Flush bytes are what the display sends over SPI in RGB565: the whole canvas when the
+ * image is invalidated, as before, or only the dirty area reported by GetDirtyArea().
+ * The canvas of every presented frame must be the same with and without the cache.
+ */
+#include "gif/lvgl_gif.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+uint32_t lv_host_tick = 0;
+lv_timer_t* lv_host_timers = nullptr;
+
+static constexpr size_t kFrames = 600;
+static constexpr size_t kCacheBudget = 8 * 1024 * 1024;
+
+struct Playback {
+    double frames_per_second = 0;
+    size_t frames = 0;
+    size_t dirty_bytes = 0;
+    std::vector<uint64_t> hashes;
+};
+
+static uint64_t Hash(const uint8_t* data, size_t size) {
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// Play kFrames frames, or until a GIF that does not loop forever ends
+static Playback Play(const lv_img_dsc_t& dsc, bool hash) {
+    using Clock = std::chrono::steady_clock;
+    Playback playback;
+    LvglGif gif(&dsc);
+    if (!gif.IsLoaded()) {
+        return playback;
+    }
+    auto image = gif.image_dsc();
+    gif.SetFrameCallback([&]() {
+        playback.frames++;
+        lv_area_t area;
+        if (gif.GetDirtyArea(area)) {
+            playback.dirty_bytes += lv_area_get_width(&area) * lv_area_get_height(&area) * 2;
+        }
+        if (hash) {
+            playback.hashes.push_back(Hash(image->data, image->data_size));
+        }
+    });
+    gif.Start();
+    auto start = Clock::now();
+    while (playback.frames < kFrames && gif.IsPlaying()) {
+        lv_host_tick += 10;
+        lv_timer_handler();
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    playback.frames_per_second = playback.frames / seconds;
+    return playback;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        printf("Usage: %s gif_directory\n", argv[0]);
+        return 1;
+    }
+    std::vector<std::filesystem::path> paths;
+    for (auto& entry : std::filesystem::directory_iterator(argv[1])) {
+        if (entry.path().extension() == ".gif") {
+            paths.push_back(entry.path());
+        }
+    }
+    std::sort(paths.begin(), paths.end());
+    if (paths.empty()) {
+        printf("No GIFs in %s\n", argv[1]);
+        return 1;
+    }
+
+    auto& frame_cache = GifFrameCache::GetInstance();
+    bool ok = true;
+    printf("%-28s %12s %12s %14s %14s\n", "", "decode fps", "cache fps", "full KB/frame", "dirty KB/frame");
+    for (auto& path : paths) {
+        std::ifstream file(path, std::ios::binary);
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        lv_img_dsc_t dsc = {};
+        dsc.data = data.data();
+        dsc.data_size = data.size();
+
+        frame_cache.Clear();
+        frame_cache.SetBudget(0);
+        auto decoded = Play(dsc, true);
+        frame_cache.Clear();
+        frame_cache.SetBudget(kCacheBudget);
+        auto cached = Play(dsc, true);
+        if (decoded.frames == 0 || decoded.hashes != cached.hashes) {
+            printf("%-28s frames differ with the cache\n", path.filename().c_str());
+            ok = false;
+            continue;
+        }
+
+        frame_cache.Clear();
+        frame_cache.SetBudget(0);
+        decoded = Play(dsc, false);
+        frame_cache.Clear();
+        frame_cache.SetBudget(kCacheBudget);
+        cached = Play(dsc, false);
+
+        LvglGif gif(&dsc);
+        double full_bytes = gif.width() * gif.height() * 2;
+        printf("%-28s %12.0f %12.0f %14.1f %14.1f\n", path.filename().c_str(),
+            decoded.frames_per_second, cached.frames_per_second,
+            full_bytes / 1024, double(cached.dirty_bytes) / cached.frames / 1024);
+    }
+    return ok ? 0 : 1;
+}
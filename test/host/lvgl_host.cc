@@ -0,0 +1,10 @@
+/*
+ * What the LVGL benchmarks need from lvgl_font.cc, which also holds the assets font and is not built here
+ */
+#include "lvgl_font.h"
+
+#include <cstring>
+
+int32_t LvglFont::GetTextWidth(const char* text) {
+    return lv_txt_get_width(text, strlen(text), font(), 0);
+}
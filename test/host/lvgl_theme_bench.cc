@@ -0,0 +1,431 @@
+/*
+ * Theme switches of LcdDisplay on a headless LVGL display: the status bar, the low battery
+ * popup, the emoji label and a full chat list are switched between the light and the dark theme,
+ * once with the previous code (local style properties set on every object by SetupUI and
+ * SetChatMessage, and a SetTheme that walks every label and bubble to set them again) and once
+ * with the shared LvglThemeStyles attached once, where SetTheme is one Apply().
+ *
+ * The objects follow LcdDisplay::SetupUI of the WeChat style, with the status bar over the chat
+ * list of lvgl_chat_list.h and the screen standing in for container_. After every switch the LVGL
+ * timers run once with the tick advanced by one refresh period, so every switch is rendered.
+ * Reported: time in SetTheme and in rendering per switch, and the LVGL heap per shown message
+ * and in total, each run starting from a fresh lv_init(). After every switch all objects must
+ * have the colors of the new theme.
+ */
+#include "lvgl_chat_list.h"
+
+#include <chrono>
+#include <cstdio>
+
+#define HOR_RES 320
+#define VER_RES 240
+#define MESSAGE_COUNT 60
+#define SWITCH_COUNT 200
+
+static uint32_t tick = 0;
+
+static void Flush(lv_display_t* display, const lv_area_t* area, uint8_t* pixels) {
+    lv_display_flush_ready(display);
+}
+
+// The objects of LcdDisplay::SetupUI besides the chat list
+struct ScreenObjects {
+    lv_obj_t* status_bar_ = nullptr;
+    lv_obj_t* network_label_ = nullptr;
+    lv_obj_t* notification_label_ = nullptr;
+    lv_obj_t* status_label_ = nullptr;
+    lv_obj_t* mute_label_ = nullptr;
+    lv_obj_t* battery_label_ = nullptr;
+    lv_obj_t* low_battery_popup_ = nullptr;
+    lv_obj_t* low_battery_label_ = nullptr;
+    lv_obj_t* emoji_label_ = nullptr;
+};
+
+// LcdDisplay::SetupUI and SetTheme before the styles were shared
+class BaselineScreen : public BaselineChatList, public ScreenObjects {
+public:
+    BaselineScreen(LvglTheme* theme) : BaselineChatList(theme) {
+        auto text_font = theme->text_font()->font();
+        auto icon_font = theme->icon_font()->font();
+        auto large_icon_font = theme->large_icon_font()->font();
+
+        auto screen = lv_screen_active();
+        lv_obj_set_style_text_font(screen, text_font, 0);
+        lv_obj_set_style_text_color(screen, theme->text_color(), 0);
+        lv_obj_set_style_bg_color(screen, theme->background_color(), 0);
+
+        status_bar_ = lv_obj_create(screen);
+        lv_obj_set_size(status_bar_, LV_HOR_RES, LV_SIZE_CONTENT);
+        lv_obj_set_style_radius(status_bar_, 0, 0);
+        lv_obj_set_style_bg_color(status_bar_, theme->background_color(), 0);
+        lv_obj_set_style_text_color(status_bar_, theme->text_color(), 0);
+        lv_obj_set_flex_flow(status_bar_, LV_FLEX_FLOW_ROW);
+        lv_obj_set_style_pad_all(status_bar_, 0, 0);
+        lv_obj_set_style_border_width(status_bar_, 0, 0);
+        lv_obj_set_style_pad_column(status_bar_, 0, 0);
+        lv_obj_set_style_pad_top(status_bar_, theme->spacing(2), 0);
+        lv_obj_set_style_pad_bottom(status_bar_, theme->spacing(2), 0);
+        lv_obj_set_style_pad_left(status_bar_, theme->spacing(4), 0);
+        lv_obj_set_style_pad_right(status_bar_, theme->spacing(4), 0);
+        lv_obj_set_scrollbar_mode(status_bar_, LV_SCROLLBAR_MODE_OFF);
+        lv_obj_set_flex_align(status_bar_, LV_FLEX_ALIGN_SPACE_BETWEEN, LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_CENTER);
+
+        network_label_ = lv_label_create(status_bar_);
+        lv_label_set_text(network_label_, LV_SYMBOL_WIFI);
+        lv_obj_set_style_text_font(network_label_, icon_font, 0);
+        lv_obj_set_style_text_color(network_label_, theme->text_color(), 0);
+
+        notification_label_ = lv_label_create(status_bar_);
+        lv_obj_set_flex_grow(notification_label_, 1);
+        lv_obj_set_style_text_align(notification_label_, LV_TEXT_ALIGN_CENTER, 0);
+        lv_obj_set_style_text_color(notification_label_, theme->text_color(), 0);
+        lv_label_set_text(notification_label_, "");
+        lv_obj_add_flag(notification_label_, LV_OBJ_FLAG_HIDDEN);
+
+        status_label_ = lv_label_create(status_bar_);
+        lv_obj_set_flex_grow(status_label_, 1);
+        lv_label_set_long_mode(status_label_, LV_LABEL_LONG_SCROLL_CIRCULAR);
+        lv_obj_set_style_text_align(status_label_, LV_TEXT_ALIGN_CENTER, 0);
+        lv_obj_set_style_text_color(status_label_, theme->text_color(), 0);
+        lv_label_set_text(status_label_, "Standby");
+
+        mute_label_ = lv_label_create(status_bar_);
+        lv_label_set_text(mute_label_, "");
+        lv_obj_set_style_text_font(mute_label_, icon_font, 0);
+        lv_obj_set_style_text_color(mute_label_, theme->text_color(), 0);
+
+        battery_label_ = lv_label_create(status_bar_);
+        lv_label_set_text(battery_label_, LV_SYMBOL_BATTERY_3);
+        lv_obj_set_style_text_font(battery_label_, icon_font, 0);
+        lv_obj_set_style_text_color(battery_label_, theme->text_color(), 0);
+        lv_obj_set_style_margin_left(battery_label_, theme->spacing(2), 0);
+
+        low_battery_popup_ = lv_obj_create(screen);
+        lv_obj_set_scrollbar_mode(low_battery_popup_, LV_SCROLLBAR_MODE_OFF);
+        lv_obj_set_size(low_battery_popup_, LV_HOR_RES * 0.9, text_font->line_height * 2);
+        lv_obj_align(low_battery_popup_, LV_ALIGN_BOTTOM_MID, 0, -theme->spacing(4));
+        lv_obj_set_style_bg_color(low_battery_popup_, theme->low_battery_color(), 0);
+        lv_obj_set_style_radius(low_battery_popup_, theme->spacing(4), 0);
+        low_battery_label_ = lv_label_create(low_battery_popup_);
+        lv_label_set_text(low_battery_label_, "Low battery");
+        lv_obj_set_style_text_color(low_battery_label_, lv_color_white(), 0);
+        lv_obj_center(low_battery_label_);
+
+        emoji_label_ = lv_label_create(screen);
+        lv_obj_center(emoji_label_);
+        lv_obj_set_style_text_font(emoji_label_, large_icon_font, 0);
+        lv_obj_set_style_text_color(emoji_label_, theme->text_color(), 0);
+        lv_label_set_text(emoji_label_, LV_SYMBOL_AUDIO);
+    }
+
+    void SetTheme(LvglTheme* theme) {
+        lv_obj_t* screen = lv_screen_active();
+
+        auto text_font = theme->text_font()->font();
+        auto icon_font = theme->icon_font()->font();
+        auto large_icon_font = theme->large_icon_font()->font();
+
+        if (text_font->line_height >= 40) {
+            lv_obj_set_style_text_font(mute_label_, large_icon_font, 0);
+            lv_obj_set_style_text_font(battery_label_, large_icon_font, 0);
+            lv_obj_set_style_text_font(network_label_, large_icon_font, 0);
+        } else {
+            lv_obj_set_style_text_font(mute_label_, icon_font, 0);
+            lv_obj_set_style_text_font(battery_label_, icon_font, 0);
+            lv_obj_set_style_text_font(network_label_, icon_font, 0);
+        }
+
+        lv_obj_set_style_text_font(screen, text_font, 0);
+        lv_obj_set_style_text_color(screen, theme->text_color(), 0);
+
+        lv_obj_set_style_bg_image_src(screen, nullptr, 0);
+        lv_obj_set_style_bg_color(screen, theme->background_color(), 0);
+
+        lv_obj_set_style_bg_opa(status_bar_, LV_OPA_50, 0);
+        lv_obj_set_style_bg_color(status_bar_, theme->background_color(), 0);
+
+        lv_obj_set_style_text_color(network_label_, theme->text_color(), 0);
+        lv_obj_set_style_text_color(status_label_, theme->text_color(), 0);
+        lv_obj_set_style_text_color(notification_label_, theme->text_color(), 0);
+        lv_obj_set_style_text_color(mute_label_, theme->text_color(), 0);
+        lv_obj_set_style_text_color(battery_label_, theme->text_color(), 0);
+        lv_obj_set_style_text_color(emoji_label_, theme->text_color(), 0);
+
+        lv_obj_set_style_bg_opa(content_, LV_OPA_TRANSP, 0);
+
+        uint32_t child_count = lv_obj_get_child_cnt(content_);
+        for (uint32_t i = 0; i < child_count; i++) {
+            lv_obj_t* obj = lv_obj_get_child(content_, i);
+            if (obj == nullptr) continue;
+
+            lv_obj_t* bubble = nullptr;
+            if (lv_obj_get_child_cnt(obj) > 0) {
+                lv_opa_t bg_opa = lv_obj_get_style_bg_opa(obj, 0);
+                if (bg_opa == LV_OPA_TRANSP) {
+                    bubble = lv_obj_get_child(obj, 0);
+                } else {
+                    bubble = obj;
+                }
+            } else {
+                continue;
+            }
+
+            if (bubble == nullptr) continue;
+
+            void* bubble_type_ptr = lv_obj_get_user_data(bubble);
+            if (bubble_type_ptr != nullptr) {
+                const char* bubble_type = static_cast<const char*>(bubble_type_ptr);
+
+                if (strcmp(bubble_type, "user") == 0) {
+                    lv_obj_set_style_bg_color(bubble, theme->user_bubble_color(), 0);
+                } else if (strcmp(bubble_type, "assistant") == 0) {
+                    lv_obj_set_style_bg_color(bubble, theme->assistant_bubble_color(), 0);
+                } else if (strcmp(bubble_type, "system") == 0) {
+                    lv_obj_set_style_bg_color(bubble, theme->system_bubble_color(), 0);
+                } else if (strcmp(bubble_type, "image") == 0) {
+                    lv_obj_set_style_bg_color(bubble, theme->system_bubble_color(), 0);
+                }
+
+                lv_obj_set_style_border_color(bubble, theme->border_color(), 0);
+
+                if (lv_obj_get_child_cnt(bubble) > 0) {
+                    lv_obj_t* text = lv_obj_get_child(bubble, 0);
+                    if (text != nullptr) {
+                        if (strcmp(bubble_type, "system") == 0) {
+                            lv_obj_set_style_text_color(text, theme->system_text_color(), 0);
+                        } else {
+                            lv_obj_set_style_text_color(text, theme->text_color(), 0);
+                        }
+                    }
+                }
+            }
+        }
+
+        lv_obj_set_style_bg_color(low_battery_popup_, theme->low_battery_color(), 0);
+        theme_ = theme;
+    }
+};
+
+// LcdDisplay::SetupUI and SetTheme with the shared styles
+class SharedStyleScreen : public RecycledChatList, public ScreenObjects {
+public:
+    SharedStyleScreen(LvglTheme* theme) : RecycledChatList(theme) {
+        auto text_font = theme->text_font()->font();
+
+        auto screen = lv_screen_active();
+        lv_obj_set_style_text_font(screen, text_font, 0);
+        lv_obj_set_style_text_color(screen, theme->text_color(), 0);
+        styles_.Attach(screen, {kLvglStyleBackground});
+
+        status_bar_ = lv_obj_create(screen);
+        lv_obj_set_size(status_bar_, LV_HOR_RES, LV_SIZE_CONTENT);
+        styles_.Attach(status_bar_, {kLvglStyleStatusBar});
+        lv_obj_set_flex_flow(status_bar_, LV_FLEX_FLOW_ROW);
+        lv_obj_set_scrollbar_mode(status_bar_, LV_SCROLLBAR_MODE_OFF);
+        lv_obj_set_flex_align(status_bar_, LV_FLEX_ALIGN_SPACE_BETWEEN, LV_FLEX_ALIGN_CENTER, LV_FLEX_ALIGN_CENTER);
+
+        network_label_ = lv_label_create(status_bar_);
+        lv_label_set_text(network_label_, LV_SYMBOL_WIFI);
+        styles_.Attach(network_label_, {kLvglStyleIcon});
+
+        notification_label_ = lv_label_create(status_bar_);
+        lv_obj_set_flex_grow(notification_label_, 1);
+        lv_obj_set_style_text_align(notification_label_, LV_TEXT_ALIGN_CENTER, 0);
+        lv_label_set_text(notification_label_, "");
+        lv_obj_add_flag(notification_label_, LV_OBJ_FLAG_HIDDEN);
+
+        status_label_ = lv_label_create(status_bar_);
+        lv_obj_set_flex_grow(status_label_, 1);
+        lv_label_set_long_mode(status_label_, LV_LABEL_LONG_SCROLL_CIRCULAR);
+        lv_obj_set_style_text_align(status_label_, LV_TEXT_ALIGN_CENTER, 0);
+        lv_label_set_text(status_label_, "Standby");
+
+        mute_label_ = lv_label_create(status_bar_);
+        lv_label_set_text(mute_label_, "");
+        styles_.Attach(mute_label_, {kLvglStyleIcon});
+
+        battery_label_ = lv_label_create(status_bar_);
+        lv_label_set_text(battery_label_, LV_SYMBOL_BATTERY_3);
+        styles_.Attach(battery_label_, {kLvglStyleIcon});
+        lv_obj_set_style_margin_left(battery_label_, theme->spacing(2), 0);
+
+        low_battery_popup_ = lv_obj_create(screen);
+        lv_obj_set_scrollbar_mode(low_battery_popup_, LV_SCROLLBAR_MODE_OFF);
+        lv_obj_set_size(low_battery_popup_, LV_HOR_RES * 0.9, text_font->line_height * 2);
+        lv_obj_align(low_battery_popup_, LV_ALIGN_BOTTOM_MID, 0, -theme->spacing(4));
+        styles_.Attach(low_battery_popup_, {kLvglStylePopup});
+        low_battery_label_ = lv_label_create(low_battery_popup_);
+        lv_label_set_text(low_battery_label_, "Low battery");
+        styles_.Attach(low_battery_label_, {kLvglStylePopupText});
+        lv_obj_center(low_battery_label_);
+
+        emoji_label_ = lv_label_create(screen);
+        lv_obj_center(emoji_label_);
+        styles_.Attach(emoji_label_, {kLvglStyleLargeIcon});
+        lv_label_set_text(emoji_label_, LV_SYMBOL_AUDIO);
+    }
+
+    ~SharedStyleScreen() {
+        // The objects use the styles, so they go first
+        lv_obj_delete(status_bar_);
+        lv_obj_delete(low_battery_popup_);
+        lv_obj_delete(emoji_label_);
+        lv_obj_remove_style(lv_screen_active(), styles_.get(kLvglStyleBackground), 0);
+    }
+
+    void SetTheme(LvglTheme* theme) {
+        lv_obj_t* screen = lv_screen_active();
+        lv_obj_set_style_text_font(screen, theme->text_font()->font(), 0);
+        lv_obj_set_style_text_color(screen, theme->text_color(), 0);
+
+        lv_obj_set_style_bg_opa(status_bar_, LV_OPA_50, 0);
+        lv_obj_set_style_bg_opa(content_, LV_OPA_TRANSP, 0);
+
+        styles_.Apply(theme);
+        theme_ = theme;
+    }
+};
+
+static void InitializeThemes(LvglTheme& light, LvglTheme& dark) {
+    auto font = std::make_shared<LvglBuiltInFont>(&lv_font_montserrat_14);
+    for (auto theme : { &light, &dark }) {
+        theme->set_text_font(font);
+        theme->set_icon_font(font);
+        theme->set_large_icon_font(font);
+    }
+
+    // The colors of LcdDisplay::InitializeLcdThemes
+    light.set_background_color(lv_color_hex(0xFFFFFF));
+    light.set_text_color(lv_color_hex(0x000000));
+    light.set_chat_background_color(lv_color_hex(0xE0E0E0));
+    light.set_user_bubble_color(lv_color_hex(0x00FF00));
+    light.set_assistant_bubble_color(lv_color_hex(0xDDDDDD));
+    light.set_system_bubble_color(lv_color_hex(0xFFFFFF));
+    light.set_system_text_color(lv_color_hex(0x000000));
+    light.set_border_color(lv_color_hex(0x000000));
+    light.set_low_battery_color(lv_color_hex(0x000000));
+
+    dark.set_background_color(lv_color_hex(0x000000));
+    dark.set_text_color(lv_color_hex(0xFFFFFF));
+    dark.set_chat_background_color(lv_color_hex(0x1F1F1F));
+    dark.set_user_bubble_color(lv_color_hex(0x00FF00));
+    dark.set_assistant_bubble_color(lv_color_hex(0x222222));
+    dark.set_system_bubble_color(lv_color_hex(0x000000));
+    dark.set_system_text_color(lv_color_hex(0xFFFFFF));
+    dark.set_border_color(lv_color_hex(0xFFFFFF));
+    dark.set_low_battery_color(lv_color_hex(0xFF0000));
+}
+
+// Every shown message label has the text color and its bubble one of the bubble colors of the theme
+static bool BubblesShowTheme(lv_obj_t* obj, LvglTheme* theme) {
+    if (lv_obj_has_flag(obj, LV_OBJ_FLAG_HIDDEN)) {
+        return true;
+    }
+    if (lv_obj_check_type(obj, &lv_label_class)) {
+        lv_color_t text = lv_obj_get_style_text_color(obj, LV_PART_MAIN);
+        lv_color_t bubble = lv_obj_get_style_bg_color(lv_obj_get_parent(obj), LV_PART_MAIN);
+        return (lv_color_eq(text, theme->text_color()) || lv_color_eq(text, theme->system_text_color())) &&
+            (lv_color_eq(bubble, theme->user_bubble_color()) || lv_color_eq(bubble, theme->assistant_bubble_color()) ||
+             lv_color_eq(bubble, theme->system_bubble_color()));
+    }
+    for (uint32_t i = 0; i < lv_obj_get_child_cnt(obj); i++) {
+        if (!BubblesShowTheme(lv_obj_get_child(obj, i), theme)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename Screen>
+static bool ShowsTheme(Screen& screen, LvglTheme* theme) {
+    for (auto label : { screen.network_label_, screen.status_label_, screen.battery_label_, screen.emoji_label_ }) {
+        if (!lv_color_eq(lv_obj_get_style_text_color(label, LV_PART_MAIN), theme->text_color())) {
+            return false;
+        }
+    }
+    return lv_color_eq(lv_obj_get_style_bg_color(screen.status_bar_, LV_PART_MAIN), theme->background_color()) &&
+        lv_color_eq(lv_obj_get_style_bg_color(screen.low_battery_popup_, LV_PART_MAIN), theme->low_battery_color()) &&
+        BubblesShowTheme(screen.content(), theme);
+}
+
+struct Result {
+    double apply_us = 0;
+    double render_us = 0;
+    size_t message_bytes = 0;
+    size_t used = 0;
+    size_t messages = 0;
+    bool shows_theme = true;
+};
+
+static size_t HeapUsed() {
+    lv_mem_monitor_t monitor;
+    lv_mem_monitor(&monitor);
+    return monitor.total_size - monitor.free_size;
+}
+
+template <typename Screen>
+static Result Run(const std::vector<std::pair<const char*, std::string>>& messages) {
+    using Clock = std::chrono::steady_clock;
+    lv_init();
+    lv_tick_set_cb([]() { return tick; });
+    lv_display_t* display = lv_display_create(HOR_RES, VER_RES);
+    static uint8_t buffer[HOR_RES * VER_RES / 10 * 2];
+    lv_display_set_buffers(display, buffer, nullptr, sizeof(buffer), LV_DISPLAY_RENDER_MODE_PARTIAL);
+    lv_display_set_flush_cb(display, Flush);
+
+    Result result;
+    {
+        LvglTheme light("light");
+        LvglTheme dark("dark");
+        InitializeThemes(light, dark);
+
+        Screen screen(&light);
+        tick += LV_DEF_REFR_PERIOD;
+        lv_timer_handler();
+        size_t empty = HeapUsed();
+        for (auto& [role, text] : messages) {
+            screen.SetChatMessage(role, text.c_str());
+            tick += LV_DEF_REFR_PERIOD;
+            lv_timer_handler();
+        }
+        result.used = HeapUsed();
+        result.messages = screen.GetTexts().size();
+        result.message_bytes = (result.used - empty) / std::max<size_t>(result.messages, 1);
+
+        LvglTheme* themes[] = { &dark, &light };
+        Clock::duration apply{}, render{};
+        for (int i = 0; i < SWITCH_COUNT; i++) {
+            auto start = Clock::now();
+            screen.SetTheme(themes[i % 2]);
+            auto applied = Clock::now();
+            tick += LV_DEF_REFR_PERIOD;
+            lv_timer_handler();
+            apply += applied - start;
+            render += Clock::now() - applied;
+            result.shows_theme = result.shows_theme && ShowsTheme(screen, themes[i % 2]);
+        }
+        result.apply_us = std::chrono::duration<double, std::micro>(apply).count() / SWITCH_COUNT;
+        result.render_us = std::chrono::duration<double, std::micro>(render).count() / SWITCH_COUNT;
+    }
+    lv_deinit();
+    return result;
+}
+
+int main() {
+    auto messages = CreateMessages(MESSAGE_COUNT);
+    auto before = Run<BaselineScreen>(messages);
+    auto after = Run<SharedStyleScreen>(messages);
+
+    printf("%d theme switches\n", SWITCH_COUNT);
+    printf("%-10s %12s %12s %10s %16s %12s\n", "", "apply us", "render us", "messages", "heap B/message", "heap KB");
+    bool ok = true;
+    for (auto& [name, result] : { std::make_pair("local", &before), std::make_pair("shared", &after) }) {
+        printf("%-10s %12.1f %12.1f %10zu %16zu %12.1f\n", name, result->apply_us, result->render_us,
+            result->messages, result->message_bytes, result->used / 1024.0);
+        if (!result->shows_theme) {
+            printf("%s styles do not show the theme after a switch\n", name);
+            ok = false;
+        }
+    }
+    return ok ? 0 : 1;
+}
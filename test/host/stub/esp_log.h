@@ -0,0 +1,13 @@
+#ifndef ESP_LOG_H
+#define ESP_LOG_H
+
+// Host stand-in for the ESP-IDF logging macros, debug and verbose logs are dropped
+#include <stdio.h>
+
+#define ESP_LOGE(tag, format, ...) printf("E (%s) " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) printf("W (%s) " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) printf("I (%s) " format "\n", tag, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) do {} while (0)
+#define ESP_LOGV(tag, format, ...) do {} while (0)
+
+#endif // ESP_LOG_H
@@ -0,0 +1,6 @@
+#ifndef ESP_PM_H
+#define ESP_PM_H
+
+// Host stand-in, display.h includes the power management header but the benchmarks take no locks
+
+#endif // ESP_PM_H
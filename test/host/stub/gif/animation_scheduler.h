@@ -0,0 +1,24 @@
+#ifndef ANIMATION_SCHEDULER_H
+#define ANIMATION_SCHEDULER_H
+
+#include <cstdint>
+
+// Host stand-in that lets every frame through, the benchmark measures the decoder and the cache, not pacing
+class AnimationScheduler {
+public:
+    static AnimationScheduler& GetInstance() {
+        static AnimationScheduler instance;
+        return instance;
+    }
+
+    bool CanPresent() { return true; }
+    void FramePresented(uint32_t dropped = 0) {
+        presented_frames++;
+        dropped_frames += dropped;
+    }
+
+    uint32_t presented_frames = 0;
+    uint32_t dropped_frames = 0;
+};
+
+#endif // ANIMATION_SCHEDULER_H
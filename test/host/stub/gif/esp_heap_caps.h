@@ -0,0 +1,15 @@
+#ifndef ESP_HEAP_CAPS_H
+#define ESP_HEAP_CAPS_H
+
+// Host stand-in for the capability based allocator, every capability is the host heap
+#include <stdint.h>
+#include <stdlib.h>
+
+#define MALLOC_CAP_SPIRAM (1 << 10)
+#define MALLOC_CAP_INTERNAL (1 << 11)
+#define MALLOC_CAP_8BIT (1 << 2)
+
+static inline void* heap_caps_malloc(size_t size, uint32_t caps) { return malloc(size); }
+static inline void heap_caps_free(void* ptr) { free(ptr); }
+
+#endif // ESP_HEAP_CAPS_H
@@ -0,0 +1,139 @@
+#ifndef LVGL_H
+#define LVGL_H
+
+/*
+ * Host stand-in for the parts of LVGL used by the GIF decoder and LvglGif.
+ * Timers only run when the benchmark calls lv_timer_handler(), and the tick is
+ * whatever the benchmark sets lv_host_tick to, so playback does not depend on the host clock.
+ */
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// No assembly draw kernels on the host, gifdec uses its portable C loops
+#define LV_DRAW_SW_ASM_NONE 0
+#define LV_DRAW_SW_ASM_HELIUM 2
+#define LV_USE_DRAW_SW_ASM LV_DRAW_SW_ASM_NONE
+
+#define LV_MIN(a, b) ((a) < (b) ? (a) : (b))
+#define LV_MAX(a, b) ((a) > (b) ? (a) : (b))
+
+#define lv_malloc malloc
+#define lv_realloc realloc
+#define lv_free free
+
+// The benchmarks only open GIFs from memory
+typedef int lv_fs_res_t;
+typedef struct {
+    int unused;
+} lv_fs_file_t;
+
+#define LV_FS_RES_OK 0
+#define LV_FS_MODE_RD 1
+#define LV_FS_SEEK_SET 0
+#define LV_FS_SEEK_CUR 1
+
+static inline lv_fs_res_t lv_fs_open(lv_fs_file_t* file, const char* path, int mode) { return -1; }
+static inline lv_fs_res_t lv_fs_read(lv_fs_file_t* file, void* buffer, uint32_t length, uint32_t* read) { return -1; }
+static inline lv_fs_res_t lv_fs_seek(lv_fs_file_t* file, uint32_t position, int whence) { return -1; }
+static inline lv_fs_res_t lv_fs_tell(lv_fs_file_t* file, uint32_t* position) { return -1; }
+static inline lv_fs_res_t lv_fs_close(lv_fs_file_t* file) { return LV_FS_RES_OK; }
+
+typedef struct {
+    int32_t x1;
+    int32_t y1;
+    int32_t x2;
+    int32_t y2;
+} lv_area_t;
+
+static inline void lv_area_set(lv_area_t* area, int32_t x1, int32_t y1, int32_t x2, int32_t y2) {
+    area->x1 = x1;
+    area->y1 = y1;
+    area->x2 = x2;
+    area->y2 = y2;
+}
+static inline int32_t lv_area_get_width(const lv_area_t* area) { return area->x2 - area->x1 + 1; }
+static inline int32_t lv_area_get_height(const lv_area_t* area) { return area->y2 - area->y1 + 1; }
+
+#define LV_IMAGE_HEADER_MAGIC 0x19
+#define LV_IMAGE_FLAGS_MODIFIABLE 0x0008
+#define LV_COLOR_FORMAT_ARGB8888 0x10
+
+typedef struct {
+    uint32_t magic;
+    uint32_t cf;
+    uint32_t flags;
+    uint32_t w;
+    uint32_t h;
+    uint32_t stride;
+} lv_image_header_t;
+
+typedef struct {
+    lv_image_header_t header;
+    uint32_t data_size;
+    const uint8_t* data;
+} lv_image_dsc_t;
+typedef lv_image_dsc_t lv_img_dsc_t;
+
+extern uint32_t lv_host_tick;
+
+static inline uint32_t lv_tick_get(void) { return lv_host_tick; }
+static inline uint32_t lv_tick_elaps(uint32_t prev_tick) { return lv_host_tick - prev_tick; }
+
+typedef struct lv_timer_t lv_timer_t;
+typedef void (*lv_timer_cb_t)(lv_timer_t* timer);
+
+struct lv_timer_t {
+    lv_timer_cb_t cb;
+    void* user_data;
+    bool paused;
+    lv_timer_t* next;
+};
+
+extern lv_timer_t* lv_host_timers;
+
+static inline lv_timer_t* lv_timer_create(lv_timer_cb_t cb, uint32_t period, void* user_data) {
+    lv_timer_t* timer = (lv_timer_t*)calloc(1, sizeof(lv_timer_t));
+    timer->cb = cb;
+    timer->user_data = user_data;
+    timer->next = lv_host_timers;
+    lv_host_timers = timer;
+    return timer;
+}
+static inline void lv_timer_delete(lv_timer_t* timer) {
+    for (lv_timer_t** link = &lv_host_timers; *link != NULL; link = &(*link)->next) {
+        if (*link == timer) {
+            *link = timer->next;
+            break;
+        }
+    }
+    free(timer);
+}
+static inline void* lv_timer_get_user_data(lv_timer_t* timer) { return timer->user_data; }
+static inline void lv_timer_pause(lv_timer_t* timer) { timer->paused = true; }
+static inline void lv_timer_resume(lv_timer_t* timer) { timer->paused = false; }
+static inline void lv_timer_reset(lv_timer_t* timer) {}
+
+// Run every timer that is not paused once, a timer may delete itself from its callback
+static inline void lv_timer_handler(void) {
+    lv_timer_t* timer = lv_host_timers;
+    while (timer != NULL) {
+        lv_timer_t* next = timer->next;
+        if (!timer->paused) {
+            timer->cb(timer);
+        }
+        timer = next;
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LVGL_H